@@ -11,19 +11,30 @@ friend class BiomorphInstance;
 public:
 	BiomorphBase()
 		: mRefcount(0)
+		, mSpeculationRoot(0)
+		, mFailed(false)
 	{
 		mTexture.Invalidate();
 	}
 
-	inline bool IsValid()
+	// valid once the generated texture has been published
+	inline bool IsValid() const
 	{
 		return mTexture.IsValid();
 	}
 
+	// set when the generator couldn't build it; requesting it again retries
+	inline bool HasFailed() const
+	{
+		return mFailed;
+	}
+
 private:
 	Texture2D mTexture;
 	MorphDNA mDNA;
 	int mRefcount;
+	StringHashing::StringHash mSpeculationRoot;	// kept alive while this dna is being speculated from
+	bool mFailed;
 };
 
 class BiomorphInstance
@@ -45,9 +56,32 @@ public:
 		return NULL;
 	}
 
+	const MorphDNA* GetDNA() const
+	{
+		if( mBase )
+		{
+			return &mBase->mDNA;
+		}
+
+		return NULL;
+	}
+
+	// true once the biomorph has been generated and its texture can be used
 	inline bool IsValid() const
 	{
-		return mBase != NULL;
+		return mBase != NULL && mBase->IsValid();
+	}
+
+	// true while the biomorph is still queued / being generated
+	inline bool IsPending() const
+	{
+		return mBase != NULL && !mBase->IsValid() && !mBase->HasFailed();
+	}
+
+	// true if the generator gave up on it, it will never become valid
+	inline bool HasFailed() const
+	{
+		return mBase != NULL && mBase->HasFailed();
 	}
 
 private:
@@ -0,0 +1,256 @@
+#include "biomorph_archive.h"
+#include <string.h>
+
+namespace
+{
+	inline uint_64 AlignUp( uint_64 v, uint_64 alignment )
+	{
+		return (v + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+BiomorphArchive::BiomorphArchive()
+{
+	memset( &mHeader, 0, sizeof(mHeader) );
+}
+
+BiomorphArchive::~BiomorphArchive()
+{
+	Close();
+}
+
+bool BiomorphArchive::Open( const char* fileName )
+{
+	if( IsOpen() || !mFile.Open( fileName, false ) )
+	{
+		return false;
+	}
+
+	const uint_64 fileSize = mFile.GetFileSize();
+	MappedView view;
+	bool valid = view.Map( mFile, 0, fileSize < sizeof(Header) ? (size_t)fileSize : sizeof(Header) );
+	if( valid )
+	{
+		memcpy( &mHeader, view.GetData(), view.GetSize() );
+	}
+	valid = valid && memcmp( mHeader.mMagic, "BARC", 4 ) == 0 && mHeader.mVersion == kVersion;
+
+	// blobs are mapped straight from their offsets, so they must sit on the alignment the
+	// writer uses
+	valid = valid && mHeader.mBlobAlignment == kBlobAlignment;
+
+	// only the index is read here, copied out so its view can go straight away
+	const uint_64 indexSize = (uint_64)mHeader.mEntryCount * sizeof(Entry);
+	valid = valid && fileSize >= sizeof(Header) && indexSize <= fileSize - sizeof(Header) && indexSize <= (size_t)-1;
+	valid = valid && (mHeader.mEntryCount == 0 || view.Map( mFile, sizeof(Header), (size_t)indexSize ));
+
+	const uint_64 blobSize = (uint_64)mHeader.mWidth * mHeader.mHeight * mHeader.mPixelSize;
+	mEntries.resize( valid ? mHeader.mEntryCount : 0 );
+	if( valid && mHeader.mEntryCount > 0 )
+	{
+		memcpy( &mEntries[0], view.GetData(), (size_t)indexSize );
+	}
+	for( unsigned int i = 0; valid && i < mHeader.mEntryCount; ++i )
+	{
+		const Entry& e = mEntries[i];
+		valid = e.mOffset % kBlobAlignment == 0 && e.mOffset <= fileSize && blobSize <= fileSize - e.mOffset;
+	}
+
+	if( !valid )
+	{
+		printf("'%s' is not a biomorph archive\n", fileName);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void BiomorphArchive::Close()
+{
+	mPixelView.Unmap();
+	mFile.Close();
+	mEntries.clear();
+	memset( &mHeader, 0, sizeof(mHeader) );
+}
+
+int BiomorphArchive::Find( const MorphDNA& dna ) const
+{
+	// binary search of the sorted index
+	unsigned int first = 0;
+	unsigned int last = GetEntryCount();
+	while( first < last )
+	{
+		const unsigned int middle = first + (last - first) / 2;
+		const Entry& e = mEntries[middle];
+		if( e.mSequence0 < dna.mFullSequence0 || (e.mSequence0 == dna.mFullSequence0 && e.mSequence1 < dna.mFullSequence1) )
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	if( first < GetEntryCount() && mEntries[first].mSequence0 == dna.mFullSequence0 && mEntries[first].mSequence1 == dna.mFullSequence1 )
+	{
+		return (int)first;
+	}
+
+	return -1;
+}
+
+const void* BiomorphArchive::MapPixels( unsigned int index )
+{
+	const size_t blobSize = (size_t)GetRowSize() * mHeader.mHeight;
+	if( index >= GetEntryCount() || !mPixelView.Map( mFile, mEntries[index].mOffset, blobSize ) )
+	{
+		return NULL;
+	}
+
+	return mPixelView.GetData();
+}
+
+BiomorphArchiveWriter::BiomorphArchiveWriter()
+	: mFile(NULL)
+	, mEntries(NULL)
+	, mMaxEntries(0)
+	, mOffset(0)
+	, mFailed(false)
+{
+}
+
+BiomorphArchiveWriter::~BiomorphArchiveWriter()
+{
+	Close();
+}
+
+bool BiomorphArchiveWriter::Open( const char* fileName, unsigned int maxEntries, unsigned int width, unsigned int height, unsigned int format, unsigned int pixelSize, unsigned int session )
+{
+	if( mFile != NULL )
+	{
+		return false;
+	}
+
+	mFile = fopen( fileName, "wb" );
+	if( mFile == NULL )
+	{
+		printf("Failed to open archive '%s'\n", fileName);
+		return false;
+	}
+
+	memcpy( mHeader.mMagic, "BARC", 4 );
+	mHeader.mVersion = BiomorphArchive::kVersion;
+	mHeader.mEntryCount = 0;
+	mHeader.mWidth = width;
+	mHeader.mHeight = height;
+	mHeader.mFormat = format;
+	mHeader.mPixelSize = pixelSize;
+	mHeader.mBlobAlignment = BiomorphArchive::kBlobAlignment;
+	mHeader.mSession = session;
+	mHeader.mReserved = 0;
+
+	mMaxEntries = maxEntries;
+	mEntries = new BiomorphArchive::Entry[maxEntries > 0 ? maxEntries : 1];
+	memset( mEntries, 0, sizeof(BiomorphArchive::Entry) * mMaxEntries );
+	mOffset = 0;
+	mFailed = false;
+
+	// room for the full index, it is filled in on close
+	mFailed = fwrite( &mHeader, sizeof(mHeader), 1, mFile ) != 1;
+	mOffset = sizeof(mHeader);
+	mFailed = mFailed || (mMaxEntries > 0 && fwrite( mEntries, sizeof(BiomorphArchive::Entry) * mMaxEntries, 1, mFile ) != 1);
+	mOffset += sizeof(BiomorphArchive::Entry) * mMaxEntries;
+
+	return !mFailed;
+}
+
+bool BiomorphArchiveWriter::AddEntry( const MorphDNA& dna, const void* pixels, unsigned int rowPitch, unsigned int lastUsed )
+{
+	if( mFile == NULL || mFailed || mHeader.mEntryCount >= mMaxEntries )
+	{
+		return false;
+	}
+
+	if( mHeader.mEntryCount > 0 )
+	{
+		MorphDNA previous;
+		previous.mFullSequence0 = mEntries[mHeader.mEntryCount - 1].mSequence0;
+		previous.mFullSequence1 = mEntries[mHeader.mEntryCount - 1].mSequence1;
+		if( !BiomorphArchive::IsLess( previous, dna ) )
+		{
+			printf("Biomorph archive entries out of order\n");
+			return false;
+		}
+	}
+
+	// each blob starts on its own page
+	mFailed = !_pad( AlignUp( mOffset, BiomorphArchive::kBlobAlignment ) - mOffset );
+
+	BiomorphArchive::Entry& e = mEntries[mHeader.mEntryCount];
+	e.mSequence0 = dna.mFullSequence0;
+	e.mSequence1 = dna.mFullSequence1;
+	e.mOffset = mOffset;
+	e.mLastUsed = lastUsed;
+
+	const unsigned int rowSize = mHeader.mWidth * mHeader.mPixelSize;
+	const unsigned char* row = (const unsigned char*)pixels;
+	for( unsigned int y = 0; y < mHeader.mHeight && !mFailed; ++y )
+	{
+		mFailed = fwrite( row, rowSize, 1, mFile ) != 1;
+		row += rowPitch;
+	}
+
+	if( mFailed )
+	{
+		printf("Failed to write biomorph to the archive\n");
+		return false;
+	}
+
+	mOffset += (uint_64)rowSize * mHeader.mHeight;
+	++mHeader.mEntryCount;
+	return true;
+}
+
+bool BiomorphArchiveWriter::Close()
+{
+	if( mFile == NULL )
+	{
+		return false;
+	}
+
+	// unused index slots stay zeroed after the real entries
+	if( !mFailed )
+	{
+		mFailed = fseek( mFile, 0, SEEK_SET ) != 0;
+		mFailed = mFailed || fwrite( &mHeader, sizeof(mHeader), 1, mFile ) != 1;
+		mFailed = mFailed || (mHeader.mEntryCount > 0 && fwrite( mEntries, sizeof(BiomorphArchive::Entry) * mHeader.mEntryCount, 1, mFile ) != 1);
+	}
+
+	mFailed = fclose( mFile ) != 0 || mFailed;
+	mFile = NULL;
+
+	delete [] mEntries;
+	mEntries = NULL;
+	mMaxEntries = 0;
+
+	return !mFailed;
+}
+
+bool BiomorphArchiveWriter::_pad( uint_64 size )
+{
+	static const unsigned char zeros[BiomorphArchive::kBlobAlignment] = { 0 };
+	while( size > 0 )
+	{
+		const size_t chunk = size < sizeof(zeros) ? (size_t)size : sizeof(zeros);
+		if( fwrite( zeros, chunk, 1, mFile ) != 1 )
+		{
+			return false;
+		}
+		mOffset += chunk;
+		size -= chunk;
+	}
+
+	return true;
+}
\ No newline at end of file
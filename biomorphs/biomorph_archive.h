@@ -0,0 +1,124 @@
+#ifndef BIOMORPH_ARCHIVE_INCLUDED
+#define BIOMORPH_ARCHIVE_INCLUDED
+
+#include "morph_dna.h"
+#include "core\mapped_file.h"
+#include <stdio.h>
+#include <vector>
+
+// Rendered biomorph textures, stored as one file so they survive between sessions
+// The file is a header, an index sorted by the full 128 bit dna, then one page aligned
+// pixel blob per biomorph. Only the index is read when opening; blobs are mapped one view
+// at a time as they are used, so the archive never has to fit in the address space
+class BiomorphArchive
+{
+public:
+	struct Header
+	{
+		char mMagic[4];				// BARC
+		unsigned int mVersion;
+		unsigned int mEntryCount;
+		unsigned int mWidth;
+		unsigned int mHeight;
+		unsigned int mFormat;		// Texture2D::TextureFormat
+		unsigned int mPixelSize;	// bytes
+		unsigned int mBlobAlignment;
+		unsigned int mSession;		// bumped by every export
+		unsigned int mReserved;
+	};
+
+	struct Entry
+	{
+		uint_64 mSequence0;
+		uint_64 mSequence1;
+		uint_64 mOffset;			// from the start of the file
+		unsigned int mLastUsed;		// session it was last loaded or generated in
+		unsigned int mReserved;
+	};
+
+	static const unsigned int kVersion = 1;
+	static const unsigned int kBlobAlignment = 4096;
+
+	BiomorphArchive();
+	~BiomorphArchive();
+
+	bool Open( const char* fileName );
+	void Close();
+
+	inline bool IsOpen() const
+	{
+		return mFile.IsOpen();
+	}
+
+	inline unsigned int GetEntryCount() const
+	{
+		return (unsigned int)mEntries.size();
+	}
+
+	inline const Header& GetHeader() const
+	{
+		return mHeader;
+	}
+
+	// blobs are tightly packed rows
+	inline unsigned int GetRowSize() const
+	{
+		return mHeader.mWidth * mHeader.mPixelSize;
+	}
+
+	inline const Entry& GetEntry( unsigned int index ) const
+	{
+		return mEntries[index];
+	}
+
+	// the index of this dna, or -1 if it isn't in the archive
+	int Find( const MorphDNA& dna ) const;
+
+	// the pixels stay mapped until the next call or Close
+	const void* MapPixels( unsigned int index );
+
+	// index order
+	static inline bool IsLess( const MorphDNA& a, const MorphDNA& b )
+	{
+		return a.mFullSequence0 < b.mFullSequence0 || (a.mFullSequence0 == b.mFullSequence0 && a.mFullSequence1 < b.mFullSequence1);
+	}
+
+private:
+	BiomorphArchive( const BiomorphArchive& );
+	BiomorphArchive& operator=( const BiomorphArchive& );
+
+	MappedFile mFile;
+	MappedView mPixelView;
+	Header mHeader;
+	std::vector<Entry> mEntries;
+};
+
+// Writes an archive a blob at a time, so exporting never holds more than one texture in memory
+// The entry count is an upper bound; the index is written on Close with whatever was added
+class BiomorphArchiveWriter
+{
+public:
+	BiomorphArchiveWriter();
+	~BiomorphArchiveWriter();
+
+	bool Open( const char* fileName, unsigned int maxEntries, unsigned int width, unsigned int height, unsigned int format, unsigned int pixelSize, unsigned int session );
+	bool Close();	// false if anything failed to write
+
+	// entries must be added in ascending dna order (BiomorphArchive::IsLess)
+	bool AddEntry( const MorphDNA& dna, const void* pixels, unsigned int rowPitch, unsigned int lastUsed );
+
+private:
+	BiomorphArchiveWriter( const BiomorphArchiveWriter& );
+	BiomorphArchiveWriter& operator=( const BiomorphArchiveWriter& );
+
+	bool _pad( uint_64 size );
+
+	FILE* mFile;
+	BiomorphArchive::Header mHeader;
+	BiomorphArchive::Entry* mEntries;
+	unsigned int mMaxEntries;
+	uint_64 mOffset;
+	bool mFailed;
+};
+
+#endif
\ No newline at end of file
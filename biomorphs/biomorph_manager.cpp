@@ -1,9 +1,45 @@
 #include "biomorph_manager.h"
-#include "framework\graphics\device.h"
+#include "framework\graphics\idevice.h"
+#include "core\profiler.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	// morph textures are Float32 RGBA
+	const Texture2D::TextureFormat kMorphFormat = Texture2D::TypeFloat32;
+	const unsigned int kMorphPixelSize = sizeof(float) * 4;
+
+	// copies to staging textures are queued this far ahead of the one being written out
+	const int kExportReadbacks = 4;
+
+	// a biomorph going into an exported archive, from the cache or the previous archive
+	struct ExportItem
+	{
+		MorphDNA mDNA;
+		BiomorphBase* mBase;
+		int mArchiveIndex;		// -1 for cached biomorphs, read back from the gpu
+		unsigned int mLastUsed;
+	};
+
+	bool ExportItemLess( const ExportItem& a, const ExportItem& b )
+	{
+		return BiomorphArchive::IsLess( a.mDNA, b.mDNA );
+	}
+
+	// most recently used first, ties in dna order so eviction doesn't depend on the sort
+	bool ExportItemNewer( const ExportItem& a, const ExportItem& b )
+	{
+		return a.mLastUsed > b.mLastUsed || (a.mLastUsed == b.mLastUsed && BiomorphArchive::IsLess( a.mDNA, b.mDNA ));
+	}
+}
 
 BiomorphManager::BiomorphManager()
 	: mDevice(NULL)
+	, mSpeculationRoot(0)
+	, mArchiveUnreadable(false)
 {
+	mArchiveFileName[0] = '\0';
 }
 
 BiomorphManager::~BiomorphManager()
@@ -11,7 +47,7 @@ BiomorphManager::~BiomorphManager()
 	Release();
 }
 
-bool BiomorphManager::Initialise( Device* d, Parameters& p )
+bool BiomorphManager::Initialise( IDevice* d, Parameters& p )
 {
 	MorphRender::Parameters mp;
 	mp.mTextureHeight = p.TextureSize;
@@ -22,13 +58,32 @@ bool BiomorphManager::Initialise( Device* d, Parameters& p )
 		return false;
 	}
 
+	if( !mGenerator.Initialise( p.GeneratorThreads ) )
+	{
+		return false;
+	}
+
 	mDevice = d;
+	mParams = p;
 
 	return true;
 }
 
+void BiomorphManager::SetDevice( IDevice* d )
+{
+	mDevice = d;
+	mMorphRenderer.SetDevice( d );
+}
+
 void BiomorphManager::Release()
 {
+	if( mDevice == NULL )
+	{
+		return;
+	}
+
+	// stop the generator before the renderer goes away
+	mGenerator.Release();
 	mMorphRenderer.Release();
 
 	for( BiomorphMap::iterator it = mBiomorphs.begin();
@@ -40,56 +95,215 @@ void BiomorphManager::Release()
 			printf("Biomorph still has references!");
 		}
 		mDevice->Release( (*it).second->mTexture );
+		delete (*it).second;
 	}
 
 	mBiomorphs.erase( mBiomorphs.begin(), mBiomorphs.end() );
+	mArchive.Close();
+	mArchiveUsed.clear();
+	mDevice = NULL;
+}
+
+void BiomorphManager::_renderToBase( BiomorphBase* base )
+{
+	base->mTexture = mMorphRenderer.CopyOutputTexture( base->mTexture );
+	base->mFailed = false;
 }
 
 bool BiomorphManager::GenerateBiomorph( MorphDNA& dna )
 {
 	StringHashing::StringHash morphHash = dna.GetHash();
 	BiomorphMap::iterator it = mBiomorphs.find( morphHash );
+	BiomorphBase* base = NULL;
 	if( it != mBiomorphs.end() )
 	{
 		// test the values. if they dont match, we have a hash collision
 		if( (*it).second->mDNA != dna )
 		{
 			printf("Hash collision! This is very bad!\n");
+			return false;
+		}
+
+		if( (*it).second->IsValid() )
+		{
+			return false;
 		}
+
+		// still pending on the generator; build it now instead
+		base = (*it).second;
 	}
 	else
 	{
-		// generate the biomorph texture
-		mMorphRenderer.StartRendering();
-		mMorphRenderer.DrawBiomorph( dna );
-		mMorphRenderer.EndRendering();
+		base = new BiomorphBase;
+		if( base == NULL )
+		{
+			return false;
+		}
+
+		base->mDNA = dna;
+		base->mRefcount = 0;
+		mBiomorphs.insert( BiomorphMapPair( morphHash, base ) );
+	}
+
+	if( _loadFromArchive( base ) )
+	{
+		return true;
+	}
+
+	// generate the biomorph texture
+	MorphGeometry geometry;
+	if( !MorphRender::GenerateGeometry( dna, geometry ) )
+	{
+		base->mFailed = true;
+		return false;
+	}
+	mMorphRenderer.RenderGeometry( geometry );
+	_renderToBase( base );
+
+	return true;
+}
+
+BiomorphBase* BiomorphManager::_addPendingBase( const MorphDNA& dna, StringHashing::StringHash hash )
+{
+	// add a pending biomorph (no texture yet)
+	BiomorphBase* newBase = new BiomorphBase;
+	if( newBase )
+	{
+		newBase->mDNA = dna;
+		newBase->mRefcount = 0;
+		mBiomorphs.insert( BiomorphMapPair( hash, newBase ) );
+	}
+
+	return newBase;
+}
+
+bool BiomorphManager::RequestBiomorph( MorphDNA& dna )
+{
+	StringHashing::StringHash morphHash = dna.GetHash();
+	BiomorphMap::iterator it = mBiomorphs.find( morphHash );
+	if( it != mBiomorphs.end() )
+	{
+		// test the values. if they dont match, we have a hash collision
+		if( (*it).second->mDNA != dna )
+		{
+			printf("Hash collision! This is very bad!\n");
+			return false;
+		}
 
-		BiomorphBase* newBase = new BiomorphBase;
-		if( newBase )
+		// if this was only speculated (or failed last time), make sure it jumps the queue
+		if( !(*it).second->IsValid() )
 		{
-			newBase->mDNA = dna;
-			newBase->mRefcount = 0;
-			newBase->mTexture = mMorphRenderer.CopyOutputTexture( newBase->mTexture );
-			mBiomorphs.insert( BiomorphMapPair( morphHash, newBase ) );
+			(*it).second->mFailed = false;
+			mGenerator.Request( dna, MorphGenerator::PriorityHigh );
+		}
+
+		return true;	// already generated or pending
+	}
 
-			return true;
+	BiomorphBase* base = _addPendingBase( dna, morphHash );
+	if( base )
+	{
+		if( !_loadFromArchive( base ) )
+		{
+			mGenerator.Request( dna, MorphGenerator::PriorityHigh );
 		}
+		return true;
 	}
 
 	return false;
 }
 
+void BiomorphManager::Speculate( const MorphDNA& dna )
+{
+	mGenerator.CancelSpeculative();
+
+	mSpeculationRoot = dna.GetHash();
+	if( mParams.SpeculativeCount <= 0 )
+	{
+		return;
+	}
+
+	MorphDNA neighbours[kMorphMutableGenes * 2];
+	int count = GetMutationNeighbours( dna, neighbours, Bounds::Min( mParams.SpeculativeCount, kMorphMutableGenes * 2 ) );
+	for( int n = 0; n < count; ++n )
+	{
+		StringHashing::StringHash hash = neighbours[n].GetHash();
+		BiomorphMap::iterator it = mBiomorphs.find( hash );
+		BiomorphBase* base = NULL;
+		if( it != mBiomorphs.end() )
+		{
+			base = (*it).second;
+			if( base->mDNA != neighbours[n] )
+			{
+				continue;	// hash collision, leave it alone
+			}
+		}
+		else
+		{
+			base = _addPendingBase( neighbours[n], hash );
+		}
+
+		if( base )
+		{
+			// keep it out of the cleanup while this root is current
+			base->mSpeculationRoot = mSpeculationRoot;
+			// failed ones aren't speculated again, only an explicit request retries them
+			if( !base->IsValid() && !base->HasFailed() && !_loadFromArchive( base ) )
+			{
+				mGenerator.Request( neighbours[n], MorphGenerator::PrioritySpeculative );
+			}
+		}
+	}
+}
+
+void BiomorphManager::Update()
+{
+	SCOPED_PROFILE(PublishBiomorphs);
+
+	for( int published = 0; published < mParams.MaxPublishPerFrame; ++published )
+	{
+		const MorphGeometry* geometry = mGenerator.AcquireCompleted();
+		if( geometry == NULL )
+		{
+			return;
+		}
+
+		// the biomorph may have been cleaned up or generated synchronously in the meantime
+		BiomorphMap::iterator it = mBiomorphs.find( geometry->GetDNA().GetHash() );
+		if( it != mBiomorphs.end() && !(*it).second->IsValid() && (*it).second->mDNA == geometry->GetDNA() )
+		{
+			if( geometry->HasFailed() )
+			{
+				printf("Failed to generate biomorph geometry\n");
+				(*it).second->mFailed = true;
+			}
+			else
+			{
+				mMorphRenderer.RenderGeometry( *geometry );
+				_renderToBase( (*it).second );
+			}
+		}
+
+		mGenerator.ReleaseCompleted( geometry );
+	}
+}
+
 void BiomorphManager::CleanupDatabase()
 {
-	for( BiomorphMap::iterator it = mBiomorphs.begin();
-		it != mBiomorphs.end();
-		++it )
+	BiomorphMap::iterator it = mBiomorphs.begin();
+	while( it != mBiomorphs.end() )
 	{
-		if( (*it).second->mRefcount <= 0 )
+		BiomorphBase* base = (*it).second;
+		bool speculated = base->mSpeculationRoot != 0 && base->mSpeculationRoot == mSpeculationRoot;
+		if( base->mRefcount <= 0 && !speculated )
+		{
+			mDevice->Release( base->mTexture );
+			delete base;
+			mBiomorphs.erase( it++ );
+		}
+		else
 		{
-			mDevice->Release( (*it).second->mTexture );
-			mBiomorphs.erase( it );
-			it = mBiomorphs.begin();
+			++it;
 		}
 	}
 }
@@ -110,8 +324,233 @@ BiomorphInstance BiomorphManager::CreateInstance( MorphDNA& dna )
 
 void BiomorphManager::DestroyInstance( BiomorphInstance& instance )
 {
-	if( instance.IsValid() )
+	if( instance.mBase != NULL )
 	{
 		instance.mBase->mRefcount--;
+		instance.mBase = NULL;
+	}
+}
+
+
+bool BiomorphManager::OpenArchive( const char* fileName )
+{
+	mArchive.Close();
+	mArchiveUsed.clear();
+	strncpy_s( mArchiveFileName, fileName, _TRUNCATE );
+	mArchiveUnreadable = false;
+
+	if( mDevice == NULL )
+	{
+		return false;
+	}
+
+	if( !mArchive.Open( fileName ) )
+	{
+		// not there yet is fine, anything else has to be left alone
+		mArchiveUnreadable = GetFileAttributesA( fileName ) != INVALID_FILE_ATTRIBUTES;
+		return false;
+	}
+
+	// the blobs are uploaded as they are, so they have to match what the renderer makes
+	const BiomorphArchive::Header& h = mArchive.GetHeader();
+	if( h.mWidth != (unsigned int)mParams.TextureSize || h.mHeight != (unsigned int)mParams.TextureSize
+		|| h.mFormat != (unsigned int)kMorphFormat || h.mPixelSize != kMorphPixelSize )
+	{
+		printf("Biomorph archive '%s' doesn't match the texture size\n", fileName);
+		mArchive.Close();
+		mArchiveUnreadable = true;
+		return false;
+	}
+
+	mArchiveUsed.resize( mArchive.GetEntryCount(), false );
+	return true;
+}
+
+bool BiomorphManager::_loadFromArchive( BiomorphBase* base )
+{
+	SCOPED_PROFILE(LoadArchivedMorph);
+
+	const int index = mArchive.Find( base->mDNA );
+	const void* pixels = index >= 0 ? mArchive.MapPixels( index ) : NULL;
+	if( pixels == NULL )
+	{
+		return false;
+	}
+
+	// the texture is created straight from the mapped pages, before the view is reused
+	Texture2D::Parameters tp;
+	tp.access = Texture2D::CpuNoAccess;
+	tp.bindFlags = Texture2D::BindAsShaderResource;
+	tp.format = kMorphFormat;
+	tp.height = mParams.TextureSize;
+	tp.width = mParams.TextureSize;
+	tp.msaaCount = 1;
+	tp.msaaQuality = 0;
+	tp.numMips = 1;
+	tp.initialData = pixels;
+	tp.initialRowPitch = mArchive.GetRowSize();
+	base->mTexture = mDevice->CreateTexture( tp );
+
+	mArchiveUsed[index] = mArchiveUsed[index] || base->IsValid();
+	return base->IsValid();
+}
+
+bool BiomorphManager::ExportCache( const char* fileName )
+{
+	if( mDevice == NULL )
+	{
+		return false;
+	}
+
+	const bool sameArchive = _stricmp( mArchiveFileName, fileName ) == 0;
+	if( sameArchive && mArchiveUnreadable )
+	{
+		printf("Not replacing biomorph archive '%s', it couldn't be opened\n", fileName);
+		return false;
+	}
+
+	// the open archive may be the one being replaced, so write next to it first
+	char tempFileName[300] = {'\0'};
+	sprintf_s(tempFileName, "%s.tmp", fileName);
+	if( !_writeArchive( tempFileName ) )
+	{
+		DeleteFileA( tempFileName );
+		return false;
+	}
+
+	const bool replacingArchive = sameArchive && mArchive.IsOpen();
+	if( replacingArchive )
+	{
+		// anything loaded from it already lives in its own texture
+		mArchive.Close();
+	}
+
+	if( !MoveFileExA( tempFileName, fileName, MOVEFILE_REPLACE_EXISTING ) )
+	{
+		printf("Failed to replace biomorph archive '%s'\n", fileName);
+		DeleteFileA( tempFileName );
+		if( replacingArchive )
+		{
+			OpenArchive( fileName );
+		}
+		return false;
+	}
+
+	return replacingArchive ? OpenArchive( fileName ) : true;
+}
+
+bool BiomorphManager::_writeArchive( const char* fileName )
+{
+	SCOPED_PROFILE(ExportMorphArchive);
+
+	// everything used this session is stamped with the new session, the rest keep their old stamp
+	const unsigned int session = (mArchive.IsOpen() ? mArchive.GetHeader().mSession : 0) + 1;
+
+	std::vector<ExportItem> items;
+	items.reserve( mBiomorphs.size() + mArchive.GetEntryCount() );
+	for( unsigned int i = 0; i < mArchive.GetEntryCount(); ++i )
+	{
+		const BiomorphArchive::Entry& e = mArchive.GetEntry( i );
+		ExportItem item;
+		item.mDNA.mFullSequence0 = e.mSequence0;
+		item.mDNA.mFullSequence1 = e.mSequence1;
+		item.mBase = NULL;
+		item.mArchiveIndex = (int)i;
+		item.mLastUsed = mArchiveUsed[i] ? session : e.mLastUsed;
+		items.push_back( item );
+	}
+
+	// archived biomorphs are copied from the archive, the rest are read back from the gpu
+	for( BiomorphMap::iterator it = mBiomorphs.begin(); it != mBiomorphs.end(); ++it )
+	{
+		BiomorphBase* base = (*it).second;
+		if( base->IsValid() && mArchive.Find( base->mDNA ) < 0 )
+		{
+			ExportItem item;
+			item.mDNA = base->mDNA;
+			item.mBase = base;
+			item.mArchiveIndex = -1;
+			item.mLastUsed = session;
+			items.push_back( item );
+		}
+	}
+
+	// past the cap, the least recently used are dropped
+	const size_t maxItems = mParams.MaxArchivedMorphs > 0 ? (size_t)mParams.MaxArchivedMorphs : 0;
+	if( items.size() > maxItems )
+	{
+		std::nth_element( items.begin(), items.begin() + maxItems, items.end(), ExportItemNewer );
+		items.resize( maxItems );
+	}
+	std::sort( items.begin(), items.end(), ExportItemLess );
+
+	std::vector<size_t> readbacks;
+	for( size_t i = 0; i < items.size(); ++i )
+	{
+		if( items[i].mArchiveIndex < 0 )
+		{
+			readbacks.push_back( i );
+		}
+	}
+
+	Texture2D::Parameters sp;
+	sp.access = Texture2D::CpuRead;
+	sp.bindFlags = 0;
+	sp.format = kMorphFormat;
+	sp.height = mParams.TextureSize;
+	sp.width = mParams.TextureSize;
+	sp.msaaCount = 1;
+	sp.msaaQuality = 0;
+	sp.numMips = 1;
+	sp.stagingTexture = true;
+	Texture2D staging[kExportReadbacks];
+	const size_t stagingCount = readbacks.size() < (size_t)kExportReadbacks ? readbacks.size() : (size_t)kExportReadbacks;
+	bool ok = true;
+	for( size_t s = 0; s < stagingCount && ok; ++s )
+	{
+		staging[s] = mDevice->CreateTexture( sp );
+		ok = staging[s].IsValid();
+	}
+
+	if( !ok )
+	{
+		printf("Failed to create the archive staging textures\n");
+	}
+
+	BiomorphArchiveWriter writer;
+	ok = ok && writer.Open( fileName, (unsigned int)items.size(), mParams.TextureSize, mParams.TextureSize, kMorphFormat, kMorphPixelSize, session );
+	size_t copied = 0;
+	size_t written = 0;
+	for( size_t i = 0; i < items.size() && ok; ++i )
+	{
+		if( items[i].mArchiveIndex >= 0 )
+		{
+			const void* pixels = mArchive.MapPixels( items[i].mArchiveIndex );
+			ok = pixels != NULL && writer.AddEntry( items[i].mDNA, pixels, mArchive.GetRowSize(), items[i].mLastUsed );
+			continue;
+		}
+
+		// keep the copies ahead, so the gpu works on the next ones while this one is written out
+		for( ; copied < readbacks.size() && copied < written + stagingCount; ++copied )
+		{
+			mDevice->CopyTextureToTexture( items[readbacks[copied]].mBase->mTexture, staging[copied % stagingCount] );
+		}
+
+		Texture2D& s = staging[written++ % stagingCount];
+		unsigned int rowPitch = 0;
+		void* pixels = mDevice->MapStagingTexture( s, rowPitch, true );
+		ok = pixels != NULL && writer.AddEntry( items[i].mDNA, pixels, rowPitch, items[i].mLastUsed );
+		if( pixels )
+		{
+			mDevice->UnmapStagingTexture( s );
+		}
+	}
+
+	ok = writer.Close() && ok;
+	for( size_t s = 0; s < stagingCount; ++s )
+	{
+		mDevice->Release( staging[s] );
 	}
-}
\ No newline at end of file
+
+	return ok;
+}
@@ -3,9 +3,12 @@
 
 #include "biomorph.h"
 #include "morph_render.h"
+#include "morph_generator.h"
+#include "biomorph_archive.h"
 #include <map>
+#include <vector>
 
-class Device;
+class IDevice;
 class BiomorphManager
 {
 public:
@@ -14,16 +17,47 @@ public:
 
 	struct Parameters
 	{
+		Parameters()
+			: TextureSize(512)
+			, GeneratorThreads(1)
+			, SpeculativeCount(0)
+			, MaxPublishPerFrame(1)
+			, MaxArchivedMorphs(256)
+		{
+		}
 		int TextureSize;
+		int GeneratorThreads;	// number of background generator threads
+		int SpeculativeCount;	// max mutation neighbours to pre-generate (0 = off)
+		int MaxPublishPerFrame;	// max completed biomorphs rendered to texture per frame
+		int MaxArchivedMorphs;	// exports drop the least recently used past this, each is TextureSize^2 * 16 bytes
 	};
 
-	bool Initialise( Device* d, Parameters& p );
+	bool Initialise( IDevice* d, Parameters& p );
 	void Release();
 
-	bool GenerateBiomorph( MorphDNA& dna );
+	// rendering, copies and releases all go to this device, usually a command list swapped each frame.
+	// Update can record on any thread, as long as nothing else is using the manager at the time
+	void SetDevice( IDevice* d );
+
+	bool GenerateBiomorph( MorphDNA& dna );	// blocking generation
+	bool RequestBiomorph( MorphDNA& dna );	// queues generation on the generator thread
+	void Update();				// publishes completed biomorphs, call once per frame
+
+	// pre-generate the likely next mutations of this dna on idle generator threads
+	// any speculation from a previous dna is cancelled and becomes eligible for cleanup
+	void Speculate( const MorphDNA& dna );
 	void CleanupDatabase();	// removes unreferenced biomorphs
 
+	// biomorphs found in the archive are loaded from it instead of being generated
+	bool OpenArchive( const char* fileName );
+
+	// writes every generated biomorph, plus everything in the open archive, to one archive.
+	// Exporting over the open archive replaces it once the new one is complete.
+	// An existing archive that failed to open is never replaced, so nothing is lost to a bad read
+	bool ExportCache( const char* fileName );
+
 	// instance creation / destruction
+	// instances of requested biomorphs become valid once the result is published
 	BiomorphInstance CreateInstance( MorphDNA& dna );
 	void DestroyInstance( BiomorphInstance& instance );
 
@@ -31,9 +65,21 @@ private:
 	typedef std::map<StringHashing::StringHash, BiomorphBase*> BiomorphMap;
 	typedef std::pair<StringHashing::StringHash, BiomorphBase*> BiomorphMapPair;
 
-	Device* mDevice;
+	void _renderToBase( BiomorphBase* base );
+	BiomorphBase* _addPendingBase( const MorphDNA& dna, StringHashing::StringHash hash );
+	bool _loadFromArchive( BiomorphBase* base );
+	bool _writeArchive( const char* fileName );
+
+	IDevice* mDevice;
+	Parameters mParams;
+	StringHashing::StringHash mSpeculationRoot;
 	MorphRender mMorphRenderer;
+	MorphGenerator mGenerator;
 	BiomorphMap mBiomorphs;
+	BiomorphArchive mArchive;
+	std::vector<bool> mArchiveUsed;		// per archive entry, loaded this session
+	char mArchiveFileName[256];
+	bool mArchiveUnreadable;			// mArchiveFileName exists but couldn't be opened
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -6,7 +6,19 @@
 
 Biomorphs::Biomorphs( void* userData )
 	: m_appConfig(*((D3DAppConfig*)userData))
+	, m_recordingDevice( NULL, m_appConfig.m_windowWidth, m_appConfig.m_windowHeight )
+	, m_renderDevice(NULL)
+	, m_spriteTechnique(-1)
+	, m_lineageSeed(0)
+	, m_lineageCount(0)
+	, m_frameCount(0)
+	, m_frameList(0)
+	, m_executedFrameCount(0)
+	, m_lastCapturedGeneration(-1)
+	, m_captureCount(0)
 {
+	memset( m_frameFences, 0, sizeof(m_frameFences) );
+	memset( m_frameStats, 0, sizeof(m_frameStats) );
 }
 
 Biomorphs::~Biomorphs()
@@ -15,14 +27,15 @@ Biomorphs::~Biomorphs()
 
 void Biomorphs::_resetDNA()
 {
-	Random::seed( (int)time(NULL) );
+	m_lineageSeed = (unsigned int)time(NULL);
+	Random::seed( (int)m_lineageSeed );
 
 	// initialise dna values to a random tree-ish start point
-	D3DXVECTOR3 baseColour( Random::getFloat( 0.5f, 1.0f ),
+	Vector3f baseColour( Random::getFloat( 0.5f, 1.0f ),
 							Random::getFloat( 0.5f, 1.0f ),
 							Random::getFloat( 0.5f, 1.0f ) );
 
-	D3DXVECTOR3 colourMod( Random::getFloat( 0.6f, 1.4f ),
+	Vector3f colourMod( Random::getFloat( 0.6f, 1.4f ),
 							Random::getFloat( 0.6f, 1.4f ),
 							Random::getFloat( 0.6f, 1.4f ) );
 
@@ -35,17 +48,64 @@ void Biomorphs::_resetDNA()
 							colourMod);
 
 	m_generation = 0;
+	m_lastCapturedGeneration = -1;
 
-	mBiomorphManager.GenerateBiomorph( m_testDNA );
+	// a new lineage, the root record holds the starting dna
+	char logName[64] = {'\0'};
+	sprintf_s(logName, "lineage_%u_%d.blin", m_lineageSeed, m_lineageCount++);
+	m_lineageLog.Close();
+	m_lineageLog.Open( logName, false );
+	_logGeneration( m_testDNA, -1, 0 );
 
-	if( mMorphInstance.IsValid() )
+	_requestMorph();
+}
+
+void Biomorphs::_logGeneration( const MorphDNA& parent, int gene, int direction )
+{
+	LineageRecord r;
+	r.mGeneration = (uint_64)m_generation;
+	r.mParent0 = parent.mFullSequence0;
+	r.mParent1 = parent.mFullSequence1;
+	r.mChild0 = m_testDNA.mFullSequence0;
+	r.mChild1 = m_testDNA.mFullSequence1;
+	r.mGene = (short)gene;
+	r.mDirection = (short)direction;
+	r.mSeed = m_lineageSeed;
+	m_lineageLog.Append( r );
+}
+
+void Biomorphs::_requestMorph()
+{
+	// drop any previous request, the old morph stays on screen until this one is ready
+	mBiomorphManager.DestroyInstance( mPendingInstance );
+
+	mBiomorphManager.RequestBiomorph( m_testDNA );
+	mPendingInstance = mBiomorphManager.CreateInstance( m_testDNA );
+
+	// the next generation is one of the neighbours of this dna, so get them going early
+	mBiomorphManager.Speculate( m_testDNA );
+}
+
+void Biomorphs::_publishPendingMorph()
+{
+	if( mPendingInstance.IsValid() )
 	{
 		mBiomorphManager.DestroyInstance( mMorphInstance );
+		mMorphInstance = mPendingInstance;
+		mPendingInstance = BiomorphInstance();
+	}
+	else if( mPendingInstance.HasFailed() )
+	{
+		// drop it, and mutate again from whatever is on screen
+		mBiomorphManager.DestroyInstance( mPendingInstance );
+		if( mMorphInstance.GetDNA() )
+		{
+			m_testDNA = *mMorphInstance.GetDNA();
+		}
 	}
-	mMorphInstance = mBiomorphManager.CreateInstance( m_testDNA );
 }
 
-void Biomorphs::_drawOverlay()
+void Biomorphs::_drawOverlay( IDevice& d )
 {
 	char textOut[256] = {'\0'};
 	Font::DrawParameters dp;
@@ -59,21 +119,87 @@ void Biomorphs::_drawOverlay()
 	{
 		textPos.x() = 16 + ((*ItName).mStackLevel * 16);
 		sprintf_s(textOut, "%s: %3.3fms\n", (*ItName).mName.c_str(), (*ItName).mTimeDiff * 1000.0f);
-		m_device.DrawText( textOut, m_font, dp, textPos );	textPos.y() = textPos.y() + 18;
+		d.DrawText( textOut, m_font, dp, textPos );	textPos.y() = textPos.y() + 18;
 	}
 
 	textPos.x() = 16;
 	textPos.y() = textPos.y() + 30;
 	sprintf_s(textOut, "Generation: %d", m_generation);
-	m_device.DrawText( textOut, m_font, dp, textPos );
+	d.DrawText( textOut, m_font, dp, textPos );
 
 	textPos.y() = textPos.y() + 18;
 	sprintf_s(textOut, "DNA: %x%x%x%x", m_testDNA.mFullSequenceHigh0, m_testDNA.mFullSequenceLow0
 										  , m_testDNA.mFullSequenceHigh1, m_testDNA.mFullSequenceLow1);
-	m_device.DrawText( textOut, m_font, dp, textPos );
+	d.DrawText( textOut, m_font, dp, textPos );
+
+#ifdef ENABLE_PERF_GRAB
+	textPos.y() = textPos.y() + 18;
+	// this list set was last executed two frames ago, and that frame is complete
+	const FrameStats& stats = m_frameStats[m_frameList];
+	sprintf_s(textOut, "State changes: %d applied, %d filtered, %d draws", stats.mAppliedStateChanges
+										  , stats.mFilteredStateChanges, stats.mDrawCalls);
+	d.DrawText( textOut, m_font, dp, textPos );
+#endif
 }
 
-void Biomorphs::_drawMorphToScreen()
+void Biomorphs::_captureFrame()
+{
+	SCOPED_PROFILE(CaptureFrame);
+
+	// stopped before this frame's captures are taken, a flush can't wait on copies that haven't been submitted
+	const bool streaming = m_inputModule->keyToggled( 'V' );
+	if( !streaming && m_captureStream.IsOpen() )
+	{
+		// frames still in the staging ring belong to this stream
+		m_screenshots.Flush();
+		m_captureStream.Close();
+	}
+
+	if( m_inputModule->keyToggled( 'C' ) && m_generation != m_lastCapturedGeneration && mMorphInstance.IsValid() )
+	{
+		char fileName[64] = {'\0'};
+		sprintf_s(fileName, "capture_%06d", m_captureCount++);
+		m_screenshots.TakeScreenshot( fileName, ImageEncoder::FormatPNG );
+		m_lastCapturedGeneration = m_generation;
+	}
+
+	if( streaming && !m_captureStream.IsOpen() )
+	{
+		CaptureStream::Parameters cp;
+		cp.mMode = CaptureStream::ModeDelta;
+		cp.mWidth = m_appConfig.m_windowWidth;
+		cp.mHeight = m_appConfig.m_windowHeight;
+		sprintf_s(cp.mFileName, "capture_%06d.bcap", m_captureCount++);
+		m_captureStream.Open( cp );
+	}
+
+	// a failed stream stays open, so it isn't reopened every frame, until 'V' is toggled off
+	if( m_captureStream.IsOpen() && !m_captureStream.HasFailed() )
+	{
+		m_screenshots.CaptureToStream( m_captureStream );
+	}
+
+	// the frames are read back a couple of frames later, so this has to run every frame
+	m_screenshots.Update();
+}
+
+BloomRender::ContentKey Biomorphs::_getContentKey()
+{
+	// the scene is just the morph sprite, so its dna and the screen size identify the frame
+	const MorphDNA* dna = mMorphInstance.GetDNA();
+	if( !mMorphInstance.IsValid() || dna == NULL )
+	{
+		return 0;
+	}
+
+	BloomRender::ContentKey key = dna->GetHash();
+	key = StringHashing::getHash( &m_appConfig.m_windowWidth, sizeof(m_appConfig.m_windowWidth), key );
+	key = StringHashing::getHash( &m_appConfig.m_windowHeight, sizeof(m_appConfig.m_windowHeight), key );
+
+	return key;
+}
+
+void Biomorphs::_drawMorphToScreen( IDevice& d )
 {
 	SCOPED_PROFILE(RenderMorphToScreen);
 
@@ -85,75 +211,185 @@ void Biomorphs::_drawMorphToScreen()
 	float aspect = (float)m_appConfig.m_windowWidth / (float)m_appConfig.m_windowHeight;
 
 	// switch back to rendering to back buffer
-	Rendertarget& backBuffer = m_device.GetBackBuffer();
-	DepthStencilBuffer& depthBuffer = m_device.GetDepthStencilBuffer();
-	m_device.SetRenderTargets( &backBuffer, &depthBuffer );
+	Rendertarget& backBuffer = d.GetBackBuffer();
+	DepthStencilBuffer& depthBuffer = d.GetDepthStencilBuffer();
+	d.SetRenderTargets( &backBuffer, &depthBuffer );
 
 	// Set the viewport
 	Viewport vp;
 	vp.topLeft = Vector2(0,0);
 	vp.depthRange = Vector2f(0.0f,1.0f);
 	vp.dimensions = Vector2(m_appConfig.m_windowWidth, m_appConfig.m_windowHeight);
-	m_device.SetViewport( vp );
+	d.SetViewport( vp );
 
 	// Clear buffers
 	static float clearColour[4] = {0.05f, 0.15f, 0.25f, 1.0f};
-	m_device.ClearTarget( backBuffer, clearColour );
-	m_device.ClearTarget( depthBuffer, 1.0f, 0 );
+	d.ClearTarget( backBuffer, clearColour );
+	d.ClearTarget( depthBuffer, 1.0f, 0 );
 
 	// draw the biomorph as a sprite
-	m_spriteRender.GetTexture() = *mMorphInstance.GetTexture();
-		 
-	m_spriteRender.RemoveSprites();
-	m_spriteRender.AddSprite( 0, D3DXVECTOR2(-0.7f,-0.7f), D3DXVECTOR2(1.4f,1.4f) );
+	m_spriteBatch.Begin();
+	m_spriteBatch.AddSprite( *mMorphInstance.GetTexture(), m_spriteTechnique, Vector2f(-0.7f,-0.7f), Vector2f(1.4f,1.4f) );
 	float scale = 0.6f;
-	m_spriteRender.Draw( m_device, D3DXVECTOR2(0.0f,0.0f), D3DXVECTOR2(scale,scale*aspect), "Render" );
+	m_spriteBatch.Draw( d, Vector2f(0.0f,0.0f), Vector2f(scale,scale*aspect) );
 }
 
-void Biomorphs::_render(Timer& timer)
+void Biomorphs::_startFrameCallback( IDevice& d, void* userData )
 {
+	Biomorphs* self = (Biomorphs*)userData;
+	self->m_shadowedDevice.StartFrame();
+
+	// only the last frame is kept, so the log doesn't grow for the whole session
+	if( self->m_appConfig.m_headless )
+	{
+		self->m_recordingDevice.ResetFrame();
+	}
+}
+
+void Biomorphs::_endFrameCallback( IDevice& d, void* userData )
+{
+	Biomorphs* self = (Biomorphs*)userData;
+	self->m_shadowedDevice.EndFrame();
+
+	// frames execute in the order they were recorded, so this is the same set the frame used
+	FrameStats& stats = self->m_frameStats[self->m_executedFrameCount++ % kFrameLists];
+	memset( &stats, 0, sizeof(stats) );
+#ifdef ENABLE_PERF_GRAB
+	stats.mAppliedStateChanges = ShadowDevicePerfs::Grab(ShadowPerfGrab::NumAppliedStateChanges);
+	stats.mFilteredStateChanges = ShadowDevicePerfs::Grab(ShadowPerfGrab::NumFilteredStateChanges);
+	stats.mDrawCalls = ShadowDevicePerfs::Grab(ShadowPerfGrab::NumDrawCalls);
+#endif
+}
+
+void Biomorphs::_beginFrame()
+{
+	SCOPED_PROFILE(WaitForFrameLists);
+
+	// this set was submitted two frames ago, it can only be recorded over once it has executed
+	m_frameList = m_frameCount++ % kFrameLists;
+	m_submitter.WaitFor( m_frameFences[m_frameList] );
+
+	CommandList& morphCommands = m_morphCommands[m_frameList];
+	CommandList& frameCommands = m_frameCommands[m_frameList];
+	morphCommands.Reset();
+	frameCommands.Reset();
+
+	// the morph list executes first, so the shadow's frame starts there
+	morphCommands.AddCallback( _startFrameCallback, this );
+
+	// CleanupDatabase records its releases into the morph list as well, so this is done first
+	mBiomorphManager.SetDevice( &morphCommands );
+	m_bloom.SetDevice( &frameCommands );
+	m_screenshots.SetDevice( &frameCommands );
+}
+
+void Biomorphs::_recordJob( int begin, int end, int workerIndex, void* userData )
+{
+	Biomorphs* self = (Biomorphs*)userData;
+	for( int job = begin; job < end; ++job )
+	{
+		if( job == RecordMorphs )
+		{
+			// only touches biomorphs that aren't published yet, so nothing the scene is drawing
+			self->mBiomorphManager.Update();
+		}
+		else
+		{
+			self->_recordScene( self->m_frameCommands[self->m_frameList] );
+		}
+	}
+}
+
+void Biomorphs::_recordScene( IDevice& d )
+{
+	static BloomRender::DrawParameters dp( 0.15f, 1.0f,
+											0.2f, 1.0f,
+											0.8f, 1.0f,
+											0.4f, 1.0f );
+
+	// nothing has changed since the last frame, reuse the composite
+	const BloomRender::ContentKey contentKey = _getContentKey();
+	if( !m_bloom.RestoreCached( dp, contentKey ) )
 	{
-		SCOPED_PROFILE(RenderAll);
-		
 		// draw the morph on screen
-		_drawMorphToScreen();
-	
+		_drawMorphToScreen( d );
+
 		//now render the bloom from the backbuffer
-		static BloomRender::DrawParameters dp( 0.15f, 1.0f,
-												0.2f, 1.0f,
-												0.8f, 1.0f,
-												0.4f, 1.0f );
-		m_bloom.Render(dp);
+		m_bloom.Render( dp, contentKey );
 	}
+}
+
+void Biomorphs::_render(Timer& timer)
+{
+	SCOPED_PROFILE(RenderAll);
+
+	// one job per list, the profiler only sees whichever of them runs on this thread
+	m_recordPool.ParallelFor( MaxRecordJobs, 1, _recordJob, this );
+
+	CommandList& frameCommands = m_frameCommands[m_frameList];
+
+	// grab the frame before the overlay goes on
+	_captureFrame();
 
 	// display overlay
-	_drawOverlay();
+	_drawOverlay( frameCommands );
 
-	m_device.PresentBackbuffer();
+	frameCommands.PresentBackbuffer();
+	frameCommands.AddCallback( _endFrameCallback, this );
+
+	// always in this order, whichever finished recording first. The scene may sample a morph
+	// published in an earlier frame's list, never one from this frame
+	CommandList* lists[MaxRecordJobs] = { &m_morphCommands[m_frameList], &frameCommands };
+	m_frameFences[m_frameList] = m_submitter.Submit( lists, MaxRecordJobs );
+	m_screenshots.Submitted( m_frameFences[m_frameList] );
 }
 
 bool Biomorphs::_initialise()
 {
 	// load the sprite shader
 	Effect::Parameters ep("shaders//textured_sprite.fx");
-	m_spriteShader = m_device.CreateEffect(ep);
+	m_spriteShader = m_shadowedDevice.CreateEffect(ep);
 
 	// create the morph renderer
 	BiomorphManager::Parameters biop;
 	biop.TextureSize = 512;
-	mBiomorphManager.Initialise( &m_device, biop );
+	biop.GeneratorThreads = 3;
+	biop.SpeculativeCount = 20;		// gene 10 is almost never picked by MutateDNA
+	biop.MaxPublishPerFrame = 4;
+	biop.MaxArchivedMorphs = 256;	// 1 GB of 512x512 float textures
+	mBiomorphManager.Initialise( &m_shadowedDevice, biop );
+
+	// morphs rendered in earlier sessions load from here rather than being generated again
+	mBiomorphManager.OpenArchive( "biomorphs.barc" );
 
-	// Create a sprite renderer
-	SpriteRender::Parameters sp;
+	// frame recording, replayed through the shadow so redundant state is dropped
+	for( int i = 0; i < kFrameLists; ++i )
+	{
+		m_morphCommands[i].Create( &m_shadowedDevice );
+		m_frameCommands[i].Create( &m_shadowedDevice );
+	}
+	m_submitter.Initialise( &m_shadowedDevice );
+
+	// one extra thread, so both lists are recorded at once
+	m_recordPool.Initialise( MaxRecordJobs - 1 );
+
+	// Create a sprite batch, morph textures come from the manager. Created through the shadow
+	// like everything else that draws, so its state changes are filtered
+	SpriteBatch::Parameters sp;
 	sp.mMaxSprites = 1024 * 8;
 	sp.shader = m_spriteShader;
-	m_spriteRender.Create( m_device, sp );
+	m_spriteBatch.Create( m_shadowedDevice, sp );
+	m_spriteTechnique = m_spriteBatch.GetTechnique( "Render" );
 
 	// Create bloom renderer
 	BloomRender::Parameters bp;
 	bp.mWidth = m_appConfig.m_windowWidth;
 	bp.mHeight = m_appConfig.m_windowHeight;
-	m_bloom.Create( &m_device, bp );
+	m_bloom.Create( &m_shadowedDevice, bp );
+
+	// frame capture, encoding happens on its own threads
+	m_imageEncoder.Initialise( 2, 8 );
+	m_screenshots.Initialise( &m_shadowedDevice, &m_imageEncoder, 4, 2, &m_submitter );
 
 	// Reset DNA and generate biomorph instance
 	_resetDNA();
@@ -166,22 +402,27 @@ bool Biomorphs::_update(Timer& timer)
 	PROFILER_RESET();
 	SCOPED_PROFILE(AppUpdate);
 
+	// anything released from here on is recorded into this frame's lists
+	_beginFrame();
+
+	// pick up anything published while the last frame was recorded
+	_publishPendingMorph();
+
 	if( m_inputModule->keyPressed( VK_SPACE ) )
 	{
 		_resetDNA();
 	}
-	else
+	else if( !mPendingInstance.IsPending() && !m_inputModule->keyToggled( 'P' ) )
 	{
-		MutateDNA( m_testDNA );
-		mBiomorphManager.GenerateBiomorph( m_testDNA );
-
-		if( mMorphInstance.IsValid() )
-		{
-			mBiomorphManager.DestroyInstance( mMorphInstance );
-		}
-		mMorphInstance = mBiomorphManager.CreateInstance( m_testDNA );
+		// only mutate once the previous generation has been published, and 'P' pauses evolution
+		const MorphDNA parent = m_testDNA;
+		int gene = 0;
+		int direction = 0;
+		MutateDNA( m_testDNA, &gene, &direction );
+		_requestMorph();
 
 		m_generation++;
+		_logGeneration( parent, gene, direction );
 	}
 
 	mBiomorphManager.CleanupDatabase();
@@ -201,18 +442,49 @@ bool Biomorphs::shutdown()
 {
 	PROFILER_CLEANUP();
 
-	m_device.Flush();
+	m_lineageLog.Close();
+
+	// everything recorded has executed once the submitter is gone, so from here on
+	// resources are released straight through the shadow
+	m_submitter.Release();
+	m_recordPool.Release();
+	mBiomorphManager.SetDevice( &m_shadowedDevice );
+	m_bloom.SetDevice( &m_shadowedDevice );
+	m_screenshots.SetDevice( &m_shadowedDevice );
+
+	m_screenshots.Release();
+	m_captureStream.Close();
+	m_imageEncoder.Release();
+	m_shadowedDevice.Flush();
 
 	m_bloom.Release();
+	for( int i = 0; i < kFrameLists; ++i )
+	{
+		m_morphCommands[i].Release();
+		m_frameCommands[i].Release();
+	}
 
-	m_device.Release(m_spriteRender.GetTexture());
+	// the batch only references textures, the morph textures belong to the manager
+	m_spriteBatch.Release( m_shadowedDevice );
+	m_shadowedDevice.Release( m_spriteShader );
 
-	m_device.Release( m_font );
+	m_renderDevice->Release( m_font );
 
+	// everything generated this session is added to the archive for the next one
+	mBiomorphManager.ExportCache( "biomorphs.barc" );
+	mBiomorphManager.DestroyInstance( mPendingInstance );
 	mBiomorphManager.DestroyInstance( mMorphInstance );
 	mBiomorphManager.Release();
 
-	m_device.Shutdown();
+	if( m_appConfig.m_headless )
+	{
+		// anything still live here has leaked
+		m_recordingDevice.WriteLog( "headless_device.log" );
+	}
+	else
+	{
+		m_device.Shutdown();
+	}
 	return true;
 }
 
@@ -232,13 +504,22 @@ bool Biomorphs::startup()
 	fontParams.mSize = 16;
 	fontParams.mWeight = 400;
 	strcpy_s(fontParams.mTypeface, "Arial");
-	m_font = m_device.CreateFont( fontParams );
+	m_font = m_renderDevice->CreateFont( fontParams );
 
 	return _initialise();
 }
 
 bool Biomorphs::initDevice()
 {
+	// no d3d at all, frames are recorded and dropped
+	if( m_appConfig.m_headless )
+	{
+		printf("Running headless, nothing will be drawn\n");
+		m_renderDevice = &m_recordingDevice;
+		m_shadowedDevice.SetDevice( m_renderDevice );
+		return true;
+	}
+
 	// Init the device
 	Device::InitParameters params;
 #ifdef _DEBUG
@@ -246,6 +527,7 @@ bool Biomorphs::initDevice()
 #else
 	params.enableDebugD3d = false;
 #endif
+	params.nullDriver = false;
 	params.msaaCount = 1;
 	params.msaaQuality = 0;
 	params.windowHeight = m_appConfig.m_windowHeight;
@@ -254,6 +536,8 @@ bool Biomorphs::initDevice()
 	{
 		return false;
 	}
+	m_renderDevice = &m_device;
+	m_shadowedDevice.SetDevice( m_renderDevice );
 
 	return true;
 }
\ No newline at end of file
@@ -4,10 +4,17 @@
 #include "biomorph_manager.h"
 #include "framework\graphics\d3d_app.h"
 #include "framework\graphics\device.h"
+#include "framework\graphics\shadowed_device.h"
+#include "framework\graphics\recording_device.h"
+#include "framework\graphics\command_list.h"
+#include "framework\graphics\command_submitter.h"
 #include "framework\graphics\screenshot_helper.h"
-#include "framework\graphics\sprite_render.h"
+#include "framework\graphics\capture_stream.h"
+#include "framework\graphics\sprite_batch.h"
 #include "framework\input.h"
+#include "core\job_pool.h"
 #include "bloom_render.h"
+#include "lineage_log.h"
 
 class Biomorphs : public Module
 {
@@ -21,9 +28,39 @@ public:
 	virtual bool update( Timer& timer );
 
 private:
+	// the two lists recorded each frame, one job each
+	enum RecordJobs
+	{
+		RecordMorphs = 0,	// biomorphs published this frame, rendered to their textures
+		RecordScene,		// the morph on screen + bloom
+
+		MaxRecordJobs
+	};
+
+	static const int kFrameLists = 2;
+
+	// shadow stats are counted on the submission thread, so they are copied out at the end of each frame
+	struct FrameStats
+	{
+		int mAppliedStateChanges;
+		int mFilteredStateChanges;
+		int mDrawCalls;
+	};
+
+	static void _recordJob( int begin, int end, int workerIndex, void* userData );
+	static void _startFrameCallback( IDevice& d, void* userData );
+	static void _endFrameCallback( IDevice& d, void* userData );
+
+	void _beginFrame();
+	void _recordScene( IDevice& d );
 	void _resetDNA();
-	void _drawOverlay();
-	void _drawMorphToScreen();
+	void _drawOverlay( IDevice& d );
+	void _drawMorphToScreen( IDevice& d );
+	BloomRender::ContentKey _getContentKey();
+	void _requestMorph();
+	void _publishPendingMorph();
+	void _logGeneration( const MorphDNA& parent, int gene, int direction );
+	void _captureFrame();
 
 	bool _update(Timer& timer);
 	void _render(Timer& timer);
@@ -34,18 +71,48 @@ private:
 	MorphDNA m_testDNA;
 	int m_generation;
 
-	BiomorphInstance mMorphInstance;
+	// every generation is logged, one file per reset
+	LineageLogWriter m_lineageLog;
+	unsigned int m_lineageSeed;
+	int m_lineageCount;		// resets this session, the seed alone repeats within a second
+
+	BiomorphInstance mMorphInstance;	// the morph currently on screen
+	BiomorphInstance mPendingInstance;	// the next morph, waiting on the generator
 	BiomorphManager mBiomorphManager;	
 
 	BloomRender m_bloom;
 
 	Font m_font;
 	Effect m_spriteShader;
-	SpriteRender m_spriteRender;
+	SpriteBatch m_spriteBatch;
+	SpriteBatch::TechniqueID m_spriteTechnique;	// resolved once in _initialise
 
 	InputModule* m_inputModule;
 	D3DAppConfig m_appConfig;
 	Device m_device;
+	RecordingDevice m_recordingDevice;	// no-op backend, used instead of m_device when headless
+	IDevice* m_renderDevice;			// whichever of the two the shadow wraps
+	ShadowedDevice m_shadowedDevice;	// everything that renders goes through this
+
+	// each frame records the morph publishing and the scene at the same time, into their own
+	// lists, and submits them together in a fixed order. Lists are double buffered, so the next
+	// frame is recorded while the submission thread executes this one
+	CommandList m_morphCommands[kFrameLists];
+	CommandList m_frameCommands[kFrameLists];
+	unsigned int m_frameFences[kFrameLists];
+	FrameStats m_frameStats[kFrameLists];
+	int m_frameCount;			// frames recorded
+	int m_frameList;			// the lists being recorded
+	int m_executedFrameCount;	// only touched on the submission thread
+	JobPool m_recordPool;
+	CommandSubmitter m_submitter;
+
+	// 'C' captures every new generation to disk in the background, 'V' streams every frame
+	ImageEncoder m_imageEncoder;
+	ScreenshotHelper m_screenshots;
+	CaptureStream m_captureStream;
+	int m_lastCapturedGeneration;
+	int m_captureCount;
 };
 
 #endif
\ No newline at end of file
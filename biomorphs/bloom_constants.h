@@ -0,0 +1,26 @@
+#ifndef BLOOM_CONSTANTS_INCLUDED
+#define BLOOM_CONSTANTS_INCLUDED
+
+// Mirrors cbuffer BloomConstants in data/shaders/bloom.fx and is uploaded as is, so keep the two
+// in step.
+// HLSL packs the float2s two to a register, so there is no padding to add
+struct BloomConstants
+{
+	BloomConstants(float extraTinyThres=0.0f, float extraTinyMul = 0.0f,
+				   float tinyThresh=0.0f, float tinyMul=0.0f,
+				   float quarterThresh=0.0f, float quarterMul=0.0f,
+				   float halfThresh=0.0f, float halfMul=0.0f)
+	{
+		ExtraTinyBlurConsts[0] = extraTinyThres;	ExtraTinyBlurConsts[1] = extraTinyMul;
+		TinyBlurConsts[0] = tinyThresh;				TinyBlurConsts[1] = tinyMul;
+		QuarterBlurConsts[0] = quarterThresh;		QuarterBlurConsts[1] = quarterMul;
+		HalfBlurConsts[0] = halfThresh;				HalfBlurConsts[1] = halfMul;
+	}
+
+	float ExtraTinyBlurConsts[2];	// threshold, mul
+	float TinyBlurConsts[2];
+	float QuarterBlurConsts[2];
+	float HalfBlurConsts[2];
+};
+
+#endif
\ No newline at end of file
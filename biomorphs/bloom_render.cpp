@@ -1,8 +1,8 @@
 #include "bloom_render.h"
-#include "framework\graphics\device.h"
+#include "framework\graphics\idevice.h"
 #include "core\profiler.h"
 
-void BloomRender::CombineTargets( const DrawParameters& p )
+void BloomRender::CombineTargets( const DrawParameters& p, BloomRT& fullscreen, const Levels& levels )
 {
 	SCOPED_PROFILE(CombineBloom);
 
@@ -22,77 +22,50 @@ void BloomRender::CombineTargets( const DrawParameters& p )
 
 	// Clear depth/stencil
 	m_device->ClearTarget(m_device->GetDepthStencilBuffer(), 1.0f, 0 );
-	m_spriteRender.GetTexture() = m_fullscreen.mTexture;	// use the fullscreen rt as base texture
+	m_spriteRender.GetTexture() = fullscreen.mTexture;	// use the fullscreen rt as base texture
 
 	// set the blur samplers
-	EffectTechnique t = m_effect.GetTechniqueByName("Combine");
+	m_device->SetSampler( m_tinyBlurSampler, levels.mTiny->mTexture );
+	m_device->SetSampler( m_extraTinyBlurSampler, levels.mExtraTiny->mTexture );
+	m_device->SetSampler( m_quarterBlurSampler, levels.mQuarter->mTexture );
+	m_device->SetSampler( m_halfBlurSampler, levels.mHalf->mTexture );
 
-	TextureSampler tinyblur = t.GetSamplerByName("Tinyblur");
-	tinyblur.Set( m_tiny.mTexture );
-
-	TextureSampler extb = t.GetSamplerByName("ExtraTinyBlur");
-	extb.Set( m_extraTiny.mTexture );
-
-	TextureSampler quarterblur = t.GetSamplerByName("Quarterblur");
-	quarterblur.Set( m_quarterRes.mTexture );
-
-	TextureSampler halfblur = t.GetSamplerByName("Halfblur");
-	halfblur.Set( m_halfRes.mTexture );
-
-	// set the bloom constants
-	VectorConstant ps = t.GetVectorConstant("TinyBloomConsts");
-	ps.Set(p.TinyBlurConsts);	ps.Apply();
-
-	ps = t.GetVectorConstant("ExtraTinyBloomConsts");
-	ps.Set(p.ExtraTinyBlurConsts);	ps.Apply();
-
-	ps = t.GetVectorConstant("QuarterBloomConsts");
-	ps.Set(p.QuarterBlurConsts);	ps.Apply();
-
-	ps = t.GetVectorConstant("HalfBloomConsts");
-	ps.Set(p.HalfBlurConsts);	ps.Apply();
+	// the draw parameters are the constant block
+	m_device->SetConstants( m_bloomConstants, &p, sizeof(p) );
 
 	const float scale = 1.0f;
-	m_spriteRender.Draw( *m_device, D3DXVECTOR2(0.0f,0.0f), D3DXVECTOR2(scale,scale), "Combine" );
+	m_spriteRender.Draw( *m_device, Vector2f(0.0f,0.0f), Vector2f(scale,scale), m_combineTechnique );
 
 	m_device->ResetShaderState();
 }
 
-void BloomRender::RenderTargetToTarget( BloomRT& src, BloomRT& dst, const char* technique )
+void BloomRender::RenderTargetToTarget( BloomRT& src, BloomRT& dst, EffectTechnique& technique )
 {
 	m_device->ResetShaderState();	// flush currently bound rt
-	m_device->SetRenderTargets( &dst.mRT, &dst.mDSB );
+	m_device->SetRenderTargets( &dst.mRT, NULL );	// depth is disabled for all bloom passes
 
 	// Set the viewport
 	Viewport vp;
 	vp.topLeft = Vector2(0,0);
 	vp.depthRange = Vector2f(0.0f,1.0f);
-	vp.dimensions = Vector2(dst.mTexture.GetParameters().width, dst.mTexture.GetParameters().height);
+	vp.dimensions = Vector2(dst.mWidth, dst.mHeight);
 	m_device->SetViewport( vp );
 
-	// clear all colour to 0
-	static float clearColour[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-	m_device->ClearTarget( dst.mRT, clearColour );
-
-	// Clear depth/stencil
-	m_device->ClearTarget(dst.mDSB, 1.0f, 0 );
+	// no colour clear, the full screen quad writes every pixel
 
 	// set the pixel size constant
-	EffectTechnique t = m_effect.GetTechniqueByName(technique);
-	VectorConstant ps = t.GetVectorConstant("PixelSize");
-	D3DXVECTOR4 pixelSize = D3DXVECTOR4( 1.0f / (float)dst.mTexture.GetParameters().height,
-										 1.0f / (float)dst.mTexture.GetParameters().width,
-										 0.0f, 0.0f );
-	ps.Set( pixelSize );
-	ps.Apply();
+	const float pixelSize[4] = { 1.0f / (float)dst.mHeight,
+								 1.0f / (float)dst.mWidth,
+								 0.0f, 0.0f };
+	m_device->SetConstant( m_pixelSize, pixelSize );
 
 	// render to the target using the sprite renderer
 	m_spriteRender.GetTexture() = src.mTexture;	// use the source rt as a texture
 	m_spriteRender.RemoveSprites();
-	m_spriteRender.AddSprite( 0, D3DXVECTOR2(-1.0f,-1.0f), D3DXVECTOR2(2.0f,2.0f) );
+	m_spriteRender.AddSprite( 0, Vector2f(-1.0f,-1.0f), Vector2f(2.0f,2.0f) );
 
 	float scale = 1.0f;
-	m_spriteRender.Draw( *m_device, D3DXVECTOR2(0.0f,0.0f), D3DXVECTOR2(scale,scale), technique );
+	m_spriteRender.Draw( *m_device, Vector2f(0.0f,0.0f), Vector2f(scale,scale), technique );
 }
 
 void BloomRender::DebugTarget( BloomRT& source )
@@ -118,121 +91,118 @@ void BloomRender::DebugTarget( BloomRT& source )
 	// render to the target using the sprite renderer
 	m_spriteRender.GetTexture() = source.mTexture;	// use the source rt as a texture
 	m_spriteRender.RemoveSprites();
-	m_spriteRender.AddSprite( 0, D3DXVECTOR2(-1.0f,-1.0f), D3DXVECTOR2(2.0f,2.0f) );
+	m_spriteRender.AddSprite( 0, Vector2f(-1.0f,-1.0f), Vector2f(2.0f,2.0f) );
 
 	float scale = 1.0f;
-	m_spriteRender.Draw( *m_device, D3DXVECTOR2(0.0f,0.0f), D3DXVECTOR2(scale,scale), "Debug" );
+	m_spriteRender.Draw( *m_device, Vector2f(0.0f,0.0f), Vector2f(scale,scale), m_debugTechnique );
 }
 
-void BloomRender::Render(const DrawParameters& p)
+BloomRender::ContentKey BloomRender::MakeCacheKey( const DrawParameters& p, ContentKey contentKey ) const
 {
-	SCOPED_PROFILE(RenderBloom);
-	{
-		SCOPED_PROFILE(BloomCopyBackbuffer);
-		Texture2D backBufferTexture = m_device->GetBackBufferTexture();
-	
-		// first grab the back buffer to our fullscreen texture
-		m_device->CopyTextureToTexture(backBufferTexture, m_fullscreen.mTexture);
-	}
+	ContentKey key = StringHashing::getHash( &p, sizeof(p), contentKey );
+	key = StringHashing::getHash( &m_params, sizeof(m_params), key );
+	return key != 0 ? key : 1;
+}
 
+bool BloomRender::RestoreCached( const DrawParameters& p, ContentKey contentKey )
+{
+	if( contentKey == 0 || m_cachedComposite == NULL || m_cachedKey != MakeCacheKey( p, contentKey ) )
 	{
-		SCOPED_PROFILE(BloomDownsample);
-
-		// downsample the full res to half res
-		RenderTargetToTarget(m_fullscreen, m_halfRes, "Downsample");
+		return false;
+	}
 
-		// downsample again to 1/4 res
-		RenderTargetToTarget(m_halfRes, m_quarterRes, "Downsample");
+	SCOPED_PROFILE(RestoreCachedBloom);
+	Texture2D backBufferTexture = m_device->GetBackBufferTexture();
+	m_device->CopyTextureToTexture( m_cachedComposite->mTexture, backBufferTexture );
 
-		// .. and again
-		RenderTargetToTarget(m_quarterRes, m_tiny, "Downsample");
+	return true;
+}
 
-		// extra tiny
-		RenderTargetToTarget( m_tiny, m_extraTiny, "Downsample");
-	}
+// Each level has a plain downsample, which feeds the next level and its own level's blur, and the
+// blurred result, which the combine reads. Every level is a different size, and the two targets of
+// a level are both live while the blur reads one and writes the other, so the downsamples don't
+// alias each other. Each is returned straight after its last read
+void BloomRender::DownsampleAndBlur( BloomRT& fullscreen, Levels& levels )
+{
+	SCOPED_PROFILE(BloomDownsampleBlur);
+
+	const int w = m_params.mWidth;
+	const int h = m_params.mHeight;
+	const Texture2D::TextureFormat levelFormat = Texture2D::TypeFloat16;	// [0,1] and smoothed, half precision is plenty
+
+	BloomRT* halfDownsample = m_targets.Acquire( w / 2, h / 2, levelFormat );
+	RenderTargetToTarget( fullscreen, *halfDownsample, m_downsampleTechnique );
+
+	BloomRT* quarterDownsample = m_targets.Acquire( w / 4, h / 4, levelFormat );
+	RenderTargetToTarget( *halfDownsample, *quarterDownsample, m_downsampleTechnique );
+	levels.mHalf = m_targets.Acquire( w / 2, h / 2, levelFormat );
+	RenderTargetToTarget( *halfDownsample, *levels.mHalf, m_blurTechnique );
+	m_targets.Return( halfDownsample );
+
+	BloomRT* tinyDownsample = m_targets.Acquire( w / 8, h / 8, levelFormat );
+	RenderTargetToTarget( *quarterDownsample, *tinyDownsample, m_downsampleTechnique );
+	levels.mQuarter = m_targets.Acquire( w / 4, h / 4, levelFormat );
+	RenderTargetToTarget( *quarterDownsample, *levels.mQuarter, m_blurTechnique );
+	m_targets.Return( quarterDownsample );
+
+	BloomRT* extraTinyDownsample = m_targets.Acquire( w / 16, h / 16, levelFormat );
+	RenderTargetToTarget( *tinyDownsample, *extraTinyDownsample, m_downsampleTechnique );
+	levels.mTiny = m_targets.Acquire( w / 8, h / 8, levelFormat );
+	RenderTargetToTarget( *tinyDownsample, *levels.mTiny, m_blurTechnique );
+	m_targets.Return( tinyDownsample );
+
+	levels.mExtraTiny = m_targets.Acquire( w / 16, h / 16, levelFormat );
+	RenderTargetToTarget( *extraTinyDownsample, *levels.mExtraTiny, m_blurTechnique );
+	m_targets.Return( extraTinyDownsample );
+}
 
-	{
-		SCOPED_PROFILE(BloomBlurHalf);
-		// 2 pass blur on half
-		RenderTargetToTarget(m_halfRes, m_halfBlur, "BlurH");
-		RenderTargetToTarget(m_halfBlur, m_halfRes, "BlurV");
-	}
+void BloomRender::Render(const DrawParameters& p, ContentKey contentKey)
+{
+	SCOPED_PROFILE(RenderBloom);
 
+	// this frame replaces the cached composite, so its target is free for the full screen copy.
+	// Lists execute in order, so a restore recorded in an earlier frame has already read it
+	if( m_cachedComposite != NULL )
 	{
-		SCOPED_PROFILE(BloomBlurQuarter);
-		// 2 pass blur on quarter
-		RenderTargetToTarget(m_quarterRes, m_quarterBlur, "BlurH");
-		RenderTargetToTarget(m_quarterBlur, m_quarterRes, "BlurV");
+		m_targets.Return( m_cachedComposite );
+		m_cachedComposite = NULL;
 	}
+	m_cachedKey = 0;
 
+	BloomRT* fullscreen = m_targets.Acquire( m_params.mWidth, m_params.mHeight, Texture2D::TypeInt8UnNormalised );
 	{
-
-		SCOPED_PROFILE(BloomBlurTiny);
-		// 2 pass blur on tiny
-		RenderTargetToTarget(m_tiny, m_tinyBlur, "BlurH");
-		RenderTargetToTarget(m_tinyBlur, m_tiny, "BlurV");
+		SCOPED_PROFILE(BloomCopyBackbuffer);
+		Texture2D backBufferTexture = m_device->GetBackBufferTexture();
+	
+		// first grab the back buffer to our fullscreen texture
+		m_device->CopyTextureToTexture(backBufferTexture, fullscreen->mTexture);
 	}
 
-	{
-
-		SCOPED_PROFILE(BloomBlurExtraTiny);
-		// 2 pass blur on tiny
-		RenderTargetToTarget(m_extraTiny, m_extraTinyBlur, "BlurH");
-		RenderTargetToTarget(m_extraTinyBlur, m_extraTiny, "BlurV");
-	}
+	Levels levels;
+	DownsampleAndBlur( *fullscreen, levels );
 
 	// final combine back to back buffer
-	CombineTargets( p );
-}
+	CombineTargets( p, *fullscreen, levels );
 
-Texture2D BloomRender::CreateRTTexture(int width, int height, Texture2D::TextureFormat format)
-{
-	// create a texture to render to
-	Texture2D::Parameters tp;
-	tp.access = Texture2D::CpuNoAccess;
-	tp.bindFlags = Texture2D::BindAsShaderResource | Texture2D::BindAsRenderTarget;
-	tp.format = format;	// work at full precision
-	tp.height = height;
-	tp.width = width;
-	tp.msaaCount = 1;
-	tp.msaaQuality = 0;
-	tp.numMips = 1;
-	return m_device->CreateTexture( tp );
-}
-
-DepthStencilBuffer BloomRender::CreateRTDepthStencil(int width, int height)
-{
-	DepthStencilBuffer::Parameters dbp;
-	dbp.m_format = DepthStencilBuffer::TypeDepthStencil32;
-	dbp.m_width = width;
-	dbp.m_height = height;
-	dbp.m_msaaCount = 1;
-	dbp.m_msaaQuality = 0;
-	return m_device->CreateDepthStencil( dbp );
-}
+	m_targets.Return( levels.mExtraTiny );
+	m_targets.Return( levels.mTiny );
+	m_targets.Return( levels.mQuarter );
+	m_targets.Return( levels.mHalf );
+	m_targets.Return( fullscreen );
 
-BloomRender::BloomRT BloomRender::CreateRenderTarget(int width, int height, Texture2D::TextureFormat format)
-{
-	BloomRT brt;
-	brt.mTexture = CreateRTTexture( width, height, format );
-
-	Rendertarget::Parameters rtp;
-	rtp.target = brt.mTexture;
-	brt.mRT = m_device->CreateRendertarget( rtp );
-
-	brt.mDSB = CreateRTDepthStencil(width, height);
-
-	return brt;
-}
+	if( contentKey != 0 )
+	{
+		// same size and format as the full screen copy, which is finished with, so this is the same target
+		SCOPED_PROFILE(BloomCacheComposite);
+		m_cachedComposite = m_targets.Acquire( m_params.mWidth, m_params.mHeight, Texture2D::TypeInt8UnNormalised );
 
-void BloomRender::Release( BloomRT& rt )
-{
-	m_device->Release( rt.mDSB );
-	m_device->Release( rt.mRT );
-	m_device->Release( rt.mTexture );
+		Texture2D backBufferTexture = m_device->GetBackBufferTexture();
+		m_device->CopyTextureToTexture( backBufferTexture, m_cachedComposite->mTexture );
+		m_cachedKey = MakeCacheKey( p, contentKey );
+	}
 }
 
-void BloomRender::Create(Device* d, Parameters& p)
+void BloomRender::Create(IDevice* d, Parameters& p)
 {
 	// create the first full screen texture
 	m_device = d;
@@ -242,40 +212,41 @@ void BloomRender::Create(Device* d, Parameters& p)
 	Effect::Parameters ep("shaders/bloom.fx");
 	m_effect = m_device->CreateEffect(ep);
 
-	// create rts
-	m_fullscreen = CreateRenderTarget( p.mWidth, p.mHeight, Texture2D::TypeInt8UnNormalised );
-	m_halfRes = CreateRenderTarget( p.mWidth / 2, p.mHeight / 2, Texture2D::TypeFloat32 );
-	m_quarterRes = CreateRenderTarget( p.mWidth / 4, p.mHeight / 4, Texture2D::TypeFloat32 );
-	m_tiny = CreateRenderTarget( p.mWidth / 8, p.mHeight / 8, Texture2D::TypeFloat32 );
-	m_extraTiny = CreateRenderTarget( p.mWidth / 16, p.mHeight / 16, Texture2D::TypeFloat32 );
-	
-	m_halfBlur = CreateRenderTarget( p.mWidth / 2, p.mHeight / 2, Texture2D::TypeFloat32 );
-	m_quarterBlur = CreateRenderTarget( p.mWidth / 4, p.mHeight / 4, Texture2D::TypeFloat32 );
-	m_tinyBlur = CreateRenderTarget( p.mWidth / 8, p.mHeight / 8, Texture2D::TypeFloat32 );
-	m_extraTinyBlur = CreateRenderTarget( p.mWidth / 16, p.mHeight / 16, Texture2D::TypeFloat32 );
+	// targets are created by the first Render
+	m_targets.Create( d );
+	m_cachedComposite = NULL;
+	m_cachedKey = 0;
 
-	// create sprite renderer
+	// create sprite renderer, every pass sets its source texture before drawing
 	SpriteRender::Parameters sp;
 	sp.mMaxSprites = 32;
 	sp.shader = m_effect;
-	sp.texture = m_fullscreen.mTexture;
 	m_spriteRender.Create( *m_device, sp );
+
+	// everything the passes need is looked up once here
+	const EffectBinding& binding = m_spriteRender.GetBinding();
+	m_combineTechnique = binding.GetTechnique( "Combine" );
+	m_downsampleTechnique = binding.GetTechnique( "Downsample" );
+	m_blurTechnique = binding.GetTechnique( "Blur" );
+	m_debugTechnique = binding.GetTechnique( "Debug" );
+	m_tinyBlurSampler = binding.GetSampler( "Tinyblur" );
+	m_extraTinyBlurSampler = binding.GetSampler( "ExtraTinyBlur" );
+	m_quarterBlurSampler = binding.GetSampler( "Quarterblur" );
+	m_halfBlurSampler = binding.GetSampler( "Halfblur" );
+	m_bloomConstants = binding.GetConstantBlock( "BloomConstants" );
+	m_pixelSize = binding.GetVectorConstant( "PixelSize" );
 }
 
 void BloomRender::Release()
 {
 	m_spriteRender.Release(*m_device);
 
-	Release( m_extraTinyBlur );
-	Release( m_tinyBlur );
-	Release( m_quarterBlur );
-	Release( m_halfBlur );
-
-	Release( m_extraTiny );
-	Release( m_tiny );
-	Release( m_quarterRes );
-	Release( m_halfRes );
-	Release( m_fullscreen );
+	if( m_cachedComposite != NULL )
+	{
+		m_targets.Return( m_cachedComposite );
+		m_cachedComposite = NULL;
+	}
+	m_targets.Release();
 
 	m_device->Release( m_effect );
 }
\ No newline at end of file
@@ -3,7 +3,11 @@
 
 #include "framework\graphics\device_types.h"
 #include "framework\graphics\sprite_render.h"
+#include "framework\graphics\transient_targets.h"
 #include "core\containers.h"
+#include "bloom_constants.h"
+
+class IDevice;
 
 class BloomRender
 {
@@ -14,65 +18,75 @@ public:
 		int mHeight;
 	};
 
-	struct DrawParameters
-	{
-		DrawParameters(float extraTinyThres=0.0f, float extraTinyMul = 0.0f,
-					   float tinyThresh=0.0f, float tinyMul=0.0f,
-					   float quarterThresh=0.0f, float quarterMul=0.0f,
-					   float halfThresh=0.0f, float halfMul=0.0f)
-					   : TinyBlurConsts(tinyThresh, tinyMul,0.0f,0.0f)
-					   , QuarterBlurConsts(quarterThresh, quarterMul,0.0f,0.0f)
-					   , HalfBlurConsts(halfThresh, halfMul,0.0f,0.0f)
-					   , ExtraTinyBlurConsts(extraTinyThres, extraTinyMul, 0.0f,0.0f)
-		{
-		}
-
-		D3DXVECTOR4 ExtraTinyBlurConsts;
-		D3DXVECTOR4 TinyBlurConsts;
-		D3DXVECTOR4 QuarterBlurConsts;
-		D3DXVECTOR4 HalfBlurConsts;
-	};
+	// uploaded as a single constant block, see bloom_constants.h
+	typedef BloomConstants DrawParameters;
 
-	void Create(Device* d, Parameters& p);
+	// content keys identify what is in the back buffer when Render is called
+	// 0 means 'unknown', and is never cached
+	typedef StringHashing::StringHash ContentKey;
+
+	void Create(IDevice* d, Parameters& p);
 	void Release();
-	void Render( const DrawParameters& p );
+
+	// usually a command list, swapped each frame
+	inline void SetDevice( IDevice* d )
+	{
+		m_device = d;
+		m_targets.SetDevice( d );
+	}
+
+	// if contentKey is non-zero, the composited result is kept for RestoreCached
+	void Render( const DrawParameters& p, ContentKey contentKey = 0 );
+
+	// copies the last composite to the back buffer if it was made from the same content + parameters
+	bool RestoreCached( const DrawParameters& p, ContentKey contentKey );
 
 private:
 
-	struct BloomRT
+	typedef TransientTargets::Target BloomRT;
+
+	// the blurred levels, read by the combine
+	struct Levels
 	{
-		Texture2D mTexture;
-		Rendertarget mRT;
-		DepthStencilBuffer mDSB;
+		BloomRT* mHalf;
+		BloomRT* mQuarter;
+		BloomRT* mTiny;
+		BloomRT* mExtraTiny;
 	};
 
 	void DebugTarget( BloomRT& source );
-	void CombineTargets( const DrawParameters& p );
-	void RenderTargetToTarget( BloomRT& src, BloomRT& dst, const char* technique );
+	void CombineTargets( const DrawParameters& p, BloomRT& fullscreen, const Levels& levels );
+	void RenderTargetToTarget( BloomRT& src, BloomRT& dst, EffectTechnique& technique );
+	void DownsampleAndBlur( BloomRT& fullscreen, Levels& levels );
 
-	Texture2D CreateRTTexture(int width, int height, Texture2D::TextureFormat format);
-	DepthStencilBuffer CreateRTDepthStencil(int width, int height);
-	BloomRT CreateRenderTarget(int width, int height, Texture2D::TextureFormat format);
-	void Release( BloomRT& rt );
+	ContentKey MakeCacheKey( const DrawParameters& p, ContentKey contentKey ) const;
 
 	Parameters m_params;
 
 	SpriteRender m_spriteRender;
-	Device* m_device;
+	IDevice* m_device;
 
 	Effect m_effect;	// bloom shader
 
-	BloomRT m_fullscreen;	// original FS copy
-	BloomRT m_halfRes;		// half res (quarter size) f32 target
-	BloomRT m_quarterRes;	// quarter res (1/16 size) f32 target
-	BloomRT m_tiny;			// 1 / 16 res f32 target
-	BloomRT m_extraTiny;
-
-	// working textures
-	BloomRT m_extraTinyBlur;
-	BloomRT m_tinyBlur;
-	BloomRT m_quarterBlur;
-	BloomRT m_halfBlur;;
+	// resolved from the sprite renderer's binding at creation
+	EffectTechnique m_combineTechnique;
+	EffectTechnique m_downsampleTechnique;
+	EffectTechnique m_blurTechnique;
+	EffectTechnique m_debugTechnique;
+	TextureSampler m_tinyBlurSampler;
+	TextureSampler m_extraTinyBlurSampler;
+	TextureSampler m_quarterBlurSampler;
+	TextureSampler m_halfBlurSampler;
+	ConstantBlock m_bloomConstants;
+	VectorConstant m_pixelSize;
+
+	// every target is acquired for the passes that use it, see Render
+	TransientTargets m_targets;
+
+	// last composite, for frames where nothing changed. Held between frames, and handed back
+	// at the start of the next Render, where it becomes that frame's full screen copy
+	BloomRT* m_cachedComposite;
+	ContentKey m_cachedKey;
 };
 
 #endif
\ No newline at end of file
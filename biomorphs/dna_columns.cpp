@@ -0,0 +1,476 @@
+#include "dna_columns.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace
+{
+	// where each gene lives in the 4 dna words, this has to match the bitfields in MorphDNA
+	struct GeneLayout
+	{
+		int mWord;
+		int mShift;
+		unsigned int mMask;
+	};
+
+	const GeneLayout kGeneLayout[kMorphMutableGenes] =
+	{
+		{ 0, 0, 0xf },		// mBranchDepth
+		{ 0, 4, 0x7f },		// mBranchInitialAngle
+		{ 0, 11, 0x3f },	// mBranchInitialLength
+		{ 0, 17, 0xff },	// mBranchLengthModifier
+		{ 1, 0, 0xff },		// mBranchAngleModifier
+		{ 1, 8, 0x1f },		// mBaseColourRed
+		{ 1, 13, 0x1f },	// mBaseColourGreen
+		{ 1, 18, 0x1f },	// mBaseColourBlue
+		{ 1, 23, 0xff },	// mBranchRedModifier
+		{ 2, 0, 0xff },		// mBranchGreenModifier
+		{ 2, 8, 0xff },		// mBranchBlueModifier
+	};
+
+	// distances are worked out a block at a time so they stay in the cache
+	const size_t kDistanceBlock = 1024;
+
+	typedef std::pair<unsigned int, unsigned int> DistanceIndex;
+
+	// 4 dna (rows) to 4 words (columns) and back, word 3 is unused
+	inline void Transpose( __m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3 )
+	{
+		const __m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+		const __m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+		const __m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+		const __m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+		r0 = _mm_unpacklo_epi64( t0, t1 );
+		r1 = _mm_unpackhi_epi64( t0, t1 );
+		r2 = _mm_unpacklo_epi64( t2, t3 );
+		r3 = _mm_unpackhi_epi64( t2, t3 );
+	}
+}
+
+DNAColumns::DNAColumns()
+	: mBuffer(NULL)
+	, mCount(0)
+	, mCapacity(0)
+	, mVectorLayout(_checkLayout())
+{
+	memset( mColumns, 0, sizeof(mColumns) );
+}
+
+DNAColumns::~DNAColumns()
+{
+	Release();
+}
+
+bool DNAColumns::_checkLayout()
+{
+	// set every gene to a distinct value through the bitfields and read it back through the table
+	MorphDNA dna;
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		_setGene( dna, gene, (unsigned char)((gene * 7 + 3) & kGeneLayout[gene].mMask) );
+	}
+
+	const unsigned int words[4] = { dna.mFullSequenceHigh0, dna.mFullSequenceLow0, dna.mFullSequenceHigh1, dna.mFullSequenceLow1 };
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		const GeneLayout& l = kGeneLayout[gene];
+		if( ((words[l.mWord] >> l.mShift) & l.mMask) != GetGene( dna, gene ) )
+		{
+			printf("MorphDNA layout doesn't match the column table, using the scalar path\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool DNAColumns::Reserve( size_t capacity )
+{
+	// whole blocks of 16 so the vector loops never need a tail inside the buffer
+	capacity = (capacity + 15) & ~(size_t)15;
+	if( capacity <= mCapacity )
+	{
+		return true;
+	}
+
+	unsigned char* buffer = (unsigned char*)_mm_malloc( capacity * kMorphMutableGenes, 16 );
+	if( buffer == NULL )
+	{
+		printf("Failed to allocate dna columns for %u genomes\n", (unsigned int)capacity);
+		return false;
+	}
+
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		unsigned char* column = buffer + (gene * capacity);
+		if( mCount > 0 )
+		{
+			memcpy( column, mColumns[gene], mCount );
+		}
+		mColumns[gene] = column;
+	}
+
+	if( mBuffer )
+	{
+		_mm_free( mBuffer );
+	}
+	mBuffer = buffer;
+	mCapacity = capacity;
+
+	return true;
+}
+
+void DNAColumns::Release()
+{
+	if( mBuffer )
+	{
+		_mm_free( mBuffer );
+		mBuffer = NULL;
+	}
+	memset( mColumns, 0, sizeof(mColumns) );
+	mCount = 0;
+	mCapacity = 0;
+}
+
+unsigned char DNAColumns::GetGeneMax( int gene )
+{
+	return (unsigned char)kGeneLayout[gene].mMask;
+}
+
+unsigned char DNAColumns::GetGene( const MorphDNA& dna, int gene )
+{
+	switch( gene )
+	{
+	case 0:		return (unsigned char)dna.mBranchDepth;
+	case 1:		return (unsigned char)dna.mBranchInitialAngle;
+	case 2:		return (unsigned char)dna.mBranchInitialLength;
+	case 3:		return (unsigned char)dna.mBranchLengthModifier;
+	case 4:		return (unsigned char)dna.mBranchAngleModifier;
+	case 5:		return (unsigned char)dna.mBaseColourRed;
+	case 6:		return (unsigned char)dna.mBaseColourGreen;
+	case 7:		return (unsigned char)dna.mBaseColourBlue;
+	case 8:		return (unsigned char)dna.mBranchRedModifier;
+	case 9:		return (unsigned char)dna.mBranchGreenModifier;
+	case 10:	return (unsigned char)dna.mBranchBlueModifier;
+	default:	return 0;
+	}
+}
+
+void DNAColumns::_setGene( MorphDNA& dna, int gene, unsigned char value )
+{
+	switch( gene )
+	{
+	case 0:		dna.mBranchDepth = value;			break;
+	case 1:		dna.mBranchInitialAngle = value;	break;
+	case 2:		dna.mBranchInitialLength = value;	break;
+	case 3:		dna.mBranchLengthModifier = value;	break;
+	case 4:		dna.mBranchAngleModifier = value;	break;
+	case 5:		dna.mBaseColourRed = value;			break;
+	case 6:		dna.mBaseColourGreen = value;		break;
+	case 7:		dna.mBaseColourBlue = value;		break;
+	case 8:		dna.mBranchRedModifier = value;		break;
+	case 9:		dna.mBranchGreenModifier = value;	break;
+	case 10:	dna.mBranchBlueModifier = value;	break;
+	}
+}
+
+unsigned int DNAColumns::Distance( const MorphDNA& a, const MorphDNA& b, const unsigned char* weights )
+{
+	unsigned int distance = 0;
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		const int difference = (int)GetGene( a, gene ) - (int)GetGene( b, gene );
+		distance += (difference < 0 ? -difference : difference) * (weights ? weights[gene] : 1);
+	}
+
+	return distance;
+}
+
+bool DNAColumns::Append( const MorphDNA* dna, size_t count )
+{
+	if( mCount + count > mCapacity && !Reserve( Bounds::Max( mCount + count, mCapacity * 2 ) ) )
+	{
+		return false;
+	}
+
+	size_t i = 0;
+	if( mVectorLayout )
+	{
+		for( ; i + 16 <= count; i += 16 )
+		{
+			_unpack16( dna + i, mCount + i );
+		}
+	}
+
+	for( ; i < count; ++i )
+	{
+		for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+		{
+			mColumns[gene][mCount + i] = GetGene( dna[i], gene );
+		}
+	}
+
+	mCount += count;
+	return true;
+}
+
+void DNAColumns::_unpack16( const MorphDNA* dna, size_t index )
+{
+	// 4 groups of 4 genomes, each transposed so a register holds one word of 4 genomes
+	__m128i words[4][4];
+	for( int g = 0; g < 4; ++g )
+	{
+		for( int r = 0; r < 4; ++r )
+		{
+			words[g][r] = _mm_loadu_si128( (const __m128i*)&dna[g * 4 + r] );
+		}
+		Transpose( words[g][0], words[g][1], words[g][2], words[g][3] );
+	}
+
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		const GeneLayout& l = kGeneLayout[gene];
+		const __m128i shift = _mm_cvtsi32_si128( l.mShift );
+		const __m128i mask = _mm_set1_epi32( (int)l.mMask );
+
+		__m128i v[4];
+		for( int g = 0; g < 4; ++g )
+		{
+			v[g] = _mm_and_si128( _mm_srl_epi32( words[g][l.mWord], shift ), mask );
+		}
+
+		// every gene fits in a byte, so the saturating packs never clamp
+		const __m128i bytes = _mm_packus_epi16( _mm_packs_epi32( v[0], v[1] ), _mm_packs_epi32( v[2], v[3] ) );
+		_mm_storeu_si128( (__m128i*)(mColumns[gene] + index), bytes );
+	}
+}
+
+void DNAColumns::Get( size_t first, size_t count, MorphDNA* dna ) const
+{
+	size_t i = 0;
+	if( mVectorLayout )
+	{
+		for( ; i + 16 <= count; i += 16 )
+		{
+			_pack16( first + i, dna + i );
+		}
+	}
+
+	for( ; i < count; ++i )
+	{
+		dna[i] = Get( first + i );
+	}
+}
+
+MorphDNA DNAColumns::Get( size_t index ) const
+{
+	MorphDNA dna;
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		_setGene( dna, gene, mColumns[gene][index] );
+	}
+
+	return dna;
+}
+
+void DNAColumns::_pack16( size_t index, MorphDNA* dna ) const
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i words[4][4];
+	for( int g = 0; g < 4; ++g )
+	{
+		for( int w = 0; w < 4; ++w )
+		{
+			words[g][w] = zero;
+		}
+	}
+
+	for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+	{
+		const GeneLayout& l = kGeneLayout[gene];
+		const __m128i shift = _mm_cvtsi32_si128( l.mShift );
+		const __m128i mask = _mm_set1_epi32( (int)l.mMask );
+
+		// widen 16 bytes to 4 x 4 words
+		const __m128i bytes = _mm_loadu_si128( (const __m128i*)(mColumns[gene] + index) );
+		const __m128i lo = _mm_unpacklo_epi8( bytes, zero );
+		const __m128i hi = _mm_unpackhi_epi8( bytes, zero );
+		__m128i v[4];
+		v[0] = _mm_unpacklo_epi16( lo, zero );
+		v[1] = _mm_unpackhi_epi16( lo, zero );
+		v[2] = _mm_unpacklo_epi16( hi, zero );
+		v[3] = _mm_unpackhi_epi16( hi, zero );
+
+		for( int g = 0; g < 4; ++g )
+		{
+			words[g][l.mWord] = _mm_or_si128( words[g][l.mWord], _mm_sll_epi32( _mm_and_si128( v[g], mask ), shift ) );
+		}
+	}
+
+	for( int g = 0; g < 4; ++g )
+	{
+		Transpose( words[g][0], words[g][1], words[g][2], words[g][3] );
+		for( int r = 0; r < 4; ++r )
+		{
+			_mm_storeu_si128( (__m128i*)&dna[g * 4 + r], words[g][r] );
+		}
+	}
+}
+
+void DNAColumns::Filter( int gene, unsigned char minValue, unsigned char maxValue, unsigned char* mask ) const
+{
+	const unsigned char* column = mColumns[gene];
+	const __m128i minValues = _mm_set1_epi8( (char)minValue );
+	const __m128i maxValues = _mm_set1_epi8( (char)maxValue );
+
+	size_t i = 0;
+	for( ; i + 16 <= mCount; i += 16 )
+	{
+		// in range if clamping to the range leaves the value alone
+		const __m128i v = _mm_load_si128( (const __m128i*)(column + i) );
+		const __m128i inRange = _mm_cmpeq_epi8( _mm_min_epu8( _mm_max_epu8( v, minValues ), maxValues ), v );
+		__m128i m = _mm_loadu_si128( (const __m128i*)(mask + i) );
+		_mm_storeu_si128( (__m128i*)(mask + i), _mm_and_si128( m, inRange ) );
+	}
+
+	for( ; i < mCount; ++i )
+	{
+		if( column[i] < minValue || column[i] > maxValue )
+		{
+			mask[i] = 0;
+		}
+	}
+}
+
+size_t DNAColumns::GetSelected( const unsigned char* mask, unsigned int* indices ) const
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t selected = 0;
+	size_t i = 0;
+	for( ; i + 16 <= mCount; i += 16 )
+	{
+		// skip whole blocks with nothing selected
+		const __m128i m = _mm_loadu_si128( (const __m128i*)(mask + i) );
+		if( _mm_movemask_epi8( _mm_cmpeq_epi8( m, zero ) ) == 0xffff )
+		{
+			continue;
+		}
+
+		for( size_t j = i; j < i + 16; ++j )
+		{
+			if( mask[j] )
+			{
+				indices[selected++] = (unsigned int)j;
+			}
+		}
+	}
+
+	for( ; i < mCount; ++i )
+	{
+		if( mask[i] )
+		{
+			indices[selected++] = (unsigned int)i;
+		}
+	}
+
+	return selected;
+}
+
+void DNAColumns::Histogram( int gene, unsigned int histogram[256] ) const
+{
+	// 4 partial histograms, so runs of the same value don't stall on the same counter
+	unsigned int partial[4][256];
+	memset( partial, 0, sizeof(partial) );
+
+	const unsigned char* column = mColumns[gene];
+	size_t i = 0;
+	for( ; i + 4 <= mCount; i += 4 )
+	{
+		++partial[0][column[i]];
+		++partial[1][column[i + 1]];
+		++partial[2][column[i + 2]];
+		++partial[3][column[i + 3]];
+	}
+	for( ; i < mCount; ++i )
+	{
+		++partial[0][column[i]];
+	}
+
+	for( int v = 0; v < 256; ++v )
+	{
+		histogram[v] = partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+	}
+}
+
+size_t DNAColumns::FindNearest( const MorphDNA& dna, const unsigned char* weights, size_t k, unsigned int* indices, unsigned int* distances ) const
+{
+	if( k == 0 || mCount == 0 )
+	{
+		return 0;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+
+	// max heap of the best k so far
+	std::vector<DistanceIndex> best;
+	best.reserve( k );
+
+	__declspec(align(16)) unsigned int blockDistances[kDistanceBlock];
+	for( size_t blockStart = 0; blockStart < mCount; blockStart += kDistanceBlock )
+	{
+		// whole vectors, the columns are padded to 16 and the extra results are ignored
+		const size_t blockCount = Bounds::Min( kDistanceBlock, mCount - blockStart );
+		const size_t vectorCount = (blockCount + 15) & ~(size_t)15;
+		memset( blockDistances, 0, vectorCount * sizeof(unsigned int) );
+
+		for( int gene = 0; gene < kMorphMutableGenes; ++gene )
+		{
+			const unsigned char* column = mColumns[gene] + blockStart;
+			const __m128i target = _mm_set1_epi8( (char)GetGene( dna, gene ) );
+			const __m128i weight = _mm_set1_epi16( weights ? weights[gene] : 1 );
+			for( size_t i = 0; i < vectorCount; i += 16 )
+			{
+				// |a - b| for unsigned bytes, then weighted in 16 bits and summed in 32
+				const __m128i v = _mm_load_si128( (const __m128i*)(column + i) );
+				const __m128i difference = _mm_or_si128( _mm_subs_epu8( v, target ), _mm_subs_epu8( target, v ) );
+				const __m128i lo = _mm_mullo_epi16( _mm_unpacklo_epi8( difference, zero ), weight );
+				const __m128i hi = _mm_mullo_epi16( _mm_unpackhi_epi8( difference, zero ), weight );
+
+				__m128i* d = (__m128i*)(blockDistances + i);
+				d[0] = _mm_add_epi32( d[0], _mm_unpacklo_epi16( lo, zero ) );
+				d[1] = _mm_add_epi32( d[1], _mm_unpackhi_epi16( lo, zero ) );
+				d[2] = _mm_add_epi32( d[2], _mm_unpacklo_epi16( hi, zero ) );
+				d[3] = _mm_add_epi32( d[3], _mm_unpackhi_epi16( hi, zero ) );
+			}
+		}
+
+		for( size_t i = 0; i < blockCount; ++i )
+		{
+			const DistanceIndex candidate( blockDistances[i], (unsigned int)(blockStart + i) );
+			if( best.size() < k )
+			{
+				best.push_back( candidate );
+				std::push_heap( best.begin(), best.end() );
+			}
+			else if( candidate < best.front() )
+			{
+				std::pop_heap( best.begin(), best.end() );
+				best.back() = candidate;
+				std::push_heap( best.begin(), best.end() );
+			}
+		}
+	}
+
+	std::sort_heap( best.begin(), best.end() );
+	for( size_t i = 0; i < best.size(); ++i )
+	{
+		indices[i] = best[i].second;
+		if( distances )
+		{
+			distances[i] = best[i].first;
+		}
+	}
+
+	return best.size();
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef DNA_COLUMNS_INCLUDED
+#define DNA_COLUMNS_INCLUDED
+
+#include "morph_dna.h"
+
+// A population of dna stored a gene at a time
+// Every gene fits in a byte, so each one gets its own byte column (genes are numbered as in
+// MutateDNAGene). Scans over a single gene then touch 1 byte per genome instead of 16, and
+// filters / distances run 16 genomes per SSE2 instruction. Converting to and from the packed
+// 128 bit form is vectorised too. Bits of the dna that aren't genes are not stored
+class DNAColumns
+{
+public:
+	DNAColumns();
+	~DNAColumns();
+
+	bool Reserve( size_t capacity );	// keeps the current contents
+	void Release();
+
+	inline void Clear()
+	{
+		mCount = 0;
+	}
+
+	inline size_t GetCount() const
+	{
+		return mCount;
+	}
+
+	inline size_t GetCapacity() const
+	{
+		return mCapacity;
+	}
+
+	// 16 byte aligned, GetCount() entries
+	inline const unsigned char* GetColumn( int gene ) const
+	{
+		return mColumns[gene];
+	}
+
+	// grows as needed
+	bool Append( const MorphDNA* dna, size_t count );
+
+	void Get( size_t first, size_t count, MorphDNA* dna ) const;
+	MorphDNA Get( size_t index ) const;
+
+	// clears mask entries whose gene is outside [minValue, maxValue]. Start with a mask of 0xff
+	// and filter on as many genes as needed
+	void Filter( int gene, unsigned char minValue, unsigned char maxValue, unsigned char* mask ) const;
+
+	// indices of the non-zero mask entries, returns how many were written
+	size_t GetSelected( const unsigned char* mask, unsigned int* indices ) const;
+
+	void Histogram( int gene, unsigned int histogram[256] ) const;
+
+	// the k closest genomes by weighted gene distance (sum of weight * |difference|), closest first
+	// weights can be NULL to weigh every gene as 1. Returns the number found
+	size_t FindNearest( const MorphDNA& dna, const unsigned char* weights, size_t k, unsigned int* indices, unsigned int* distances = NULL ) const;
+
+	static unsigned char GetGene( const MorphDNA& dna, int gene );
+	static unsigned char GetGeneMax( int gene );
+	static unsigned int Distance( const MorphDNA& a, const MorphDNA& b, const unsigned char* weights );
+
+private:
+	DNAColumns( const DNAColumns& );
+	DNAColumns& operator=( const DNAColumns& );
+
+	void _unpack16( const MorphDNA* dna, size_t index );
+	void _pack16( size_t index, MorphDNA* dna ) const;
+	static void _setGene( MorphDNA& dna, int gene, unsigned char value );
+	static bool _checkLayout();
+
+	unsigned char* mBuffer;
+	unsigned char* mColumns[kMorphMutableGenes];
+	size_t mCount;
+	size_t mCapacity;
+	bool mVectorLayout;		// false if the bitfields aren't laid out as the sse code expects
+};
+
+#endif
\ No newline at end of file
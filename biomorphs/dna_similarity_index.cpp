@@ -0,0 +1,383 @@
+#include "dna_similarity_index.h"
+#include <emmintrin.h>
+#include <algorithm>
+
+namespace
+{
+	struct GeneLess
+	{
+		GeneLess( int gene )
+			: mGene(gene)
+		{
+		}
+
+		template<class T>
+		bool operator()( const T& a, const T& b ) const
+		{
+			return a.mGenes[mGene] < b.mGenes[mGene];
+		}
+
+		int mGene;
+	};
+
+	const unsigned int kNoLimit = 0xffffffff;
+
+	// the sum of the 16 bytes of a sum of absolute differences
+	inline unsigned int SumSAD( __m128i sad )
+	{
+		return (unsigned int)(_mm_cvtsi128_si32( sad ) + _mm_extract_epi16( sad, 4 ));
+	}
+}
+
+DNASimilarityIndex::DNASimilarityIndex()
+	: mWeighted(false)
+{
+	for( int i = 0; i < kDepthBuckets; ++i )
+	{
+		mBuckets[i] = -1;
+	}
+}
+
+DNASimilarityIndex::~DNASimilarityIndex()
+{
+	Release();
+}
+
+bool DNASimilarityIndex::Build( const DNAColumns& population, const Parameters& p )
+{
+	Release();
+
+	const size_t count = population.GetCount();
+	if( count == 0 || count >= kNoLimit )
+	{
+		return false;
+	}
+
+	mParams = p;
+	mParams.mLeafSize = Bounds::Max( mParams.mLeafSize, 1 );
+
+	mWeighted = true;
+	for( int g = 0; g < kTreeGenes; ++g )
+	{
+		mWeighted = mWeighted && (unsigned int)mParams.mWeights[g + 1] * DNAColumns::GetGeneMax( g + 1 ) <= 0xff;
+	}
+
+	// bucket by branch depth, keeping the population order within a bucket
+	const unsigned char* depths = population.GetColumn( 0 );
+	unsigned int bucketStart[kDepthBuckets + 1] = { 0 };
+	for( size_t i = 0; i < count; ++i )
+	{
+		++bucketStart[depths[i] + 1];
+	}
+	for( int b = 0; b < kDepthBuckets; ++b )
+	{
+		bucketStart[b + 1] += bucketStart[b];
+	}
+
+	mItems.resize( count );
+	unsigned int bucketFill[kDepthBuckets];
+	memcpy( bucketFill, bucketStart, sizeof(bucketFill) );
+	for( size_t i = 0; i < count; ++i )
+	{
+		Item& item = mItems[bucketFill[depths[i]]++];
+		for( int g = 0; g < kTreeGenes; ++g )
+		{
+			const unsigned char gene = population.GetColumn( g + 1 )[i];
+			item.mGenes[g] = mWeighted ? (unsigned char)(gene * mParams.mWeights[g + 1]) : gene;
+		}
+		item.mDepth = depths[i];
+		item.mPad = 0;
+		item.mIndex = (unsigned int)i;
+	}
+
+	mNodes.reserve( (count / mParams.mLeafSize) * 2 + kDepthBuckets );
+	for( int b = 0; b < kDepthBuckets; ++b )
+	{
+		if( bucketStart[b + 1] > bucketStart[b] )
+		{
+			mBuckets[b] = _build( bucketStart[b], bucketStart[b + 1] );
+		}
+	}
+
+	return true;
+}
+
+void DNASimilarityIndex::Release()
+{
+	mItems.clear();
+	mNodes.clear();
+	for( int i = 0; i < kDepthBuckets; ++i )
+	{
+		mBuckets[i] = -1;
+	}
+}
+
+int DNASimilarityIndex::_build( unsigned int first, unsigned int end )
+{
+	Node n;
+	memset( n.mMin, 0xff, sizeof(n.mMin) );
+	memset( n.mMax, 0, sizeof(n.mMax) );
+	for( unsigned int i = first; i < end; ++i )
+	{
+		for( int g = 0; g < kTreeGenes; ++g )
+		{
+			n.mMin[g] = Bounds::Min( n.mMin[g], mItems[i].mGenes[g] );
+			n.mMax[g] = Bounds::Max( n.mMax[g], mItems[i].mGenes[g] );
+		}
+	}
+	memset( n.mMin + kTreeGenes, 0, sizeof(n.mMin) - kTreeGenes );
+	n.mFirst = first;
+	n.mEnd = end;
+	n.mLower = -1;
+	n.mUpper = -1;
+
+	const int nodeIndex = (int)mNodes.size();
+	mNodes.push_back( n );
+	if( end - first <= (unsigned int)mParams.mLeafSize )
+	{
+		return nodeIndex;
+	}
+
+	// split the widest gene, as it counts towards the distance, at its median
+	int splitGene = 0;
+	unsigned int widest = 0;
+	for( int g = 0; g < kTreeGenes; ++g )
+	{
+		const unsigned int width = (n.mMax[g] - n.mMin[g]) * (mWeighted ? 1 : mParams.mWeights[g + 1]);
+		if( width > widest )
+		{
+			widest = width;
+			splitGene = g;
+		}
+	}
+
+	// every genome in the range is the same
+	if( widest == 0 )
+	{
+		return nodeIndex;
+	}
+
+	const unsigned int split = first + (end - first) / 2;
+	std::nth_element( mItems.begin() + first, mItems.begin() + split, mItems.begin() + end, GeneLess( splitGene ) );
+
+	const int lower = _build( first, split );
+	const int upper = _build( split, end );
+	mNodes[nodeIndex].mLower = lower;
+	mNodes[nodeIndex].mUpper = upper;
+
+	return nodeIndex;
+}
+
+void DNASimilarityIndex::_makeQuery( const MorphDNA& dna, int depth, Query& q ) const
+{
+	memset( q.mGenes, 0, sizeof(q.mGenes) );
+	for( int g = 0; g < kTreeGenes; ++g )
+	{
+		const unsigned char gene = DNAColumns::GetGene( dna, g + 1 );
+		q.mGenes[g] = mWeighted ? (unsigned char)(gene * mParams.mWeights[g + 1]) : gene;
+	}
+
+	const int depthDifference = (int)DNAColumns::GetGene( dna, 0 ) - depth;
+	q.mBase = mParams.mWeights[0] * (unsigned int)(depthDifference < 0 ? -depthDifference : depthDifference);
+}
+
+unsigned int DNASimilarityIndex::_distance( const Query& q, const Item& item ) const
+{
+	if( mWeighted )
+	{
+		// |w*a - w*b| == w*|a - b|, so the weighted distance is a plain sum of differences
+		const __m128i mask = _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0 );
+		const __m128i genes = _mm_and_si128( _mm_loadu_si128( (const __m128i*)item.mGenes ), mask );
+		return SumSAD( _mm_sad_epu8( _mm_loadu_si128( (const __m128i*)q.mGenes ), genes ) );
+	}
+
+	unsigned int distance = 0;
+	for( int g = 0; g < kTreeGenes; ++g )
+	{
+		const int difference = (int)q.mGenes[g] - (int)item.mGenes[g];
+		distance += mParams.mWeights[g + 1] * (unsigned int)(difference < 0 ? -difference : difference);
+	}
+
+	return distance;
+}
+
+unsigned int DNASimilarityIndex::_boxDistance( const Query& q, const Node& n, unsigned int& furthest ) const
+{
+	if( mWeighted )
+	{
+		// per gene, how far below / above the box the query is, and how far the far side is
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i genes = _mm_loadu_si128( (const __m128i*)q.mGenes );
+		const __m128i boxMin = _mm_loadu_si128( (const __m128i*)n.mMin );
+		const __m128i boxMax = _mm_loadu_si128( (const __m128i*)n.mMax );
+		const __m128i outside = _mm_or_si128( _mm_subs_epu8( boxMin, genes ), _mm_subs_epu8( genes, boxMax ) );
+		const __m128i farSide = _mm_max_epu8( _mm_subs_epu8( genes, boxMin ), _mm_subs_epu8( boxMax, genes ) );
+		furthest = SumSAD( _mm_sad_epu8( farSide, zero ) );
+		return SumSAD( _mm_sad_epu8( outside, zero ) );
+	}
+
+	unsigned int nearest = 0;
+	furthest = 0;
+	for( int g = 0; g < kTreeGenes; ++g )
+	{
+		const int gene = q.mGenes[g];
+		const int below = n.mMin[g] - gene;
+		const int above = gene - n.mMax[g];
+		nearest += mParams.mWeights[g + 1] * (unsigned int)Bounds::Max( 0, Bounds::Max( below, above ) );
+		furthest += mParams.mWeights[g + 1] * (unsigned int)Bounds::Max( gene - n.mMin[g], n.mMax[g] - gene );
+	}
+
+	return nearest;
+}
+
+void DNASimilarityIndex::_addResult( const DistanceIndex& candidate, size_t k, std::vector<DistanceIndex>& best )
+{
+	// best is a max heap of the closest k so far
+	if( best.size() < k )
+	{
+		best.push_back( candidate );
+		std::push_heap( best.begin(), best.end() );
+	}
+	else if( candidate < best.front() )
+	{
+		std::pop_heap( best.begin(), best.end() );
+		best.back() = candidate;
+		std::push_heap( best.begin(), best.end() );
+	}
+}
+
+size_t DNASimilarityIndex::FindNearest( const MorphDNA& dna, size_t k, unsigned int* indices, unsigned int* distances ) const
+{
+	if( k == 0 || mItems.empty() )
+	{
+		return 0;
+	}
+
+	std::vector<DistanceIndex> best;
+	best.reserve( k + 1 );
+
+	// buckets in order of depth difference, until a whole bucket can't beat the worst result.
+	// A bucket at the worst distance may still hold a lower index, so only further ones stop it
+	const int depth = DNAColumns::GetGene( dna, 0 );
+	for( int difference = 0; difference < kDepthBuckets; ++difference )
+	{
+		const unsigned int base = mParams.mWeights[0] * (unsigned int)difference;
+		if( best.size() == k && base > best.front().first )
+		{
+			break;
+		}
+
+		for( int side = 0; side < (difference == 0 ? 1 : 2); ++side )
+		{
+			const int bucket = side == 0 ? depth - difference : depth + difference;
+			if( bucket >= 0 && bucket < kDepthBuckets && mBuckets[bucket] >= 0 )
+			{
+				Query q;
+				_makeQuery( dna, bucket, q );
+				_search( mBuckets[bucket], q, k, best );
+			}
+		}
+	}
+
+	std::sort_heap( best.begin(), best.end() );
+	for( size_t i = 0; i < best.size(); ++i )
+	{
+		indices[i] = best[i].second;
+		if( distances )
+		{
+			distances[i] = best[i].first;
+		}
+	}
+
+	return best.size();
+}
+
+void DNASimilarityIndex::_search( int nodeIndex, const Query& q, size_t k, std::vector<DistanceIndex>& best ) const
+{
+	const Node& n = mNodes[nodeIndex];
+	if( n.mLower < 0 )
+	{
+		for( unsigned int i = n.mFirst; i < n.mEnd; ++i )
+		{
+			// same (distance, index) order as _addResult, which the node test below relies on
+			const DistanceIndex candidate( q.mBase + _distance( q, mItems[i] ), mItems[i].mIndex );
+			if( best.size() < k || candidate < best.front() )
+			{
+				_addResult( candidate, k, best );
+			}
+		}
+		return;
+	}
+
+	// the nearer child first, it tightens the bound for the other one
+	unsigned int furthest = 0;
+	const unsigned int lowerDistance = q.mBase + _boxDistance( q, mNodes[n.mLower], furthest );
+	const unsigned int upperDistance = q.mBase + _boxDistance( q, mNodes[n.mUpper], furthest );
+	const bool lowerFirst = lowerDistance <= upperDistance;
+	const int children[2] = { lowerFirst ? n.mLower : n.mUpper, lowerFirst ? n.mUpper : n.mLower };
+	const unsigned int childDistances[2] = { lowerFirst ? lowerDistance : upperDistance, lowerFirst ? upperDistance : lowerDistance };
+
+	for( int c = 0; c < 2; ++c )
+	{
+		// a box at the worst distance may still hold a lower index, so only further ones are skipped
+		if( best.size() == k && childDistances[c] > best.front().first )
+		{
+			return;
+		}
+		_search( children[c], q, k, best );
+	}
+}
+
+size_t DNASimilarityIndex::CountWithin( const MorphDNA& dna, unsigned int radius, size_t maxCount ) const
+{
+	size_t count = 0;
+	for( int bucket = 0; bucket < kDepthBuckets && count < maxCount; ++bucket )
+	{
+		if( mBuckets[bucket] < 0 )
+		{
+			continue;
+		}
+
+		Query q;
+		_makeQuery( dna, bucket, q );
+		if( q.mBase <= radius )
+		{
+			count = _countWithin( mBuckets[bucket], q, radius - q.mBase, count, maxCount );
+		}
+	}
+
+	return Bounds::Min( count, maxCount );
+}
+
+size_t DNASimilarityIndex::_countWithin( int nodeIndex, const Query& q, unsigned int radius, size_t count, size_t maxCount ) const
+{
+	const Node& n = mNodes[nodeIndex];
+	unsigned int furthest = 0;
+	if( _boxDistance( q, n, furthest ) > radius )
+	{
+		return count;
+	}
+
+	// the whole box is inside the radius
+	if( furthest <= radius )
+	{
+		return count + (n.mEnd - n.mFirst);
+	}
+
+	if( n.mLower < 0 )
+	{
+		for( unsigned int i = n.mFirst; i < n.mEnd && count < maxCount; ++i )
+		{
+			count += _distance( q, mItems[i] ) <= radius ? 1 : 0;
+		}
+		return count;
+	}
+
+	count = _countWithin( n.mLower, q, radius, count, maxCount );
+	if( count < maxCount )
+	{
+		count = _countWithin( n.mUpper, q, radius, count, maxCount );
+	}
+
+	return count;
+}
\ No newline at end of file
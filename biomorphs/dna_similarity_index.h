@@ -0,0 +1,110 @@
+#ifndef DNA_SIMILARITY_INDEX_INCLUDED
+#define DNA_SIMILARITY_INDEX_INCLUDED
+
+#include "dna_columns.h"
+#include <vector>
+#include <string.h>
+
+// Nearest phenotype search over a population
+// Similarity is the weighted sum of gene differences (DNAColumns::Distance). Branch depth changes
+// the shape the most, so the population is bucketed on it first and each bucket gets a tree
+// over the other genes, split at the median of the widest gene. Every node keeps the bounding
+// box of its genomes, and the distance to a box is a lower bound for everything in it, so whole
+// subtrees are skipped once they can't beat the results so far. Queries visit the buckets
+// nearest in depth first and stop once a whole bucket is further away.
+// With weights small enough that weight * gene fits in a byte (the defaults do), the genes are
+// stored pre-weighted, and a distance to a genome or a box is a few SSE2 instructions
+class DNASimilarityIndex
+{
+public:
+	struct Parameters
+	{
+		Parameters()
+			: mLeafSize(32)
+		{
+			// a colour step counts for more than a step of the wider genes
+			const unsigned char defaultWeights[kMorphMutableGenes] = { 32, 2, 4, 1, 1, 8, 8, 8, 1, 1, 1 };
+			memcpy( mWeights, defaultWeights, sizeof(mWeights) );
+		}
+
+		unsigned char mWeights[kMorphMutableGenes];
+		int mLeafSize;		// ranges this small are scanned rather than split
+	};
+
+	DNASimilarityIndex();
+	~DNASimilarityIndex();
+
+	// indices in results refer to the order of the population
+	bool Build( const DNAColumns& population, const Parameters& p );
+	void Release();
+
+	inline size_t GetCount() const
+	{
+		return mItems.size();
+	}
+
+	// the k most similar genomes, closest first with ties going to the lower index, so the result
+	// doesn't depend on the tree layout. Returns the number found
+	size_t FindNearest( const MorphDNA& dna, size_t k, unsigned int* indices, unsigned int* distances = NULL ) const;
+
+	// genomes within radius, stopping at maxCount. Low counts mean a sparse part of the
+	// population, which is what diversity preserving selection wants to keep
+	size_t CountWithin( const MorphDNA& dna, unsigned int radius, size_t maxCount ) const;
+
+	inline unsigned int Distance( const MorphDNA& a, const MorphDNA& b ) const
+	{
+		return DNAColumns::Distance( a, b, mParams.mWeights );
+	}
+
+private:
+	DNASimilarityIndex( const DNASimilarityIndex& );
+	DNASimilarityIndex& operator=( const DNASimilarityIndex& );
+
+	static const int kTreeGenes = kMorphMutableGenes - 1;	// everything but branch depth
+	static const int kDepthBuckets = 16;
+
+	// genes copied out of the population in tree order, so a node's items sit together
+	// the first 16 bytes are loaded as one vector, the bytes after the genes are masked off
+	struct Item
+	{
+		unsigned char mGenes[kTreeGenes];
+		unsigned char mDepth;
+		unsigned char mPad;
+		unsigned int mIndex;
+	};
+
+	// leaves have no children, the box covers every item from mFirst to mEnd
+	struct Node
+	{
+		unsigned char mMin[16];
+		unsigned char mMax[16];
+		unsigned int mFirst;
+		unsigned int mEnd;
+		int mLower;
+		int mUpper;
+	};
+
+	typedef std::pair<unsigned int, unsigned int> DistanceIndex;
+
+	struct Query
+	{
+		unsigned char mGenes[16];	// kTreeGenes used, the rest zero
+		unsigned int mBase;		// the depth part of the distance
+	};
+
+	int _build( unsigned int first, unsigned int end );
+	void _search( int node, const Query& q, size_t k, std::vector<DistanceIndex>& best ) const;
+	size_t _countWithin( int node, const Query& q, unsigned int radius, size_t count, size_t maxCount ) const;
+	unsigned int _distance( const Query& q, const Item& item ) const;
+	unsigned int _boxDistance( const Query& q, const Node& n, unsigned int& furthest ) const;
+	void _makeQuery( const MorphDNA& dna, int depth, Query& q ) const;
+	static void _addResult( const DistanceIndex& candidate, size_t k, std::vector<DistanceIndex>& best );
+
+	Parameters mParams;
+	std::vector<Item> mItems;
+	std::vector<Node> mNodes;
+	int mBuckets[kDepthBuckets];	// root node of each branch depth, -1 if none
+	bool mWeighted;		// genes are stored multiplied by their weights
+};
+
+#endif
\ No newline at end of file
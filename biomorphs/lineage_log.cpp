@@ -0,0 +1,214 @@
+#include "lineage_log.h"
+#include <string.h>
+#include <io.h>
+
+namespace
+{
+	// records are tiny, so write them out in large blocks
+	const size_t kWriteBufferSize = 64 * 1024;
+}
+
+LineageLog::LineageLog()
+	: mRecords(NULL)
+	, mRecordCount(0)
+{
+}
+
+LineageLog::~LineageLog()
+{
+	Close();
+}
+
+bool LineageLog::IsValidHeader( const Header& h )
+{
+	return memcmp( h.mMagic, "BLIN", 4 ) == 0 && h.mVersion == kVersion && h.mRecordSize == sizeof(LineageRecord);
+}
+
+void LineageLog::MakeHeader( Header& h )
+{
+	memcpy( h.mMagic, "BLIN", 4 );
+	h.mVersion = kVersion;
+	h.mRecordSize = sizeof(LineageRecord);
+	h.mReserved = 0;
+}
+
+bool LineageLog::Open( const char* fileName )
+{
+	if( IsOpen() || !mFile.Open( fileName ) )
+	{
+		return false;
+	}
+
+	const Header* header = (const Header*)mFile.GetData();
+	if( mFile.GetSize() < sizeof(Header) || !IsValidHeader( *header ) )
+	{
+		printf("'%s' is not a lineage log\n", fileName);
+		mFile.Close();
+		return false;
+	}
+
+	// a partly written record at the end is ignored
+	mRecords = (const LineageRecord*)(header + 1);
+	mRecordCount = (mFile.GetSize() - sizeof(Header)) / sizeof(LineageRecord);
+	return true;
+}
+
+void LineageLog::Close()
+{
+	mFile.Close();
+	mRecords = NULL;
+	mRecordCount = 0;
+}
+
+const LineageRecord* LineageLog::Seek( uint_64 generation ) const
+{
+	if( mRecordCount == 0 || mRecords[0].mGeneration > generation )
+	{
+		return NULL;
+	}
+
+	// logs are usually one record per generation, so try the direct index first
+	const uint_64 guess = generation - mRecords[0].mGeneration;
+	if( guess < mRecordCount && mRecords[(size_t)guess].mGeneration == generation )
+	{
+		return &mRecords[(size_t)guess];
+	}
+
+	// otherwise find the last record at or before the generation
+	size_t first = 0;
+	size_t last = mRecordCount;
+	while( last - first > 1 )
+	{
+		const size_t middle = first + (last - first) / 2;
+		if( mRecords[middle].mGeneration <= generation )
+		{
+			first = middle;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	return &mRecords[first];
+}
+
+LineageLogWriter::LineageLogWriter()
+	: mFile(NULL)
+	, mRecordCount(0)
+	, mLastGeneration(0)
+{
+}
+
+LineageLogWriter::~LineageLogWriter()
+{
+	Close();
+}
+
+bool LineageLogWriter::Open( const char* fileName, bool append )
+{
+	if( IsOpen() )
+	{
+		return false;
+	}
+
+	LineageLog::Header header;
+	mRecordCount = 0;
+	mLastGeneration = 0;
+
+	mFile = append ? fopen( fileName, "r+b" ) : NULL;
+	if( mFile != NULL )
+	{
+		setvbuf( mFile, NULL, _IOFBF, kWriteBufferSize );
+
+		// carry on from the end of the existing log
+		bool valid = fread( &header, sizeof(header), 1, mFile ) == 1 && LineageLog::IsValidHeader( header );
+		valid = valid && _fseeki64( mFile, 0, SEEK_END ) == 0;
+		const __int64 size = valid ? _ftelli64( mFile ) : 0;
+		valid = valid && size >= (__int64)sizeof(header);
+		if( !valid )
+		{
+			printf("'%s' is not a lineage log\n", fileName);
+			fclose( mFile );
+			mFile = NULL;
+			return false;
+		}
+
+		mRecordCount = (uint_64)(size - sizeof(header)) / sizeof(LineageRecord);
+		const __int64 end = sizeof(header) + mRecordCount * sizeof(LineageRecord);
+		if( end != size )
+		{
+			_chsize_s( _fileno( mFile ), end );
+		}
+
+		LineageRecord last;
+		if( mRecordCount > 0
+			&& _fseeki64( mFile, end - sizeof(LineageRecord), SEEK_SET ) == 0
+			&& fread( &last, sizeof(last), 1, mFile ) == 1 )
+		{
+			mLastGeneration = last.mGeneration;
+		}
+		_fseeki64( mFile, end, SEEK_SET );
+	}
+	else
+	{
+		mFile = fopen( fileName, "wb" );
+		if( mFile == NULL )
+		{
+			printf("Failed to open lineage log '%s'\n", fileName);
+			return false;
+		}
+		setvbuf( mFile, NULL, _IOFBF, kWriteBufferSize );
+
+		LineageLog::MakeHeader( header );
+		if( fwrite( &header, sizeof(header), 1, mFile ) != 1 )
+		{
+			printf("Failed to write lineage log '%s'\n", fileName);
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void LineageLogWriter::Close()
+{
+	if( mFile )
+	{
+		fclose( mFile );
+		mFile = NULL;
+	}
+}
+
+void LineageLogWriter::Flush()
+{
+	if( mFile )
+	{
+		fflush( mFile );
+	}
+}
+
+bool LineageLogWriter::Append( const LineageRecord& r )
+{
+	if( mFile == NULL )
+	{
+		return false;
+	}
+
+	if( mRecordCount > 0 && r.mGeneration <= mLastGeneration )
+	{
+		printf("Lineage log generations must increase\n");
+		return false;
+	}
+
+	if( fwrite( &r, sizeof(r), 1, mFile ) != 1 )
+	{
+		printf("Failed to write to the lineage log\n");
+		return false;
+	}
+
+	mLastGeneration = r.mGeneration;
+	++mRecordCount;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef LINEAGE_LOG_INCLUDED
+#define LINEAGE_LOG_INCLUDED
+
+#include "morph_dna.h"
+#include "core\mapped_file.h"
+#include <stdio.h>
+
+// one generation of a lineage, 48 bytes on disk
+struct LineageRecord
+{
+	uint_64 mGeneration;
+	uint_64 mParent0;		// raw dna words
+	uint_64 mParent1;
+	uint_64 mChild0;
+	uint_64 mChild1;
+	short mGene;			// -1 for the root of the lineage
+	short mDirection;
+	unsigned int mSeed;		// the random seed the lineage was started from
+
+	inline MorphDNA GetParent() const
+	{
+		MorphDNA dna;
+		dna.mFullSequence0 = mParent0;
+		dna.mFullSequence1 = mParent1;
+		return dna;
+	}
+
+	inline MorphDNA GetChild() const
+	{
+		MorphDNA dna;
+		dna.mFullSequence0 = mChild0;
+		dna.mFullSequence1 = mChild1;
+		return dna;
+	}
+};
+
+// Append-only history of a lineage
+// The file is a small versioned header followed by fixed size records in increasing generation
+// order, so any generation can be found by a search of the mapped records rather than by
+// simulating the run again. Replay by reading the records, branch by starting a new log from one
+class LineageLog
+{
+public:
+	struct Header
+	{
+		char mMagic[4];				// BLIN
+		unsigned int mVersion;
+		unsigned int mRecordSize;
+		unsigned int mReserved;		// keeps the records 16 byte aligned
+	};
+
+	static const unsigned int kVersion = 1;
+
+	LineageLog();
+	~LineageLog();
+
+	// maps whatever has been written so far, reopen to see newer records
+	bool Open( const char* fileName );
+	void Close();
+
+	inline bool IsOpen() const
+	{
+		return mFile.IsOpen();
+	}
+
+	inline size_t GetRecordCount() const
+	{
+		return mRecordCount;
+	}
+
+	inline const LineageRecord& GetRecord( size_t index ) const
+	{
+		return mRecords[index];
+	}
+
+	// the record of this generation, or the closest one before it. NULL if there is none
+	const LineageRecord* Seek( uint_64 generation ) const;
+
+	static bool IsValidHeader( const Header& h );
+	static void MakeHeader( Header& h );
+
+private:
+	LineageLog( const LineageLog& );
+	LineageLog& operator=( const LineageLog& );
+
+	MappedFile mFile;
+	const LineageRecord* mRecords;
+	size_t mRecordCount;
+};
+
+// Buffered writer for a lineage log
+// Appending to an existing log drops any record left half written by a crash
+class LineageLogWriter
+{
+public:
+	LineageLogWriter();
+	~LineageLogWriter();
+
+	bool Open( const char* fileName, bool append );
+	void Close();
+	void Flush();	// call before mapping a log that is still being written
+
+	inline bool IsOpen() const
+	{
+		return mFile != NULL;
+	}
+
+	inline uint_64 GetRecordCount() const
+	{
+		return mRecordCount;
+	}
+
+	// generations must increase
+	bool Append( const LineageRecord& r );
+
+private:
+	LineageLogWriter( const LineageLogWriter& );
+	LineageLogWriter& operator=( const LineageLogWriter& );
+
+	FILE* mFile;
+	uint_64 mRecordCount;
+	uint_64 mLastGeneration;
+};
+
+#endif
\ No newline at end of file
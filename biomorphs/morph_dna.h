@@ -5,7 +5,9 @@
 #include "core/minmax.h"
 #include "core/random.h"
 #include "core/serialisation.h"
-#include <D3DX10math.h>
+#include "core/vector3.h"
+#include "core/vector4.h"
+#include <math.h>
 
 typedef unsigned long long uint_64;
 
@@ -52,12 +54,12 @@ struct MorphDNA
 		};
 	};
 
-	bool operator==(const MorphDNA& rhs)
+	bool operator==(const MorphDNA& rhs) const
 	{
 		return mFullSequence0 == rhs.mFullSequence0 && mFullSequence1 == rhs.mFullSequence1;
 	}
 
-	bool operator!=(const MorphDNA& rhs)
+	bool operator!=(const MorphDNA& rhs) const
 	{
 		return !(*this == rhs);
 	}
@@ -86,8 +88,8 @@ inline MorphDNA MAKEDNA(unsigned int branches,
 						float initLength,
 						float lengthMod,
 						float angleMod,
-						D3DXVECTOR3 baseColour,
-						D3DXVECTOR3 colourMod)
+						Vector3f baseColour,
+						Vector3f colourMod)
 {
 	MorphDNA dna;
 	dna.mBranchDepth = branches;
@@ -96,13 +98,13 @@ inline MorphDNA MAKEDNA(unsigned int branches,
 	dna.mBranchInitialAngle = (unsigned int)((Angles::ToRadians(initAngle) / Angles::PI) * 127.0f);
 	dna.mBranchAngleModifier = (unsigned int)(angleMod * 0.5f * 255.0f);
 
-	dna.mBaseColourRed = (unsigned int)(baseColour.x * 31.0f);
-	dna.mBaseColourGreen = (unsigned int)(baseColour.y * 31.0f);
-	dna.mBaseColourBlue = (unsigned int)(baseColour.z * 31.0f);
+	dna.mBaseColourRed = (unsigned int)(baseColour.x() * 31.0f);
+	dna.mBaseColourGreen = (unsigned int)(baseColour.y() * 31.0f);
+	dna.mBaseColourBlue = (unsigned int)(baseColour.z() * 31.0f);
 
-	dna.mBranchRedModifier = (unsigned int)(colourMod.x * 0.5f * 255.0f);
-	dna.mBranchGreenModifier = (unsigned int)(colourMod.y * 0.5f * 255.0f);
-	dna.mBranchBlueModifier = (unsigned int)(colourMod.z * 0.5f * 255.0f);
+	dna.mBranchRedModifier = (unsigned int)(colourMod.x() * 0.5f * 255.0f);
+	dna.mBranchGreenModifier = (unsigned int)(colourMod.y() * 0.5f * 255.0f);
+	dna.mBranchBlueModifier = (unsigned int)(colourMod.z() * 0.5f * 255.0f);
 
 	return dna;
 }
@@ -126,14 +128,14 @@ MORPH_DNA_INLINE float BASELENGTH(const MorphDNA& dna)
 }
 
 // base colour
-MORPH_DNA_INLINE D3DXVECTOR4 BASECOLOUR(const MorphDNA& dna)
+MORPH_DNA_INLINE Vector4f BASECOLOUR(const MorphDNA& dna)
 {
 	float red = (float)dna.mBaseColourRed / 31.0f;
 	float green = (float)dna.mBaseColourGreen / 31.0f;
 	float blue = (float)dna.mBaseColourBlue / 31.0f;
 	const float alpha = 1.0f;
 
-	return D3DXVECTOR4( red, green, blue, alpha );
+	return Vector4f( red, green, blue, alpha );
 }
 
 // branch length modifier
@@ -181,22 +183,22 @@ MORPH_DNA_INLINE float BRANCHANGLE(const MorphDNA&dna, int depth)
 }
 
 // branch colour for a specific branch
-MORPH_DNA_INLINE D3DXVECTOR4 BRANCHCOLOUR(const MorphDNA&dna, int depth)	
+MORPH_DNA_INLINE Vector4f BRANCHCOLOUR(const MorphDNA&dna, int depth)	
 {
 	int d = BASEDEPTH(dna) - depth;
 
-	D3DXVECTOR4 baseColour = BASECOLOUR(dna);
+	Vector4f baseColour = BASECOLOUR(dna);
 
 	float mod = pow(BRANCHREDMOD(dna), d);
-	float r = mod * baseColour.x;
+	float r = mod * baseColour.x();
 
 	mod = pow(BRANCHGREENMOD(dna), d);
-	float g = mod * baseColour.y;
+	float g = mod * baseColour.y();
 
 	mod = pow(BRANCHBLUEMOD(dna), d);
-	float b = mod * baseColour.z;
+	float b = mod * baseColour.z();
 
-	return D3DXVECTOR4( r, g, b, 1.0f );
+	return Vector4f( r, g, b, 1.0f );
 }
 
 MORPH_DNA_INLINE int MutateGene(  int originalValue,
@@ -209,12 +211,12 @@ MORPH_DNA_INLINE int MutateGene(  int originalValue,
 	return Bounds::Min( valueMax, bd );
 }
 
-inline void MutateDNA( MorphDNA& dna )
-{
-	int gene = Random::getInt(0,10);
-	int direction = Random::getInt(0,100);
-	int dir = direction > 50 ? 1 : -1;
+// number of genes MutateDNA can modify
+static const int kMorphMutableGenes = 11;
 
+// apply a single mutation in a known direction (+1 / -1)
+inline void MutateDNAGene( MorphDNA& dna, int gene, int dir )
+{
 	switch(gene)
 	{
 	case 0:
@@ -253,4 +255,52 @@ inline void MutateDNA( MorphDNA& dna )
 	}
 }
 
+// random mutation. optionally returns the gene and direction picked
+inline void MutateDNA( MorphDNA& dna, int* geneOut = NULL, int* dirOut = NULL )
+{
+	int gene = Random::getInt(0,10);
+	int direction = Random::getInt(0,100);
+	int dir = direction > 50 ? 1 : -1;
+
+	MutateDNAGene( dna, gene, dir );
+
+	if( geneOut )
+	{
+		*geneOut = gene;
+	}
+	if( dirOut )
+	{
+		*dirOut = dir;
+	}
+}
+
+// fills 'results' with the distinct dna MutateDNA can produce from 'dna', most likely first
+// Random::getInt truncates, so it only returns its max when rand() == RAND_MAX. That makes genes 0-9
+// about 1 in 10 each and the last gene almost never picked, and -1 (0-50) a little more likely than
+// +1 (51-99). So the order is every -1 mutation, then every +1, then the last gene.
+// returns the number written
+inline int GetMutationNeighbours( const MorphDNA& dna, MorphDNA* results, int maxResults )
+{
+	static const int kLastGene = kMorphMutableGenes - 1;
+	static const int kOrder[kMorphMutableGenes * 2][2] =
+	{
+		{ 0, -1 }, { 1, -1 }, { 2, -1 }, { 3, -1 }, { 4, -1 }, { 5, -1 }, { 6, -1 }, { 7, -1 }, { 8, -1 }, { 9, -1 },
+		{ 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 1 }, { 5, 1 }, { 6, 1 }, { 7, 1 }, { 8, 1 }, { 9, 1 },
+		{ kLastGene, -1 }, { kLastGene, 1 }
+	};
+
+	int count = 0;
+	for( int n = 0; n < kMorphMutableGenes * 2 && count < maxResults; ++n )
+	{
+		MorphDNA neighbour = dna;
+		MutateDNAGene( neighbour, kOrder[n][0], kOrder[n][1] );
+		if( neighbour != dna )	// clamped genes produce the parent again
+		{
+			results[count++] = neighbour;
+		}
+	}
+
+	return count;
+}
+
 #endif
\ No newline at end of file
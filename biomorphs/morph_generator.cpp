@@ -0,0 +1,251 @@
+#include "morph_generator.h"
+#include "morph_render.h"
+
+MorphGeneratorWorker::MorphGeneratorWorker()
+	: mParent(NULL)
+	, mBuilding(false)
+	, mFrontIndex(0)
+	, mFrontReady(false)
+{
+}
+
+MorphGeneratorWorker::~MorphGeneratorWorker()
+{
+}
+
+void MorphGeneratorWorker::_publish()
+{
+	// wait until the main thread is done with the front buffer
+	while( !mParent->mQuit )
+	{
+		{
+			ScopedLock lock( mParent->mLock );
+			if( !mFrontReady )
+			{
+				mFrontIndex = mFrontIndex ^ 1;
+				mFrontReady = true;
+				mBuilding = false;
+				return;
+			}
+		}
+		mFrontFreeEvent.Wait();
+	}
+}
+
+bool MorphGeneratorWorker::threadFunc()
+{
+	while( !mParent->mQuit )
+	{
+		mParent->mWorkSemaphore.Wait();
+
+		MorphDNA dna;
+		if( !mParent->_popRequest( *this, dna ) )
+		{
+			continue;	// cancelled, or shutting down
+		}
+
+		// build into the back buffer; the front is only touched by the main thread
+		// failures are published too, so whoever is waiting on this dna finds out
+		MorphGeometry& backBuffer = mBuffers[mFrontIndex ^ 1];
+		const bool generated = MorphRender::GenerateGeometry( dna, backBuffer );
+		if( !generated )
+		{
+			backBuffer.GetDNA() = dna;
+			backBuffer.SetCounts( 0, 0 );
+		}
+		backBuffer.SetFailed( !generated );
+		_publish();
+	}
+
+	return true;
+}
+
+MorphGenerator::MorphGenerator()
+	: mWorkers(NULL)
+	, mWorkerCount(0)
+	, mQuit(false)
+{
+}
+
+MorphGenerator::~MorphGenerator()
+{
+	Release();
+}
+
+bool MorphGenerator::Initialise( int workerCount )
+{
+	mQuit = false;
+
+	mWorkerCount = Bounds::Max( workerCount, 1 );
+	mWorkers = new MorphGeneratorWorker[mWorkerCount];
+	for( int w = 0; w < mWorkerCount; ++w )
+	{
+		mWorkers[w].mParent = this;
+		if( !mWorkers[w].run() )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MorphGenerator::Release()
+{
+	if( mWorkers == NULL )
+	{
+		return;
+	}
+
+	// wake the workers up wherever they are waiting, and wait for them to exit
+	mQuit = true;
+	mWorkSemaphore.Signal( mWorkerCount );
+	for( int w = 0; w < mWorkerCount; ++w )
+	{
+		mWorkers[w].mFrontFreeEvent.Signal();
+	}
+
+	for( int w = 0; w < mWorkerCount; ++w )
+	{
+		if( mWorkers[w].m_threadHandle )
+		{
+			mWorkers[w].waitUntilComplete();
+			CloseHandle( mWorkers[w].m_threadHandle );
+		}
+	}
+
+	delete [] mWorkers;
+	mWorkers = NULL;
+	mWorkerCount = 0;
+
+	mRequests.clear();
+}
+
+void MorphGenerator::Request( const MorphDNA& dna, Priority priority )
+{
+	bool promoted = false;
+	{
+		ScopedLock lock( mLock );
+		for( int w = 0; w < mWorkerCount; ++w )
+		{
+			const MorphGeneratorWorker& worker = mWorkers[w];
+			if( worker.mBuilding && worker.mBuildingDNA == dna )
+			{
+				return;	// in progress
+			}
+			if( worker.mFrontReady && worker.mBuffers[worker.mFrontIndex].GetDNA() == dna )
+			{
+				return;	// waiting to be published
+			}
+		}
+
+		RequestList::iterator insertPos = mRequests.end();
+		for( RequestList::iterator it = mRequests.begin(); it != mRequests.end(); ++it )
+		{
+			if( (*it).mDNA == dna )
+			{
+				if( priority == PriorityHigh && (*it).mPriority == PrioritySpeculative )
+				{
+					// promote it; the semaphore already has a count for this one
+					mRequests.erase( it );
+					promoted = true;
+					break;
+				}
+				return;	// already queued
+			}
+		}
+
+		GenerateRequest request;
+		request.mDNA = dna;
+		request.mPriority = priority;
+
+		if( priority == PriorityHigh )
+		{
+			// high priority goes after other high priority requests, but before any speculation
+			for( insertPos = mRequests.begin(); insertPos != mRequests.end(); ++insertPos )
+			{
+				if( (*insertPos).mPriority == PrioritySpeculative )
+				{
+					break;
+				}
+			}
+		}
+		mRequests.insert( insertPos, request );
+	}
+
+	if( !promoted )
+	{
+		mWorkSemaphore.Signal();
+	}
+}
+
+void MorphGenerator::CancelSpeculative()
+{
+	ScopedLock lock( mLock );
+	RequestList::iterator it = mRequests.begin();
+	while( it != mRequests.end() )
+	{
+		if( (*it).mPriority == PrioritySpeculative )
+		{
+			it = mRequests.erase( it );	// workers skip the stale semaphore counts
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+const MorphGeometry* MorphGenerator::AcquireCompleted()
+{
+	ScopedLock lock( mLock );
+	for( int w = 0; w < mWorkerCount; ++w )
+	{
+		if( mWorkers[w].mFrontReady )
+		{
+			return &mWorkers[w].mBuffers[mWorkers[w].mFrontIndex];
+		}
+	}
+
+	return NULL;
+}
+
+void MorphGenerator::ReleaseCompleted( const MorphGeometry* geometry )
+{
+	for( int w = 0; w < mWorkerCount; ++w )
+	{
+		MorphGeneratorWorker& worker = mWorkers[w];
+		bool released = false;
+		{
+			ScopedLock lock( mLock );
+			if( worker.mFrontReady && geometry == &worker.mBuffers[worker.mFrontIndex] )
+			{
+				worker.mFrontReady = false;
+				released = true;
+			}
+		}
+
+		if( released )
+		{
+			worker.mFrontFreeEvent.Signal();
+			return;
+		}
+	}
+}
+
+bool MorphGenerator::_popRequest( MorphGeneratorWorker& worker, MorphDNA& dna )
+{
+	ScopedLock lock( mLock );
+	if( mRequests.empty() )
+	{
+		return false;
+	}
+
+	dna = mRequests.front().mDNA;
+	mRequests.pop_front();
+
+	worker.mBuildingDNA = dna;
+	worker.mBuilding = true;
+
+	return true;
+}
@@ -0,0 +1,89 @@
+#ifndef MORPH_GENERATOR_INCLUDED
+#define MORPH_GENERATOR_INCLUDED
+
+#include "morph_geometry.h"
+#include "core/thread.h"
+#include "core/critical_section.h"
+#include <list>
+
+class MorphGenerator;
+
+// A single producer thread. Builds geometry into a back buffer, and publishes
+// it to the front buffer once the main thread has consumed the previous result
+class MorphGeneratorWorker : public Thread
+{
+friend class MorphGenerator;
+public:
+	MorphGeneratorWorker();
+	~MorphGeneratorWorker();
+
+protected:
+	virtual bool threadFunc();
+
+private:
+	void _publish();
+
+	MorphGenerator* mParent;
+	MorphDNA mBuildingDNA;	// the dna being built, or waiting to be published
+	bool mBuilding;
+	Event mFrontFreeEvent;	// signalled when the front buffer is consumed
+	MorphGeometry mBuffers[2];
+	int mFrontIndex;		// the back buffer is always the other one
+	bool mFrontReady;		// true when the front buffer holds unconsumed data
+};
+
+// Background generation of biomorph geometry
+// Requests are queued from the main thread and picked up by a set of worker threads.
+// Only the cpu side is done here, with MorphRender::GenerateGeometry which is safe to run on
+// every worker at once; the upload + render to texture is recorded by whichever thread
+// publishes the results, via MorphRender::RenderGeometry
+class MorphGenerator
+{
+friend class MorphGeneratorWorker;
+public:
+	enum Priority
+	{
+		PriorityHigh,			// something is waiting on this
+		PrioritySpeculative		// generate when idle, may be cancelled
+	};
+
+	MorphGenerator();
+	~MorphGenerator();
+
+	bool Initialise( int workerCount );
+	void Release();
+
+	// queue some dna for generation (main thread)
+	// requesting queued speculative dna at high priority moves it to the front
+	// dna that is already queued or being built is ignored
+	void Request( const MorphDNA& dna, Priority priority = PriorityHigh );
+
+	// removes any speculative requests that have not been started
+	void CancelSpeculative();
+
+	// returns a published result, or NULL if nothing is ready (one consumer thread at a time)
+	// results that failed to generate are published with HasFailed set
+	// call ReleaseCompleted once the data has been consumed
+	const MorphGeometry* AcquireCompleted();
+	void ReleaseCompleted( const MorphGeometry* geometry );
+
+private:
+	struct GenerateRequest
+	{
+		MorphDNA mDNA;
+		Priority mPriority;
+	};
+	typedef std::list<GenerateRequest> RequestList;
+
+	bool _popRequest( MorphGeneratorWorker& worker, MorphDNA& dna );
+
+	CriticalSection mLock;
+	Semaphore mWorkSemaphore;	// one count per queued request
+	RequestList mRequests;		// high priority requests are kept in front
+
+	MorphGeneratorWorker* mWorkers;
+	int mWorkerCount;
+	volatile bool mQuit;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef MORPH_GEOMETRY_INCLUDED
+#define MORPH_GEOMETRY_INCLUDED
+
+#include "morph_dna.h"
+#include "core/vector2.h"
+#include "core/vector4.h"
+#include <stdlib.h>
+
+// CPU-side storage for a single generated biomorph mesh
+// This is filled by MorphRender::GenerateGeometry (safe to call from any thread),
+// and uploaded to the GPU on the render thread by MorphRender::RenderGeometry
+class MorphGeometry
+{
+public:
+	// vertex structure
+	struct Vertex
+	{
+		Vector2f mPosition;
+		Vector4f mColour;
+	};
+
+	MorphGeometry()
+		: mVertices(NULL)
+		, mIndices(NULL)
+		, mMaxVertices(0)
+		, mMaxIndices(0)
+		, mVertexCount(0)
+		, mIndexCount(0)
+		, mFailed(false)
+	{
+	}
+
+	~MorphGeometry()
+	{
+		Release();
+	}
+
+	// grows the buffers if required. Existing contents are lost
+	inline bool Reserve( int vertexCount, int indexCount )
+	{
+		if( vertexCount > mMaxVertices )
+		{
+			free( mVertices );
+			mVertices = (Vertex*)malloc( sizeof(Vertex) * vertexCount );
+			mMaxVertices = mVertices ? vertexCount : 0;
+		}
+
+		if( indexCount > mMaxIndices )
+		{
+			free( mIndices );
+			mIndices = (unsigned int*)malloc( sizeof(unsigned int) * indexCount );
+			mMaxIndices = mIndices ? indexCount : 0;
+		}
+
+		Reset();
+
+		return mVertices != NULL && mIndices != NULL;
+	}
+
+	inline void Release()
+	{
+		free( mVertices );
+		free( mIndices );
+		mVertices = NULL;
+		mIndices = NULL;
+		mMaxVertices = mMaxIndices = 0;
+		Reset();
+	}
+
+	inline void Reset()
+	{
+		mVertexCount = mIndexCount = 0;
+	}
+
+	inline Vertex* GetVertices()				{ return mVertices; }
+	inline const Vertex* GetVertices() const	{ return mVertices; }
+	inline unsigned int* GetIndices()			{ return mIndices; }
+	inline const unsigned int* GetIndices() const { return mIndices; }
+
+	inline int GetVertexCount() const	{ return mVertexCount; }
+	inline int GetIndexCount() const	{ return mIndexCount; }
+	inline void SetCounts( int vertices, int indices )
+	{
+		mVertexCount = vertices;
+		mIndexCount = indices;
+	}
+
+	inline MorphDNA& GetDNA()				{ return mDNA; }
+	inline const MorphDNA& GetDNA() const	{ return mDNA; }
+
+	// set when generation failed, the dna is still valid but there is no mesh
+	inline bool HasFailed() const			{ return mFailed; }
+	inline void SetFailed( bool failed )	{ mFailed = failed; }
+
+private:
+	MorphGeometry( const MorphGeometry& );
+	MorphGeometry& operator=( const MorphGeometry& );
+
+	MorphDNA mDNA;	// the dna this geometry was built from
+	Vertex* mVertices;
+	unsigned int* mIndices;
+	int mMaxVertices;
+	int mMaxIndices;
+	int mVertexCount;
+	int mIndexCount;
+	bool mFailed;
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,5 @@
 #include "biomorphs/morph_render.h"
-#include "framework/graphics/device.h"
+#include "framework/graphics/idevice.h"
 #include "core/profiler.h"
 
 MorphRender::MorphRender()
@@ -38,7 +38,7 @@ Texture2D MorphRender::CopyOutputTexture(Texture2D& texture)
 	return resultTexture;
 }
 
-int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVertex*& vertices, unsigned int*& indices )
+int MorphRender::_drawRecursive( const MorphDNA& dna, RecursionParams& params, MorphVertex*& vertices, unsigned int*& indices )
 {
 	if( params.branchDepth <= 0 )
 	{
@@ -46,15 +46,15 @@ int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVe
 	}
 
 	const float kBranchWidth = 0.1f;	// line width
-	D3DXVECTOR2 branchDir;
-	D3DXVECTOR2 branchPerp;
+	Vector2f branchDir;
+	Vector2f branchPerp;
 	GetGeometryVectors( params.Angle, params.Length, branchDir, branchPerp );	// calculate vectors
 
 	int vCount = 0;
 	int iCount = 0;
 	if( params.Draw )
 	{
-		D3DXVECTOR2 offset(0.0f,0.0f);
+		Vector2f offset(0.0f,0.0f);
 		vCount = WriteVertices( vertices, kBranchWidth, params.Colour, params.Origin, branchDir, branchPerp, offset, params.DrawScale );	// write verts
 		iCount = WriteQuadIndices( indices, params.vertexOffset );	// write indices
 	}
@@ -68,7 +68,7 @@ int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVe
 	int newDepth = params.branchDepth-1;
 	float branchLength = BRANCHLENGTH(dna, newDepth);
 	float branchAngle = BRANCHANGLE(dna, newDepth);
-	D3DXVECTOR4 branchColour = BRANCHCOLOUR(dna, newDepth);
+	Vector4f branchColour = BRANCHCOLOUR(dna, newDepth);
 		
 	// now draw 2 child branches
 	RecursionParams childParams;
@@ -87,10 +87,10 @@ int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVe
 	childParams.vertexOffset += ((ch0Indices / 6) * 4);
 	if( !params.Draw )
 	{
-		params.BoundsMin.x = Bounds::Min(params.BoundsMin.x, childParams.BoundsMin.x);
-		params.BoundsMin.y = Bounds::Min(params.BoundsMin.y, childParams.BoundsMin.y);
-		params.BoundsMax.x = Bounds::Max(params.BoundsMax.x, childParams.BoundsMax.x);
-		params.BoundsMax.y = Bounds::Max(params.BoundsMax.y, childParams.BoundsMax.y);
+		params.BoundsMin.x() = Bounds::Min(params.BoundsMin.x(), childParams.BoundsMin.x());
+		params.BoundsMin.y() = Bounds::Min(params.BoundsMin.y(), childParams.BoundsMin.y());
+		params.BoundsMax.x() = Bounds::Max(params.BoundsMax.x(), childParams.BoundsMax.x());
+		params.BoundsMax.y() = Bounds::Max(params.BoundsMax.y(), childParams.BoundsMax.y());
 	}
 
 	childParams.Angle = params.Angle - branchAngle;
@@ -98,10 +98,10 @@ int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVe
 	
 	if( !params.Draw )
 	{
-		params.BoundsMin.x = Bounds::Min(params.BoundsMin.x, childParams.BoundsMin.x);
-		params.BoundsMin.y = Bounds::Min(params.BoundsMin.y, childParams.BoundsMin.y);
-		params.BoundsMax.x = Bounds::Max(params.BoundsMax.x, childParams.BoundsMax.x);
-		params.BoundsMax.y = Bounds::Max(params.BoundsMax.y, childParams.BoundsMax.y);
+		params.BoundsMin.x() = Bounds::Min(params.BoundsMin.x(), childParams.BoundsMin.x());
+		params.BoundsMin.y() = Bounds::Min(params.BoundsMin.y(), childParams.BoundsMin.y());
+		params.BoundsMax.x() = Bounds::Max(params.BoundsMax.x(), childParams.BoundsMax.x());
+		params.BoundsMax.y() = Bounds::Max(params.BoundsMax.y(), childParams.BoundsMax.y());
 	}
 
 	iCount += ch0Indices + ch1Indices;
@@ -109,20 +109,25 @@ int MorphRender::_drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVe
 	return iCount;
 }
 
-void MorphRender::CalculateBounds( MorphDNA& dna, D3DXVECTOR2& min, D3DXVECTOR2& max )
+void MorphRender::CalculateBounds( MorphDNA& dna, Vector2f& min, Vector2f& max )
 {
 	SCOPED_PROFILE(CalculateMorphBounds);
+	_calculateBounds( dna, min, max );
+}
 
+// no profiling in here, as it is called from the generator thread
+void MorphRender::_calculateBounds( const MorphDNA& dna, Vector2f& min, Vector2f& max )
+{
 	// first calculate the overal bounds
 	RecursionParams baseParams;
 	baseParams.vertexOffset = 0;
 	baseParams.branchDepth = BASEDEPTH(dna);
 	baseParams.Angle = 0;						// Start straight up
 	baseParams.Length = BASELENGTH(dna);
-	baseParams.Origin = D3DXVECTOR2(0.0f,0.0f);
+	baseParams.Origin = Vector2f(0.0f,0.0f);
 	baseParams.Colour = BASECOLOUR(dna);
-	baseParams.BoundsMin = D3DXVECTOR2(1.0f,1.0f);
-	baseParams.BoundsMax = D3DXVECTOR2(0.0f,0.0f);
+	baseParams.BoundsMin = Vector2f(1.0f,1.0f);
+	baseParams.BoundsMax = Vector2f(0.0f,0.0f);
 	baseParams.Draw = false;
 	baseParams.DrawScale = 1.0f;
 
@@ -134,54 +139,58 @@ void MorphRender::CalculateBounds( MorphDNA& dna, D3DXVECTOR2& min, D3DXVECTOR2&
 	max = baseParams.BoundsMax;
 }
 
-void MorphRender::DrawBiomorph( MorphDNA& dna, D3DXVECTOR2 offset, float size )
+bool MorphRender::GenerateGeometry( const MorphDNA& dna, MorphGeometry& geometry, Vector2f offset, float size )
 {
-	SCOPED_PROFILE(DrawBiomorph);
-
-	if( m_verticesWritten > kMaxVertices || m_indicesWritten > kMaxIndices )
+	// each branch spawns 2 children, so the quad count is known up-front
+	const int quadCount = (1 << BASEDEPTH(dna)) - 1;
+	if( !geometry.Reserve( quadCount * 4, quadCount * 6 ) )
 	{
-		printf("Drawing too many verts/indices\n");
-		return ;
+		return false;
 	}
+	geometry.GetDNA() = dna;
 
 	// build render parameters
 	RecursionParams baseParams;
-	_buildRenderParameters( dna, baseParams );
+	_buildRenderParameters( dna, 0, baseParams );
 
 	// first calculate the overal bounds
-	CalculateBounds( dna, baseParams.BoundsMin, baseParams.BoundsMax );
+	_calculateBounds( dna, baseParams.BoundsMin, baseParams.BoundsMax );
 
 	// now draw, rescaling using the bounds
-	D3DXVECTOR2 dimensions = (baseParams.BoundsMax - baseParams.BoundsMin);
-	baseParams.DrawScale = size / Bounds::Max( dimensions.x, dimensions.y );
+	Vector2f dimensions = (baseParams.BoundsMax - baseParams.BoundsMin);
+	baseParams.DrawScale = size / Bounds::Max( dimensions.x(), dimensions.y() );
 	baseParams.Origin = offset;
 	baseParams.Draw = true;
 
-	{
-		SCOPED_PROFILE(GenerateGeometry);
-		MorphVertex* v = m_lockedVBData + m_verticesWritten;
-		unsigned int* i = m_lockedIBData + m_indicesWritten;	
-		int indexCount = _drawRecursive( dna, baseParams, v, i );
-		m_verticesWritten += (indexCount / 6) * 4;
-		m_indicesWritten += indexCount;
-	}
+	MorphVertex* v = geometry.GetVertices();
+	unsigned int* i = geometry.GetIndices();
+	int indexCount = _drawRecursive( dna, baseParams, v, i );
+	geometry.SetCounts( (indexCount / 6) * 4, indexCount );
+
+	return true;
 }
 
-void MorphRender::StartRendering()
+void MorphRender::RenderGeometry( const MorphGeometry& geometry )
 {
-	// Lock the VB and IB for writing
-	m_lockedVBData = (MorphVertex*)m_device->LockVB(m_vb);
-	m_lockedIBData = (unsigned int*)m_device->LockIB(m_ib);
+	SCOPED_PROFILE(RenderMorphGeometry);
 
-	m_verticesWritten = m_indicesWritten = 0;
+	int indexCount = 0;
+	if( geometry.GetVertexCount() <= kMaxVertices && geometry.GetIndexCount() <= kMaxIndices )
+	{
+		m_device->UpdateVB( m_vb, geometry.GetVertices(), 0, sizeof(MorphVertex) * geometry.GetVertexCount() );
+		m_device->UpdateIB( m_ib, geometry.GetIndices(), 0, sizeof(unsigned int) * geometry.GetIndexCount() );
+		indexCount = geometry.GetIndexCount();
+	}
+	else
+	{
+		printf("Drawing too many verts/indices\n");
+	}
+
+	_renderToTexture( indexCount );
 }
 
-void MorphRender::EndRendering()
+void MorphRender::_renderToTexture( int indexCount )
 {
-	// Unlock the vb and ib ready to draw
-	m_device->UnlockVB(m_vb);
-	m_device->UnlockIB(m_ib);
-
 	// reset the shader state (unbinds the render target)
 	m_device->ResetShaderState();
 	m_device->SetRenderTargets( &m_rt, &m_depthStencil );
@@ -200,9 +209,7 @@ void MorphRender::EndRendering()
 	// Clear depth/stencil
 	m_device->ClearTarget(m_depthStencil, 1.0f, 0 );
 
-	EffectTechnique t = m_shader.GetTechniqueByName("Render");
-
-	m_device->SetTechnique(t, 0);
+	m_device->SetTechnique(m_renderTechnique, 0);
 	m_device->SetInputLayout(m_inputLayout);
 	m_device->SetPrimitiveTopology(PRIMITIVE_TRIANGLES);
 
@@ -210,19 +217,21 @@ void MorphRender::EndRendering()
 	m_device->SetVertexBuffer(0, m_vb);
 
 	DrawIndexedParameters dp;
-	dp.m_indexCount = m_indicesWritten;
+	dp.m_indexCount = indexCount;
 	dp.m_pass = 0;
 	dp.m_startIndex = 0;
 	m_device->DrawIndexed(dp);
 }
 
-bool MorphRender::Initialise( Device* d, const Parameters& p )
+bool MorphRender::Initialise( IDevice* d, const Parameters& p )
 {
 	m_device = d;
 
 	// load the effect
 	Effect::Parameters ep("shaders/simple_blit.fx");
 	m_shader = m_device->CreateEffect( ep );
+	m_binding.Create( *m_device, m_shader );
+	m_renderTechnique = m_binding.GetTechnique( "Render" );
 
 	// create vertex descriptor
 	VertexElement e;
@@ -231,7 +240,7 @@ bool MorphRender::Initialise( Device* d, const Parameters& p )
 	e.format = VertexElement::VTX_FLOAT2;
 	e.SetSemanticName("POSITION");
 	m_vd.AddElement(e);
-	e.byteOffset += sizeof(D3DXVECTOR2);
+	e.byteOffset += sizeof(Vector2f);
 	e.format = VertexElement::VTX_FLOAT4;
 	e.SetSemanticName("COLOR");
 	m_vd.AddElement(e);
@@ -243,7 +252,7 @@ bool MorphRender::Initialise( Device* d, const Parameters& p )
 
 	VertexBuffer::Parameters vbParams;
 	vbParams.sourceBuffer = NULL;
-	vbParams.access = VertexBuffer::CpuWrite;	// we want to write to the buffer
+	vbParams.access = VertexBuffer::CpuNoAccess;	// written with UpdateVB
 	vbParams.stride = vertexSize;
 	vbParams.vertexCount = numVerts;
 	vbParams.vertexSize = vertexSize;
@@ -254,7 +263,7 @@ bool MorphRender::Initialise( Device* d, const Parameters& p )
 	ibParams.format = IndexBuffer::IB_32BIT;
 	ibParams.indexCount = kMaxIndices;
 	ibParams.sourceBuffer = NULL;
-	ibParams.access = IndexBuffer::CpuWrite;	// we want to write to the buffer
+	ibParams.access = IndexBuffer::CpuNoAccess;	// written with UpdateIB
 	m_ib = m_device->CreateIB( ibParams );
 
 	// Create the input layout
@@ -298,6 +307,7 @@ bool MorphRender::Release()
 	m_device->Release( m_inputLayout );
 	m_device->Release( m_vb );
 	m_device->Release( m_ib );
+	m_binding.Release();
 	m_device->Release( m_shader );
 
 	return true;
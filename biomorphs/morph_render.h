@@ -2,8 +2,14 @@
 #define MORPH_RENDER_INCLUDED
 
 #include "framework\graphics\device_types.h"
+#include "framework\graphics\effect_binding.h"
 #include "morph_dna.h"
+#include "morph_geometry.h"
 #include "core/minmax.h"
+#include "core/vector2.h"
+#include "core/vector4.h"
+
+class IDevice;
 
 class MorphRender
 {
@@ -16,40 +22,43 @@ public:
 	MorphRender();
 	~MorphRender();
 
-	bool Initialise( Device* d, const Parameters& p );
+	bool Initialise( IDevice* d, const Parameters& p );
 	bool Release();
 
-	void StartRendering();	// call this at the start of the frame
-	void CalculateBounds( MorphDNA& dna, D3DXVECTOR2& min, D3DXVECTOR2& max );
-	void DrawBiomorph( MorphDNA& dna, D3DXVECTOR2 offset = D3DXVECTOR2(0.0f,0.0f), float size = 1.0f );
-	void EndRendering();	// call this to push all data to D3D
-
-	inline int GetVertexCount()
+	// usually a command list, swapped each frame
+	inline void SetDevice( IDevice* d )
 	{
-		return m_verticesWritten;
+		m_device = d;
 	}
 
+	void CalculateBounds( MorphDNA& dna, Vector2f& min, Vector2f& max );
+
+	// cpu-only geometry generation. Static, so it touches no renderer or device state
+	// and any number of threads can call it at once
+	static bool GenerateGeometry( const MorphDNA& dna, MorphGeometry& geometry, Vector2f offset = Vector2f(0.0f,0.0f), float size = 1.0f );
+
+	// upload pre-generated geometry and render it to the output texture
+	// only the vertices + indices the morph uses are written, so recorded lists stay small
+	void RenderGeometry( const MorphGeometry& geometry );
+
 	Texture2D CopyOutputTexture(Texture2D& texture);
 
 private:
 	// vertex structure
-	struct MorphVertex
-	{
-		D3DXVECTOR2 mPosition;
-		D3DXVECTOR4 mColour;	
-	};
+	typedef MorphGeometry::Vertex MorphVertex;
 
-	inline void CalculateBounds( const D3DXVECTOR2& origin, D3DXVECTOR2& direction, D3DXVECTOR2& min, D3DXVECTOR2& max );
-	inline void GetGeometryVectors( float angle, float length, D3DXVECTOR2& direction, D3DXVECTOR2& perpendicular );
-	__forceinline int WriteVertices( MorphVertex*& vertices, 
+	// everything GenerateGeometry uses is static as well
+	static inline void CalculateBounds( const Vector2f& origin, Vector2f& direction, Vector2f& min, Vector2f& max );
+	static inline void GetGeometryVectors( float angle, float length, Vector2f& direction, Vector2f& perpendicular );
+	static __forceinline int WriteVertices( MorphVertex*& vertices, 
 								float width,
-								const D3DXVECTOR4& colour,
-								const D3DXVECTOR2& origin,
-								const D3DXVECTOR2& direction, 
-								const D3DXVECTOR2& perpendicular,
-								const D3DXVECTOR2& offset,
+								const Vector4f& colour,
+								const Vector2f& origin,
+								const Vector2f& direction, 
+								const Vector2f& perpendicular,
+								const Vector2f& offset,
 								float drawScale );
-	__forceinline int WriteQuadIndices( unsigned int*& indices, int vertexOffset );
+	static __forceinline int WriteQuadIndices( unsigned int*& indices, int vertexOffset );
 
 	// recursion structure (saves passing lots of arguments)
 	// base structure based on the MorphDNA
@@ -58,35 +67,33 @@ private:
 		int vertexOffset;		// index buffer vertex offset
 		int branchDepth;		// branch depth
 
-		D3DXVECTOR2 Origin;		// branch origin
+		Vector2f Origin;		// branch origin
 		float Angle;			// branch angle (0 = straight up)
 		float Length;			// length of a branch
-		D3DXVECTOR4 Colour;		// branch colour
+		Vector4f Colour;		// branch colour
 
 		bool Draw;				// flag to switch between draw and bounds calculation
-		D3DXVECTOR2 BoundsMin;
-		D3DXVECTOR2 BoundsMax;
+		Vector2f BoundsMin;
+		Vector2f BoundsMax;
 
 		float DrawScale;
 	};
 
 	// returns indices written
-	int _drawRecursive( MorphDNA& dna, RecursionParams& params, MorphVertex*& vertices, unsigned int*& indices );
-	inline void _buildRenderParameters( MorphDNA& dna, RecursionParams& p );
+	static int _drawRecursive( const MorphDNA& dna, RecursionParams& params, MorphVertex*& vertices, unsigned int*& indices );
+	static void _calculateBounds( const MorphDNA& dna, Vector2f& min, Vector2f& max );
+	static inline void _buildRenderParameters( const MorphDNA& dna, int vertexOffset, RecursionParams& p );
+	void _renderToTexture( int indexCount );
 
 	static const int kMaxVertices = 4 * 1024 * 1024;
 	static const int kMaxIndices = kMaxVertices * 6;
 
 	Parameters m_params;
 
-	// temporary pointers to locked data
-	MorphVertex* m_lockedVBData;
-	unsigned int* m_lockedIBData;
-	int m_verticesWritten;
-	int m_indicesWritten;
-
-	Device* m_device;
+	IDevice* m_device;
 	Effect m_shader;
+	EffectBinding m_binding;
+	EffectTechnique m_renderTechnique;
 	VertexDescriptor m_vd;
 	VertexBuffer m_vb;
 	IndexBuffer m_ib;
@@ -98,16 +105,16 @@ private:
 	Texture2D m_texture;
 };
 
-inline void MorphRender::_buildRenderParameters( MorphDNA& dna, RecursionParams& p )
+inline void MorphRender::_buildRenderParameters( const MorphDNA& dna, int vertexOffset, RecursionParams& p )
 {
-	p.vertexOffset = m_verticesWritten;
+	p.vertexOffset = vertexOffset;
 	p.branchDepth = BASEDEPTH(dna);
 	p.Angle = 0;
 	p.Length = BASELENGTH(dna);
-	p.Origin = D3DXVECTOR2(0.0f,0.0f);
+	p.Origin = Vector2f(0.0f,0.0f);
 	p.Colour = BASECOLOUR(dna);
-	p.BoundsMin = D3DXVECTOR2(1.0f,1.0f);
-	p.BoundsMax = D3DXVECTOR2(0.0f,0.0f);
+	p.BoundsMin = Vector2f(1.0f,1.0f);
+	p.BoundsMax = Vector2f(0.0f,0.0f);
 	p.Draw = false;
 	p.DrawScale = 1.0f;
 }
@@ -130,16 +137,16 @@ __forceinline int MorphRender::WriteQuadIndices( unsigned int*& indices, int ver
 // write verts for a single branch
 __forceinline int MorphRender::WriteVertices( MorphVertex*& vertices, 
 										float width,
-										const D3DXVECTOR4& colour,
-										const D3DXVECTOR2& origin,
-										const D3DXVECTOR2& direction, 
-										const D3DXVECTOR2& perpendicular,
-										const D3DXVECTOR2& offset,
+										const Vector4f& colour,
+										const Vector2f& origin,
+										const Vector2f& direction, 
+										const Vector2f& perpendicular,
+										const Vector2f& offset,
 										float drawScale)
 {
-	const D3DXVECTOR2 perp = perpendicular * width * drawScale;
-	const D3DXVECTOR2 o(origin + offset);
-	const D3DXVECTOR2 d = direction * drawScale;
+	const Vector2f perp = perpendicular * width * drawScale;
+	const Vector2f o(origin + offset);
+	const Vector2f d = direction * drawScale;
 
 	vertices[0].mPosition = o - perp;
 	vertices[0].mColour = colour;
@@ -157,48 +164,32 @@ __forceinline int MorphRender::WriteVertices( MorphVertex*& vertices,
 	return 4;
 }
 
-inline void MorphRender::CalculateBounds( const D3DXVECTOR2& origin, D3DXVECTOR2& direction, D3DXVECTOR2& min, D3DXVECTOR2& max )
+inline void MorphRender::CalculateBounds( const Vector2f& origin, Vector2f& direction, Vector2f& min, Vector2f& max )
 {
 	// calculate min and max
-	min.x = Bounds::Min(min.x, origin.x);
-	min.x = Bounds::Min(min.x, origin.x + direction.x);
+	min.x() = Bounds::Min(min.x(), origin.x());
+	min.x() = Bounds::Min(min.x(), origin.x() + direction.x());
 
-	min.y = Bounds::Min(min.y, origin.y);
-	min.y = Bounds::Min(min.y, origin.y + direction.y);
+	min.y() = Bounds::Min(min.y(), origin.y());
+	min.y() = Bounds::Min(min.y(), origin.y() + direction.y());
 
-	max.x = Bounds::Max(max.x, origin.x);
-	max.x = Bounds::Max(max.x, origin.x + direction.x);
+	max.x() = Bounds::Max(max.x(), origin.x());
+	max.x() = Bounds::Max(max.x(), origin.x() + direction.x());
 
-	max.y = Bounds::Max(max.y, origin.y);
-	max.y = Bounds::Max(max.y, origin.y + direction.y);
+	max.y() = Bounds::Max(max.y(), origin.y());
+	max.y() = Bounds::Max(max.y(), origin.y() + direction.y());
 }
 
 // calculate direction and perpendicular (normalised)
-inline void MorphRender::GetGeometryVectors( float angle, float length, D3DXVECTOR2& direction, D3DXVECTOR2& perpendicular )
+inline void MorphRender::GetGeometryVectors( float angle, float length, Vector2f& direction, Vector2f& perpendicular )
 {
-	const D3DXVECTOR2 baseDirection(0.0f, 1.0f);
-
-	// rotate the direction, based on the angle
-	D3DXMATRIX branchRotationMat;
-	D3DXMatrixRotationZ( &branchRotationMat, angle );
-
-	// rotate the vector
-	D3DXVECTOR4 branchDirection4;
-	D3DXVec2Transform( &branchDirection4, &baseDirection, &branchRotationMat );
-	
-	// resolve to normalised 2d vector
-	D3DXVECTOR2 branchDirection2( branchDirection4.x, branchDirection4.y );
-	D3DXVec2Normalize( &direction, &branchDirection2 );
-	direction *= length;
-
-	// now get the normalised perpendicular
-	D3DXVECTOR3 branchPerp3;
-	const D3DXVECTOR3 v0( 0.0f, 0.0f, -1.0f);
-	D3DXVECTOR3 v1( branchDirection2.x, branchDirection2.y, 0.0f );
-	D3DXVec3Cross( &branchPerp3, &v0, &v1 );
-	D3DXVECTOR2 branchPerpendicular( branchPerp3.x, branchPerp3.y );
-	D3DXVec2Normalize( &branchPerpendicular, &branchPerpendicular );
-	perpendicular = branchPerpendicular * 0.5f;
+	// (0,1) rotated about z by the angle
+	const float s = sinf( angle );
+	const float c = cosf( angle );
+	direction = Vector2f( -s, c ) * length;
+
+	// (0,0,-1) x direction, already unit length
+	perpendicular = Vector2f( c, s ) * 0.5f;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef BOUNDED_QUEUE_INCLUDED
+#define BOUNDED_QUEUE_INCLUDED
+
+#include "critical_section.h"
+#include <vector>
+
+// Fixed capacity FIFO for handing work between threads
+// Push blocks while the queue is full, so a slow consumer holds back the producer
+// instead of letting memory grow. Pop blocks until something arrives
+template<class T>
+class BoundedQueue
+{
+public:
+	BoundedQueue()
+		: mHead(0)
+		, mCount(0)
+	{
+	}
+
+	bool Initialise( int capacity )
+	{
+		if( capacity <= 0 || !mItems.empty() )
+		{
+			return false;
+		}
+
+		mItems.resize( capacity );
+		mFreeSlots.Signal( capacity );
+		return true;
+	}
+
+	// drops anything still queued, nothing may be waiting on the queue
+	void Release()
+	{
+		while( mFreeSlots.Wait( 0 ) )
+		{
+		}
+		while( mUsedSlots.Wait( 0 ) )
+		{
+		}
+
+		mItems.clear();
+		mHead = 0;
+		mCount = 0;
+	}
+
+	inline int GetCapacity() const
+	{
+		return (int)mItems.size();
+	}
+
+	int GetCount()
+	{
+		ScopedLock lock( mLock );
+		return mCount;
+	}
+
+	void Push( const T& item )
+	{
+		mFreeSlots.Wait();
+		_push( item );
+	}
+
+	// returns false if the queue was full
+	bool TryPush( const T& item )
+	{
+		if( !mFreeSlots.Wait( 0 ) )
+		{
+			return false;
+		}
+		_push( item );
+		return true;
+	}
+
+	T Pop()
+	{
+		mUsedSlots.Wait();
+		return _pop();
+	}
+
+	// returns false if the queue was empty
+	bool TryPop( T& item )
+	{
+		if( !mUsedSlots.Wait( 0 ) )
+		{
+			return false;
+		}
+		item = _pop();
+		return true;
+	}
+
+private:
+	BoundedQueue( const BoundedQueue& );
+	BoundedQueue& operator=( const BoundedQueue& );
+
+	void _push( const T& item )
+	{
+		{
+			ScopedLock lock( mLock );
+			mItems[(mHead + mCount) % mItems.size()] = item;
+			++mCount;
+		}
+		mUsedSlots.Signal();
+	}
+
+	T _pop()
+	{
+		T item;
+		{
+			ScopedLock lock( mLock );
+			item = mItems[mHead];
+			mHead = (mHead + 1) % (int)mItems.size();
+			--mCount;
+		}
+		mFreeSlots.Signal();
+		return item;
+	}
+
+	CriticalSection mLock;
+	Semaphore mFreeSlots;
+	Semaphore mUsedSlots;
+	std::vector<T> mItems;
+	int mHead;
+	int mCount;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef CRITICAL_SECTION_INCLUDED
+#define CRITICAL_SECTION_INCLUDED
+
+#include <Windows.h>
+
+// Thin wrappers around the win32 sync primitives, used alongside Thread
+
+class CriticalSection
+{
+public:
+	CriticalSection()
+	{
+		InitializeCriticalSection( &m_section );
+	}
+
+	~CriticalSection()
+	{
+		DeleteCriticalSection( &m_section );
+	}
+
+	inline void Enter()
+	{
+		EnterCriticalSection( &m_section );
+	}
+
+	inline void Leave()
+	{
+		LeaveCriticalSection( &m_section );
+	}
+
+private:
+	CriticalSection( const CriticalSection& );
+	CriticalSection& operator=( const CriticalSection& );
+
+	CRITICAL_SECTION m_section;
+};
+
+class ScopedLock
+{
+public:
+	ScopedLock( CriticalSection& cs )
+		: m_section( cs )
+	{
+		m_section.Enter();
+	}
+
+	~ScopedLock()
+	{
+		m_section.Leave();
+	}
+
+private:
+	ScopedLock& operator=( const ScopedLock& );
+
+	CriticalSection& m_section;
+};
+
+class Event
+{
+public:
+	Event( bool manualReset = false, bool initialState = false )
+	{
+		m_event = CreateEvent( NULL, manualReset ? TRUE : FALSE, initialState ? TRUE : FALSE, NULL );
+	}
+
+	~Event()
+	{
+		if( m_event )
+		{
+			CloseHandle( m_event );
+		}
+	}
+
+	inline void Signal()
+	{
+		SetEvent( m_event );
+	}
+
+	inline void Reset()
+	{
+		ResetEvent( m_event );
+	}
+
+	// returns true if the event was signalled, false on timeout
+	inline bool Wait( DWORD timeoutMs = INFINITE )
+	{
+		return WaitForSingleObject( m_event, timeoutMs ) == WAIT_OBJECT_0;
+	}
+
+private:
+	Event( const Event& );
+	Event& operator=( const Event& );
+
+	HANDLE m_event;
+};
+
+class Semaphore
+{
+public:
+	Semaphore( int initialCount = 0, int maxCount = 0x7fffffff )
+	{
+		m_semaphore = CreateSemaphore( NULL, initialCount, maxCount, NULL );
+	}
+
+	~Semaphore()
+	{
+		if( m_semaphore )
+		{
+			CloseHandle( m_semaphore );
+		}
+	}
+
+	inline void Signal( int count = 1 )
+	{
+		ReleaseSemaphore( m_semaphore, count, NULL );
+	}
+
+	// returns true if the count was decremented, false on timeout
+	inline bool Wait( DWORD timeoutMs = INFINITE )
+	{
+		return WaitForSingleObject( m_semaphore, timeoutMs ) == WAIT_OBJECT_0;
+	}
+
+private:
+	Semaphore( const Semaphore& );
+	Semaphore& operator=( const Semaphore& );
+
+	HANDLE m_semaphore;
+};
+
+#endif
\ No newline at end of file
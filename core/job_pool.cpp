@@ -0,0 +1,198 @@
+#include "job_pool.h"
+#include "thread.h"
+#include "minmax.h"
+
+class JobPoolWorker : public Thread
+{
+friend class JobPool;
+public:
+	JobPoolWorker()
+		: mPool(NULL)
+		, mWorkerIndex(0)
+	{
+	}
+
+protected:
+	virtual bool threadFunc()
+	{
+		while( true )
+		{
+			mPool->mWakeSemaphore.Wait();
+			if( mPool->mQuit )
+			{
+				break;
+			}
+
+			int jobId = 0;
+			{
+				ScopedLock lock( mPool->mLock );
+				jobId = mPool->mJobId;
+			}
+			mPool->_runChunks( jobId, mWorkerIndex );
+		}
+
+		return true;
+	}
+
+private:
+	JobPool* mPool;
+	int mWorkerIndex;
+};
+
+JobPool::JobPool()
+	: mFunction(NULL)
+	, mUserData(NULL)
+	, mCount(0)
+	, mGranularity(1)
+	, mNextIndex(0)
+	, mChunksRemaining(0)
+	, mJobId(0)
+	, mThreads(NULL)
+	, mThreadCount(0)
+	, mQuit(false)
+{
+}
+
+JobPool::~JobPool()
+{
+	Release();
+}
+
+int JobPool::GetHardwareThreads()
+{
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo( &sysInfo );
+	return (int)sysInfo.dwNumberOfProcessors;
+}
+
+bool JobPool::Initialise( int workerThreads )
+{
+	mQuit = false;
+	mThreadCount = Bounds::Max( workerThreads, 0 );
+	if( mThreadCount == 0 )
+	{
+		return true;
+	}
+
+	mThreads = new JobPoolWorker[mThreadCount];
+	for( int t = 0; t < mThreadCount; ++t )
+	{
+		mThreads[t].mPool = this;
+		mThreads[t].mWorkerIndex = t + 1;	// 0 is the calling thread
+		if( !mThreads[t].run() )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void JobPool::Release()
+{
+	if( mThreads == NULL )
+	{
+		return;
+	}
+
+	mQuit = true;
+	mWakeSemaphore.Signal( mThreadCount );
+	for( int t = 0; t < mThreadCount; ++t )
+	{
+		JobPoolWorker& worker = mThreads[t];
+		if( worker.m_threadHandle )
+		{
+			worker.waitUntilComplete();
+			CloseHandle( worker.m_threadHandle );
+		}
+	}
+
+	delete [] mThreads;
+	mThreads = NULL;
+	mThreadCount = 0;
+}
+
+bool JobPool::_claimChunk( int jobId, int& begin, int& end )
+{
+	ScopedLock lock( mLock );
+	if( jobId != mJobId || mNextIndex >= mCount )
+	{
+		return false;	// finished, or a stale wake-up from an old job
+	}
+
+	begin = mNextIndex;
+	end = Bounds::Min( mNextIndex + mGranularity, mCount );
+	mNextIndex = end;
+
+	return true;
+}
+
+void JobPool::_completeChunk()
+{
+	bool done = false;
+	{
+		ScopedLock lock( mLock );
+		done = (--mChunksRemaining == 0);
+	}
+
+	if( done )
+	{
+		mDoneEvent.Signal();
+	}
+}
+
+void JobPool::_runChunks( int jobId, int workerIndex )
+{
+	int begin = 0, end = 0;
+	while( _claimChunk( jobId, begin, end ) )
+	{
+		mFunction( begin, end, workerIndex, mUserData );
+		_completeChunk();
+	}
+}
+
+void JobPool::ParallelFor( int count, int granularity, JobFunction fn, void* userData )
+{
+	if( count <= 0 )
+	{
+		return;
+	}
+
+	granularity = Bounds::Max( granularity, 1 );
+	int chunkCount = (count + granularity - 1) / granularity;
+
+	// not worth waking anyone up
+	if( mThreadCount == 0 || chunkCount == 1 )
+	{
+		fn( 0, count, 0, userData );
+		return;
+	}
+
+	int jobId = 0;
+	{
+		ScopedLock lock( mLock );
+		mFunction = fn;
+		mUserData = userData;
+		mCount = count;
+		mGranularity = granularity;
+		mNextIndex = 0;
+		mChunksRemaining = chunkCount;
+		jobId = ++mJobId;
+	}
+
+	mWakeSemaphore.Signal( Bounds::Min( mThreadCount, chunkCount - 1 ) );
+
+	// the calling thread helps out, then waits for the stragglers
+	_runChunks( jobId, 0 );
+	while( true )
+	{
+		{
+			ScopedLock lock( mLock );
+			if( mChunksRemaining == 0 )
+			{
+				break;
+			}
+		}
+		mDoneEvent.Wait();
+	}
+}
\ No newline at end of file
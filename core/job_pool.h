@@ -0,0 +1,60 @@
+#ifndef JOB_POOL_INCLUDED
+#define JOB_POOL_INCLUDED
+
+#include "critical_section.h"
+
+class JobPoolWorker;
+
+// Simple fork/join pool for data-parallel loops
+// ParallelFor splits [0,count) into chunks that are processed by the worker threads
+// and the calling thread, and only returns once every chunk is done
+class JobPool
+{
+friend class JobPoolWorker;
+public:
+	// workerIndex is in [0, GetWorkerCount()), and can be used to index per-thread scratch data
+	typedef void (*JobFunction)( int begin, int end, int workerIndex, void* userData );
+
+	JobPool();
+	~JobPool();
+
+	// workerThreads = number of extra threads; 0 runs everything on the calling thread
+	bool Initialise( int workerThreads );
+	void Release();
+
+	// number of threads that may run jobs, including the caller
+	inline int GetWorkerCount() const
+	{
+		return mThreadCount + 1;
+	}
+
+	// granularity = number of items processed per chunk
+	void ParallelFor( int count, int granularity, JobFunction fn, void* userData );
+
+	// number of hardware threads available
+	static int GetHardwareThreads();
+
+private:
+	bool _claimChunk( int jobId, int& begin, int& end );
+	void _completeChunk();
+	void _runChunks( int jobId, int workerIndex );
+
+	CriticalSection mLock;
+	Semaphore mWakeSemaphore;
+	Event mDoneEvent;
+
+	// current job
+	JobFunction mFunction;
+	void* mUserData;
+	int mCount;
+	int mGranularity;
+	int mNextIndex;
+	int mChunksRemaining;
+	int mJobId;
+
+	JobPoolWorker* mThreads;
+	int mThreadCount;
+	volatile bool mQuit;
+};
+
+#endif
\ No newline at end of file
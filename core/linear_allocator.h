@@ -2,9 +2,10 @@
 #define LINEAR_ALLOCATOR_H_INCLUDED
 
 #include <stdlib.h>
+#include <string.h>
 
-// this needs some work. allocs too much on properly aligned ptrs
-#define ALIGN_UP(ptr,align) ((size_t)ptr + (align - ((size_t)ptr % align)))
+// align must be a power of two
+#define ALIGN_UP(ptr,align) (((size_t)(ptr) + ((align) - 1)) & ~((size_t)(align) - 1))
 
 class LinearAllocator
 {
@@ -48,15 +49,36 @@ public:
 		// align up the head ptr
 		size_t headPtr = ALIGN_UP(mHead, align);
 
-		if( headPtr + size < (size_t)mTail )
+		if( headPtr + size <= (size_t)mTail )
 		{
-			mHead = (void*)((size_t)mHead + size);
+			mHead = (void*)(headPtr + size);
 			return (void*)headPtr;
 		}
 
 		return NULL;
 	}
 
+	// throws away everything allocated so far, the buffer is kept
+	inline void Reset()
+	{
+		mHead = mBuffer;
+	}
+
+	inline void* GetBuffer() const
+	{
+		return mBuffer;
+	}
+
+	inline size_t GetUsedSize() const
+	{
+		return (size_t)mHead - (size_t)mBuffer;
+	}
+
+	inline size_t GetCapacity() const
+	{
+		return (size_t)mTail - (size_t)mBuffer;
+	}
+
 	inline void Release()
 	{
 		if( mBuffer )
@@ -67,6 +89,9 @@ public:
 	}
 
 private:
+	LinearAllocator( const LinearAllocator& );
+	LinearAllocator& operator=( const LinearAllocator& );
+
 	void* mBuffer;
 	void* mHead;
 	void* mTail;
@@ -0,0 +1,138 @@
+#include "mapped_file.h"
+#include <stdio.h>
+
+MappedFile::MappedFile()
+	: mFile(INVALID_HANDLE_VALUE)
+	, mMapping(NULL)
+	, mData(NULL)
+	, mSize(0)
+	, mFileSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open( const char* fileName, bool mapWholeFile )
+{
+	if( IsOpen() )
+	{
+		return false;
+	}
+
+	// writers may still have the file open (a lineage log being appended to), the view only sees
+	// what was written before it was mapped
+	mFile = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( mFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	// an empty file can't be mapped, and on 32 bit a whole file view has to fit in the address space
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( mFile, &fileSize ) || fileSize.QuadPart == 0
+		|| (mapWholeFile && (unsigned long long)fileSize.QuadPart > (size_t)-1) )
+	{
+		printf("Can't map file '%s'\n", fileName);
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingA( mFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mMapping != NULL && mapWholeFile )
+	{
+		mData = MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 );
+	}
+
+	if( mMapping == NULL || (mapWholeFile && mData == NULL) )
+	{
+		printf("Failed to map file '%s'\n", fileName);
+		Close();
+		return false;
+	}
+
+	mFileSize = (unsigned long long)fileSize.QuadPart;
+	mSize = mapWholeFile ? (size_t)mFileSize : 0;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if( mData )
+	{
+		UnmapViewOfFile( mData );
+		mData = NULL;
+	}
+
+	if( mMapping )
+	{
+		CloseHandle( mMapping );
+		mMapping = NULL;
+	}
+
+	if( mFile != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( mFile );
+		mFile = INVALID_HANDLE_VALUE;
+	}
+
+	mSize = 0;
+	mFileSize = 0;
+}
+
+MappedView::MappedView()
+	: mView(NULL)
+	, mData(NULL)
+	, mSize(0)
+{
+}
+
+MappedView::~MappedView()
+{
+	Unmap();
+}
+
+bool MappedView::Map( const MappedFile& file, unsigned long long offset, size_t size )
+{
+	Unmap();
+
+	if( !file.IsOpen() || size == 0 || offset > file.GetFileSize() || size > file.GetFileSize() - offset )
+	{
+		return false;
+	}
+
+	// views have to start on the allocation granularity, not just a page
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	const unsigned long long start = offset - (offset % info.dwAllocationGranularity);
+	const size_t lead = (size_t)(offset - start);
+	if( size > (size_t)-1 - lead )
+	{
+		return false;
+	}
+
+	mView = MapViewOfFile( file.mMapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)(start & 0xffffffff), lead + size );
+	if( mView == NULL )
+	{
+		printf("Failed to map %u bytes of a file\n", (unsigned int)size);
+		return false;
+	}
+
+	mData = (const unsigned char*)mView + lead;
+	mSize = size;
+	return true;
+}
+
+void MappedView::Unmap()
+{
+	if( mView )
+	{
+		UnmapViewOfFile( mView );
+		mView = NULL;
+	}
+
+	mData = NULL;
+	mSize = 0;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef MAPPED_FILE_INCLUDED
+#define MAPPED_FILE_INCLUDED
+
+#include <Windows.h>
+
+// Read only view of a whole file
+// The pages are faulted in as they are touched and come straight from the file cache,
+// so any number of processes mapping the same file share one copy
+// Files that may not fit in the address space are opened without a view and read through MappedView
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open( const char* fileName, bool mapWholeFile = true );
+	void Close();
+
+	inline bool IsOpen() const
+	{
+		return mMapping != NULL;
+	}
+
+	// NULL unless the whole file was mapped
+	inline const void* GetData() const
+	{
+		return mData;
+	}
+
+	inline size_t GetSize() const
+	{
+		return mSize;
+	}
+
+	inline unsigned long long GetFileSize() const
+	{
+		return mFileSize;
+	}
+
+private:
+	friend class MappedView;
+
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+
+	HANDLE mFile;
+	HANDLE mMapping;
+	const void* mData;
+	size_t mSize;
+	unsigned long long mFileSize;
+};
+
+// Part of a mapped file, only this much address space is used however big the file is
+// Mapping again replaces the previous view
+class MappedView
+{
+public:
+	MappedView();
+	~MappedView();
+
+	bool Map( const MappedFile& file, unsigned long long offset, size_t size );
+	void Unmap();
+
+	inline const void* GetData() const
+	{
+		return mData;
+	}
+
+	inline size_t GetSize() const
+	{
+		return mSize;
+	}
+
+private:
+	MappedView( const MappedView& );
+	MappedView& operator=( const MappedView& );
+
+	const void* mView;		// starts on an allocation boundary, at or before mData
+	const void* mData;
+	size_t mSize;
+};
+
+#endif
\ No newline at end of file
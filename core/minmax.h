@@ -1,8 +1,6 @@
 #ifndef MINMAX_H_INCLUDED
 #define MINMAX_H_INCLUDED
 
-#include <D3D10.h>
-
 namespace Bounds
 {
 
@@ -68,6 +68,12 @@ public:
 		return m_profileData.size();
 	}
 
+	// the profile isn't thread safe, so only the thread that last reset it records anything
+	inline bool IsProfilingThread() const
+	{
+		return GetCurrentThreadId() == m_threadId;
+	}
+
 private:
 	inline virtual int SetProfileData( const char* name, float timeStamp, int id );
 	virtual Timer& GetTimer(){
@@ -79,12 +85,14 @@ private:
 		m_timer.reset();
 		m_firstID = 1;
 		m_stackLevel = 0;
+		m_threadId = GetCurrentThreadId();
 	}
 
 	ProfileDataList m_profileData;
 	Timer m_timer;
 	int m_firstID;
 	int m_stackLevel;
+	DWORD m_threadId;
 	static ProfilerSingleton* s_it;
 };
 
@@ -128,23 +136,31 @@ inline void ProfilerSingleton::Reset()
 	m_profileData.clear();
 	m_firstID = 1;
 	m_stackLevel = 0;
+	m_threadId = GetCurrentThreadId();
 }
 
 class ScopedProfiler
 {
 public:
 	ScopedProfiler(const char* name)
-		: mName(name)
+		: mID(0)
+		, mName(name)
 	{
 		ProfilerSingleton* ps = ProfilerSingleton::it();
-		float timeStamp = ((IProfilerSet*)ps)->GetTimer().getSystemTime();
-		mID = ((IProfilerSet*)ps)->SetProfileData( name, timeStamp );
+		if( ps->IsProfilingThread() )
+		{
+			float timeStamp = ((IProfilerSet*)ps)->GetTimer().getSystemTime();
+			mID = ((IProfilerSet*)ps)->SetProfileData( name, timeStamp );
+		}
 	};
 	~ScopedProfiler()
 	{
-		ProfilerSingleton* ps = ProfilerSingleton::it();
-		float timeStamp = ((IProfilerSet*)ps)->GetTimer().getSystemTime();
-		((IProfilerSet*)ps)->SetProfileData( mName, timeStamp, mID );
+		if( mID != 0 )
+		{
+			ProfilerSingleton* ps = ProfilerSingleton::it();
+			float timeStamp = ((IProfilerSet*)ps)->GetTimer().getSystemTime();
+			((IProfilerSet*)ps)->SetProfileData( mName, timeStamp, mID );
+		}
 	}
 private:
 	int mID;
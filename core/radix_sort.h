@@ -0,0 +1,70 @@
+#ifndef RADIX_SORT_INCLUDED
+#define RADIX_SORT_INCLUDED
+
+#include <string.h>
+
+namespace RadixSort
+{
+	// Stable LSD radix sort of 32 bit keys, 8 bits per pass
+	// Writes the sorted order as indices into keys. scratch must hold count entries
+	// Passes where every key has the same byte are skipped, so small keys cost fewer passes
+	inline void SortIndices( const unsigned int* keys, int count, unsigned int* indicesOut, unsigned int* scratch )
+	{
+		unsigned int histograms[4][256];
+		memset( histograms, 0, sizeof(histograms) );
+
+		// all 4 histograms in one walk over the keys
+		for( int i = 0; i < count; ++i )
+		{
+			const unsigned int k = keys[i];
+			histograms[0][k & 0xff]++;
+			histograms[1][(k >> 8) & 0xff]++;
+			histograms[2][(k >> 16) & 0xff]++;
+			histograms[3][k >> 24]++;
+		}
+
+		for( int i = 0; i < count; ++i )
+		{
+			indicesOut[i] = i;
+		}
+
+		unsigned int* src = indicesOut;
+		unsigned int* dst = scratch;
+		for( int pass = 0; pass < 4; ++pass )
+		{
+			const int shift = pass * 8;
+			unsigned int* histogram = histograms[pass];
+			if( count == 0 || histogram[(keys[0] >> shift) & 0xff] == (unsigned int)count )
+			{
+				continue;	// nothing to do for this byte
+			}
+
+			// prefix sum to get the start of each bucket
+			unsigned int offset = 0;
+			for( int b = 0; b < 256; ++b )
+			{
+				const unsigned int c = histogram[b];
+				histogram[b] = offset;
+				offset += c;
+			}
+
+			for( int i = 0; i < count; ++i )
+			{
+				const unsigned int index = src[i];
+				dst[histogram[(keys[index] >> shift) & 0xff]++] = index;
+			}
+
+			unsigned int* tmp = src;
+			src = dst;
+			dst = tmp;
+		}
+
+		// an odd number of passes leaves the result in scratch
+		if( src != indicesOut )
+		{
+			memcpy( indicesOut, src, sizeof(unsigned int) * count );
+		}
+	}
+}
+
+#endif
\ No newline at end of file
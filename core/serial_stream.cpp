@@ -0,0 +1,214 @@
+#include "serial_stream.h"
+#include <string.h>
+
+FileSerialSink::FileSerialSink()
+	: mFile(NULL)
+	, mFailed(false)
+{
+}
+
+FileSerialSink::~FileSerialSink()
+{
+	Close();
+}
+
+bool FileSerialSink::Open( const char* fileName, size_t bufferSize )
+{
+	if( mFile != NULL )
+	{
+		return false;
+	}
+
+	mFile = fopen( fileName, "wb" );
+	if( mFile == NULL )
+	{
+		printf("Failed to open '%s' for writing\n", fileName);
+		return false;
+	}
+
+	// has to happen before anything is written
+	setvbuf( mFile, NULL, _IOFBF, bufferSize );
+	mFailed = false;
+	return true;
+}
+
+bool FileSerialSink::Close()
+{
+	if( mFile == NULL )
+	{
+		return false;
+	}
+
+	mFailed = fclose( mFile ) != 0 || mFailed;
+	mFile = NULL;
+	return !mFailed;
+}
+
+bool FileSerialSink::Write( const void* data, size_t size )
+{
+	if( mFile == NULL || mFailed )
+	{
+		return false;
+	}
+
+	mFailed = size > 0 && fwrite( data, size, 1, mFile ) != 1;
+	return !mFailed;
+}
+
+bool MemorySerialSink::Write( const void* data, size_t size )
+{
+	mData.insert( mData.end(), (const unsigned char*)data, (const unsigned char*)data + size );
+	return true;
+}
+
+MemorySerialSource::MemorySerialSource( const void* data, size_t size )
+	: mData((const unsigned char*)data)
+	, mSize(size)
+	, mPosition(0)
+{
+}
+
+const void* MemorySerialSource::Read( size_t size )
+{
+	if( size > mSize - mPosition )
+	{
+		return NULL;
+	}
+
+	const void* result = mData + mPosition;
+	mPosition += size;
+	return result;
+}
+
+MappedSerialSource::MappedSerialSource()
+	: mPosition(0)
+{
+}
+
+bool MappedSerialSource::Open( const char* fileName )
+{
+	mPosition = 0;
+	return mFile.Open( fileName );
+}
+
+void MappedSerialSource::Close()
+{
+	mFile.Close();
+	mPosition = 0;
+}
+
+const void* MappedSerialSource::Read( size_t size )
+{
+	if( !mFile.IsOpen() || size > mFile.GetSize() - mPosition )
+	{
+		return NULL;
+	}
+
+	const void* result = (const unsigned char*)mFile.GetData() + mPosition;
+	mPosition += size;
+	return result;
+}
+
+FileSerialSource::FileSerialSource()
+	: mFile(NULL)
+{
+}
+
+FileSerialSource::~FileSerialSource()
+{
+	Close();
+}
+
+bool FileSerialSource::Open( const char* fileName, size_t bufferSize )
+{
+	if( mFile != NULL )
+	{
+		return false;
+	}
+
+	mFile = fopen( fileName, "rb" );
+	if( mFile == NULL )
+	{
+		printf("Failed to open '%s' for reading\n", fileName);
+		return false;
+	}
+
+	setvbuf( mFile, NULL, _IOFBF, bufferSize );
+	return true;
+}
+
+void FileSerialSource::Close()
+{
+	if( mFile )
+	{
+		fclose( mFile );
+		mFile = NULL;
+	}
+}
+
+const void* FileSerialSource::Read( size_t size )
+{
+	if( mFile == NULL )
+	{
+		return NULL;
+	}
+
+	// the buffer only grows, so reading chunk after chunk doesn't allocate
+	if( mBuffer.size() < size || mBuffer.empty() )
+	{
+		mBuffer.resize( size > 0 ? size : 1 );
+	}
+
+	if( size > 0 && fread( &mBuffer[0], size, 1, mFile ) != 1 )
+	{
+		return NULL;
+	}
+
+	return &mBuffer[0];
+}
+
+bool SerialArrayStream::WriteHeader( SerialSink& sink, const SerialRecordPlan& plan )
+{
+	const std::vector<SerialField>& fields = plan.GetRecordFields();
+
+	Header header;
+	memcpy( header.mMagic, "SARR", 4 );
+	header.mVersion = kVersion;
+	header.mFieldCount = (unsigned int)fields.size();
+	header.mRecordSize = plan.GetRecordSize();
+
+	return sink.Write( &header, sizeof(header) )
+		&& (fields.empty() || sink.Write( &fields[0], fields.size() * sizeof(SerialField) ));
+}
+
+bool SerialArrayStream::ReadHeader( SerialSource& source, const std::vector<SerialField>& layout, size_t objectSize, SerialRecordPlan& plan )
+{
+	const Header* h = (const Header*)source.Read( sizeof(Header) );
+	if( h == NULL || memcmp( h->mMagic, "SARR", 4 ) != 0 || h->mVersion != kVersion
+		|| h->mRecordSize == 0 || h->mFieldCount > h->mRecordSize )
+	{
+		printf("Not a serialised array stream\n");
+		return false;
+	}
+
+	// copied out, the next read can reuse the source's buffer
+	const Header header = *h;
+	const SerialField* fields = (const SerialField*)source.Read( header.mFieldCount * sizeof(SerialField) );
+	if( fields == NULL )
+	{
+		printf("Serialised array stream is truncated\n");
+		return false;
+	}
+
+	return plan.BuildForRead( layout, objectSize, fields, header.mFieldCount, header.mRecordSize );
+}
+
+bool SerialArrayStream::WriteChunk( SerialSink& sink, const void* records, unsigned int recordCount, unsigned int recordSize )
+{
+	ChunkHeader chunk;
+	chunk.mRecordCount = recordCount;
+	chunk.mReserved = 0;
+
+	return sink.Write( &chunk, sizeof(chunk) )
+		&& (recordCount == 0 || sink.Write( records, (size_t)recordCount * recordSize ));
+}
\ No newline at end of file
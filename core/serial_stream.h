@@ -0,0 +1,348 @@
+#ifndef SERIAL_STREAM_INCLUDED
+#define SERIAL_STREAM_INCLUDED
+
+#include "serialiser.h"
+#include "mapped_file.h"
+#include <stdio.h>
+#include <vector>
+
+// Where serialised bytes go
+class SerialSink
+{
+public:
+	virtual ~SerialSink() {}
+	virtual bool Write( const void* data, size_t size ) = 0;
+};
+
+// Where serialised bytes come from
+// Read returns the next size bytes, valid until the next call, or NULL if there aren't that many
+class SerialSource
+{
+public:
+	virtual ~SerialSource() {}
+	virtual const void* Read( size_t size ) = 0;
+};
+
+// writes through a large buffer, so many small writes cost one system call per buffer
+class FileSerialSink : public SerialSink
+{
+public:
+	FileSerialSink();
+	virtual ~FileSerialSink();
+
+	bool Open( const char* fileName, size_t bufferSize = 256 * 1024 );
+	bool Close();	// false if anything failed to write
+
+	virtual bool Write( const void* data, size_t size );
+
+private:
+	FileSerialSink( const FileSerialSink& );
+	FileSerialSink& operator=( const FileSerialSink& );
+
+	FILE* mFile;
+	bool mFailed;
+};
+
+class MemorySerialSink : public SerialSink
+{
+public:
+	virtual bool Write( const void* data, size_t size );
+
+	inline const std::vector<unsigned char>& GetData() const
+	{
+		return mData;
+	}
+
+	inline void Clear()
+	{
+		mData.clear();
+	}
+
+private:
+	std::vector<unsigned char> mData;
+};
+
+// reads straight out of memory, nothing is copied
+class MemorySerialSource : public SerialSource
+{
+public:
+	MemorySerialSource( const void* data, size_t size );
+
+	virtual const void* Read( size_t size );
+
+private:
+	const unsigned char* mData;
+	size_t mSize;
+	size_t mPosition;
+};
+
+// reads straight out of a mapped file, nothing is copied
+class MappedSerialSource : public SerialSource
+{
+public:
+	MappedSerialSource();
+
+	bool Open( const char* fileName );
+	void Close();
+
+	virtual const void* Read( size_t size );
+
+private:
+	MappedFile mFile;
+	size_t mPosition;
+};
+
+// for files that are only read once, front to back
+class FileSerialSource : public SerialSource
+{
+public:
+	FileSerialSource();
+	virtual ~FileSerialSource();
+
+	bool Open( const char* fileName, size_t bufferSize = 256 * 1024 );
+	void Close();
+
+	virtual const void* Read( size_t size );
+
+private:
+	FileSerialSource( const FileSerialSource& );
+	FileSerialSource& operator=( const FileSerialSource& );
+
+	FILE* mFile;
+	std::vector<unsigned char> mBuffer;
+};
+
+// Streamed arrays of DEFINE_SERIALISED_CLASS objects
+// A header and the field table, then chunks of packed records, then an empty chunk.
+// The field table is worked out once per stream, so there are no per-record lookups and
+// memory use is one chunk however many records go through
+struct SerialArrayStream
+{
+	struct Header
+	{
+		char mMagic[4];			// SARR
+		unsigned int mVersion;
+		unsigned int mFieldCount;
+		unsigned int mRecordSize;
+	};
+
+	// followed by mRecordCount records, a count of zero ends the stream
+	struct ChunkHeader
+	{
+		unsigned int mRecordCount;
+		unsigned int mReserved;
+	};
+
+	static const unsigned int kVersion = 1;
+
+	static bool WriteHeader( SerialSink& sink, const SerialRecordPlan& plan );
+	static bool ReadHeader( SerialSource& source, const std::vector<SerialField>& layout, size_t objectSize, SerialRecordPlan& plan );
+	static bool WriteChunk( SerialSink& sink, const void* records, unsigned int recordCount, unsigned int recordSize );
+};
+
+template<typename T>
+class SerialArrayWriter
+{
+public:
+	SerialArrayWriter()
+		: mSink(NULL)
+		, mChunkRecords(0)
+		, mBuffered(0)
+		, mFailed(false)
+	{
+	}
+
+	~SerialArrayWriter()
+	{
+		Close();
+	}
+
+	bool Open( SerialSink& sink, unsigned int chunkRecords = 4096 )
+	{
+		const SerialFieldTable& table = SerialFieldTable::Get<T>();
+		if( mSink != NULL || chunkRecords == 0 || !table.IsValid() || !mPlan.BuildForWrite( table.GetFields(), sizeof(T) ) )
+		{
+			return false;
+		}
+
+		if( !SerialArrayStream::WriteHeader( sink, mPlan ) )
+		{
+			return false;
+		}
+
+		mSink = &sink;
+		mChunkRecords = chunkRecords;
+		mBuffered = 0;
+		mFailed = false;
+		mChunk.resize( (size_t)chunkRecords * mPlan.GetRecordSize() );
+		return true;
+	}
+
+	bool Add( const T* objects, size_t count )
+	{
+		if( mSink == NULL )
+		{
+			return false;
+		}
+
+		while( count > 0 && !mFailed )
+		{
+			// whole chunks of objects that are their own records skip the copy
+			if( mBuffered == 0 && count >= mChunkRecords && mPlan.IsBlockCopy() )
+			{
+				mFailed = !SerialArrayStream::WriteChunk( *mSink, objects, mChunkRecords, mPlan.GetRecordSize() );
+				objects += mChunkRecords;
+				count -= mChunkRecords;
+				continue;
+			}
+
+			const size_t space = mChunkRecords - mBuffered;
+			const size_t n = count < space ? count : space;
+			mPlan.Pack( objects, n, &mChunk[(size_t)mBuffered * mPlan.GetRecordSize()] );
+			mBuffered += (unsigned int)n;
+			objects += n;
+			count -= n;
+
+			if( mBuffered == mChunkRecords )
+			{
+				_flush();
+			}
+		}
+
+		return !mFailed;
+	}
+
+	// false if anything failed to write
+	bool Close()
+	{
+		if( mSink == NULL )
+		{
+			return false;
+		}
+
+		_flush();
+		mFailed = mFailed || !SerialArrayStream::WriteChunk( *mSink, NULL, 0, 0 );
+		mSink = NULL;
+		return !mFailed;
+	}
+
+private:
+	SerialArrayWriter( const SerialArrayWriter& );
+	SerialArrayWriter& operator=( const SerialArrayWriter& );
+
+	void _flush()
+	{
+		if( mBuffered > 0 && !mFailed )
+		{
+			mFailed = !SerialArrayStream::WriteChunk( *mSink, &mChunk[0], mBuffered, mPlan.GetRecordSize() );
+		}
+		mBuffered = 0;
+	}
+
+	SerialSink* mSink;
+	SerialRecordPlan mPlan;
+	std::vector<unsigned char> mChunk;
+	unsigned int mChunkRecords;
+	unsigned int mBuffered;
+	bool mFailed;
+};
+
+template<typename T>
+class SerialArrayReader
+{
+public:
+	SerialArrayReader()
+		: mSource(NULL)
+		, mRecords(NULL)
+		, mRemaining(0)
+		, mFinished(false)
+	{
+	}
+
+	bool Open( SerialSource& source )
+	{
+		const SerialFieldTable& table = SerialFieldTable::Get<T>();
+		if( !table.IsValid() || !SerialArrayStream::ReadHeader( source, table.GetFields(), sizeof(T), mPlan ) )
+		{
+			return false;
+		}
+
+		mSource = &source;
+		mRecords = NULL;
+		mRemaining = 0;
+		mFinished = false;
+		return true;
+	}
+
+	// reads up to maxCount objects, 0 once the stream has ended
+	size_t Read( T* objects, size_t maxCount )
+	{
+		size_t count = 0;
+		while( count < maxCount && _nextChunk() )
+		{
+			const size_t n = (maxCount - count) < mRemaining ? (maxCount - count) : mRemaining;
+			mPlan.Unpack( mRecords, n, objects + count );
+			mRecords += n * mPlan.GetRecordSize();
+			mRemaining -= (unsigned int)n;
+			count += n;
+		}
+
+		return count;
+	}
+
+	// true once the end of the stream has been read, false if it was cut short
+	inline bool IsFinished() const
+	{
+		return mFinished;
+	}
+
+private:
+	SerialArrayReader( const SerialArrayReader& );
+	SerialArrayReader& operator=( const SerialArrayReader& );
+
+	bool _nextChunk()
+	{
+		if( mRemaining > 0 )
+		{
+			return true;
+		}
+		if( mSource == NULL || mFinished )
+		{
+			return false;
+		}
+
+		const SerialArrayStream::ChunkHeader* chunk = (const SerialArrayStream::ChunkHeader*)mSource->Read( sizeof(SerialArrayStream::ChunkHeader) );
+		if( chunk == NULL )
+		{
+			printf("Serialised array stream is truncated\n");
+			mSource = NULL;
+			return false;
+		}
+
+		const unsigned int recordCount = chunk->mRecordCount;
+		if( recordCount == 0 )
+		{
+			mFinished = true;
+			return false;
+		}
+
+		mRecords = (const unsigned char*)mSource->Read( (size_t)recordCount * mPlan.GetRecordSize() );
+		if( mRecords == NULL )
+		{
+			printf("Serialised array stream is truncated\n");
+			mSource = NULL;
+			return false;
+		}
+
+		mRemaining = recordCount;
+		return true;
+	}
+
+	SerialSource* mSource;
+	SerialRecordPlan mPlan;
+	const unsigned char* mRecords;
+	unsigned int mRemaining;
+	bool mFinished;
+};
+
+#endif
\ No newline at end of file
@@ -3,18 +3,20 @@
 
 #include "serialiser.h"
 
-enum SerialMode
-{
-	MODE_WRITE,
-	MODE_READ
-};
-
 #define DECLARE_SERIALISED(className) \
 	inline void className::Serialise( Serialiser& s, SerialMode mode );
 
+// fields are read and written from the class's SerialFieldTable when it has one,
+// the code for each DECLARE_ is only run to build the table, or if it can't be built
 #define SERIALISE_BEGIN(className) \
 	inline void className::Serialise( Serialiser& s, SerialMode mode ) \
 	{ \
+		const SerialFieldTable& fieldTable = SerialFieldTable::Get<className>(); \
+		if( mode != MODE_DESCRIBE && fieldTable.IsValid() ) \
+		{ \
+			s.SerialiseFields( fieldTable, this, mode ); \
+			return; \
+		} \
 
 #define SERIALISE_END(className) \
 	}
@@ -29,11 +31,13 @@ enum SerialMode
 	{ \
 		s.AddNode( #variable, variable );	\
 	} \
-	else \
+	else if( mode == MODE_READ ) \
+	{	\
+		s.GetValue( #variable, variable );	\
+	}	\
+	else	\
 	{	\
-		Serialiser::SerialNode* n = s.GetNode( #variable );	\
-		if( n ) \
-			n->GetValue( variable );	\
+		s.DescribeField( #variable, variable, (const char*)&variable - (const char*)this );	\
 	}
 
 #define DECLARE_STRING( variable ) \
@@ -41,14 +45,13 @@ enum SerialMode
 	{ \
 		s.AddNode( #variable, (const char*)variable );	\
 	}	\
+	else if( mode == MODE_READ )	\
+	{	\
+		s.GetValue( #variable, (char*)variable );	\
+	}	\
 	else	\
 	{	\
-		Serialiser::SerialNode* n = s.GetNode( #variable );	\
-		if( n ) \
-		{	\
-			char* v = (char*)variable;	\
-			n->GetValue(v);	\
-		}	\
+		s.DescribeString( #variable, variable, (const char*)&variable - (const char*)this );	\
 	}
 
 #endif
\ No newline at end of file
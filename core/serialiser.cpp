@@ -0,0 +1,508 @@
+#include "serialiser.h"
+#include "serial_stream.h"
+#include "linear_allocator.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+	bool NodeLess( const Serialiser::SerialNode& a, const Serialiser::SerialNode& b )
+	{
+		return a.mKey < b.mKey;
+	}
+
+	// the images are limited to 32 bit offsets
+	const unsigned long long kMaxImageSize = 0xffffffff;
+}
+
+Serialiser::Serialiser( size_t reserveSize )
+	: mLayoutValid(false)
+{
+	mBuffer.reserve( reserveSize );
+	Reset();
+}
+
+Serialiser::~Serialiser()
+{
+}
+
+void Serialiser::Reset()
+{
+	mBuffer.resize( sizeof(ImageHeader) );
+	mDataEnd = sizeof(ImageHeader);
+	mNodes.clear();
+	mSorted = true;
+	mExternal = false;
+
+	mImage = NULL;
+	mImageSize = 0;
+	mTable = NULL;
+	mTableCount = 0;
+}
+
+void* Serialiser::_allocate( size_t size, size_t align )
+{
+	// an opened image is read only, writing starts a new one
+	if( mExternal )
+	{
+		Reset();
+	}
+
+	const size_t offset = ALIGN_UP( mDataEnd, align );
+	if( (unsigned long long)offset + size > kMaxImageSize )
+	{
+		printf("Serialiser image is too large\n");
+		return NULL;
+	}
+
+	// this also drops the node table a previous GetImage put after the data
+	mBuffer.resize( offset + size );
+	mDataEnd = offset + size;
+	mSorted = false;
+
+	return &mBuffer[offset];
+}
+
+void Serialiser::_addNode( const char* key, SerialisedType type, const void* value, size_t size )
+{
+	_addNode( (unsigned int)StringHashing::getHash( key ), type, value, size );
+}
+
+void Serialiser::_addNode( unsigned int key, unsigned int type, const void* value, size_t size )
+{
+	void* data = _allocate( size, 4 );
+	if( data == NULL )
+	{
+		return;
+	}
+
+	memcpy( data, value, size );
+
+	SerialNode n;
+	n.mKey = key;
+	n.mType = type;
+	n.mOffset = (unsigned int)((unsigned char*)data - &mBuffer[0]);
+	n.mSize = (unsigned int)size;
+	mNodes.push_back( n );
+}
+
+void Serialiser::_sortNodes() const
+{
+	if( mExternal )
+	{
+		return;
+	}
+
+	// stable, so a key added twice still finds the first one
+	if( !mSorted )
+	{
+		std::stable_sort( mNodes.begin(), mNodes.end(), NodeLess );
+		mSorted = true;
+	}
+
+	mImage = &mBuffer[0];
+	mImageSize = mDataEnd;
+	mTable = mNodes.empty() ? NULL : &mNodes[0];
+	mTableCount = mNodes.size();
+}
+
+const void* Serialiser::GetImage( size_t& size )
+{
+	_sortNodes();
+	if( mExternal )
+	{
+		size = mImageSize;
+		return mImage;
+	}
+
+	const size_t tableOffset = ALIGN_UP( mDataEnd, 4 );
+	const size_t tableSize = mNodes.size() * sizeof(SerialNode);
+	mBuffer.resize( tableOffset + tableSize );
+	if( tableSize > 0 )
+	{
+		memcpy( &mBuffer[tableOffset], &mNodes[0], tableSize );
+	}
+
+	ImageHeader* header = (ImageHeader*)&mBuffer[0];
+	memcpy( header->mMagic, "SRLZ", 4 );
+	header->mVersion = kVersion;
+	header->mNodeCount = (unsigned int)mNodes.size();
+	header->mTableOffset = (unsigned int)tableOffset;
+
+	// the buffer may have moved
+	_sortNodes();
+
+	size = mBuffer.size();
+	return &mBuffer[0];
+}
+
+bool Serialiser::Open( const void* image, size_t size )
+{
+	Reset();
+
+	const ImageHeader* header = (const ImageHeader*)image;
+	bool valid = image != NULL && size >= sizeof(ImageHeader) && memcmp( header->mMagic, "SRLZ", 4 ) == 0 && header->mVersion == kVersion;
+	valid = valid && (unsigned long long)header->mTableOffset + (unsigned long long)header->mNodeCount * sizeof(SerialNode) <= size;
+
+	const SerialNode* table = valid ? (const SerialNode*)((const unsigned char*)image + header->mTableOffset) : NULL;
+	for( unsigned int i = 0; valid && i < header->mNodeCount; ++i )
+	{
+		valid = (unsigned long long)table[i].mOffset + table[i].mSize <= header->mTableOffset;
+	}
+
+	if( !valid )
+	{
+		printf("Not a serialised image\n");
+		return false;
+	}
+
+	mExternal = true;
+	mImage = (const unsigned char*)image;
+	mImageSize = size;
+	mTable = table;
+	mTableCount = header->mNodeCount;
+	return true;
+}
+
+const Serialiser::SerialNode* Serialiser::_findNode( const char* key ) const
+{
+	return _findNode( (unsigned int)StringHashing::getHash( key ) );
+}
+
+const Serialiser::SerialNode* Serialiser::_findNode( unsigned int key ) const
+{
+	_sortNodes();
+
+	SerialNode search;
+	search.mKey = key;
+	const SerialNode* end = mTable + mTableCount;
+	const SerialNode* n = std::lower_bound( mTable, end, search, NodeLess );
+	if( n != end && n->mKey == search.mKey )
+	{
+		return n;
+	}
+
+	return NULL;
+}
+
+bool Serialiser::_getValue( const char* key, SerialisedType type, void* result, size_t size ) const
+{
+	const SerialNode* n = _findNode( key );
+	if( n && n->mType == (unsigned int)type && n->mSize == size )
+	{
+		memcpy( result, mImage + n->mOffset, size );
+		return true;
+	}
+
+	return false;
+}
+
+bool Serialiser::GetValue( const char* key, char* result ) const
+{
+	const SerialNode* n = _findNode( key );
+	if( n && n->mType == TYPE_STRING && n->mSize > 0 )
+	{
+		memcpy( result, mImage + n->mOffset, n->mSize );
+		result[n->mSize - 1] = '\0';
+		return true;
+	}
+
+	return false;
+}
+
+size_t Serialiser::GetArrayCount( const char* key ) const
+{
+	const SerialNode* n = _findNode( key );
+	if( n == NULL || n->mType != TYPE_ARRAY || n->mSize < sizeof(ArrayHeader) )
+	{
+		return 0;
+	}
+
+	ArrayHeader header;
+	memcpy( &header, mImage + n->mOffset, sizeof(header) );
+	return header.mRecordCount;
+}
+
+void Serialiser::SerialiseFields( const SerialFieldTable& table, void* object, SerialMode mode )
+{
+	const std::vector<SerialField>& fields = table.GetFields();
+	unsigned char* base = (unsigned char*)object;
+
+	if( mode == MODE_WRITE )
+	{
+		for( size_t i = 0; i < fields.size(); ++i )
+		{
+			const SerialField& f = fields[i];
+			size_t size = f.mSize;
+			if( f.mType == TYPE_STRING )
+			{
+				// up to and including the terminator
+				const unsigned char* end = (const unsigned char*)memchr( base + f.mOffset, '\0', f.mSize );
+				size = end ? (end - (base + f.mOffset)) + 1 : f.mSize;
+			}
+			_addNode( f.mKey, f.mType, base + f.mOffset, size );
+		}
+		return;
+	}
+
+	for( size_t i = 0; i < fields.size(); ++i )
+	{
+		const SerialField& f = fields[i];
+		const SerialNode* n = f.mType != TYPE_UNKNOWN ? _findNode( f.mKey ) : NULL;
+		if( n == NULL || n->mType != f.mType )
+		{
+			continue;
+		}
+
+		if( f.mType == TYPE_STRING )
+		{
+			// the field's size is known here, so a stored string that is too long is skipped
+			if( n->mSize > 0 && n->mSize <= f.mSize )
+			{
+				memcpy( base + f.mOffset, mImage + n->mOffset, n->mSize );
+				base[f.mOffset + n->mSize - 1] = '\0';
+			}
+		}
+		else if( n->mSize == f.mSize )
+		{
+			memcpy( base + f.mOffset, mImage + n->mOffset, f.mSize );
+		}
+	}
+}
+
+void Serialiser::_describeField( const char* key, SerialisedType type, ptrdiff_t offset, size_t size )
+{
+	if( offset < 0 )
+	{
+		mLayoutValid = false;
+		return;
+	}
+
+	SerialField f;
+	f.mKey = StringHashing::getHash( key );
+	f.mType = type;
+	f.mOffset = (unsigned int)offset;
+	f.mSize = (unsigned int)size;
+	mLayout.push_back( f );
+}
+
+unsigned char* Serialiser::_beginArray( const char* key, size_t count, const SerialRecordPlan& plan )
+{
+	const std::vector<SerialField>& fields = plan.GetRecordFields();
+	const size_t fieldsSize = fields.size() * sizeof(SerialField);
+	const size_t recordOffset = ALIGN_UP( sizeof(ArrayHeader) + fieldsSize, 16 );
+	if( (unsigned long long)plan.GetRecordSize() * count + recordOffset > kMaxImageSize )
+	{
+		printf("Serialised array '%s' is too large\n", key);
+		return NULL;
+	}
+
+	const size_t size = recordOffset + (size_t)plan.GetRecordSize() * count;
+	unsigned char* data = (unsigned char*)_allocate( size, 16 );
+	if( data == NULL )
+	{
+		return NULL;
+	}
+
+	ArrayHeader header;
+	header.mFieldCount = (unsigned int)fields.size();
+	header.mRecordSize = plan.GetRecordSize();
+	header.mRecordCount = (unsigned int)count;
+	header.mRecordOffset = (unsigned int)recordOffset;
+	memcpy( data, &header, sizeof(header) );
+	memcpy( data + sizeof(header), &fields[0], fieldsSize );
+
+	SerialNode n;
+	n.mKey = StringHashing::getHash( key );
+	n.mType = TYPE_ARRAY;
+	n.mOffset = (unsigned int)(data - &mBuffer[0]);
+	n.mSize = (unsigned int)size;
+	mNodes.push_back( n );
+
+	return data + recordOffset;
+}
+
+const unsigned char* Serialiser::_beginRead( const char* key, const std::vector<SerialField>& layout, size_t objectSize, SerialRecordPlan& plan, size_t& count ) const
+{
+	const SerialNode* n = _findNode( key );
+	if( n == NULL || n->mType != TYPE_ARRAY || n->mSize < sizeof(ArrayHeader) )
+	{
+		return NULL;
+	}
+
+	const unsigned char* data = mImage + n->mOffset;
+	ArrayHeader header;
+	memcpy( &header, data, sizeof(header) );
+	if( (unsigned long long)header.mRecordOffset + (unsigned long long)header.mRecordSize * header.mRecordCount > n->mSize
+		|| sizeof(header) + header.mFieldCount * sizeof(SerialField) > header.mRecordOffset )
+	{
+		return NULL;
+	}
+
+	const SerialField* stored = (const SerialField*)(data + sizeof(header));
+	if( !plan.BuildForRead( layout, objectSize, stored, header.mFieldCount, header.mRecordSize ) )
+	{
+		return NULL;
+	}
+
+	count = header.mRecordCount;
+	return data + header.mRecordOffset;
+}
+
+bool Serialiser::Write( SerialSink& sink )
+{
+	size_t size = 0;
+	const void* image = GetImage( size );
+	return sink.Write( image, size );
+}
+
+bool Serialiser::Read( SerialSource& source )
+{
+	// the header says how much follows
+	const ImageHeader* header = (const ImageHeader*)source.Read( sizeof(ImageHeader) );
+	if( header == NULL || memcmp( header->mMagic, "SRLZ", 4 ) != 0 || header->mTableOffset < sizeof(ImageHeader) )
+	{
+		printf("Not a serialised image\n");
+		return false;
+	}
+
+	const unsigned long long imageSize = header->mTableOffset + (unsigned long long)header->mNodeCount * sizeof(SerialNode);
+	if( imageSize > kMaxImageSize )
+	{
+		printf("Serialised image is too large\n");
+		return false;
+	}
+
+	const size_t size = (size_t)imageSize;
+	std::vector<unsigned char> image( size );
+	memcpy( &image[0], header, sizeof(ImageHeader) );
+
+	const void* rest = source.Read( size - sizeof(ImageHeader) );
+	if( rest == NULL )
+	{
+		printf("Serialised image is truncated\n");
+		return false;
+	}
+	memcpy( &image[sizeof(ImageHeader)], rest, size - sizeof(ImageHeader) );
+
+	if( !Open( &image[0], size ) )
+	{
+		return false;
+	}
+
+	// keep the copy, Open only looked at it
+	mBuffer.swap( image );
+	mImage = &mBuffer[0];
+	mTable = (const SerialNode*)(mImage + ((const ImageHeader*)mImage)->mTableOffset);
+	return true;
+}
+
+bool SerialRecordPlan::BuildForWrite( const std::vector<SerialField>& layout, size_t objectSize )
+{
+	mRecordFields = layout;
+	mCopies.resize( layout.size() );
+	mObjectSize = objectSize;
+	mRecordSize = 0;
+	for( size_t f = 0; f < layout.size(); ++f )
+	{
+		mCopies[f].mObjectOffset = layout[f].mOffset;
+		mCopies[f].mRecordOffset = mRecordSize;
+		mCopies[f].mSize = layout[f].mSize;
+		mRecordFields[f].mOffset = mRecordSize;
+		mRecordSize += layout[f].mSize;
+	}
+
+	mBlockCopy = _checkBlockCopy();
+	return mRecordSize > 0;
+}
+
+bool SerialRecordPlan::BuildForRead( const std::vector<SerialField>& layout, size_t objectSize, const SerialField* stored, unsigned int storedCount, unsigned int storedRecordSize )
+{
+	mRecordFields.assign( stored, stored + storedCount );
+	mCopies.clear();
+	mObjectSize = objectSize;
+	mRecordSize = storedRecordSize;
+
+	for( size_t f = 0; f < layout.size(); ++f )
+	{
+		for( unsigned int s = 0; s < storedCount; ++s )
+		{
+			if( stored[s].mKey == layout[f].mKey && stored[s].mType == layout[f].mType && stored[s].mSize == layout[f].mSize
+				&& (unsigned long long)stored[s].mOffset + stored[s].mSize <= storedRecordSize )
+			{
+				FieldCopy c;
+				c.mObjectOffset = layout[f].mOffset;
+				c.mRecordOffset = stored[s].mOffset;
+				c.mSize = layout[f].mSize;
+				mCopies.push_back( c );
+				break;
+			}
+		}
+	}
+
+	mBlockCopy = _checkBlockCopy();
+	return mRecordSize > 0;
+}
+
+bool SerialRecordPlan::_checkBlockCopy() const
+{
+	// the records are the objects if the fields cover every byte, in place
+	if( mRecordSize != mObjectSize )
+	{
+		return false;
+	}
+
+	size_t covered = 0;
+	for( size_t f = 0; f < mCopies.size(); ++f )
+	{
+		if( mCopies[f].mObjectOffset != covered || mCopies[f].mRecordOffset != covered )
+		{
+			return false;
+		}
+		covered += mCopies[f].mSize;
+	}
+
+	return covered == mObjectSize;
+}
+
+void SerialRecordPlan::Pack( const void* objects, size_t count, void* records ) const
+{
+	if( mBlockCopy )
+	{
+		memcpy( records, objects, count * mObjectSize );
+		return;
+	}
+
+	const unsigned char* object = (const unsigned char*)objects;
+	unsigned char* record = (unsigned char*)records;
+	for( size_t i = 0; i < count; ++i )
+	{
+		for( size_t f = 0; f < mCopies.size(); ++f )
+		{
+			memcpy( record + mCopies[f].mRecordOffset, object + mCopies[f].mObjectOffset, mCopies[f].mSize );
+		}
+		object += mObjectSize;
+		record += mRecordSize;
+	}
+}
+
+void SerialRecordPlan::Unpack( const void* records, size_t count, void* objects ) const
+{
+	if( mBlockCopy )
+	{
+		memcpy( objects, records, count * mObjectSize );
+		return;
+	}
+
+	const unsigned char* record = (const unsigned char*)records;
+	unsigned char* object = (unsigned char*)objects;
+	for( size_t i = 0; i < count; ++i )
+	{
+		for( size_t f = 0; f < mCopies.size(); ++f )
+		{
+			memcpy( object + mCopies[f].mObjectOffset, record + mCopies[f].mRecordOffset, mCopies[f].mSize );
+		}
+		record += mRecordSize;
+		object += mObjectSize;
+	}
+}
\ No newline at end of file
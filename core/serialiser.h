@@ -2,204 +2,341 @@
 #define SERIALISER_H_INCLUDED
 
 #include "string_hashing.h"
-#include "linear_allocator.h"
-#include <list>
+#include <vector>
+#include <string.h>
+#include <stddef.h>
 
-class Serialiser
+class SerialSink;
+class SerialSource;
+class SerialFieldTable;
+
+enum SerialMode
+{
+	MODE_WRITE,
+	MODE_READ,
+	MODE_DESCRIBE	// records the layout of the serialised fields, see Serialiser::DescribeField
+};
+
+// one serialised field of a class, or of the records of a stored array
+struct SerialField
+{
+	unsigned int mKey;		// hash of the field name
+	unsigned int mType;
+	unsigned int mOffset;	// in the object / record
+	unsigned int mSize;
+};
+
+// How the serialised fields of a class map onto packed records
+// Built once per array or stream, after that records are copied with no lookups at all, and
+// when the fields cover the whole object in order the records are the objects
+class SerialRecordPlan
 {
 public:
-	Serialiser(size_t maxSize = 8 * 1024)
+	SerialRecordPlan()
+		: mRecordSize(0)
+		, mObjectSize(0)
+		, mBlockCopy(false)
 	{
-		mAllocator.Initialise( maxSize );
 	}
-	~Serialiser()
+
+	// records hold the fields packed in the order they are declared
+	bool BuildForWrite( const std::vector<SerialField>& layout, size_t objectSize );
+
+	// records as they were stored. Fields are matched by name, type and size,
+	// anything the stored records don't have is left alone
+	bool BuildForRead( const std::vector<SerialField>& layout, size_t objectSize, const SerialField* stored, unsigned int storedCount, unsigned int storedRecordSize );
+
+	void Pack( const void* objects, size_t count, void* records ) const;
+	void Unpack( const void* records, size_t count, void* objects ) const;
+
+	inline unsigned int GetRecordSize() const
 	{
-		mAllocator.Release();
+		return mRecordSize;
 	}
 
-	class SerialNode
+	inline const std::vector<SerialField>& GetRecordFields() const
 	{
-	friend class Serialiser;
-	public:
-		template< typename T >
-		bool GetValue( T& result )
-		{
-			return false;
-		}
-	private:
-		void* mPtr;
-		size_t mSize;
-		int mType;
-	};
+		return mRecordFields;
+	}
 
-	template<typename T>
-	inline void AddNode( const char* key, const T& value )
-	{
-		// add an unknown node
-		SerialNode* nodePtr = (SerialNode*)mAllocator.Allocate( sizeof(SerialNode) );
-		if( nodePtr )
-		{
-			void* dataPtr = mAllocator.Allocate( sizeof(value) );
-			if( dataPtr != NULL )
-			{
-				memcpy( dataPtr, &value, sizeof(value ) );
-				nodePtr->mPtr = dataPtr;
-				nodePtr->mSize = sizeof(value);
-				nodePtr->mType = _nodeType( value );
-
-				StringHashing::StringHash keyHash = StringHashing::getHash( key );
-				mNodes.push_back( SerialiserListNode( keyHash, nodePtr ) );
-			}
-		}
-	}
-
-	// specialised for strings
-	template<>
-	inline void AddNode( const char* key, const char* const &value )
-	{
-		// add an unknown node
-		SerialNode* nodePtr = (SerialNode*)mAllocator.Allocate( sizeof(SerialNode) );
-		if( nodePtr )
-		{
-			size_t stringSize = (strlen(value) + 1) * sizeof(char);
-			char* dataPtr = (char*)mAllocator.Allocate( stringSize );
-			if( dataPtr != NULL )
-			{
-				memset( dataPtr, '\0', stringSize );
-				memcpy( dataPtr, value, stringSize );
-				nodePtr->mPtr = (void*)dataPtr;
-				nodePtr->mSize = stringSize;
-				nodePtr->mType = TYPE_STRING;
-
-				StringHashing::StringHash keyHash = StringHashing::getHash( key );
-				mNodes.push_back( SerialiserListNode( keyHash, nodePtr ) );
-			}
-		}
-	}
-
-	inline SerialNode* GetNode( const char* key )
-	{
-		StringHashing::StringHash hash = StringHashing::getHash( key );
-		for( SerialiserList::iterator it = mNodes.begin();
-			it != mNodes.end();
-			++it )
-		{
-			if( (*it).first == hash )
-			{
-				return (*it).second;
-			}
-		}
-
-		return NULL;
+	inline bool IsBlockCopy() const
+	{
+		return mBlockCopy;
 	}
 
 private:
+	struct FieldCopy
+	{
+		unsigned int mObjectOffset;
+		unsigned int mRecordOffset;
+		unsigned int mSize;
+	};
+
+	bool _checkBlockCopy() const;
+
+	std::vector<SerialField> mRecordFields;
+	std::vector<FieldCopy> mCopies;
+	unsigned int mRecordSize;
+	size_t mObjectSize;
+	bool mBlockCopy;
+};
+
+// Serialised values in one flat, contiguous image
+// The image is a header, the value data, then a table of nodes sorted by key hash, so reading
+// is a binary search with no allocation and an image can be used straight out of a file.
+// Arrays of DEFINE_SERIALISED_CLASS types are stored as a field table plus packed records;
+// when the serialised fields cover the whole object the records are copied in one block
+class Serialiser
+{
+public:
+	struct SerialNode
+	{
+		unsigned int mKey;
+		unsigned int mType;
+		unsigned int mOffset;	// from the start of the image
+		unsigned int mSize;
+	};
+
+	struct ImageHeader
+	{
+		char mMagic[4];			// SRLZ
+		unsigned int mVersion;
+		unsigned int mNodeCount;
+		unsigned int mTableOffset;
+	};
+
+	// array data starts with this, then the fields, then the records
+	struct ArrayHeader
+	{
+		unsigned int mFieldCount;
+		unsigned int mRecordSize;
+		unsigned int mRecordCount;
+		unsigned int mRecordOffset;		// from the start of the array data
+	};
+
 	enum SerialisedType
 	{
 		TYPE_INT,
 		TYPE_UINT,
 		TYPE_FLOAT,
 		TYPE_STRING,
-		TYPE_UNKNOWN
+		TYPE_UNKNOWN,
+		TYPE_ARRAY
 	};
 
+	static const unsigned int kVersion = 1;
+
+	Serialiser( size_t reserveSize = 8 * 1024 );	// grows as needed
+	~Serialiser();
+
+	void Reset();	// drops everything, ready to write
+
+	// writing
+	void AddNode( const char* key, const int& value )			{ _addNode( key, TYPE_INT, &value, sizeof(value) ); }
+	void AddNode( const char* key, const unsigned int& value )	{ _addNode( key, TYPE_UINT, &value, sizeof(value) ); }
+	void AddNode( const char* key, const float& value )			{ _addNode( key, TYPE_FLOAT, &value, sizeof(value) ); }
+	void AddNode( const char* key, const char* value )			{ _addNode( key, TYPE_STRING, value, strlen( value ) + 1 ); }
+
+	// anything else is kept, but can't be read back
 	template<typename T>
-	inline SerialisedType _nodeType( const T& value )
+	void AddNode( const char* key, const T& value )
 	{
-		return TYPE_UNKNOWN;
+		_addNode( key, TYPE_UNKNOWN, &value, sizeof(value) );
 	}
 
 	template<typename T>
-	inline T* _nodeValue(SerialNode* node)
+	bool AddArray( const char* key, const T* objects, size_t count );
+
+	// finishes the image, it stays valid until the serialiser is written to again
+	const void* GetImage( size_t& size );
+
+	// reading, from what has been written or from an opened image
+	// the image isn't copied, so it has to outlive the reads
+	bool Open( const void* image, size_t size );
+
+	bool GetValue( const char* key, int& result ) const				{ return _getValue( key, TYPE_INT, &result, sizeof(result) ); }
+	bool GetValue( const char* key, unsigned int& result ) const	{ return _getValue( key, TYPE_UINT, &result, sizeof(result) ); }
+	bool GetValue( const char* key, float& result ) const			{ return _getValue( key, TYPE_FLOAT, &result, sizeof(result) ); }
+	bool GetValue( const char* key, char* result ) const;			// result must be big enough
+
+	template<typename T>
+	bool GetValue( const char* key, T& result ) const
 	{
-		return NULL;
+		return false;
 	}
 
-	typedef std::pair<StringHashing::StringHash, SerialNode*> SerialiserListNode;
-	typedef std::list<SerialiserListNode> SerialiserList;
+	size_t GetArrayCount( const char* key ) const;
 
-	LinearAllocator mAllocator;
-	SerialiserList mNodes;
-};
+	// reads up to maxCount objects, fields missing from the stored array are left alone
+	template<typename T>
+	size_t GetArray( const char* key, T* objects, size_t maxCount );
 
-// Serialiser node data types
+	// the serialised fields of a DEFINE_SERIALISED_CLASS type, false if they can't be copied as records
+	template<typename T>
+	static bool Describe( std::vector<SerialField>& layout );
 
-template<>
-inline Serialiser::SerialisedType Serialiser::_nodeType( const int& value )
-{
-	return TYPE_INT;
-}
+	// writes or reads every field of a DEFINE_SERIALISED_CLASS object from its SerialFieldTable
+	void SerialiseFields( const SerialFieldTable& table, void* object, SerialMode mode );
 
-template<>
-inline Serialiser::SerialisedType Serialiser::_nodeType( const unsigned int& value )
-{
-	return TYPE_UINT;
-}
+	// the image in one write / a copy of one read from a stream
+	bool Write( SerialSink& sink );
+	bool Read( SerialSource& source );
 
-template<>
-inline Serialiser::SerialisedType Serialiser::_nodeType( const float& value )
-{
-	return TYPE_FLOAT;
-}
+	// MODE_DESCRIBE, called by DECLARE_VALUE with the field's offset in the object
+	void DescribeField( const char* key, const int& value, ptrdiff_t offset )			{ _describeField( key, TYPE_INT, offset, sizeof(value) ); }
+	void DescribeField( const char* key, const unsigned int& value, ptrdiff_t offset )	{ _describeField( key, TYPE_UINT, offset, sizeof(value) ); }
+	void DescribeField( const char* key, const float& value, ptrdiff_t offset )			{ _describeField( key, TYPE_FLOAT, offset, sizeof(value) ); }
 
-// serialiser node data fetchers
+	template<typename T>
+	void DescribeField( const char* key, const T& value, ptrdiff_t offset )
+	{
+		_describeField( key, TYPE_UNKNOWN, offset, sizeof(value) );
+	}
 
-template<>
-inline bool Serialiser::SerialNode::GetValue( int& result )
-{
-	if( mType == TYPE_INT )
+	// fixed size strings are copied as they are, pointers can't be
+	template<size_t N>
+	void DescribeString( const char* key, const char (&value)[N], ptrdiff_t offset )
 	{
-		int* iPtr = (int*)mPtr;
-		result = *iPtr;
+		_describeField( key, TYPE_STRING, offset, N );
+	}
 
-		return true;
+	template<typename T>
+	void DescribeString( const char* key, const T& value, ptrdiff_t offset )
+	{
+		mLayoutValid = false;
 	}
 
-	return false;
+private:
+	Serialiser( const Serialiser& );
+	Serialiser& operator=( const Serialiser& );
+
+	void _addNode( const char* key, SerialisedType type, const void* value, size_t size );
+	void _addNode( unsigned int key, unsigned int type, const void* value, size_t size );
+	void* _allocate( size_t size, size_t align );
+	void _describeField( const char* key, SerialisedType type, ptrdiff_t offset, size_t size );
+	bool _getValue( const char* key, SerialisedType type, void* result, size_t size ) const;
+	const SerialNode* _findNode( const char* key ) const;
+	const SerialNode* _findNode( unsigned int key ) const;
+	void _sortNodes() const;
+
+	unsigned char* _beginArray( const char* key, size_t count, const SerialRecordPlan& plan );
+	const unsigned char* _beginRead( const char* key, const std::vector<SerialField>& layout, size_t objectSize, SerialRecordPlan& plan, size_t& count ) const;
+
+	// the image being written, or a copy of one read from a stream
+	std::vector<unsigned char> mBuffer;
+	size_t mDataEnd;
+	mutable std::vector<SerialNode> mNodes;
+	mutable bool mSorted;
+
+	// what reads come from, either the above or an opened image
+	bool mExternal;
+	mutable const unsigned char* mImage;
+	mutable size_t mImageSize;
+	mutable const SerialNode* mTable;
+	mutable size_t mTableCount;
+
+	// filled in by MODE_DESCRIBE
+	std::vector<SerialField> mLayout;
+	bool mLayoutValid;
+};
+
+template<typename T>
+bool Serialiser::Describe( std::vector<SerialField>& layout )
+{
+	Serialiser describer( 0 );
+	describer.mLayoutValid = true;
+
+	T sample;
+	sample.Serialise( describer, MODE_DESCRIBE );
+
+	layout.swap( describer.mLayout );
+	return describer.mLayoutValid;
 }
 
-template<>
-inline bool Serialiser::SerialNode::GetValue( unsigned int& result )
+// The serialised fields of a DEFINE_SERIALISED_CLASS type, with the names already hashed
+// Each table is built once while the program starts, so serialising an object is a loop over
+// the table with no hashing and no per-field code. Classes with fields the table can't describe
+// (strings held by pointer) and anything serialised before the tables are built fall back to
+// the field by field code in the macros
+class SerialFieldTable
 {
-	if( mType == TYPE_UINT )
+public:
+	template<typename T>
+	static inline const SerialFieldTable& Get()
 	{
-		unsigned int* iPtr = (unsigned int*)mPtr;
-		result = *iPtr;
+		return Instance<T>::sTable;
+	}
 
-		return true;
+	inline bool IsValid() const
+	{
+		return mValid;
 	}
 
-	return false;
-}
+	inline const std::vector<SerialField>& GetFields() const
+	{
+		return mFields;
+	}
 
-template<>
-inline bool Serialiser::SerialNode::GetValue( float& result )
-{
-	if( mType == TYPE_FLOAT )
+private:
+	SerialFieldTable( const SerialFieldTable& );
+	SerialFieldTable& operator=( const SerialFieldTable& );
+
+	// static members of class templates are built with the other statics, without the
+	// unsafe first-use guard a function local static would get
+	template<typename T>
+	struct Instance
 	{
-		float* iPtr = (float*)mPtr;
-		result = *iPtr;
+		static const SerialFieldTable sTable;
+	};
 
-		return true;
+	template<typename T>
+	explicit SerialFieldTable( const T* )
+	{
+		mValid = Serialiser::Describe<T>( mFields );
 	}
 
-	return false;
-}
+	std::vector<SerialField> mFields;
+	bool mValid;
+};
+
+template<typename T>
+const SerialFieldTable SerialFieldTable::Instance<T>::sTable( (const T*)NULL );
 
-template<>
-inline bool Serialiser::SerialNode::GetValue( char* &result )
+template<typename T>
+bool Serialiser::AddArray( const char* key, const T* objects, size_t count )
 {
-	if( mType == TYPE_STRING )
+	const SerialFieldTable& table = SerialFieldTable::Get<T>();
+	SerialRecordPlan plan;
+	if( !table.IsValid() || !plan.BuildForWrite( table.GetFields(), sizeof(T) ) )
 	{
-		char* iPtr = (char*)mPtr;
-		strcpy( result, iPtr );
+		return false;
+	}
 
-		return true;
+	unsigned char* records = _beginArray( key, count, plan );
+	if( records == NULL )
+	{
+		return false;
 	}
 
-	return false;
+	plan.Pack( objects, count, records );
+	return true;
 }
 
+template<typename T>
+size_t Serialiser::GetArray( const char* key, T* objects, size_t maxCount )
+{
+	const SerialFieldTable& table = SerialFieldTable::Get<T>();
+	SerialRecordPlan plan;
+	size_t count = 0;
+	const unsigned char* records = table.IsValid() ? _beginRead( key, table.GetFields(), sizeof(T), plan, count ) : NULL;
+	if( records == NULL )
+	{
+		return 0;
+	}
 
+	count = count < maxCount ? count : maxCount;
+	plan.Unpack( records, count, objects );
+	return count;
+}
 
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef STRING_HASH_INCLUDED
 #define STRING_HASH_INCLUDED
 
+#include <stddef.h>
+
 class StringHashing
 {
 public:
@@ -19,6 +21,20 @@ public:
 
 		return hash;
 	}
+
+	// djb2 over raw bytes, pass a previous hash as the seed to combine values
+	static inline unsigned long getHash( const void* data, size_t size, unsigned long seed = 5381 )
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		unsigned long hash = seed;
+
+		for( size_t i = 0; i < size; ++i )
+		{
+			hash = ((hash << 5) + hash) + bytes[i];
+		}
+
+		return hash;
+	}
 };
 
 #endif
\ No newline at end of file
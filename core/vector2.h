@@ -34,28 +34,30 @@ public:
 
 	inline int& x() { return m_x; }
 	inline int& y() { return m_y; }
+	inline int x() const { return m_x; }
+	inline int y() const { return m_y; }
 
-	inline Vector2 operator*(float f)
+	inline Vector2 operator*(float f) const
 	{
 		return Vector2((int)(m_x*f),(int)(m_y*f));
 	}
 
-	inline Vector2 operator+(Vector2 f)
+	inline Vector2 operator+(Vector2 f) const
 	{
 		return Vector2((int)(m_x+f.m_x),(int)(m_y+f.m_y));
 	}
 
-	inline Vector2 operator-(Vector2 f)
+	inline Vector2 operator-(Vector2 f) const
 	{
 		return Vector2((int)(m_x-f.m_x),(int)(m_y-f.m_y));
 	}
 	
-	inline float length()
+	inline float length() const
 	{
 		return sqrt((float)((m_x*m_x) + (m_y*m_y)));
 	}
 
-	inline Vector2 normalise()
+	inline Vector2 normalise() const
 	{
 		float l=length();
 		return *this * l;
@@ -97,28 +99,30 @@ public:
 
 	inline float& x() { return m_x; }
 	inline float& y() { return m_y; }
+	inline float x() const { return m_x; }
+	inline float y() const { return m_y; }
 
-	inline Vector2f operator*(float f)
+	inline Vector2f operator*(float f) const
 	{
 		return Vector2f(m_x*f,m_y*f);
 	}
 
-	inline Vector2f operator+(Vector2f f)
+	inline Vector2f operator+(Vector2f f) const
 	{
 		return Vector2f(m_x+f.m_x,m_y+f.m_y);
 	}
 
-	inline Vector2f operator-(Vector2f f)
+	inline Vector2f operator-(Vector2f f) const
 	{
 		return Vector2f((m_x-f.m_x),(m_y-f.m_y));
 	}
 	
-	inline float length()
+	inline float length() const
 	{
 		return sqrt((m_x*m_x) + (m_y*m_y));
 	}
 
-	inline Vector2f normalise()
+	inline Vector2f normalise() const
 	{
 		float l=length();
 		return *this * (1.0f / l);
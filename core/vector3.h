@@ -0,0 +1,31 @@
+#ifndef VECTOR3_INCLUDED
+#define VECTOR3_INCLUDED
+
+class Vector3f
+{
+public:
+	Vector3f()
+	{
+	}
+
+	Vector3f(float x, float y, float z)
+		: m_x(x)
+		, m_y(y)
+		, m_z(z)
+	{
+	}
+
+	inline float& x() { return m_x; }
+	inline float& y() { return m_y; }
+	inline float& z() { return m_z; }
+	inline float x() const { return m_x; }
+	inline float y() const { return m_y; }
+	inline float z() const { return m_z; }
+
+private:
+	float m_x;
+	float m_y;
+	float m_z;
+};
+
+#endif
\ No newline at end of file
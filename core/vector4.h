@@ -0,0 +1,36 @@
+#ifndef VECTOR4_INCLUDED
+#define VECTOR4_INCLUDED
+
+// laid out as 4 floats, so it can be written straight into vertex buffers
+class Vector4f
+{
+public:
+	Vector4f()
+	{
+	}
+
+	Vector4f(float x, float y, float z, float w)
+		: m_x(x)
+		, m_y(y)
+		, m_z(z)
+		, m_w(w)
+	{
+	}
+
+	inline float& x() { return m_x; }
+	inline float& y() { return m_y; }
+	inline float& z() { return m_z; }
+	inline float& w() { return m_w; }
+	inline float x() const { return m_x; }
+	inline float y() const { return m_y; }
+	inline float z() const { return m_z; }
+	inline float w() const { return m_w; }
+
+private:
+	float m_x;
+	float m_y;
+	float m_z;
+	float m_w;
+};
+
+#endif
\ No newline at end of file
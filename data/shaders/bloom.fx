@@ -49,10 +49,15 @@ SamplerState sampleLinear
 
 float4 PositionScale;
 float2 PixelSize;
-float2 ExtraTinyBloomConsts;	// x = threshold, y = mul
-float2 TinyBloomConsts;	// x = threshold, y = mul
-float2 QuarterBloomConsts;	// x = threshold, y = mul
-float2 HalfBloomConsts;	// x = threshold, y = mul
+
+// written in one go from biomorphs/bloom_constants.h, keep the layouts in step
+cbuffer BloomConstants
+{
+	float2 ExtraTinyBloomConsts;	// x = threshold, y = mul
+	float2 TinyBloomConsts;	// x = threshold, y = mul
+	float2 QuarterBloomConsts;	// x = threshold, y = mul
+	float2 HalfBloomConsts;	// x = threshold, y = mul
+};
 
 ///////////////////////////////////////////////////////////////////////////////////////
 // Vertex shader
@@ -219,4 +224,43 @@ technique10 BlurV
         SetGeometryShader( NULL );
         SetPixelShader( CompileShader( ps_4_0, PS_BV() ) );
     }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Gaussian blur, both directions in one pass
+// The 9 tap kernel from BlurH/BlurV applied in 2D. Each pair of neighbouring taps is merged into
+// one bilinear fetch at their weighted position, so it is 5x5 fetches rather than 9x9.
+// This matches BlurH then BlurV exactly when blurSize is a whole texel, which it always is
+// vertically; horizontally on wide targets it is a close approximation
+static const float BlurOffsets[5] = { -3.357143, -1.444444, 0.0, 1.444444, 3.357143 };
+static const float BlurWeights[5] = { 0.14, 0.27, 0.16, 0.27, 0.14 };
+
+float4 PS_BLUR( PS_INPUT input) : SV_Target
+{
+	const float blurSize = max(PixelSize.x, PixelSize.y);
+	float4 sum = float4(0.0,0.0,0.0,0.0);
+
+	[unroll] for( int y = 0; y < 5; ++y )
+	{
+		float4 row = float4(0.0,0.0,0.0,0.0);
+		[unroll] for( int x = 0; x < 5; ++x )
+		{
+			row += BlitTexture.Sample(sampleLinear, input.UV + float2(BlurOffsets[x], BlurOffsets[y]) * blurSize) * BlurWeights[x];
+		}
+		sum += row * BlurWeights[y];
+	}
+
+	return sum;
+}
+
+technique10 Blur
+{
+    pass P0
+    {
+		SetBlendState(SrcAlphaBlendingOff, float4( 0.0f, 0.0f, 0.0f, 0.0f ), 0xFFFFFFFF );
+		SetDepthStencilState(ds, 0);
+        SetVertexShader( CompileShader( vs_4_0, VS() ) );
+        SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_4_0, PS_BLUR() ) );
+    }
 }
\ No newline at end of file
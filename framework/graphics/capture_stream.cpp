@@ -0,0 +1,376 @@
+#include "capture_stream.h"
+#include "core\thread.h"
+#include <string.h>
+
+namespace
+{
+	// delta tokens are a 32 bit length, with the top bit set for a run of unchanged bytes.
+	// Otherwise that many changed (XORed) bytes follow
+	const unsigned int kZeroRunFlag = 0x80000000;
+
+	// shorter runs of unchanged bytes are cheaper to leave in the literals
+	const unsigned int kMinZeroRun = 8;
+}
+
+class CaptureStreamThread : public Thread
+{
+public:
+	CaptureStreamThread( CaptureStream* owner )
+		: mOwner(owner)
+	{
+	}
+
+protected:
+	virtual bool threadFunc()
+	{
+		// the png writer goes through WIC
+		HRESULT hr = CoInitializeEx( NULL, COINIT_MULTITHREADED );
+
+		// a NULL frame means the stream is closing
+		CaptureStream::Frame* f = NULL;
+		while( (f = mOwner->mQueuedFrames.Pop()) != NULL )
+		{
+			mOwner->_writeFrame( *f );
+			mOwner->mFreeFrames.Push( f );
+		}
+
+		if( SUCCEEDED(hr) )
+		{
+			CoUninitialize();
+		}
+
+		return true;
+	}
+
+private:
+	CaptureStream* mOwner;
+};
+
+CaptureStream::CaptureStream()
+	: mFrameSize(0)
+	, mFrames(NULL)
+	, mThread(NULL)
+	, mFile(NULL)
+	, mPreviousFrame(NULL)
+	, mCompressed(NULL)
+	, mFramesWritten(0)
+	, mBytesWritten(0)
+	, mFailed(false)
+	, mFramesAdded(0)
+{
+}
+
+CaptureStream::~CaptureStream()
+{
+	Close();
+}
+
+bool CaptureStream::Open( const Parameters& p )
+{
+	if( IsOpen() || p.mWidth == 0 || p.mHeight == 0 || p.mBufferCount <= 0 )
+	{
+		return false;
+	}
+
+	mParams = p;
+	mFrameSize = p.mWidth * p.mHeight * 4;
+	mFramesWritten = 0;
+	mFramesAdded = 0;
+	mBytesWritten = 0;
+	mFailed = false;
+
+	if( p.mMode == ModeDelta )
+	{
+		mFile = fopen( p.mFileName, "wb" );
+		if( mFile == NULL )
+		{
+			printf("Failed to open capture file '%s'\n", p.mFileName);
+			return false;
+		}
+
+		// the frame count is filled in on close
+		FileHeader header;
+		memcpy( header.mMagic, "BCAP", 4 );
+		header.mVersion = kVersion;
+		header.mWidth = p.mWidth;
+		header.mHeight = p.mHeight;
+		header.mFrameCount = 0;
+		header.mKeyframeInterval = p.mKeyframeInterval;
+		if( fwrite( &header, sizeof(header), 1, mFile ) != 1 )
+		{
+			// not even the header, so there is no stream to write to
+			printf("Failed to write the capture header to '%s'\n", p.mFileName);
+			fclose( mFile );
+			mFile = NULL;
+			return false;
+		}
+		mBytesWritten = sizeof(header);
+
+		// worst case, every literal run is split by a minimum length zero run
+		mPreviousFrame = (unsigned char*)malloc( mFrameSize );
+		mCompressed = (unsigned char*)malloc( mFrameSize + (mFrameSize / kMinZeroRun + 2) * sizeof(unsigned int) * 2 );
+	}
+
+	mFrames = new Frame[p.mBufferCount];
+	mFreeFrames.Initialise( p.mBufferCount );
+	mQueuedFrames.Initialise( p.mBufferCount + 1 );	// room for the quit frame
+	for( int i = 0; i < p.mBufferCount; ++i )
+	{
+		mFrames[i].mPixels = (unsigned char*)malloc( mFrameSize );
+		mFrames[i].mIndex = 0;
+		mFreeFrames.Push( &mFrames[i] );
+	}
+
+	mThread = new CaptureStreamThread( this );
+	if( !mThread->run() )
+	{
+		printf("Failed to start the capture thread\n");
+		delete mThread;
+		mThread = NULL;
+	}
+
+	bool allocated = mThread != NULL && (p.mMode != ModeDelta || (mPreviousFrame != NULL && mCompressed != NULL));
+	for( int i = 0; i < p.mBufferCount; ++i )
+	{
+		allocated = allocated && mFrames[i].mPixels != NULL;
+	}
+
+	if( !allocated )
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool CaptureStream::Close()
+{
+	if( mThread )
+	{
+		mQueuedFrames.Push( NULL );
+		mThread->waitUntilComplete();
+		delete mThread;
+		mThread = NULL;
+	}
+
+	if( mFile )
+	{
+		// now the frame count is known. Anything after the last whole frame is ignored by readers
+		FileHeader header;
+		memcpy( header.mMagic, "BCAP", 4 );
+		header.mVersion = kVersion;
+		header.mWidth = mParams.mWidth;
+		header.mHeight = mParams.mHeight;
+		header.mFrameCount = mFramesWritten;
+		header.mKeyframeInterval = mParams.mKeyframeInterval;
+		if( fseek( mFile, 0, SEEK_SET ) != 0 || fwrite( &header, sizeof(header), 1, mFile ) != 1 )
+		{
+			printf("Failed to update the capture header\n");
+			mFailed = true;
+		}
+
+		if( fclose( mFile ) != 0 )
+		{
+			mFailed = true;
+		}
+		mFile = NULL;
+	}
+
+	if( mFrames )
+	{
+		for( int i = 0; i < mParams.mBufferCount; ++i )
+		{
+			free( mFrames[i].mPixels );
+		}
+		delete [] mFrames;
+		mFrames = NULL;
+	}
+	mFreeFrames.Release();
+	mQueuedFrames.Release();
+
+	free( mPreviousFrame );
+	free( mCompressed );
+	mPreviousFrame = NULL;
+	mCompressed = NULL;
+
+	if( mFailed )
+	{
+		printf("Capture '%s' failed, only the first %u of %u frames were written\n", mParams.mFileName, mFramesWritten, mFramesAdded);
+	}
+	return !mFailed;
+}
+
+bool CaptureStream::AddFrame( const void* rgba, unsigned int rowPitch )
+{
+	if( !IsOpen() || mFailed )
+	{
+		return false;
+	}
+
+	// this is where a slow disk holds the caller back
+	Frame* f = mFreeFrames.Pop();
+
+	const unsigned int rowSize = mParams.mWidth * 4;
+	const unsigned char* src = (const unsigned char*)rgba;
+	for( unsigned int y = 0; y < mParams.mHeight; ++y )
+	{
+		memcpy( f->mPixels + (y * rowSize), src, rowSize );
+		src += rowPitch;
+	}
+
+	f->mIndex = mFramesAdded++;
+	mQueuedFrames.Push( f );
+
+	return true;
+}
+
+void CaptureStream::_writeFrame( Frame& f )
+{
+	// frames queued before a failure are dropped
+	if( mFailed )
+	{
+		return;
+	}
+
+	if( mParams.mMode == ModeDelta )
+	{
+		_writeDelta( f );
+		return;
+	}
+
+	ImageEncoder::Job job;
+	job.mPixels = f.mPixels;
+	job.mWidth = mParams.mWidth;
+	job.mHeight = mParams.mHeight;
+	job.mRowPitch = mParams.mWidth * 4;
+	job.mFormat = ImageEncoder::FormatPNG;
+	sprintf_s( job.mFileName, "%s_%06d", mParams.mFileName, f.mIndex );
+	if( !ImageEncoder::EncodeNow( job ) )
+	{
+		printf("Failed to write capture frame %d\n", f.mIndex);
+		mFailed = true;
+		return;
+	}
+
+	++mFramesWritten;
+}
+
+void CaptureStream::_writeDelta( Frame& f )
+{
+	FrameHeader header;
+	header.mFlags = 0;
+
+	// keyframes are deltas against black, so playback can start from any of them
+	if( mParams.mKeyframeInterval == 0 || (mFramesWritten % mParams.mKeyframeInterval) == 0 )
+	{
+		memset( mPreviousFrame, 0, mFrameSize );
+		header.mFlags |= kFlagKeyframe;
+	}
+
+	header.mCompressedSize = _compressDelta( f.mPixels, mPreviousFrame, mFrameSize, mCompressed );
+
+	// mPreviousFrame already holds this frame, so nothing after a failed write would decode.
+	// The stream stops here, and the header only counts the frames before it
+	bool ok = fwrite( &header, sizeof(header), 1, mFile ) == 1;
+	ok = ok && fwrite( mCompressed, header.mCompressedSize, 1, mFile ) == 1;
+	if( !ok )
+	{
+		printf("Failed to write capture frame %d, the capture has stopped\n", f.mIndex);
+		mFailed = true;
+		return;
+	}
+
+	mBytesWritten += sizeof(header) + header.mCompressedSize;
+	++mFramesWritten;
+}
+
+unsigned int CaptureStream::_compressDelta( const unsigned char* frame, unsigned char* previous, unsigned int size, unsigned char* out )
+{
+	// previous becomes the delta, then the new frame once it has been encoded
+	for( unsigned int i = 0; i < size; ++i )
+	{
+		previous[i] ^= frame[i];
+	}
+
+	const unsigned char* delta = previous;
+	unsigned char* o = out;
+	unsigned int literalStart = 0;
+	unsigned int i = 0;
+	while( i < size )
+	{
+		if( delta[i] != 0 )
+		{
+			++i;
+			continue;
+		}
+
+		unsigned int runEnd = i;
+		while( runEnd < size && delta[runEnd] == 0 )
+		{
+			++runEnd;
+		}
+
+		if( runEnd - i >= kMinZeroRun || runEnd == size )
+		{
+			if( i > literalStart )
+			{
+				const unsigned int literalLength = i - literalStart;
+				memcpy( o, &literalLength, sizeof(literalLength) );		o += sizeof(literalLength);
+				memcpy( o, delta + literalStart, literalLength );		o += literalLength;
+			}
+
+			const unsigned int zeroToken = (runEnd - i) | kZeroRunFlag;
+			memcpy( o, &zeroToken, sizeof(zeroToken) );		o += sizeof(zeroToken);
+			literalStart = runEnd;
+		}
+		i = runEnd;
+	}
+
+	if( size > literalStart )
+	{
+		const unsigned int literalLength = size - literalStart;
+		memcpy( o, &literalLength, sizeof(literalLength) );		o += sizeof(literalLength);
+		memcpy( o, delta + literalStart, literalLength );		o += literalLength;
+	}
+
+	memcpy( previous, frame, size );
+
+	return (unsigned int)(o - out);
+}
+
+bool CaptureStream::DecodeFrame( const void* compressed, unsigned int compressedSize, unsigned char* frame, unsigned int frameSize )
+{
+	const unsigned char* src = (const unsigned char*)compressed;
+	const unsigned char* srcEnd = src + compressedSize;
+	unsigned int pos = 0;
+
+	while( src + sizeof(unsigned int) <= srcEnd )
+	{
+		unsigned int token = 0;
+		memcpy( &token, src, sizeof(token) );
+		src += sizeof(token);
+
+		const unsigned int length = token & ~kZeroRunFlag;
+		if( pos + length > frameSize )
+		{
+			return false;
+		}
+
+		if( (token & kZeroRunFlag) == 0 )
+		{
+			if( src + length > srcEnd )
+			{
+				return false;
+			}
+			for( unsigned int i = 0; i < length; ++i )
+			{
+				frame[pos + i] ^= src[i];
+			}
+			src += length;
+		}
+		pos += length;
+	}
+
+	return pos == frameSize && src == srcEnd;
+}
\ No newline at end of file
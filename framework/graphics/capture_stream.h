@@ -0,0 +1,135 @@
+#ifndef CAPTURE_STREAM_INCLUDED
+#define CAPTURE_STREAM_INCLUDED
+
+#include "image_encoder.h"
+#include "core\bounded_queue.h"
+#include <stdio.h>
+
+class CaptureStreamThread;
+
+// Streams RGBA8 frames to disk on a background thread, with a fixed number of frame buffers
+// AddFrame blocks while every buffer is queued, so a capture can run for hours in constant memory.
+// Delta mode writes one container file; each frame is XORed against the previous one and the
+// zero runs are collapsed, so frames that barely change cost almost nothing.
+// Sequence mode writes each frame as a PNG instead
+class CaptureStream
+{
+friend class CaptureStreamThread;
+public:
+	enum Mode
+	{
+		ModeDelta = 0,
+		ModePNGSequence
+	};
+
+	struct Parameters
+	{
+		Parameters()
+			: mMode(ModeDelta)
+			, mWidth(0)
+			, mHeight(0)
+			, mBufferCount(4)
+			, mKeyframeInterval(300)
+		{
+			mFileName[0] = '\0';
+		}
+
+		Mode mMode;
+		char mFileName[256];	// the container, or the prefix of each image
+		unsigned int mWidth;
+		unsigned int mHeight;
+		int mBufferCount;
+		unsigned int mKeyframeInterval;		// frames between full (non-delta) frames
+	};
+
+	// container layout
+	struct FileHeader
+	{
+		char mMagic[4];			// BCAP
+		unsigned int mVersion;
+		unsigned int mWidth;
+		unsigned int mHeight;
+		unsigned int mFrameCount;
+		unsigned int mKeyframeInterval;
+	};
+
+	// followed by mCompressedSize bytes
+	struct FrameHeader
+	{
+		unsigned int mCompressedSize;
+		unsigned int mFlags;
+	};
+
+	static const unsigned int kVersion = 1;
+	static const unsigned int kFlagKeyframe = 1;
+
+	CaptureStream();
+	~CaptureStream();
+
+	bool Open( const Parameters& p );
+
+	// writes everything queued first. Returns false if any frame failed to write
+	bool Close();
+
+	inline bool IsOpen() const
+	{
+		return mThread != NULL;
+	}
+
+	// set on the first failed write, nothing is written after it
+	inline bool HasFailed() const
+	{
+		return mFailed;
+	}
+
+	// copies the frame, blocking until a buffer is free. Returns false once the stream has failed
+	bool AddFrame( const void* rgba, unsigned int rowPitch );
+
+	inline unsigned int GetFrameCount() const
+	{
+		return mFramesAdded;
+	}
+
+	// written by the stream thread, only exact once the stream is closed
+	inline size_t GetBytesWritten() const
+	{
+		return mBytesWritten;
+	}
+
+	// applies one delta frame on top of the previous frame (or zeros for a keyframe)
+	static bool DecodeFrame( const void* compressed, unsigned int compressedSize, unsigned char* frame, unsigned int frameSize );
+
+private:
+	CaptureStream( const CaptureStream& );
+	CaptureStream& operator=( const CaptureStream& );
+
+	struct Frame
+	{
+		unsigned char* mPixels;		// tightly packed
+		unsigned int mIndex;
+	};
+
+	void _writeFrame( Frame& f );
+	void _writeDelta( Frame& f );
+	static unsigned int _compressDelta( const unsigned char* frame, unsigned char* previous, unsigned int size, unsigned char* out );
+
+	Parameters mParams;
+	unsigned int mFrameSize;
+
+	Frame* mFrames;
+	BoundedQueue<Frame*> mFreeFrames;
+	BoundedQueue<Frame*> mQueuedFrames;
+	CaptureStreamThread* mThread;
+
+	// only touched by the stream thread
+	FILE* mFile;
+	unsigned char* mPreviousFrame;
+	unsigned char* mCompressed;
+	unsigned int mFramesWritten;
+	size_t mBytesWritten;
+	volatile bool mFailed;		// the file stops at the last whole frame, which is what the header counts
+
+	unsigned int mFramesAdded;
+};
+
+#endif
\ No newline at end of file
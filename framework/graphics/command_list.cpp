@@ -0,0 +1,938 @@
+#include "command_list.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	enum PacketTypes
+	{
+		PacketFlush = 0,
+		PacketResetShaderState,
+		PacketPresent,
+		PacketSetViewport,
+		PacketSetRenderTargets,
+		PacketSetPrimitiveTopology,
+		PacketSetInputLayout,
+		PacketSetVertexBuffer,
+		PacketSetIndexBuffer,
+		PacketSetTechnique,
+		PacketSetSampler,
+		PacketSetVectorConstant,
+		PacketSetMatrixConstant,
+		PacketSetConstants,
+		PacketDrawIndexed,
+		PacketClearDepth,
+		PacketClearColour,
+		PacketCopyTexture,
+		PacketUpdateVB,
+		PacketWriteVB,
+		PacketWriteIB,
+		PacketUpdateIB,
+		PacketDrawText,
+		PacketCallback,
+		PacketReleaseRendertarget,
+		PacketReleaseDepthStencil,
+		PacketReleaseTexture,
+		PacketReleaseVB,
+		PacketReleaseIB,
+		PacketReleaseInputLayout,
+		PacketReleaseEffect,
+		PacketReleaseFont
+	};
+
+	struct FlushPacket				{ enum { kType = PacketFlush }; };
+	struct ResetShaderStatePacket	{ enum { kType = PacketResetShaderState }; };
+	struct PresentPacket			{ enum { kType = PacketPresent }; };
+
+	struct SetViewportPacket
+	{
+		enum { kType = PacketSetViewport };
+		Viewport mViewport;
+	};
+
+	struct SetRenderTargetsPacket
+	{
+		enum { kType = PacketSetRenderTargets };
+		int mColourCount;
+		bool mHasDepth;
+		Rendertarget mColour[IDevice::kMaxRenderTargets];
+		DepthStencilBuffer mDepth;
+	};
+
+	struct SetPrimitiveTopologyPacket
+	{
+		enum { kType = PacketSetPrimitiveTopology };
+		PrimitiveTopology mTopology;
+	};
+
+	struct SetInputLayoutPacket
+	{
+		enum { kType = PacketSetInputLayout };
+		ShaderInputLayout mLayout;
+	};
+
+	struct SetVertexBufferPacket
+	{
+		enum { kType = PacketSetVertexBuffer };
+		int mStream;
+		VertexBuffer mBuffer;
+	};
+
+	struct SetIndexBufferPacket
+	{
+		enum { kType = PacketSetIndexBuffer };
+		IndexBuffer mBuffer;
+	};
+
+	struct SetTechniquePacket
+	{
+		enum { kType = PacketSetTechnique };
+		EffectTechnique mTechnique;
+		int mPass;
+	};
+
+	struct SetSamplerPacket
+	{
+		enum { kType = PacketSetSampler };
+		TextureSampler mSampler;
+		Texture2D mTexture;
+	};
+
+	struct SetVectorConstantPacket
+	{
+		enum { kType = PacketSetVectorConstant };
+		VectorConstant mConstant;
+		float mValue[4];
+	};
+
+	struct SetMatrixConstantPacket
+	{
+		enum { kType = PacketSetMatrixConstant };
+		MatrixConstant mConstant;
+		float mValue[16];
+	};
+
+	// followed by the block contents
+	struct SetConstantsPacket
+	{
+		enum { kType = PacketSetConstants };
+		ConstantBlock mBlock;
+		unsigned int mSize;
+	};
+
+	struct DrawIndexedPacket
+	{
+		enum { kType = PacketDrawIndexed };
+		DrawIndexedParameters mParams;
+	};
+
+	struct ClearDepthPacket
+	{
+		enum { kType = PacketClearDepth };
+		DepthStencilBuffer mTarget;
+		float mDepth;
+		unsigned int mStencil;
+	};
+
+	struct ClearColourPacket
+	{
+		enum { kType = PacketClearColour };
+		Rendertarget mTarget;
+		float mColour[4];
+	};
+
+	struct CopyTexturePacket
+	{
+		enum { kType = PacketCopyTexture };
+		Texture2D mSrc;
+		Texture2D mDst;
+	};
+
+	// followed by mByteCount bytes of vertex data
+	struct UpdateVBPacket
+	{
+		enum { kType = PacketUpdateVB };
+		VertexBuffer mBuffer;
+		unsigned int mByteOffset;
+		unsigned int mByteCount;
+	};
+
+	// followed by the full contents of the buffer
+	struct WriteVBPacket
+	{
+		enum { kType = PacketWriteVB };
+		VertexBuffer mBuffer;
+		unsigned int mByteCount;
+	};
+
+	struct WriteIBPacket
+	{
+		enum { kType = PacketWriteIB };
+		IndexBuffer mBuffer;
+		unsigned int mByteCount;
+	};
+
+	// followed by mByteCount bytes of index data
+	struct UpdateIBPacket
+	{
+		enum { kType = PacketUpdateIB };
+		IndexBuffer mBuffer;
+		unsigned int mByteOffset;
+		unsigned int mByteCount;
+	};
+
+	// followed by the null terminated string
+	struct DrawTextPacket
+	{
+		enum { kType = PacketDrawText };
+		Font mFont;
+		Font::DrawParameters mParams;
+		Vector2 mPosition;
+		Vector2 mRectSize;
+	};
+
+	struct CallbackPacket
+	{
+		enum { kType = PacketCallback };
+		CommandList::Callback mFunction;
+		void* mUserData;
+	};
+
+	// the handle is copied, the caller's is invalidated straight away
+	template<class ResourceType, int Type>
+	struct ReleasePacket
+	{
+		enum { kType = Type };
+		ResourceType mResource;
+	};
+
+	typedef ReleasePacket<Rendertarget, PacketReleaseRendertarget> ReleaseRendertargetPacket;
+	typedef ReleasePacket<DepthStencilBuffer, PacketReleaseDepthStencil> ReleaseDepthStencilPacket;
+	typedef ReleasePacket<Texture2D, PacketReleaseTexture> ReleaseTexturePacket;
+	typedef ReleasePacket<VertexBuffer, PacketReleaseVB> ReleaseVBPacket;
+	typedef ReleasePacket<IndexBuffer, PacketReleaseIB> ReleaseIBPacket;
+	typedef ReleasePacket<ShaderInputLayout, PacketReleaseInputLayout> ReleaseInputLayoutPacket;
+	typedef ReleasePacket<Effect, PacketReleaseEffect> ReleaseEffectPacket;
+	typedef ReleasePacket<Font, PacketReleaseFont> ReleaseFontPacket;
+}
+
+CommandList::CommandList()
+	: mTarget(NULL)
+	, mCurrentBlock(0)
+	, mBlockSize(0)
+	, mCommandCount(0)
+{
+}
+
+CommandList::~CommandList()
+{
+	Release();
+}
+
+bool CommandList::Create( IDevice* target, size_t blockSize )
+{
+	mTarget = target;
+	mBlockSize = blockSize;
+
+	LinearAllocator* block = new LinearAllocator;
+	if( !block->Initialise( mBlockSize ) )
+	{
+		delete block;
+		return false;
+	}
+	mBlocks.push_back( block );
+
+	Reset();
+
+	return true;
+}
+
+void CommandList::Release()
+{
+	for( size_t i = 0; i < mBlocks.size(); ++i )
+	{
+		delete mBlocks[i];
+	}
+	mBlocks.clear();
+	mTarget = NULL;
+	mCommandCount = 0;
+}
+
+void CommandList::Reset()
+{
+	for( size_t i = 0; i < mBlocks.size(); ++i )
+	{
+		mBlocks[i]->Reset();
+	}
+	mCurrentBlock = 0;
+	mCommandCount = 0;
+}
+
+void* CommandList::_allocPacket( unsigned int type, size_t size, size_t payloadSize )
+{
+	const size_t headerSize = ALIGN_UP( sizeof(PacketHeader), kPacketAlign );
+	const size_t totalSize = headerSize + ALIGN_UP( size, kPacketAlign ) + ALIGN_UP( payloadSize, kPacketAlign );
+
+	void* mem = NULL;
+	while( mem == NULL && mCurrentBlock < (int)mBlocks.size() )
+	{
+		mem = mBlocks[mCurrentBlock]->Allocate( totalSize, kPacketAlign );
+		if( mem == NULL )
+		{
+			++mCurrentBlock;
+		}
+	}
+
+	// out of blocks, oversized packets get a block to themselves
+	if( mem == NULL )
+	{
+		LinearAllocator* block = new LinearAllocator;
+		if( !block->Initialise( totalSize > mBlockSize ? totalSize : mBlockSize ) )
+		{
+			printf("Command list out of memory, dropped a %d byte packet\n", (int)totalSize);
+			delete block;
+			return NULL;
+		}
+		mBlocks.push_back( block );
+		mCurrentBlock = (int)mBlocks.size() - 1;
+		mem = block->Allocate( totalSize, kPacketAlign );
+	}
+
+	PacketHeader* header = (PacketHeader*)mem;
+	header->mType = type;
+	header->mSize = (unsigned int)totalSize;
+	++mCommandCount;
+
+	return (void*)((size_t)mem + headerSize);
+}
+
+void CommandList::Execute( IDevice& d )
+{
+	const size_t headerSize = ALIGN_UP( sizeof(PacketHeader), kPacketAlign );
+
+	for( int b = 0; b <= mCurrentBlock && b < (int)mBlocks.size(); ++b )
+	{
+		// packets are padded to the alignment, so they follow on from the first aligned address
+		size_t offset = ALIGN_UP( mBlocks[b]->GetBuffer(), kPacketAlign );
+		const size_t end = (size_t)mBlocks[b]->GetBuffer() + mBlocks[b]->GetUsedSize();
+		while( offset < end )
+		{
+			const PacketHeader* header = (const PacketHeader*)offset;
+			void* packet = (void*)(offset + headerSize);
+			offset += header->mSize;
+
+			switch( header->mType )
+			{
+			case PacketFlush:
+				d.Flush();
+				break;
+			case PacketResetShaderState:
+				d.ResetShaderState();
+				break;
+			case PacketPresent:
+				d.PresentBackbuffer();
+				break;
+			case PacketSetViewport:
+				d.SetViewport( ((SetViewportPacket*)packet)->mViewport );
+				break;
+			case PacketSetRenderTargets:
+				{
+					SetRenderTargetsPacket* p = (SetRenderTargetsPacket*)packet;
+					Rendertarget* targets[IDevice::kMaxRenderTargets];
+					for( int i = 0; i < p->mColourCount; ++i )
+					{
+						targets[i] = &p->mColour[i];
+					}
+					d.SetRenderTargets( targets, p->mColourCount, p->mHasDepth ? &p->mDepth : NULL );
+				}
+				break;
+			case PacketSetPrimitiveTopology:
+				{
+					SetPrimitiveTopologyPacket* p = (SetPrimitiveTopologyPacket*)packet;
+					d.SetPrimitiveTopology( p->mTopology );
+				}
+				break;
+			case PacketSetInputLayout:
+				{
+					SetInputLayoutPacket* p = (SetInputLayoutPacket*)packet;
+					d.SetInputLayout( p->mLayout );
+				}
+				break;
+			case PacketSetVertexBuffer:
+				{
+					SetVertexBufferPacket* p = (SetVertexBufferPacket*)packet;
+					d.SetVertexBuffer( p->mStream, p->mBuffer );
+				}
+				break;
+			case PacketSetIndexBuffer:
+				{
+					SetIndexBufferPacket* p = (SetIndexBufferPacket*)packet;
+					d.SetIndexBuffer( p->mBuffer );
+				}
+				break;
+			case PacketSetTechnique:
+				{
+					SetTechniquePacket* p = (SetTechniquePacket*)packet;
+					d.SetTechnique( p->mTechnique, p->mPass );
+				}
+				break;
+			case PacketSetSampler:
+				{
+					SetSamplerPacket* p = (SetSamplerPacket*)packet;
+					d.SetSampler( p->mSampler, p->mTexture );
+				}
+				break;
+			case PacketSetVectorConstant:
+				{
+					SetVectorConstantPacket* p = (SetVectorConstantPacket*)packet;
+					d.SetConstant( p->mConstant, p->mValue );
+				}
+				break;
+			case PacketSetMatrixConstant:
+				{
+					SetMatrixConstantPacket* p = (SetMatrixConstantPacket*)packet;
+					d.SetConstant( p->mConstant, p->mValue );
+				}
+				break;
+			case PacketSetConstants:
+				{
+					SetConstantsPacket* p = (SetConstantsPacket*)packet;
+					d.SetConstants( p->mBlock, _getPayload(p), p->mSize );
+				}
+				break;
+			case PacketDrawIndexed:
+				d.DrawIndexed( ((DrawIndexedPacket*)packet)->mParams );
+				break;
+			case PacketClearDepth:
+				{
+					ClearDepthPacket* p = (ClearDepthPacket*)packet;
+					d.ClearTarget( p->mTarget, p->mDepth, p->mStencil );
+				}
+				break;
+			case PacketClearColour:
+				{
+					ClearColourPacket* p = (ClearColourPacket*)packet;
+					d.ClearTarget( p->mTarget, p->mColour );
+				}
+				break;
+			case PacketCopyTexture:
+				{
+					CopyTexturePacket* p = (CopyTexturePacket*)packet;
+					d.CopyTextureToTexture( p->mSrc, p->mDst );
+				}
+				break;
+			case PacketUpdateVB:
+				{
+					UpdateVBPacket* p = (UpdateVBPacket*)packet;
+					d.UpdateVB( p->mBuffer, _getPayload(p), p->mByteOffset, p->mByteCount );
+				}
+				break;
+			case PacketWriteVB:
+				{
+					WriteVBPacket* p = (WriteVBPacket*)packet;
+					void* dst = d.LockVB( p->mBuffer );
+					if( dst )
+					{
+						memcpy( dst, _getPayload(p), p->mByteCount );
+					}
+					d.UnlockVB( p->mBuffer );
+				}
+				break;
+			case PacketWriteIB:
+				{
+					WriteIBPacket* p = (WriteIBPacket*)packet;
+					void* dst = d.LockIB( p->mBuffer );
+					if( dst )
+					{
+						memcpy( dst, _getPayload(p), p->mByteCount );
+					}
+					d.UnlockIB( p->mBuffer );
+				}
+				break;
+			case PacketUpdateIB:
+				{
+					UpdateIBPacket* p = (UpdateIBPacket*)packet;
+					d.UpdateIB( p->mBuffer, _getPayload(p), p->mByteOffset, p->mByteCount );
+				}
+				break;
+			case PacketDrawText:
+				{
+					DrawTextPacket* p = (DrawTextPacket*)packet;
+					d.DrawText( (const char*)_getPayload(p), p->mFont, p->mParams, p->mPosition, p->mRectSize );
+				}
+				break;
+			case PacketCallback:
+				{
+					CallbackPacket* p = (CallbackPacket*)packet;
+					p->mFunction( d, p->mUserData );
+				}
+				break;
+			case PacketReleaseRendertarget:
+				d.Release( ((ReleaseRendertargetPacket*)packet)->mResource );
+				break;
+			case PacketReleaseDepthStencil:
+				d.Release( ((ReleaseDepthStencilPacket*)packet)->mResource );
+				break;
+			case PacketReleaseTexture:
+				d.Release( ((ReleaseTexturePacket*)packet)->mResource );
+				break;
+			case PacketReleaseVB:
+				d.Release( ((ReleaseVBPacket*)packet)->mResource );
+				break;
+			case PacketReleaseIB:
+				d.Release( ((ReleaseIBPacket*)packet)->mResource );
+				break;
+			case PacketReleaseInputLayout:
+				d.Release( ((ReleaseInputLayoutPacket*)packet)->mResource );
+				break;
+			case PacketReleaseEffect:
+				d.Release( ((ReleaseEffectPacket*)packet)->mResource );
+				break;
+			case PacketReleaseFont:
+				d.Release( ((ReleaseFontPacket*)packet)->mResource );
+				break;
+			default:
+				printf("Unknown command packet %d\n", header->mType);
+				break;
+			}
+		}
+	}
+}
+
+void CommandList::Flush()
+{
+	_addPacket<FlushPacket>();
+}
+
+void CommandList::ResetShaderState()
+{
+	_addPacket<ResetShaderStatePacket>();
+}
+
+Rendertarget& CommandList::GetBackBuffer()
+{
+	return mTarget->GetBackBuffer();
+}
+
+Texture2D CommandList::GetBackBufferTexture()
+{
+	return mTarget->GetBackBufferTexture();
+}
+
+DepthStencilBuffer& CommandList::GetDepthStencilBuffer()
+{
+	return mTarget->GetDepthStencilBuffer();
+}
+
+void CommandList::PresentBackbuffer()
+{
+	_addPacket<PresentPacket>();
+}
+
+void CommandList::SetViewport( Viewport& vp )
+{
+	SetViewportPacket* p = _addPacket<SetViewportPacket>();
+	if( p )
+	{
+		p->mViewport = vp;
+	}
+}
+
+void CommandList::SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget )
+{
+	SetRenderTargetsPacket* p = _addPacket<SetRenderTargetsPacket>();
+	if( p )
+	{
+		// a null colour target is the same as binding none
+		p->mColourCount = colourTarget != NULL ? 1 : 0;
+		if( colourTarget )
+		{
+			p->mColour[0] = *colourTarget;
+		}
+		p->mHasDepth = depthStencilTarget != NULL;
+		if( depthStencilTarget )
+		{
+			p->mDepth = *depthStencilTarget;
+		}
+	}
+}
+
+void CommandList::SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget )
+{
+	SetRenderTargetsPacket* p = _addPacket<SetRenderTargetsPacket>();
+	if( p )
+	{
+		targetCount = targetCount < IDevice::kMaxRenderTargets ? targetCount : IDevice::kMaxRenderTargets;
+		p->mColourCount = targetCount;
+		for( int i = 0; i < targetCount; ++i )
+		{
+			if( colourTargets[i] )
+			{
+				p->mColour[i] = *colourTargets[i];
+			}
+		}
+		p->mHasDepth = depthStencilTarget != NULL;
+		if( depthStencilTarget )
+		{
+			p->mDepth = *depthStencilTarget;
+		}
+	}
+}
+
+void CommandList::SetPrimitiveTopology(PrimitiveTopology t)
+{
+	SetPrimitiveTopologyPacket* p = _addPacket<SetPrimitiveTopologyPacket>();
+	if( p )
+	{
+		p->mTopology = t;
+	}
+}
+
+void CommandList::SetInputLayout(ShaderInputLayout& l)
+{
+	SetInputLayoutPacket* p = _addPacket<SetInputLayoutPacket>();
+	if( p )
+	{
+		p->mLayout = l;
+	}
+}
+
+void CommandList::SetVertexBuffer(int streamIndex, VertexBuffer& vb)
+{
+	SetVertexBufferPacket* p = _addPacket<SetVertexBufferPacket>();
+	if( p )
+	{
+		p->mStream = streamIndex;
+		p->mBuffer = vb;
+	}
+}
+
+void CommandList::SetIndexBuffer(IndexBuffer& ib)
+{
+	SetIndexBufferPacket* p = _addPacket<SetIndexBufferPacket>();
+	if( p )
+	{
+		p->mBuffer = ib;
+	}
+}
+
+void CommandList::SetTechnique(EffectTechnique& technique, int pass)
+{
+	SetTechniquePacket* p = _addPacket<SetTechniquePacket>();
+	if( p )
+	{
+		p->mTechnique = technique;
+		p->mPass = pass;
+	}
+}
+
+void CommandList::SetSampler( TextureSampler& s, Texture2D& t )
+{
+	SetSamplerPacket* p = _addPacket<SetSamplerPacket>();
+	if( p )
+	{
+		p->mSampler = s;
+		p->mTexture = t;
+	}
+}
+
+void CommandList::SetConstant( VectorConstant& c, const float* v )
+{
+	SetVectorConstantPacket* p = _addPacket<SetVectorConstantPacket>();
+	if( p )
+	{
+		p->mConstant = c;
+		memcpy( p->mValue, v, sizeof(p->mValue) );
+	}
+}
+
+void CommandList::SetConstant( MatrixConstant& c, const float* m )
+{
+	SetMatrixConstantPacket* p = _addPacket<SetMatrixConstantPacket>();
+	if( p )
+	{
+		p->mConstant = c;
+		memcpy( p->mValue, m, sizeof(p->mValue) );
+	}
+}
+
+void CommandList::SetConstants( ConstantBlock& c, const void* data, unsigned int size )
+{
+	SetConstantsPacket* p = _addPacket<SetConstantsPacket>( size );
+	if( p )
+	{
+		p->mBlock = c;
+		p->mSize = size;
+		memcpy( _getPayload(p), data, size );
+	}
+}
+
+void CommandList::DrawIndexed(DrawIndexedParameters& params)
+{
+	DrawIndexedPacket* p = _addPacket<DrawIndexedPacket>();
+	if( p )
+	{
+		p->mParams = params;
+	}
+}
+
+bool CommandList::ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil )
+{
+	if( !rt.IsValid() )
+	{
+		return false;
+	}
+
+	ClearDepthPacket* p = _addPacket<ClearDepthPacket>();
+	if( p )
+	{
+		p->mTarget = rt;
+		p->mDepth = depth;
+		p->mStencil = stencil;
+	}
+	return p != NULL;
+}
+
+bool CommandList::ClearTarget( const Rendertarget& rt, float clearColour[4] )
+{
+	if( !rt.IsValid() )
+	{
+		return false;
+	}
+
+	ClearColourPacket* p = _addPacket<ClearColourPacket>();
+	if( p )
+	{
+		p->mTarget = rt;
+		memcpy( p->mColour, clearColour, sizeof(p->mColour) );
+	}
+	return p != NULL;
+}
+
+Rendertarget CommandList::CreateRendertarget( const Rendertarget::Parameters params )
+{
+	return mTarget->CreateRendertarget( params );
+}
+
+void CommandList::Release( Rendertarget& r )
+{
+	_addRelease<ReleaseRendertargetPacket>( r );
+}
+
+DepthStencilBuffer CommandList::CreateDepthStencil( const DepthStencilBuffer::Parameters& params )
+{
+	return mTarget->CreateDepthStencil( params );
+}
+
+void CommandList::Release( DepthStencilBuffer& d )
+{
+	_addRelease<ReleaseDepthStencilPacket>( d );
+}
+
+LockedTexture2D CommandList::LockTexture(Texture2D& t, Texture2D::CPUAccess access)
+{
+	return mTarget->LockTexture( t, access );
+}
+
+void CommandList::UnlockTexture(LockedTexture2D& t)
+{
+	mTarget->UnlockTexture( t );
+}
+
+void* CommandList::MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait)
+{
+	return mTarget->MapStagingTexture( t, rowPitch, wait );
+}
+
+void CommandList::UnmapStagingTexture(Texture2D& t)
+{
+	mTarget->UnmapStagingTexture( t );
+}
+
+void CommandList::CopyTextureToTexture(Texture2D& src, Texture2D& dst)
+{
+	CopyTexturePacket* p = _addPacket<CopyTexturePacket>();
+	if( p )
+	{
+		p->mSrc = src;
+		p->mDst = dst;
+	}
+}
+
+bool CommandList::SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type)
+{
+	return mTarget->SaveTextureToFile( t, fileName, type );
+}
+
+void* CommandList::LockVB(VertexBuffer& vb)
+{
+	WriteVBPacket* p = _addPacket<WriteVBPacket>( vb.GetByteSize() );
+	if( p == NULL )
+	{
+		return NULL;
+	}
+
+	p->mBuffer = vb;
+	p->mByteCount = (unsigned int)vb.GetByteSize();
+	return _getPayload(p);
+}
+
+void CommandList::UnlockVB(VertexBuffer& vb)
+{
+	// the data is already in the list
+}
+
+void CommandList::UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	UpdateVBPacket* p = _addPacket<UpdateVBPacket>( byteCount );
+	if( p )
+	{
+		p->mBuffer = vb;
+		p->mByteOffset = byteOffset;
+		p->mByteCount = byteCount;
+		memcpy( _getPayload(p), data, byteCount );
+	}
+}
+
+void* CommandList::LockIB(IndexBuffer& ib)
+{
+	WriteIBPacket* p = _addPacket<WriteIBPacket>( ib.GetByteSize() );
+	if( p == NULL )
+	{
+		return NULL;
+	}
+
+	p->mBuffer = ib;
+	p->mByteCount = (unsigned int)ib.GetByteSize();
+	return _getPayload(p);
+}
+
+void CommandList::UnlockIB(IndexBuffer& ib)
+{
+}
+
+void CommandList::UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	UpdateIBPacket* p = _addPacket<UpdateIBPacket>( byteCount );
+	if( p )
+	{
+		p->mBuffer = ib;
+		p->mByteOffset = byteOffset;
+		p->mByteCount = byteCount;
+		memcpy( _getPayload(p), data, byteCount );
+	}
+}
+
+Texture2D CommandList::CreateTexture( Texture2D::Parameters params )
+{
+	return mTarget->CreateTexture( params );
+}
+
+Texture2D CommandList::LoadTextureFromFile( const char* fileName )
+{
+	return mTarget->LoadTextureFromFile( fileName );
+}
+
+void CommandList::Release( Texture2D& t )
+{
+	_addRelease<ReleaseTexturePacket>( t );
+}
+
+VertexBuffer CommandList::CreateVB( VertexBuffer::Parameters params )
+{
+	return mTarget->CreateVB( params );
+}
+
+void CommandList::Release(VertexBuffer& vb)
+{
+	_addRelease<ReleaseVBPacket>( vb );
+}
+
+IndexBuffer CommandList::CreateIB( IndexBuffer::Parameters params )
+{
+	return mTarget->CreateIB( params );
+}
+
+void CommandList::Release(IndexBuffer& ib)
+{
+	_addRelease<ReleaseIBPacket>( ib );
+}
+
+ShaderInputLayout CommandList::CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd )
+{
+	return mTarget->CreateVertexInputLayout( effect, vd );
+}
+
+void CommandList::Release(ShaderInputLayout& l)
+{
+	_addRelease<ReleaseInputLayoutPacket>( l );
+}
+
+Effect CommandList::CreateEffect(Effect::Parameters params)
+{
+	return mTarget->CreateEffect( params );
+}
+
+void CommandList::Release(Effect& e)
+{
+	_addRelease<ReleaseEffectPacket>( e );
+}
+
+EffectTechnique CommandList::GetTechnique( Effect& e, const char* name )
+{
+	return mTarget->GetTechnique( e, name );
+}
+
+TextureSampler CommandList::GetSampler( Effect& e, const char* name )
+{
+	return mTarget->GetSampler( e, name );
+}
+
+VectorConstant CommandList::GetVectorConstant( Effect& e, const char* name )
+{
+	return mTarget->GetVectorConstant( e, name );
+}
+
+MatrixConstant CommandList::GetMatrixConstant( Effect& e, const char* name )
+{
+	return mTarget->GetMatrixConstant( e, name );
+}
+
+ConstantBlock CommandList::GetConstantBlock( Effect& e, const char* name )
+{
+	return mTarget->GetConstantBlock( e, name );
+}
+
+Font CommandList::CreateFont(Font::Parameters params)
+{
+	return mTarget->CreateFont( params );
+}
+
+void CommandList::Release(Font &f)
+{
+	_addRelease<ReleaseFontPacket>( f );
+}
+
+void CommandList::DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize)
+{
+	const size_t length = strlen( text ) + 1;
+	DrawTextPacket* packet = _addPacket<DrawTextPacket>( length );
+	if( packet )
+	{
+		packet->mFont = f;
+		packet->mParams = p;
+		packet->mPosition = position;
+		packet->mRectSize = rectSize;
+		memcpy( _getPayload(packet), text, length );
+	}
+}
+
+void CommandList::AddCallback( Callback fn, void* userData )
+{
+	CallbackPacket* p = _addPacket<CallbackPacket>();
+	if( p )
+	{
+		p->mFunction = fn;
+		p->mUserData = userData;
+	}
+}
\ No newline at end of file
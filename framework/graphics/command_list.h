@@ -0,0 +1,159 @@
+#ifndef COMMAND_LIST_INCLUDED
+#define COMMAND_LIST_INCLUDED
+
+#include "idevice.h"
+#include "core\linear_allocator.h"
+#include <vector>
+#include <new>
+
+// Records device calls as compact packets, to be replayed later (usually by a CommandSubmitter).
+// State, draw, clear, copy, buffer writes and releases are deferred, so a resource can be
+// released while earlier lists that use it are still waiting to execute. Anything that has to
+// hand back a result (resource creation, texture locks, back buffer queries, saving) goes
+// straight to the target device. Creation is fine while other lists execute, as the device is
+// created free threaded, but only lock or save resources once the lists writing them have executed.
+// Lists are not thread safe, each recording thread needs its own.
+class CommandList : public IDevice
+{
+public:
+	CommandList();
+	~CommandList();
+
+	bool Create( IDevice* target, size_t blockSize = 1024 * 1024 );
+	void Release();
+
+	// throws away the recorded commands, the memory is kept for the next frame
+	void Reset();
+
+	// replays everything in recorded order. Wrap the target in a ShadowedDevice to drop redundant state
+	void Execute( IDevice& d );
+
+	// called on the executing thread, in order with the rest of the list
+	typedef void (*Callback)( IDevice& d, void* userData );
+	void AddCallback( Callback fn, void* userData );
+
+	inline int GetCommandCount() const
+	{
+		return mCommandCount;
+	}
+
+	// IDevice
+	void Flush();
+	void ResetShaderState();
+
+	Rendertarget& GetBackBuffer();
+	Texture2D GetBackBufferTexture();
+	DepthStencilBuffer& GetDepthStencilBuffer();
+
+	void PresentBackbuffer();
+
+	void SetViewport( Viewport& vp );
+	void SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget );
+	void SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget );
+	void SetPrimitiveTopology(PrimitiveTopology t);
+	void SetInputLayout(ShaderInputLayout& l);
+	void SetVertexBuffer(int streamIndex, VertexBuffer& vb);
+	void SetIndexBuffer(IndexBuffer& ib);
+	void SetTechnique(EffectTechnique& technique, int pass);
+	void SetSampler( TextureSampler& s, Texture2D& t );
+	void SetConstant( VectorConstant& c, const float* v );
+	void SetConstant( MatrixConstant& c, const float* m );
+	void SetConstants( ConstantBlock& c, const void* data, unsigned int size );
+
+	void DrawIndexed(DrawIndexedParameters& params);
+	bool ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil );
+	bool ClearTarget( const Rendertarget& rt, float clearColour[4] );
+
+	Rendertarget CreateRendertarget( const Rendertarget::Parameters params );
+	void Release( Rendertarget& r );
+
+	DepthStencilBuffer CreateDepthStencil( const DepthStencilBuffer::Parameters& params );
+	void Release( DepthStencilBuffer& d );
+
+	LockedTexture2D LockTexture(Texture2D& t, Texture2D::CPUAccess);
+	void UnlockTexture(LockedTexture2D& t);
+	void* MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait);
+	void UnmapStagingTexture(Texture2D& t);
+	void CopyTextureToTexture(Texture2D& src, Texture2D& dst);
+	bool SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type);
+
+	// locks hand back list memory, the whole buffer is written (discard) when the list executes
+	void* LockVB(VertexBuffer& vb);
+	void UnlockVB(VertexBuffer& vb);
+	void UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount);
+
+	void* LockIB(IndexBuffer& ib);
+	void UnlockIB(IndexBuffer& ib);
+	void UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount);
+
+	Texture2D CreateTexture( Texture2D::Parameters params );
+	Texture2D LoadTextureFromFile( const char* fileName );
+	void Release( Texture2D& t );
+
+	VertexBuffer CreateVB( VertexBuffer::Parameters params );
+	void Release(VertexBuffer& vb);
+
+	IndexBuffer CreateIB( IndexBuffer::Parameters params );
+	void Release(IndexBuffer& ib);
+
+	ShaderInputLayout CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd );
+	void Release(ShaderInputLayout& l);
+
+	Effect CreateEffect(Effect::Parameters params);
+	void Release(Effect& e);
+	EffectTechnique GetTechnique( Effect& e, const char* name );
+	TextureSampler GetSampler( Effect& e, const char* name );
+	VectorConstant GetVectorConstant( Effect& e, const char* name );
+	MatrixConstant GetMatrixConstant( Effect& e, const char* name );
+	ConstantBlock GetConstantBlock( Effect& e, const char* name );
+
+	Font CreateFont(Font::Parameters params);
+	void Release(Font &f);
+	void DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize = Vector2(0,0));
+
+private:
+	CommandList( const CommandList& );
+	CommandList& operator=( const CommandList& );
+
+	static const size_t kPacketAlign = 16;
+
+	struct PacketHeader
+	{
+		unsigned int mType;
+		unsigned int mSize;		// including the header and any payload
+	};
+
+	void* _allocPacket( unsigned int type, size_t size, size_t payloadSize = 0 );
+
+	template<class PacketType>
+	inline PacketType* _addPacket( size_t payloadSize = 0 )
+	{
+		void* mem = _allocPacket( PacketType::kType, sizeof(PacketType), payloadSize );
+		return mem ? new(mem) PacketType : NULL;
+	}
+
+	template<class PacketType, class ResourceType>
+	inline void _addRelease( ResourceType& r )
+	{
+		PacketType* p = _addPacket<PacketType>();
+		if( p )
+		{
+			p->mResource = r;
+		}
+		r.Invalidate();
+	}
+
+	template<class PacketType>
+	static inline void* _getPayload( PacketType* p )
+	{
+		return (void*)((size_t)p + ALIGN_UP(sizeof(PacketType), kPacketAlign));
+	}
+
+	IDevice* mTarget;
+	std::vector<LinearAllocator*> mBlocks;
+	int mCurrentBlock;
+	size_t mBlockSize;
+	int mCommandCount;
+};
+
+#endif
\ No newline at end of file
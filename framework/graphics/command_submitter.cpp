@@ -0,0 +1,166 @@
+#include "command_submitter.h"
+#include "command_list.h"
+#include "core\thread.h"
+#include <stdio.h>
+
+class CommandSubmitterThread : public Thread
+{
+public:
+	CommandSubmitterThread( CommandSubmitter* owner )
+		: mOwner(owner)
+	{
+	}
+
+protected:
+	virtual bool threadFunc()
+	{
+		while( mOwner->_executeNext() )
+		{
+		}
+
+		return true;
+	}
+
+private:
+	CommandSubmitter* mOwner;
+};
+
+CommandSubmitter::CommandSubmitter()
+	: mTarget(NULL)
+	, mThread(NULL)
+	, mExecuted(true, false)
+	, mSubmitted(0)
+	, mCompleted(0)
+	, mQuit(false)
+{
+}
+
+CommandSubmitter::~CommandSubmitter()
+{
+	Release();
+}
+
+bool CommandSubmitter::Initialise( IDevice* target )
+{
+	mTarget = target;
+	mQuit = false;
+
+	mThread = new CommandSubmitterThread( this );
+	if( !mThread->run() )
+	{
+		// lists will be executed on the submitting thread instead
+		printf("Failed to start the command submission thread\n");
+		delete mThread;
+		mThread = NULL;
+	}
+
+	return true;
+}
+
+void CommandSubmitter::Release()
+{
+	if( mThread )
+	{
+		mQuit = true;
+		mWake.Signal();
+		mThread->waitUntilComplete();
+		delete mThread;
+		mThread = NULL;
+	}
+
+	// the counters are kept, so fences handed out before this still read as complete
+	mQueue.clear();
+	mCompleted = mSubmitted;
+	mTarget = NULL;
+}
+
+unsigned int CommandSubmitter::Submit( CommandList* list )
+{
+	return Submit( &list, 1 );
+}
+
+unsigned int CommandSubmitter::Submit( CommandList** lists, int count )
+{
+	if( mThread == NULL )
+	{
+		for( int i = 0; i < count; ++i )
+		{
+			lists[i]->Execute( *mTarget );
+		}
+		mSubmitted += count;
+		mCompleted = mSubmitted;
+		return mSubmitted;
+	}
+
+	unsigned int fence = 0;
+	{
+		ScopedLock lock( mLock );
+		mQueue.insert( mQueue.end(), lists, lists + count );
+		mSubmitted += count;
+		fence = mSubmitted;
+	}
+	mWake.Signal( count );
+
+	return fence;
+}
+
+bool CommandSubmitter::IsComplete( unsigned int fence )
+{
+	ScopedLock lock( mLock );
+	return mCompleted >= fence;
+}
+
+void CommandSubmitter::WaitFor( unsigned int fence )
+{
+	for(;;)
+	{
+		{
+			ScopedLock lock( mLock );
+			if( mCompleted >= fence )
+			{
+				return;
+			}
+
+			// only set again once the submission thread finishes another list
+			mExecuted.Reset();
+		}
+		mExecuted.Wait();
+	}
+}
+
+void CommandSubmitter::WaitForIdle()
+{
+	unsigned int fence = 0;
+	{
+		ScopedLock lock( mLock );
+		fence = mSubmitted;
+	}
+	WaitFor( fence );
+}
+
+bool CommandSubmitter::_executeNext()
+{
+	mWake.Wait();
+
+	CommandList* list = NULL;
+	{
+		ScopedLock lock( mLock );
+		if( mQueue.empty() )
+		{
+			// woken with nothing queued, only happens on shutdown
+			return !mQuit;
+		}
+		list = mQueue.front();
+		mQueue.erase( mQueue.begin() );
+	}
+
+	list->Execute( *mTarget );
+
+	{
+		ScopedLock lock( mLock );
+		++mCompleted;
+		mExecuted.Signal();
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef COMMAND_SUBMITTER_INCLUDED
+#define COMMAND_SUBMITTER_INCLUDED
+
+#include "core\critical_section.h"
+#include <vector>
+
+class IDevice;
+class CommandList;
+class CommandSubmitterThread;
+
+// Owns the thread that talks to the device. Command lists recorded on any thread are
+// submitted here and executed in submission order.
+// Every submission returns a fence, which is complete once that list (and everything
+// submitted before it) has executed. Fence 0 is always complete.
+class CommandSubmitter
+{
+friend class CommandSubmitterThread;
+public:
+	CommandSubmitter();
+	~CommandSubmitter();
+
+	bool Initialise( IDevice* target );
+	void Release();		// executes anything still queued first
+
+	// the list must not be touched again until its fence is complete
+	unsigned int Submit( CommandList* list );
+
+	// queued together, so they execute back to back in the order given
+	unsigned int Submit( CommandList** lists, int count );
+
+	bool IsComplete( unsigned int fence );
+	void WaitFor( unsigned int fence );
+
+	// blocks until every submitted list has executed
+	void WaitForIdle();
+
+private:
+	CommandSubmitter( const CommandSubmitter& );
+	CommandSubmitter& operator=( const CommandSubmitter& );
+
+	bool _executeNext();	// returns false when it is time to quit
+
+	IDevice* mTarget;
+	CommandSubmitterThread* mThread;
+
+	CriticalSection mLock;
+	Semaphore mWake;
+	Event mExecuted;		// signalled each time a list finishes
+	std::vector<CommandList*> mQueue;
+	unsigned int mSubmitted;	// fence of the last submitted list
+	unsigned int mCompleted;	// fence of the last executed list
+	volatile bool mQuit;
+};
+
+#endif
\ No newline at end of file
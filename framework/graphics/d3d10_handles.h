@@ -0,0 +1,31 @@
+#ifndef D3D10_HANDLES_INCLUDED
+#define D3D10_HANDLES_INCLUDED
+
+#include <D3D10.h>
+#include <D3DX10.h>
+#include "device_handles.h"
+
+// What the D3D10 device's handles really point at
+// Only the D3D10 device includes this, nothing else should know
+#define D3D10_HANDLE( HandleType, D3DType )										\
+	inline D3DType* AsD3D( HandleType h ) { return (D3DType*)h; }				\
+	inline HandleType AsHandle( D3DType* p ) { return (HandleType)p; }
+
+D3D10_HANDLE( TextureHandle, ID3D10Texture2D )
+D3D10_HANDLE( ShaderResourceHandle, ID3D10ShaderResourceView )
+D3D10_HANDLE( RendertargetHandle, ID3D10RenderTargetView )
+D3D10_HANDLE( DepthStencilHandle, ID3D10DepthStencilView )
+D3D10_HANDLE( BufferHandle, ID3D10Buffer )
+D3D10_HANDLE( InputLayoutHandle, ID3D10InputLayout )
+D3D10_HANDLE( EffectHandle, ID3D10Effect )
+D3D10_HANDLE( TechniqueHandle, ID3D10EffectTechnique )
+D3D10_HANDLE( SamplerHandle, ID3D10EffectShaderResourceVariable )
+D3D10_HANDLE( VectorVariableHandle, ID3D10EffectVectorVariable )
+D3D10_HANDLE( MatrixVariableHandle, ID3D10EffectMatrixVariable )
+D3D10_HANDLE( ConstantBufferHandle, ID3D10EffectConstantBuffer )
+D3D10_HANDLE( FontHandle, ID3DX10Font )
+D3D10_HANDLE( FontSpritesHandle, ID3DX10Sprite )
+
+#undef D3D10_HANDLE
+
+#endif
\ No newline at end of file
@@ -16,6 +16,7 @@ public:
 		, m_bpp(bpp)
 		, m_fullscreen(fullscreen)
 		, m_windowTitle(windowTitle)
+		, m_headless(false)
 		, m_app(NULL)
 		, m_hInst(hInst)
 	{
@@ -26,6 +27,7 @@ public:
 		, m_windowHeight(480)
 		, m_bpp(32)
 		, m_fullscreen(false)
+		, m_headless(false)
 		, m_app(NULL)
 	{
 	}
@@ -35,6 +37,7 @@ public:
 	int m_bpp;
 	bool m_fullscreen;
 	std::string m_windowTitle;
+	bool m_headless;	// the window still opens for input, but nothing is drawn and no gpu is used
 	HINSTANCE m_hInst;
 	D3DApp* m_app;
 };
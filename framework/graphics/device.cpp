@@ -1,6 +1,38 @@
 #include "device.h"
+#include "d3d10_handles.h"
 #include "core\strings.h"
 
+// device_types.h doesn't include D3D, its enums are written out by hand and passed straight through
+C_ASSERT( PRIMITIVE_POINTS == D3D10_PRIMITIVE_TOPOLOGY_POINTLIST );
+C_ASSERT( PRIMITIVE_LINES == D3D10_PRIMITIVE_TOPOLOGY_LINELIST );
+C_ASSERT( PRIMITIVE_LINESTRIP == D3D10_PRIMITIVE_TOPOLOGY_LINESTRIP );
+C_ASSERT( PRIMITIVE_TRIANGLES == D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+C_ASSERT( PRIMITIVE_TRIANGLESTRIP == D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP );
+C_ASSERT( Font::DRAW_LEFT == DT_LEFT );
+C_ASSERT( Font::DRAW_RIGHT == DT_RIGHT );
+C_ASSERT( Font::DRAW_CENTER == DT_CENTER );
+C_ASSERT( IndexBuffer::CpuWrite == D3D10_MAP_WRITE_DISCARD );
+C_ASSERT( VertexBuffer::CpuWrite == D3D10_MAP_WRITE_DISCARD );
+C_ASSERT( IndexBuffer::IB_16BIT == DXGI_FORMAT_R16_UINT );
+C_ASSERT( IndexBuffer::IB_32BIT == DXGI_FORMAT_R32_UINT );
+C_ASSERT( Texture2D::TypeFloat32 == DXGI_FORMAT_R32G32B32A32_FLOAT );
+C_ASSERT( Texture2D::TypeFloat16 == DXGI_FORMAT_R16G16B16A16_FLOAT );
+C_ASSERT( Texture2D::TypeDepthStencil32 == DXGI_FORMAT_D32_FLOAT );
+C_ASSERT( Texture2D::TypeInt8UnNormalised == DXGI_FORMAT_R8G8B8A8_UNORM );
+C_ASSERT( Texture2D::CpuRead == D3D10_MAP_READ );
+C_ASSERT( Texture2D::CpuWrite == D3D10_MAP_WRITE );
+C_ASSERT( Texture2D::CpuReadWrite == D3D10_MAP_READ_WRITE );
+C_ASSERT( VertexElement::VTX_FLOAT2 == DXGI_FORMAT_R32G32_FLOAT );
+C_ASSERT( VertexElement::VTX_FLOAT3 == DXGI_FORMAT_R32G32B32_FLOAT );
+C_ASSERT( VertexElement::VTX_FLOAT4 == DXGI_FORMAT_R32G32B32A32_FLOAT );
+C_ASSERT( VertexElement::PerVertex == D3D10_INPUT_PER_VERTEX_DATA );
+C_ASSERT( VertexElement::PerInstance == D3D10_INPUT_PER_INSTANCE_DATA );
+C_ASSERT( IDevice::TextureTypeBMP == D3DX10_IFF_BMP );
+C_ASSERT( IDevice::TextureTypeJPG == D3DX10_IFF_JPG );
+C_ASSERT( IDevice::TextureTypePNG == D3DX10_IFF_PNG );
+C_ASSERT( IDevice::TextureTypeDDS == D3DX10_IFF_DDS );
+C_ASSERT( IDevice::kMaxRenderTargets == D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT );
+
 HWND Device::s_appWindow = 0;
 
 Device::Device()
@@ -16,10 +48,58 @@ Device::~Device()
 
 void Device::SetTechnique(EffectTechnique& t, int pass)
 {
-	ID3D10EffectTechnique* technique = t.m_technique;
+	ID3D10EffectTechnique* technique = AsD3D( t.m_technique );
 	technique->GetPassByIndex( pass )->Apply( 0 );
 }
 
+void Device::SetSampler( TextureSampler& s, Texture2D& t )
+{
+	if( s.IsValid() && t.IsValid() )
+	{
+		HRESULT hr = AsD3D( s.m_sampler )->SetResource( AsD3D( t.m_shaderResource ) );
+		if( FAILED(hr) )
+		{
+			printf("Failed to set shader sampler\n");
+		}
+	}
+}
+
+void Device::SetConstant( VectorConstant& c, const float* v )
+{
+	if( c.IsValid() )
+	{
+		AsD3D( c.m_variable )->SetFloatVector( (float*)v );
+	}
+}
+
+void Device::SetConstant( MatrixConstant& c, const float* m )
+{
+	if( c.IsValid() )
+	{
+		AsD3D( c.m_variable )->SetMatrix( (float*)m );
+	}
+}
+
+void Device::SetConstants( ConstantBlock& c, const void* data, unsigned int size )
+{
+	if( c.m_buffer == NULL )
+	{
+		return;
+	}
+
+	if( size > c.m_size )
+	{
+		printf("Constant block is %d bytes, tried to write %d\n", c.m_size, size);
+		return;
+	}
+
+	HRESULT hr = AsD3D( c.m_buffer )->SetRawValue( (void*)data, 0, size );
+	if( FAILED(hr) )
+	{
+		printf("Failed to write constant block\n");
+	}
+}
+
 void Device::DrawIndexed(DrawIndexedParameters& params)
 {
 	m_d3dDevice->DrawIndexed( params.m_indexCount, params.m_startIndex, 0 );
@@ -28,18 +108,19 @@ void Device::DrawIndexed(DrawIndexedParameters& params)
 void Device::SetInputLayout(ShaderInputLayout& l)
 {
 	// set the vertex shader input layout
-	m_d3dDevice->IASetInputLayout( l.m_layout );
+	m_d3dDevice->IASetInputLayout( AsD3D( l.m_layout ) );
 }
 
 void Device::SetVertexBuffer(int streamIndex, VertexBuffer& vb)
 {
 	unsigned int vbOffset = 0;
-	m_d3dDevice->IASetVertexBuffers( streamIndex, 1, &vb.m_buffer, &vb.vertexStride, &vbOffset );
+	ID3D10Buffer* buffer = AsD3D( vb.m_buffer );
+	m_d3dDevice->IASetVertexBuffers( streamIndex, 1, &buffer, &vb.vertexStride, &vbOffset );
 }
 
 void Device::SetIndexBuffer(IndexBuffer& ib)
 {
-	m_d3dDevice->IASetIndexBuffer( ib.m_buffer, (DXGI_FORMAT)ib.m_format, 0 );
+	m_d3dDevice->IASetIndexBuffer( AsD3D( ib.m_buffer ), (DXGI_FORMAT)ib.m_format, 0 );
 }
 
 void Device::SetPrimitiveTopology(PrimitiveTopology t)
@@ -64,7 +145,7 @@ bool Device::ClearTarget( const Rendertarget& rt, float clearColour[4] )
 {
 	if( rt.IsValid() )
 	{
-		m_d3dDevice->ClearRenderTargetView( rt.m_rendertarget, clearColour );
+		m_d3dDevice->ClearRenderTargetView( AsD3D( rt.m_rendertarget ), clearColour );
 		return true;
 	}
 
@@ -75,7 +156,7 @@ bool Device::ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned in
 {
 	if( rt.IsValid() )
 	{
-		m_d3dDevice->ClearDepthStencilView( rt.m_renderTarget, D3D10_CLEAR_DEPTH, depth, stencil );
+		m_d3dDevice->ClearDepthStencilView( AsD3D( rt.m_renderTarget ), D3D10_CLEAR_DEPTH, depth, stencil );
 		return true;
 	}
 
@@ -84,15 +165,28 @@ bool Device::ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned in
 
 void Device::SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget )
 {
-	ID3D10RenderTargetView* c = colourTarget!=NULL ? colourTarget->m_rendertarget : NULL;
-	ID3D10DepthStencilView* d = depthStencilTarget!=NULL ? depthStencilTarget->m_renderTarget : NULL;
+	ID3D10RenderTargetView* c = colourTarget!=NULL ? AsD3D( colourTarget->m_rendertarget ) : NULL;
+	ID3D10DepthStencilView* d = depthStencilTarget!=NULL ? AsD3D( depthStencilTarget->m_renderTarget ) : NULL;
 
 	m_d3dDevice->OMSetRenderTargets(1, &c, d);
 }
 
+void Device::SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget )
+{
+	ID3D10RenderTargetView* c[D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT] = {NULL};
+	targetCount = targetCount < D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT ? targetCount : D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT;
+	for( int i = 0; i < targetCount; ++i )
+	{
+		c[i] = colourTargets[i]!=NULL ? AsD3D( colourTargets[i]->m_rendertarget ) : NULL;
+	}
+	ID3D10DepthStencilView* d = depthStencilTarget!=NULL ? AsD3D( depthStencilTarget->m_renderTarget ) : NULL;
+
+	m_d3dDevice->OMSetRenderTargets(targetCount, c, d);
+}
+
 bool Device::SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type)
 {
-	HRESULT hr = D3DX10SaveTextureToFileA( t.m_texture, (D3DX10_IMAGE_FILE_FORMAT)type, fileName );
+	HRESULT hr = D3DX10SaveTextureToFileA( AsD3D( t.m_texture ), (D3DX10_IMAGE_FILE_FORMAT)type, fileName );
 
 	return !FAILED(hr);
 }
@@ -102,7 +196,7 @@ void* Device::LockIB(IndexBuffer& ib)
 	void* buffer = NULL;
 	if( ib.IsValid() )
 	{
-		HRESULT hr = ib.m_buffer->Map( (D3D10_MAP)ib.m_lockType, 0, &buffer );
+		HRESULT hr = AsD3D( ib.m_buffer )->Map( (D3D10_MAP)ib.m_lockType, 0, &buffer );
 		if(FAILED(hr))
 		{
 			return NULL;
@@ -116,7 +210,22 @@ void Device::UnlockIB(IndexBuffer& ib)
 {
 	if( ib.IsValid() )
 	{
-		ib.m_buffer->Unmap();	
+		AsD3D( ib.m_buffer )->Unmap();	
+	}
+}
+
+void Device::UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	if( ib.IsValid() && byteCount > 0 )
+	{
+		D3D10_BOX box;
+		box.left = byteOffset;
+		box.right = byteOffset + byteCount;
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		m_d3dDevice->UpdateSubresource( AsD3D( ib.m_buffer ), 0, &box, data, 0, 0 );
 	}
 }
 
@@ -125,7 +234,7 @@ void* Device::LockVB(VertexBuffer& vb)
 	void* buffer = NULL;
 	if( vb.IsValid() )
 	{
-		HRESULT hr = vb.m_buffer->Map( (D3D10_MAP)vb.m_lockType, 0, &buffer );
+		HRESULT hr = AsD3D( vb.m_buffer )->Map( (D3D10_MAP)vb.m_lockType, 0, &buffer );
 		if(FAILED(hr))
 		{
 			return NULL;
@@ -139,13 +248,29 @@ void Device::UnlockVB(VertexBuffer& vb)
 {
 	if( vb.IsValid() )
 	{
-		vb.m_buffer->Unmap();	
+		AsD3D( vb.m_buffer )->Unmap();	
+	}
+}
+
+void Device::UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	if( vb.IsValid() && byteCount > 0 )
+	{
+		// only the given range is copied, the rest of the buffer is untouched
+		D3D10_BOX box;
+		box.left = byteOffset;
+		box.right = byteOffset + byteCount;
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		m_d3dDevice->UpdateSubresource( AsD3D( vb.m_buffer ), 0, &box, data, 0, 0 );
 	}
 }
 
 void Device::PresentBackbuffer()
 {
-	m_swapChain->Present( 0, 0 );
+	if( m_swapChain ) m_swapChain->Present( 0, 0 );
 }
 
 void Device::ResetShaderState()
@@ -165,6 +290,7 @@ bool Device::Shutdown()
 
 	Release(m_mainDepthStencil);
 	Release(m_backBufferRT);
+	Release(m_nullDriverBackBuffer);
 
     if( m_swapChain ) m_swapChain->Release();
     if( m_d3dDevice ) m_d3dDevice->Release();
@@ -187,6 +313,18 @@ DepthStencilBuffer& Device::GetDepthStencilBuffer()
 
 bool Device::Initialise(InitParameters& params)
 {
+	if( params.nullDriver )
+	{
+		if( !initNullDriver(params) )
+		{
+			Shutdown();
+			return false;
+		}
+
+		m_params = params;
+		return true;
+	}
+
 	if(!initDriver(params))
 	{
 		Shutdown();
@@ -214,7 +352,7 @@ bool Device::createRenderBuffers(InitParameters& params)
 
 	// Wrap it in our texture
 	Texture2D backBufferSurface;
-	backBufferSurface.m_texture = pBuffer;
+	backBufferSurface.m_texture = AsHandle( pBuffer );
 
 	// Create the target
 	Rendertarget::Parameters rtParams;
@@ -240,6 +378,18 @@ Texture2D Device::GetBackBufferTexture()
 {
 	Texture2D result;
 
+	if( m_swapChain == NULL )
+	{
+		// match the swap chain behaviour, the caller gets its own reference
+		if( m_nullDriverBackBuffer.IsValid() )
+		{
+			AsD3D( m_nullDriverBackBuffer.m_texture )->AddRef();
+			result.m_texture = m_nullDriverBackBuffer.m_texture;
+			result.m_params = m_nullDriverBackBuffer.m_params;
+		}
+		return result;
+	}
+
 	// get the render target surface
 	ID3D10Texture2D* pBuffer;
     HRESULT hr = m_swapChain->GetBuffer( 0, __uuidof( ID3D10Texture2D ), ( LPVOID* )&pBuffer );
@@ -247,7 +397,7 @@ Texture2D Device::GetBackBufferTexture()
         return result;
 
 	// Wrap it in our texture
-	result.m_texture = pBuffer;
+	result.m_texture = AsHandle( pBuffer );
 	result.m_params.access = Texture2D::CpuNoAccess;
 	result.m_params.bindFlags = 0;
 	result.m_params.format = Texture2D::TypeInt8UnNormalised;
@@ -311,6 +461,54 @@ bool Device::initDriver(InitParameters& params)
 	return true;
 }
 
+bool Device::initNullDriver(InitParameters& params)
+{
+	UINT createDeviceFlags = 0;
+	if( params.enableDebugD3d )
+	{
+		createDeviceFlags |= D3D10_CREATE_DEVICE_DEBUG;
+	}
+
+	// the null driver creates resources and validates calls, but never rasterises
+	m_driverType = D3D10_DRIVER_TYPE_NULL;
+	HRESULT hr = D3D10CreateDevice( NULL, m_driverType, NULL, createDeviceFlags, D3D10_SDK_VERSION, &m_d3dDevice );
+	if( FAILED( hr ) )
+	{
+		printf("Failed to create the null driver device (0x%x)\n", hr);
+		return false;
+	}
+
+	// offscreen surface standing in for the swap chain
+	Texture2D::Parameters tp;
+	tp.width = params.windowWidth;
+	tp.height = params.windowHeight;
+	tp.format = Texture2D::TypeInt8UnNormalised;
+	tp.msaaCount = params.msaaCount;
+	tp.msaaQuality = params.msaaQuality;
+	tp.numMips = 1;
+	tp.access = Texture2D::CpuNoAccess;
+	tp.bindFlags = Texture2D::BindAsRenderTarget;
+	m_nullDriverBackBuffer = CreateTexture( tp );
+	if( !m_nullDriverBackBuffer.IsValid() )
+	{
+		return false;
+	}
+
+	Rendertarget::Parameters rtParams;
+	rtParams.target = m_nullDriverBackBuffer;
+	m_backBufferRT = CreateRendertarget( rtParams );
+
+	DepthStencilBuffer::Parameters depthParams;
+	depthParams.m_width = params.windowWidth;
+	depthParams.m_height = params.windowHeight;
+	depthParams.m_msaaQuality = params.msaaQuality;
+	depthParams.m_msaaCount = params.msaaCount;
+	depthParams.m_format = DepthStencilBuffer::TypeDepthStencil32;
+	m_mainDepthStencil = CreateDepthStencil(depthParams);
+
+	return m_backBufferRT.IsValid() && m_mainDepthStencil.IsValid();
+}
+
 Rendertarget Device::CreateRendertarget( const Rendertarget::Parameters params )
 {
 	// Aim the main target at it
@@ -318,11 +516,11 @@ Rendertarget Device::CreateRendertarget( const Rendertarget::Parameters params )
 	ID3D10RenderTargetView* rtView = NULL;
 	if( params.target.IsValid() )
 	{
-		HRESULT hr = m_d3dDevice->CreateRenderTargetView( params.target.m_texture, NULL, &rtView );
+		HRESULT hr = m_d3dDevice->CreateRenderTargetView( AsD3D( params.target.m_texture ), NULL, &rtView );
     
 		if( !FAILED( hr ) )
 		{
-			rt.m_rendertarget = rtView;
+			rt.m_rendertarget = AsHandle( rtView );
 		}
 	}
 	return rt;
@@ -350,10 +548,10 @@ DepthStencilBuffer Device::CreateDepthStencil( const DepthStencilBuffer::Paramet
     descDSV.ViewDimension = D3D10_DSV_DIMENSION_TEXTURE2D;
     descDSV.Texture2D.MipSlice = 0;
 	ID3D10DepthStencilView* rt = NULL;
-	HRESULT hr = m_d3dDevice->CreateDepthStencilView( resultBuffer.m_surface.m_texture, &descDSV, &rt);
+	HRESULT hr = m_d3dDevice->CreateDepthStencilView( AsD3D( resultBuffer.m_surface.m_texture ), &descDSV, &rt);
     if( !FAILED( hr ) )
 	{
-		resultBuffer.m_renderTarget= rt;
+		resultBuffer.m_renderTarget = AsHandle( rt );
 		resultBuffer.m_params = params;
 	}
 
@@ -370,8 +568,22 @@ Texture2D Device::LoadTextureFromFile( const char* fileName )
 	HRESULT hr = D3DX10CreateShaderResourceViewFromFile( m_d3dDevice, wideName.c_str(), NULL, NULL, &rview, NULL );
     if( !FAILED( hr ) )
 	{
-		resultTexture.m_shaderResource = rview;
-		rview->GetResource( (ID3D10Resource**)&resultTexture.m_texture );
+		ID3D10Texture2D* texture = NULL;
+		rview->GetResource( (ID3D10Resource**)&texture );
+		resultTexture.m_shaderResource = AsHandle( rview );
+		resultTexture.m_texture = AsHandle( texture );
+
+		// fill in the parameters so loaded textures can be sized like created ones
+		D3D10_TEXTURE2D_DESC desc;
+		texture->GetDesc( &desc );
+		resultTexture.m_params.width = desc.Width;
+		resultTexture.m_params.height = desc.Height;
+		resultTexture.m_params.format = (Texture2D::TextureFormat)desc.Format;
+		resultTexture.m_params.msaaCount = desc.SampleDesc.Count;
+		resultTexture.m_params.msaaQuality = desc.SampleDesc.Quality;
+		resultTexture.m_params.numMips = desc.MipLevels;
+		resultTexture.m_params.access = Texture2D::CpuNoAccess;
+		resultTexture.m_params.bindFlags = Texture2D::BindAsShaderResource;
 	}
 
 	return resultTexture;
@@ -381,7 +593,7 @@ void Device::CopyTextureToTexture(Texture2D& src, Texture2D& dst)
 {
 	if( src.IsValid() && dst.IsValid() )
 	{
-		m_d3dDevice->CopyResource(  dst.m_texture, src.m_texture );
+		m_d3dDevice->CopyResource( AsD3D( dst.m_texture ), AsD3D( src.m_texture ) );
 	}
 }
 
@@ -401,13 +613,13 @@ LockedTexture2D Device::LockTexture(Texture2D& t, Texture2D::CPUAccess bindParam
 		result.m_sourceTexture = t;
 
 		// Now, copy the source texture to the staging texture using the GPU
-		m_d3dDevice->CopyResource( result.m_stagingTexture.m_texture, result.m_sourceTexture.m_texture );
+		m_d3dDevice->CopyResource( AsD3D( result.m_stagingTexture.m_texture ), AsD3D( result.m_sourceTexture.m_texture ) );
 
 		// Finally, the staging texture is mapped
 		D3D10_MAPPED_TEXTURE2D mappedTexture;
 		int subResource = D3D10CalcSubresource(0,0,1);	// just map first mip level for now
 
-		HRESULT hr = result.m_stagingTexture.m_texture->Map( subResource, (D3D10_MAP)bindParams, 0, &mappedTexture );
+		HRESULT hr = AsD3D( result.m_stagingTexture.m_texture )->Map( subResource, (D3D10_MAP)bindParams, 0, &mappedTexture );
 		if(!FAILED(hr))
 		{
 			result.m_locked = true;
@@ -423,12 +635,12 @@ void Device::UnlockTexture(LockedTexture2D& t)
 	if( t.m_locked )
 	{
 		unsigned int subResourceId = D3D10CalcSubresource(0,0,1);
-		t.m_stagingTexture.m_texture->Unmap(subResourceId);
+		AsD3D( t.m_stagingTexture.m_texture )->Unmap(subResourceId);
 		t.m_lockedBuffer = NULL;
 		t.m_locked= false;
 
 		// Now, copy the staging texture back to the souyrce texture using the GPU
-		m_d3dDevice->CopyResource( t.m_sourceTexture.m_texture, t.m_stagingTexture.m_texture );
+		m_d3dDevice->CopyResource( AsD3D( t.m_sourceTexture.m_texture ), AsD3D( t.m_stagingTexture.m_texture ) );
 	}	
 
 	// release the staging texture
@@ -438,6 +650,39 @@ void Device::UnlockTexture(LockedTexture2D& t)
 	}
 }
 
+void* Device::MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait)
+{
+	rowPitch = 0;
+	if( !t.IsValid() || !t.m_params.stagingTexture )
+	{
+		return NULL;
+	}
+
+	D3D10_MAPPED_TEXTURE2D mappedTexture;
+	unsigned int subResource = D3D10CalcSubresource(0,0,1);
+	HRESULT hr = AsD3D( t.m_texture )->Map( subResource, D3D10_MAP_READ, wait ? 0 : D3D10_MAP_FLAG_DO_NOT_WAIT, &mappedTexture );
+	if( hr == DXGI_ERROR_WAS_STILL_DRAWING )
+	{
+		return NULL;
+	}
+	if( FAILED(hr) )
+	{
+		printf("Failed to map staging texture\n");
+		return NULL;
+	}
+
+	rowPitch = mappedTexture.RowPitch;
+	return mappedTexture.pData;
+}
+
+void Device::UnmapStagingTexture(Texture2D& t)
+{
+	if( t.IsValid() )
+	{
+		AsD3D( t.m_texture )->Unmap( D3D10CalcSubresource(0,0,1) );
+	}
+}
+
 Texture2D Device::CreateTexture( Texture2D::Parameters params )
 {
 	Texture2D resultTexture;
@@ -491,18 +736,26 @@ Texture2D Device::CreateTexture( Texture2D::Parameters params )
 		descDepth.Usage = D3D10_USAGE_STAGING;
 	}
 
+	D3D10_SUBRESOURCE_DATA initialData;
+	initialData.pSysMem = params.initialData;
+	initialData.SysMemPitch = params.initialRowPitch;
+	initialData.SysMemSlicePitch = 0;
+
 	ID3D10Texture2D* surface = NULL;
-	HRESULT hr = m_d3dDevice->CreateTexture2D( &descDepth, NULL, &surface );
+	HRESULT hr = m_d3dDevice->CreateTexture2D( &descDepth, params.initialData ? &initialData : NULL, &surface );
     if( !FAILED( hr ) )
 	{
-		resultTexture.m_texture = surface;
+		resultTexture.m_texture = AsHandle( surface );
 		resultTexture.m_params = params;
+		resultTexture.m_params.initialData = NULL;	// the caller owns it, don't let copies of the params see it
 	}
 
 	// create a shader resource, if required
 	if( descDepth.BindFlags & D3D10_BIND_SHADER_RESOURCE )
 	{
-		hr = m_d3dDevice->CreateShaderResourceView( surface, NULL, &resultTexture.m_shaderResource );
+		ID3D10ShaderResourceView* view = NULL;
+		hr = m_d3dDevice->CreateShaderResourceView( surface, NULL, &view );
+		resultTexture.m_shaderResource = AsHandle( view );
 	}
 
 	return resultTexture;
@@ -543,7 +796,7 @@ VertexBuffer Device::CreateVB( VertexBuffer::Parameters params )
     HRESULT hr = m_d3dDevice->CreateBuffer( &bd, &InitData, &vb );
     if( !FAILED( hr ) )
 	{
-		result.m_buffer = vb;
+		result.m_buffer = AsHandle( vb );
 		result.vertexCount = params.vertexCount;
 		result.vertexSize = params.vertexSize;
 		result.vertexStride = params.stride;
@@ -589,7 +842,7 @@ IndexBuffer Device::CreateIB( IndexBuffer::Parameters params )
     HRESULT hr = m_d3dDevice->CreateBuffer( &bd, &InitData, &ib );
     if( !FAILED( hr ) )
 	{
-		result.m_buffer = ib;
+		result.m_buffer = AsHandle( ib );
 		result.m_indexCount = params.indexCount;
 		result.m_format = params.format;
 		result.m_lockType = params.access;
@@ -613,7 +866,7 @@ Effect Device::CreateEffect(Effect::Parameters params)
 											 NULL, &e, &compileErrors, NULL );
     if( !FAILED( hr ) )
     {
-		result.m_effect = e;
+		result.m_effect = AsHandle( e );
     }
 	else
 	{
@@ -626,6 +879,87 @@ Effect Device::CreateEffect(Effect::Parameters params)
 	return result;
 }
 
+EffectTechnique Device::GetTechnique( Effect& e, const char* name )
+{
+	EffectTechnique result;
+	if( e.IsValid() )
+	{
+		// missing names come back as an invalid technique rather than NULL
+		ID3D10EffectTechnique* technique = AsD3D( e.m_effect )->GetTechniqueByName( name );
+		D3D10_TECHNIQUE_DESC techDesc;
+		if( technique->IsValid() && !FAILED( technique->GetDesc( &techDesc ) ) )
+		{
+			result.m_technique = AsHandle( technique );
+			result.m_passCount = techDesc.Passes;
+			result.m_parent = &e;
+		}
+	}
+
+	return result;
+}
+
+TextureSampler Device::GetSampler( Effect& e, const char* name )
+{
+	TextureSampler result;
+	if( e.IsValid() )
+	{
+		ID3D10EffectShaderResourceVariable* var = AsD3D( e.m_effect )->GetVariableByName( name )->AsShaderResource();
+		if( var->IsValid() )
+		{
+			result.m_sampler = AsHandle( var );
+		}
+	}
+
+	return result;
+}
+
+VectorConstant Device::GetVectorConstant( Effect& e, const char* name )
+{
+	VectorConstant result;
+	if( e.IsValid() )
+	{
+		ID3D10EffectVectorVariable* var = AsD3D( e.m_effect )->GetVariableByName( name )->AsVector();
+		if( var->IsValid() )
+		{
+			result.m_variable = AsHandle( var );
+		}
+	}
+
+	return result;
+}
+
+MatrixConstant Device::GetMatrixConstant( Effect& e, const char* name )
+{
+	MatrixConstant result;
+	if( e.IsValid() )
+	{
+		ID3D10EffectMatrixVariable* var = AsD3D( e.m_effect )->GetVariableByName( name )->AsMatrix();
+		if( var->IsValid() )
+		{
+			result.m_variable = AsHandle( var );
+		}
+	}
+
+	return result;
+}
+
+ConstantBlock Device::GetConstantBlock( Effect& e, const char* name )
+{
+	ConstantBlock result;
+	if( e.IsValid() )
+	{
+		ID3D10EffectConstantBuffer* buffer = AsD3D( e.m_effect )->GetConstantBufferByName( name );
+		D3D10_EFFECT_TYPE_DESC typeDesc;
+		if( buffer->IsValid() && !FAILED( buffer->GetType()->GetDesc( &typeDesc ) ) )
+		{
+			result.m_buffer = AsHandle( buffer );
+			result.m_size = typeDesc.UnpackedSize;
+		}
+	}
+
+	return result;
+}
+
 ShaderInputLayout Device::CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd )
 {
 	ShaderInputLayout result;
@@ -653,7 +987,7 @@ ShaderInputLayout Device::CreateVertexInputLayout( Effect& effect, VertexDescrip
 		}
 
 		// Obtain the first technique
-		ID3D10EffectTechnique* technique = effect.m_effect->GetTechniqueByIndex(0);
+		ID3D10EffectTechnique* technique = AsD3D( effect.m_effect )->GetTechniqueByIndex(0);
 
 		// Create the input layout
 		D3D10_PASS_DESC PassDesc;
@@ -663,7 +997,7 @@ ShaderInputLayout Device::CreateVertexInputLayout( Effect& effect, VertexDescrip
 														PassDesc.IAInputSignatureSize, &inputLayout );
 		if(!FAILED(hr))
 		{
-			result.m_layout = inputLayout;
+			result.m_layout = AsHandle( inputLayout );
 		}
 		delete [] layout;
 	}
@@ -687,13 +1021,13 @@ void Device::DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector
 	if( rectSize == Vector2(0,0) )
 	{
 		// Calculate the rect if needed
-		f.mFont->DrawTextA(f.mSprites, text, -1, &fontRect, DT_CALCRECT, p.mColour);
+		AsD3D( f.mFont )->DrawTextA( AsD3D( f.mSprites ), text, -1, &fontRect, DT_CALCRECT, p.mColour);
 	}
 
 	// Render using the sprites
-	f.mSprites->Begin(D3DX10_SPRITE_SORT_TEXTURE | D3DX10_SPRITE_SAVE_STATE);
-	f.mFont->DrawTextA(f.mSprites, text, -1, &fontRect, p.mJustification | DT_WORDBREAK, p.mColour);
-	f.mSprites->End();
+	AsD3D( f.mSprites )->Begin(D3DX10_SPRITE_SORT_TEXTURE | D3DX10_SPRITE_SAVE_STATE);
+	AsD3D( f.mFont )->DrawTextA( AsD3D( f.mSprites ), text, -1, &fontRect, p.mJustification | DT_WORDBREAK, p.mColour);
+	AsD3D( f.mSprites )->End();
 
 	// Restore state
     m_d3dDevice->OMSetBlendState( OriginalBlendState, OriginalBlendFactor, OriginalSampleMask );
@@ -728,8 +1062,8 @@ Font Device::CreateFont(Font::Parameters params)
 	if(font && !FAILED(D3DX10CreateSprite(m_d3dDevice, 512, &sprite)))
     {
 		result.mParams = params;
-		result.mFont = font;
-		result.mSprites = sprite;
+		result.mFont = AsHandle( font );
+		result.mSprites = AsHandle( sprite );
     }
 
 	return result;
@@ -737,55 +1071,55 @@ Font Device::CreateFont(Font::Parameters params)
 
 void Device::Release(Font &f)
 {
-	if( f.mSprites ) f.mSprites->Release();
-	if( f.mFont ) f.mFont->Release();
+	if( f.mSprites ) AsD3D( f.mSprites )->Release();
+	if( f.mFont ) AsD3D( f.mFont )->Release();
 
 	f.Invalidate();
 }
 
 void Device::Release(ShaderInputLayout& l)
 {
-	if( l.m_layout ) l.m_layout->Release();
+	if( l.m_layout ) AsD3D( l.m_layout )->Release();
 	l.Invalidate();
 }
 
 void Device::Release(Effect& e)
 {
-	if( e.m_effect ) e.m_effect->Release();
+	if( e.m_effect ) AsD3D( e.m_effect )->Release();
 	e.Invalidate();
 }
 
 void Device::Release( Texture2D& t )
 {
-	if( t.m_texture ) t.m_texture->Release();
-	if( t.m_shaderResource ) t.m_shaderResource->Release();
+	if( t.m_texture ) AsD3D( t.m_texture )->Release();
+	if( t.m_shaderResource ) AsD3D( t.m_shaderResource )->Release();
 	t.Invalidate();
 }
 
 void Device::Release(IndexBuffer& ib)
 {
-	if( ib.m_buffer ) ib.m_buffer->Release();
+	if( ib.m_buffer ) AsD3D( ib.m_buffer )->Release();
 	if( ib.m_ownedBuffer ) delete [] ib.m_ownedBuffer;
 	ib.Invalidate();
 }
 
 void Device::Release(VertexBuffer& vb)
 {
-	if( vb.m_buffer ) vb.m_buffer->Release();
+	if( vb.m_buffer ) AsD3D( vb.m_buffer )->Release();
 	if( vb.m_ownedBuffer ) delete [] vb.m_ownedBuffer;
 	vb.Invalidate();
 }
 
 void Device::Release( DepthStencilBuffer& d )
 {
-	if( d.m_renderTarget ) d.m_renderTarget->Release();
+	if( d.m_renderTarget ) AsD3D( d.m_renderTarget )->Release();
 	if( d.m_surface.IsValid() ) Release( d.m_surface );
 	d.Invalidate();
 }
 
 void Device::Release( Rendertarget& r )
 {
-	if( r.m_rendertarget ) r.m_rendertarget->Release();
+	if( r.m_rendertarget ) AsD3D( r.m_rendertarget )->Release();
 	r.Invalidate();
 }
 
@@ -4,13 +4,12 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <D3D10.h>
-#include <D3DX10.h>
 
 #include "device_types.h"
+#include "idevice.h"
 
-class Device;
-
-class Device
+// D3D10 implementation of the rendering interface
+class Device : public IDevice
 {
 public:
 	Device();
@@ -21,19 +20,11 @@ public:
 		int windowWidth;
 		int windowHeight;
 		bool enableDebugD3d;
+		bool nullDriver;	// no window or swap chain. D3D10's null driver validates calls but never draws anything
 		int msaaQuality;
 		int msaaCount;
 	};
 
-	// used for saving textures
-	enum TextureFileType
-	{
-		TextureTypeBMP = D3DX10_IFF_BMP,
-		TextureTypeJPG = D3DX10_IFF_JPG,
-		TextureTypePNG = D3DX10_IFF_PNG,
-		TextureTypeDDS = D3DX10_IFF_DDS
-	};
-
 	// Main Init/Shutdown
 	bool Initialise(InitParameters& params);
 	bool Shutdown();
@@ -51,11 +42,16 @@ public:
 	// Render State
 	void SetViewport( Viewport& vp );
 	void SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget );
+	void SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget );	// MRT
 	void SetPrimitiveTopology(PrimitiveTopology t);
 	void SetInputLayout(ShaderInputLayout& l);
 	void SetVertexBuffer(int streamIndex, VertexBuffer& vb);
 	void SetIndexBuffer(IndexBuffer& ib);
 	void SetTechnique(EffectTechnique& technique, int pass);
+	void SetSampler( TextureSampler& s, Texture2D& t );
+	void SetConstant( VectorConstant& c, const float* v );
+	void SetConstant( MatrixConstant& c, const float* m );
+	void SetConstants( ConstantBlock& c, const void* data, unsigned int size );
 
 	// Draw/clear calls
 	void DrawIndexed(DrawIndexedParameters& params); 
@@ -73,16 +69,20 @@ public:
 	// Texture read/write
 	LockedTexture2D LockTexture(Texture2D& t, Texture2D::CPUAccess);
 	void UnlockTexture(LockedTexture2D& t);
+	void* MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait);
+	void UnmapStagingTexture(Texture2D& t);
 	void CopyTextureToTexture(Texture2D& src, Texture2D& dst);
 	bool SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type);
 
 	// VB read/write
 	void* LockVB(VertexBuffer& vb);
 	void UnlockVB(VertexBuffer& vb);
+	void UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount);	// CpuNoAccess buffers only
 
 	// IB read/write
 	void* LockIB(IndexBuffer& ib);
 	void UnlockIB(IndexBuffer& ib);
+	void UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount);	// CpuNoAccess buffers only
 
 	// Texture stuff
 	Texture2D CreateTexture( Texture2D::Parameters params );
@@ -104,6 +104,11 @@ public:
 	// Shaders/Effects
 	Effect CreateEffect(Effect::Parameters params);
 	void Release(Effect& e);
+	EffectTechnique GetTechnique( Effect& e, const char* name );
+	TextureSampler GetSampler( Effect& e, const char* name );
+	VectorConstant GetVectorConstant( Effect& e, const char* name );
+	MatrixConstant GetMatrixConstant( Effect& e, const char* name );
+	ConstantBlock GetConstantBlock( Effect& e, const char* name );
 
 	// Text Rendering
 	Font CreateFont(Font::Parameters params);
@@ -115,6 +120,7 @@ private:
 
 	bool initDriver(InitParameters& params);
 	bool createRenderBuffers(InitParameters& params);
+	bool initNullDriver(InitParameters& params);
 
 	D3D10_DRIVER_TYPE m_driverType;
 	ID3D10Device*     m_d3dDevice;
@@ -122,6 +128,7 @@ private:
 
 	InitParameters m_params;
 	Rendertarget m_backBufferRT;
+	Texture2D m_nullDriverBackBuffer;	// only used when running without a swap chain
 	DepthStencilBuffer m_mainDepthStencil;
 };
 
@@ -0,0 +1,22 @@
+#ifndef DEVICE_HANDLES_INCLUDED
+#define DEVICE_HANDLES_INCLUDED
+
+// Opaque handles to whatever a device backend creates
+// Only the device that made a handle knows what it points at, everything else just copies,
+// compares and hashes them. NULL is always the invalid handle
+typedef struct DeviceTexture* TextureHandle;
+typedef struct DeviceShaderResource* ShaderResourceHandle;
+typedef struct DeviceRendertarget* RendertargetHandle;
+typedef struct DeviceDepthStencil* DepthStencilHandle;
+typedef struct DeviceBuffer* BufferHandle;
+typedef struct DeviceInputLayout* InputLayoutHandle;
+typedef struct DeviceEffect* EffectHandle;
+typedef struct DeviceTechnique* TechniqueHandle;
+typedef struct DeviceSampler* SamplerHandle;
+typedef struct DeviceVectorVariable* VectorVariableHandle;
+typedef struct DeviceMatrixVariable* MatrixVariableHandle;
+typedef struct DeviceConstantBuffer* ConstantBufferHandle;
+typedef struct DeviceFont* FontHandle;
+typedef struct DeviceFontSprites* FontSpritesHandle;
+
+#endif
\ No newline at end of file
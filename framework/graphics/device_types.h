@@ -1,34 +1,29 @@
 #ifndef DEVICE_TYPES_INCLUDED
 #define DEVICE_TYPES_INCLUDED
 
-#include <D3DX10.h>
+#include "device_handles.h"
 #include "vertex_descriptor.h"
 #include "core\vector2.h"
 #include "core\string_hashing.h"
+#include <stddef.h>
+#include <string.h>
 
-// Forward declared D3D stuff here
-// Do it so this file can be kept completely clean of implementation
-struct ID3D10Effect;
-struct ID3D10EffectTechnique;
-struct ID3D10Buffer;
-struct ID3D10Texture2D;
-struct ID3D10DepthStencilView;
-struct ID3D10RenderTargetView;
-struct ID3D10InputLayout;
-struct ID3DX10Font;
-
+// No graphics api headers in here, so this file can be kept completely clean of implementation.
+// Resources hold opaque handles (device_handles.h) and the enums are plain values. They match
+// D3D10's, so the D3D10 device passes them straight through and checks they still match
 enum PrimitiveTopology
 {
-	PRIMITIVE_POINTS			= D3D10_PRIMITIVE_TOPOLOGY_POINTLIST,
-	PRIMITIVE_LINES				= D3D10_PRIMITIVE_TOPOLOGY_LINELIST,
-	PRIMITIVE_LINESTRIP			= D3D10_PRIMITIVE_TOPOLOGY_LINESTRIP,
-	PRIMITIVE_TRIANGLES			= D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
-	PRIMITIVE_TRIANGLESTRIP		= D3D10_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP,
+	PRIMITIVE_POINTS			= 1,
+	PRIMITIVE_LINES				= 2,
+	PRIMITIVE_LINESTRIP			= 3,
+	PRIMITIVE_TRIANGLES			= 4,
+	PRIMITIVE_TRIANGLESTRIP		= 5,
 	PRIMITIVE_NA				= 0xbad1fff
 };
 
 class Texture2D;
 class EffectTechnique;
+class Effect;
 
 struct DrawIndexedParameters
 {
@@ -45,12 +40,13 @@ struct DrawIndexedParameters
 class Font
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	enum Justification
 	{
-		DRAW_LEFT = DT_LEFT,
-		DRAW_RIGHT = DT_RIGHT,
-		DRAW_CENTER = DT_CENTER,
+		DRAW_LEFT = 0,
+		DRAW_RIGHT = 2,
+		DRAW_CENTER = 1,
 	};
 
 	struct DrawParameters
@@ -102,14 +98,15 @@ public:
 	}
 
 private:
-	ID3DX10Font* mFont;
-	ID3DX10Sprite* mSprites;
+	FontHandle mFont;
+	FontSpritesHandle mSprites;
 	Parameters mParams;
 };
 
 class ShaderInputLayout
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	ShaderInputLayout()
 		: m_layout(NULL)
@@ -131,12 +128,15 @@ public:
 		return (rt.m_layout != m_layout);
 	}
 private:
-	ID3D10InputLayout* m_layout;
+	InputLayoutHandle m_layout;
 };
 
 class TextureSampler
 {
+friend class Device;
+friend class RecordingDevice;
 friend class EffectTechnique;
+friend class EffectBinding;
 friend class ShadowedDevice;
 public:
 	TextureSampler(EffectTechnique* parent=NULL)
@@ -144,51 +144,99 @@ public:
 		, m_effect(parent)
 	{
 	}
-	void Set(Texture2D& t);
+
+	inline bool IsValid() const
+	{
+		return m_sampler != NULL;
+	}
 private:
-	ID3D10EffectShaderResourceVariable* m_sampler;
+	SamplerHandle m_sampler;
 	EffectTechnique* m_effect;
 };
 
+// values are written with IDevice::SetConstant, 16 floats, row major
 class MatrixConstant
 {
+friend class Device;
+friend class RecordingDevice;
 friend class EffectTechnique;
+friend class EffectBinding;
 friend class ShadowedDevice;
 public:
 	MatrixConstant(EffectTechnique* parent=NULL)
 		: m_variable(NULL)
 	{
 	}
-	void Set(D3DXMATRIX mat);
-	void Apply();
+
+	inline bool IsValid() const
+	{
+		return m_variable != NULL;
+	}
 private:
-	ID3D10EffectMatrixVariable* m_variable;
-	D3DXMATRIX m_value;
+	MatrixVariableHandle m_variable;
 };
 
+// values are written with IDevice::SetConstant, 4 floats
 class VectorConstant
 {
+friend class Device;
+friend class RecordingDevice;
 friend class EffectTechnique;
+friend class EffectBinding;
 friend class ShadowedDevice;
 public:
 	VectorConstant(EffectTechnique* parent=NULL)
 		: m_variable(NULL)
 	{
 	}
-	void Set(D3DXVECTOR4 vec);
-	void Apply();
+
+	inline bool IsValid() const
+	{
+		return m_variable != NULL;
+	}
+private:
+	VectorVariableHandle m_variable;
+};
+
+// A whole constant buffer, written in one go from a struct with the same layout
+class ConstantBlock
+{
+friend class Device;
+friend class RecordingDevice;
+friend class EffectBinding;
+public:
+	ConstantBlock()
+		: m_buffer(NULL)
+		, m_size(0)
+	{
+	}
+
+	inline bool IsValid() const
+	{
+		return m_buffer != NULL;
+	}
+
+	// bytes, including the padding HLSL adds
+	inline unsigned int GetSize() const
+	{
+		return m_size;
+	}
+
+	inline size_t GetID() const
+	{
+		return (size_t)m_buffer;
+	}
+
 private:
-	ID3D10EffectVectorVariable* m_variable;
-	D3DXVECTOR4 m_value;
+	ConstantBufferHandle m_buffer;
+	unsigned int m_size;
 };
 
 class EffectTechnique
 {
 friend class Device;
-friend class Effect;
-friend class VectorConstant;
-friend class MatrixConstant;
-friend class TextureSampler;
+friend class RecordingDevice;
+friend class EffectBinding;
 friend class ShadowedDevice;
 public:
 	EffectTechnique()
@@ -218,20 +266,19 @@ public:
 		return (rt.m_technique != m_technique);
 	}
 
-	MatrixConstant GetMatrixConstant(const char* name);
-	VectorConstant GetVectorConstant(const char* name);
-	TextureSampler GetSamplerByName(const char* name);
 private:
-	ID3D10EffectTechnique* m_technique;
+	TechniqueHandle m_technique;
 	Effect* m_parent;
 	int m_passCount;
 	bool m_dirty;
 };
 
+// techniques, samplers and constants are found through IDevice, see EffectBinding
 class Effect
 {
 friend class Device;
-friend class EffectTechnique;
+friend class RecordingDevice;
+friend class EffectBinding;
 public:
 	Effect()
 		: m_effect(NULL)
@@ -263,25 +310,25 @@ public:
 		return (rt.m_effect != m_effect);
 	}
 
-	EffectTechnique GetTechniqueByName(const char* name);
 private:
-	ID3D10Effect* m_effect;
+	EffectHandle m_effect;
 };
 
 class IndexBuffer
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	enum CPUAccess
 	{
 		CpuNoAccess = 0,
-		CpuWrite = D3D10_MAP_WRITE_DISCARD
+		CpuWrite = 4		// the whole buffer is rewritten (discard)
 	};
 
 	enum Format
 	{
-		IB_16BIT=DXGI_FORMAT_R16_UINT,
-		IB_32BIT=DXGI_FORMAT_R32_UINT
+		IB_16BIT=57,
+		IB_32BIT=42
 	};
 
 	struct Parameters
@@ -322,8 +369,13 @@ public:
 		return (rt.m_buffer != m_buffer);
 	}
 
+	inline size_t GetByteSize() const
+	{
+		return m_indexCount * (m_format == IB_16BIT ? sizeof(unsigned short) : sizeof(unsigned int));
+	}
+
 private:
-	ID3D10Buffer* m_buffer;
+	BufferHandle m_buffer;
 	size_t m_indexCount;
 	void* m_ownedBuffer;
 	Format m_format;
@@ -333,11 +385,12 @@ private:
 class VertexBuffer
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	enum CPUAccess
 	{
 		CpuNoAccess = 0,
-		CpuWrite = D3D10_MAP_WRITE_DISCARD
+		CpuWrite = 4		// the whole buffer is rewritten (discard)
 	};
 
 	struct Parameters
@@ -390,8 +443,14 @@ public:
 	{
 		return (rt.m_buffer != m_buffer);
 	}
+
+	inline size_t GetByteSize() const
+	{
+		return vertexCount * vertexStride;
+	}
+
 private:
-	ID3D10Buffer* m_buffer;
+	BufferHandle m_buffer;
 	size_t vertexSize;
 	size_t vertexCount;
 	unsigned int vertexStride;
@@ -402,13 +461,15 @@ private:
 class Texture2D
 {
 friend class Device;
+friend class RecordingDevice;
 friend class TextureSampler;
 public:
 	enum TextureFormat
 	{
-		TypeFloat32 = DXGI_FORMAT_R32G32B32A32_FLOAT,
-		TypeDepthStencil32 = DXGI_FORMAT_D32_FLOAT,
-		TypeInt8UnNormalised = DXGI_FORMAT_R8G8B8A8_UNORM
+		TypeFloat32 = 2,
+		TypeFloat16 = 10,
+		TypeDepthStencil32 = 40,
+		TypeInt8UnNormalised = 28
 	};
 
 	enum TextureBindType
@@ -421,15 +482,17 @@ public:
 	enum CPUAccess
 	{
 		CpuNoAccess = 0,
-		CpuRead = D3D10_MAP_READ,
-		CpuWrite = D3D10_MAP_WRITE,
-		CpuReadWrite = D3D10_MAP_READ_WRITE | D3D10_MAP_READ
+		CpuRead = 1,
+		CpuWrite = 2,
+		CpuReadWrite = 3
 	};
 
 	struct Parameters
 	{
 		Parameters()
 			: stagingTexture(false)
+			, initialData(NULL)
+			, initialRowPitch(0)
 		{
 
 		}
@@ -442,6 +505,8 @@ public:
 		CPUAccess access;
 		unsigned int bindFlags;
 		bool stagingTexture;
+		const void* initialData;		// optional contents of the top mip, only read during the create
+		unsigned int initialRowPitch;
 	};
 
 	Texture2D()
@@ -466,20 +531,27 @@ public:
 		return (rt.m_texture != m_texture) || (rt.m_shaderResource != m_shaderResource);
 	}
 
+	// identifies the texture for sorting / batching, 0 for invalid textures
+	inline size_t GetID() const
+	{
+		return (size_t)m_shaderResource;
+	}
+
 	inline const Parameters& GetParameters() const
 	{
 		return m_params;
 	}
 
 private:
-	ID3D10Texture2D* m_texture;
-	ID3D10ShaderResourceView* m_shaderResource;
+	TextureHandle m_texture;
+	ShaderResourceHandle m_shaderResource;
 	Parameters m_params;
 };
 
 class LockedTexture2D
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	inline bool IsValid()
 	{
@@ -507,6 +579,7 @@ private:
 class DepthStencilBuffer
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	enum Format
 	{
@@ -543,16 +616,22 @@ public:
 		return rt.m_renderTarget != m_renderTarget;
 	}
 
+	inline const Parameters& GetParameters() const
+	{
+		return m_params;
+	}
+
 private:
 
 	Texture2D m_surface;
-	ID3D10DepthStencilView* m_renderTarget;
+	DepthStencilHandle m_renderTarget;
 	Parameters m_params;
 };
 
 class Rendertarget
 {
 friend class Device;
+friend class RecordingDevice;
 public:
 	Rendertarget()
 		: m_rendertarget(NULL)
@@ -580,7 +659,7 @@ public:
 	}
 
 private:
-	ID3D10RenderTargetView* m_rendertarget;
+	RendertargetHandle m_rendertarget;
 };
 
 class Viewport
@@ -0,0 +1,105 @@
+#include "effect_binding.h"
+#include "idevice.h"
+#include <stdio.h>
+
+EffectBinding::EffectBinding()
+	: m_device(NULL)
+	, m_effect(NULL)
+{
+}
+
+EffectBinding::~EffectBinding()
+{
+	Release();
+}
+
+bool EffectBinding::Create( IDevice& d, Effect& e )
+{
+	Release();
+
+	if( !e.IsValid() )
+	{
+		return false;
+	}
+
+	m_device = &d;
+	m_effect = &e;
+
+	return true;
+}
+
+void EffectBinding::Release()
+{
+	m_device = NULL;
+	m_effect = NULL;
+}
+
+EffectTechnique EffectBinding::GetTechnique( const char* name ) const
+{
+	EffectTechnique t;
+	if( IsValid() )
+	{
+		t = m_device->GetTechnique( *m_effect, name );
+		if( !t.IsValid() )
+		{
+			printf("Unknown shader technique '%s'\n", name);
+		}
+	}
+	return t;
+}
+
+TextureSampler EffectBinding::GetSampler( const char* name ) const
+{
+	TextureSampler s;
+	if( IsValid() )
+	{
+		s = m_device->GetSampler( *m_effect, name );
+		if( !s.IsValid() )
+		{
+			printf("Unknown shader sampler '%s'\n", name);
+		}
+	}
+	return s;
+}
+
+VectorConstant EffectBinding::GetVectorConstant( const char* name ) const
+{
+	VectorConstant c;
+	if( IsValid() )
+	{
+		c = m_device->GetVectorConstant( *m_effect, name );
+		if( !c.IsValid() )
+		{
+			printf("Unknown shader constant '%s'\n", name);
+		}
+	}
+	return c;
+}
+
+MatrixConstant EffectBinding::GetMatrixConstant( const char* name ) const
+{
+	MatrixConstant c;
+	if( IsValid() )
+	{
+		c = m_device->GetMatrixConstant( *m_effect, name );
+		if( !c.IsValid() )
+		{
+			printf("Unknown shader constant '%s'\n", name);
+		}
+	}
+	return c;
+}
+
+ConstantBlock EffectBinding::GetConstantBlock( const char* name ) const
+{
+	ConstantBlock b;
+	if( IsValid() )
+	{
+		b = m_device->GetConstantBlock( *m_effect, name );
+		if( !b.IsValid() )
+		{
+			printf("Unknown constant buffer '%s'\n", name);
+		}
+	}
+	return b;
+}
\ No newline at end of file
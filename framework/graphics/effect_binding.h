@@ -0,0 +1,41 @@
+#ifndef EFFECT_BINDING_INCLUDED
+#define EFFECT_BINDING_INCLUDED
+
+#include "device_types.h"
+
+class IDevice;
+
+// The techniques, global variables and constant buffers of an effect, resolved by name through
+// the device that created it. Lookups are creation time only: renderers pull the handles they
+// need out once and keep them, so nothing in the frame loop touches the effect's strings.
+class EffectBinding
+{
+public:
+	EffectBinding();
+	~EffectBinding();
+
+	// the effect must outlive the binding, techniques point back at it
+	bool Create( IDevice& d, Effect& e );
+	void Release();
+
+	inline bool IsValid() const
+	{
+		return m_effect != NULL;
+	}
+
+	// these ask the device and report anything missing
+	EffectTechnique GetTechnique( const char* name ) const;
+	TextureSampler GetSampler( const char* name ) const;
+	VectorConstant GetVectorConstant( const char* name ) const;
+	MatrixConstant GetMatrixConstant( const char* name ) const;
+	ConstantBlock GetConstantBlock( const char* name ) const;
+
+private:
+	EffectBinding( const EffectBinding& );
+	EffectBinding& operator=( const EffectBinding& );
+
+	IDevice* m_device;
+	Effect* m_effect;
+};
+
+#endif
\ No newline at end of file
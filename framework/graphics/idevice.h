@@ -0,0 +1,122 @@
+#ifndef IDEVICE_INCLUDED
+#define IDEVICE_INCLUDED
+
+#include "device_types.h"
+
+// Abstract rendering interface
+// Everything outside of the application setup talks to this rather than Device directly,
+// so the pipeline can run against the D3D10 device, or a RecordingDevice for headless runs.
+// Nothing here includes a graphics api, resources are opaque handles (device_handles.h)
+class IDevice
+{
+public:
+	virtual ~IDevice() {}
+
+	// used for saving textures
+	enum TextureFileType
+	{
+		TextureTypeBMP = 0,
+		TextureTypeJPG = 1,
+		TextureTypePNG = 3,
+		TextureTypeDDS = 4
+	};
+
+	static const int kMaxRenderTargets = 8;	// most colour targets SetRenderTargets can take
+
+	virtual void Flush() = 0;				// Clear the device state
+	virtual void ResetShaderState() = 0;	// Clear the shader state
+
+	// Backbuffer / Depthstencil access
+	virtual Rendertarget& GetBackBuffer() = 0;
+	virtual Texture2D GetBackBufferTexture() = 0;
+	virtual DepthStencilBuffer& GetDepthStencilBuffer() = 0;
+
+	// Swap chain / VSync stuff
+	virtual void PresentBackbuffer() = 0;
+
+	// Render State
+	virtual void SetViewport( Viewport& vp ) = 0;
+	virtual void SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget ) = 0;
+	virtual void SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget ) = 0;	// MRT
+	virtual void SetPrimitiveTopology(PrimitiveTopology t) = 0;
+	virtual void SetInputLayout(ShaderInputLayout& l) = 0;
+	virtual void SetVertexBuffer(int streamIndex, VertexBuffer& vb) = 0;
+	virtual void SetIndexBuffer(IndexBuffer& ib) = 0;
+	virtual void SetTechnique(EffectTechnique& technique, int pass) = 0;
+
+	// Effect variables, these are committed by the next SetTechnique
+	virtual void SetSampler( TextureSampler& s, Texture2D& t ) = 0;
+	virtual void SetConstant( VectorConstant& c, const float* v ) = 0;	// 4 floats
+	virtual void SetConstant( MatrixConstant& c, const float* m ) = 0;	// 16 floats, row major
+	virtual void SetConstants( ConstantBlock& c, const void* data, unsigned int size ) = 0;	// the whole block
+
+	// Draw/clear calls
+	virtual void DrawIndexed(DrawIndexedParameters& params) = 0;
+	virtual bool ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil ) = 0;
+	virtual bool ClearTarget( const Rendertarget& rt, float clearColour[4] ) = 0;
+
+	// Rendertarget stuff
+	virtual Rendertarget CreateRendertarget( const Rendertarget::Parameters params ) = 0;
+	virtual void Release( Rendertarget& r ) = 0;
+
+	// DepthStencil buffers
+	virtual DepthStencilBuffer CreateDepthStencil( const DepthStencilBuffer::Parameters& params ) = 0;
+	virtual void Release( DepthStencilBuffer& d ) = 0;
+
+	// Texture read/write
+	virtual LockedTexture2D LockTexture(Texture2D& t, Texture2D::CPUAccess) = 0;
+	virtual void UnlockTexture(LockedTexture2D& t) = 0;
+
+	// staging textures only. Maps the texture itself rather than a copy, so reads can be deferred
+	// until the GPU is done with it. Returns NULL if it is still being written and wait is false
+	virtual void* MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait) = 0;
+	virtual void UnmapStagingTexture(Texture2D& t) = 0;
+	virtual void CopyTextureToTexture(Texture2D& src, Texture2D& dst) = 0;
+	virtual bool SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type) = 0;
+
+	// VB read/write
+	virtual void* LockVB(VertexBuffer& vb) = 0;
+	virtual void UnlockVB(VertexBuffer& vb) = 0;
+	virtual void UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount) = 0;	// CpuNoAccess buffers only
+
+	// IB read/write
+	virtual void* LockIB(IndexBuffer& ib) = 0;
+	virtual void UnlockIB(IndexBuffer& ib) = 0;
+	virtual void UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount) = 0;	// CpuNoAccess buffers only
+
+	// Texture stuff
+	virtual Texture2D CreateTexture( Texture2D::Parameters params ) = 0;
+	virtual Texture2D LoadTextureFromFile( const char* fileName ) = 0;
+	virtual void Release( Texture2D& t ) = 0;
+
+	// Vertex buffers
+	virtual VertexBuffer CreateVB( VertexBuffer::Parameters params ) = 0;
+	virtual void Release(VertexBuffer& vb) = 0;
+
+	// Index buffers
+	virtual IndexBuffer CreateIB( IndexBuffer::Parameters params ) = 0;
+	virtual void Release(IndexBuffer& ib) = 0;
+
+	// Vertex input layout
+	virtual ShaderInputLayout CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd ) = 0;
+	virtual void Release(ShaderInputLayout& l) = 0;
+
+	// Shaders/Effects
+	virtual Effect CreateEffect(Effect::Parameters params) = 0;
+	virtual void Release(Effect& e) = 0;
+
+	// Effect lookups, invalid handles for anything the effect doesn't have.
+	// Creation time only, renderers keep what they find (see EffectBinding)
+	virtual EffectTechnique GetTechnique( Effect& e, const char* name ) = 0;
+	virtual TextureSampler GetSampler( Effect& e, const char* name ) = 0;
+	virtual VectorConstant GetVectorConstant( Effect& e, const char* name ) = 0;
+	virtual MatrixConstant GetMatrixConstant( Effect& e, const char* name ) = 0;
+	virtual ConstantBlock GetConstantBlock( Effect& e, const char* name ) = 0;
+
+	// Text Rendering
+	virtual Font CreateFont(Font::Parameters params) = 0;
+	virtual void Release(Font &f) = 0;
+	virtual void DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize = Vector2(0,0)) = 0;
+};
+
+#endif
\ No newline at end of file
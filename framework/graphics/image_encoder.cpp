@@ -0,0 +1,229 @@
+#include "image_encoder.h"
+#include "core\thread.h"
+#include "core\strings.h"
+#include <wincodec.h>
+#include <stdio.h>
+
+class ImageEncoderThread : public Thread
+{
+public:
+	ImageEncoderThread( ImageEncoder* owner )
+		: mOwner(owner)
+	{
+	}
+
+protected:
+	virtual bool threadFunc()
+	{
+		// WIC is COM, each thread needs its own apartment
+		HRESULT hr = CoInitializeEx( NULL, COINIT_MULTITHREADED );
+
+		// a NULL job means it is time to quit
+		ImageEncoder::Job* job = NULL;
+		while( (job = mOwner->mQueue.Pop()) != NULL )
+		{
+			job->mSucceeded = ImageEncoder::EncodeNow( *job );
+			InterlockedExchange( &job->mDone, 1 );
+			mOwner->mJobDone.Signal();
+		}
+
+		if( SUCCEEDED(hr) )
+		{
+			CoUninitialize();
+		}
+
+		return true;
+	}
+
+private:
+	ImageEncoder* mOwner;
+};
+
+ImageEncoder::ImageEncoder()
+{
+}
+
+ImageEncoder::~ImageEncoder()
+{
+	Release();
+}
+
+bool ImageEncoder::Initialise( int threadCount, int maxQueued )
+{
+	// Release's quit jobs queue behind any work, blocking until the threads make room
+	if( !mQueue.Initialise( maxQueued ) )
+	{
+		return false;
+	}
+
+	for( int i = 0; i < threadCount; ++i )
+	{
+		ImageEncoderThread* t = new ImageEncoderThread( this );
+		if( !t->run() )
+		{
+			// anything left is encoded on the calling thread
+			printf("Failed to start image encoder thread\n");
+			delete t;
+			break;
+		}
+		mThreads.push_back( t );
+	}
+
+	return true;
+}
+
+void ImageEncoder::Release()
+{
+	for( size_t i = 0; i < mThreads.size(); ++i )
+	{
+		mQueue.Push( NULL );
+	}
+
+	for( size_t i = 0; i < mThreads.size(); ++i )
+	{
+		mThreads[i]->waitUntilComplete();
+		delete mThreads[i];
+	}
+	mThreads.clear();
+}
+
+void ImageEncoder::Encode( Job* job )
+{
+	job->mDone = 0;
+	job->mSucceeded = false;
+
+	if( mThreads.empty() )
+	{
+		job->mSucceeded = EncodeNow( *job );
+		job->mDone = 1;
+		return;
+	}
+
+	mQueue.Push( job );
+}
+
+void ImageEncoder::WaitFor( const Job& job )
+{
+	// a signal from another job just means checking again
+	while( !job.IsDone() )
+	{
+		mJobDone.Wait();
+	}
+}
+
+const char* ImageEncoder::GetExtension( Format f )
+{
+	switch( f )
+	{
+	case FormatPNG:
+		return "png";
+	case FormatJPEG:
+		return "jpg";
+	default:
+		return "raw";
+	}
+}
+
+bool ImageEncoder::EncodeNow( const Job& job )
+{
+	char fullFilename[512] = {'\0'};
+	sprintf_s(fullFilename, "%s.%s", job.mFileName, GetExtension( job.mFormat ));
+
+	bool result = job.mFormat == FormatRaw ? _writeRaw( job, fullFilename ) : _writeWIC( job, fullFilename );
+	if( !result )
+	{
+		printf("Failed to write image '%s'\n", fullFilename);
+	}
+
+	return result;
+}
+
+bool ImageEncoder::_writeRaw( const Job& job, const char* fileName )
+{
+	FILE* f = fopen( fileName, "wb" );
+	if( f == NULL )
+	{
+		return false;
+	}
+
+	// width, height, then tightly packed RGBA rows
+	unsigned int header[2] = { job.mWidth, job.mHeight };
+	bool ok = fwrite( header, sizeof(header), 1, f ) == 1;
+
+	const unsigned char* row = (const unsigned char*)job.mPixels;
+	for( unsigned int y = 0; y < job.mHeight && ok; ++y )
+	{
+		ok = fwrite( row, job.mWidth * 4, 1, f ) == 1;
+		row += job.mRowPitch;
+	}
+
+	fclose( f );
+	return ok;
+}
+
+bool ImageEncoder::_writeWIC( const Job& job, const char* fileName )
+{
+	// PNG keeps the alpha channel, JPEG has to be 24 bit
+	const bool png = job.mFormat == FormatPNG;
+	const unsigned int pixelSize = png ? 4 : 3;
+	WICPixelFormatGUID pixelFormat = png ? GUID_WICPixelFormat32bppBGRA : GUID_WICPixelFormat24bppBGR;
+
+	IWICImagingFactory* factory = NULL;
+	IWICStream* stream = NULL;
+	IWICBitmapEncoder* encoder = NULL;
+	IWICBitmapFrameEncode* frame = NULL;
+	IPropertyBag2* properties = NULL;
+
+	std::wstring wideName = Strings::StringToWide( fileName );
+	HRESULT hr = CoCreateInstance( CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (void**)&factory );
+	if( SUCCEEDED(hr) ) hr = factory->CreateStream( &stream );
+	if( SUCCEEDED(hr) ) hr = stream->InitializeFromFilename( wideName.c_str(), GENERIC_WRITE );
+	if( SUCCEEDED(hr) ) hr = factory->CreateEncoder( png ? GUID_ContainerFormatPng : GUID_ContainerFormatJpeg, NULL, &encoder );
+	if( SUCCEEDED(hr) ) hr = encoder->Initialize( stream, WICBitmapEncoderNoCache );
+	if( SUCCEEDED(hr) ) hr = encoder->CreateNewFrame( &frame, &properties );
+	if( SUCCEEDED(hr) ) hr = frame->Initialize( properties );
+	if( SUCCEEDED(hr) ) hr = frame->SetSize( job.mWidth, job.mHeight );
+	if( SUCCEEDED(hr) ) hr = frame->SetPixelFormat( &pixelFormat );
+	if( SUCCEEDED(hr) && !IsEqualGUID( pixelFormat, png ? GUID_WICPixelFormat32bppBGRA : GUID_WICPixelFormat24bppBGR ) )
+	{
+		hr = E_FAIL;	// the encoder wants something we don't convert to
+	}
+
+	// swizzle a row at a time, the source is RGBA
+	if( SUCCEEDED(hr) )
+	{
+		std::vector<unsigned char> row( job.mWidth * pixelSize );
+		const unsigned char* src = (const unsigned char*)job.mPixels;
+		for( unsigned int y = 0; y < job.mHeight && SUCCEEDED(hr); ++y )
+		{
+			const unsigned char* s = src;
+			unsigned char* d = &row[0];
+			for( unsigned int x = 0; x < job.mWidth; ++x )
+			{
+				d[0] = s[2];
+				d[1] = s[1];
+				d[2] = s[0];
+				if( png )
+				{
+					d[3] = s[3];
+				}
+				s += 4;
+				d += pixelSize;
+			}
+
+			hr = frame->WritePixels( 1, job.mWidth * pixelSize, (UINT)row.size(), &row[0] );
+			src += job.mRowPitch;
+		}
+	}
+
+	if( SUCCEEDED(hr) ) hr = frame->Commit();
+	if( SUCCEEDED(hr) ) hr = encoder->Commit();
+
+	if( properties ) properties->Release();
+	if( frame ) frame->Release();
+	if( encoder ) encoder->Release();
+	if( stream ) stream->Release();
+	if( factory ) factory->Release();
+
+	return SUCCEEDED(hr);
+}
\ No newline at end of file
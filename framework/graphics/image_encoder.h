@@ -0,0 +1,85 @@
+#ifndef IMAGE_ENCODER_INCLUDED
+#define IMAGE_ENCODER_INCLUDED
+
+#include "core\bounded_queue.h"
+#include "core\critical_section.h"
+#include <vector>
+
+class ImageEncoderThread;
+
+// Writes RGBA8 images to disk on a pool of background threads
+// PNG and JPEG go through WIC, raw is a small header followed by the rows as they are
+class ImageEncoder
+{
+friend class ImageEncoderThread;
+public:
+	enum Format
+	{
+		FormatPNG = 0,
+		FormatJPEG,
+		FormatRaw
+	};
+
+	// the pixels are not copied, they must stay untouched until IsDone returns true
+	struct Job
+	{
+		Job()
+			: mPixels(NULL)
+			, mWidth(0)
+			, mHeight(0)
+			, mRowPitch(0)
+			, mFormat(FormatPNG)
+			, mDone(0)
+			, mSucceeded(false)
+		{
+			mFileName[0] = '\0';
+		}
+
+		inline bool IsDone() const
+		{
+			return mDone != 0;
+		}
+
+		const void* mPixels;
+		unsigned int mWidth;
+		unsigned int mHeight;
+		unsigned int mRowPitch;
+		Format mFormat;
+		char mFileName[256];	// without the extension
+
+		volatile long mDone;	// set by the encoder thread
+		bool mSucceeded;
+	};
+
+	ImageEncoder();
+	~ImageEncoder();
+
+	// maxQueued = jobs waiting for a thread before Encode starts blocking
+	bool Initialise( int threadCount, int maxQueued );
+	void Release();		// finishes everything queued first
+
+	// blocks while the queue is full
+	void Encode( Job* job );
+
+	// sleeps until the job has been written. Wakes on every finished job, so only one thread
+	// should wait at a time
+	void WaitFor( const Job& job );
+
+	static const char* GetExtension( Format f );
+
+	// can be called from any thread, returns false if the file couldn't be written
+	static bool EncodeNow( const Job& job );
+
+private:
+	ImageEncoder( const ImageEncoder& );
+	ImageEncoder& operator=( const ImageEncoder& );
+
+	static bool _writeRaw( const Job& job, const char* fileName );
+	static bool _writeWIC( const Job& job, const char* fileName );
+
+	BoundedQueue<Job*> mQueue;
+	Event mJobDone;		// auto reset, signalled as each job finishes
+	std::vector<ImageEncoderThread*> mThreads;
+};
+
+#endif
\ No newline at end of file
@@ -6,11 +6,11 @@
 #ifdef ENABLE_PERF_GRAB
 	#define DoPerfGrab(stuff) stuff
 	#define DeclarePerfGrab(Name, Slotcount, Slottype) \
-	typedef PerfGrab<Slotcount, Slottype> Name; \
-	int Name::m_slots[Slotcount];
+	typedef PerfGrab<Slotcount, Slottype> Name;
 
 #else
 	#define DoPerfGrab(stuff)
+	#define DeclarePerfGrab(Name, Slotcount, Slottype)
 #endif
 
 template<int SlotCount, typename EnumName>
@@ -19,8 +19,13 @@ class PerfGrab
 public:
 	static void Reset(int slot=-1)
 	{
-		int start = ( slot >= 0 && slot < SlotCount ) ? slot : 0;
-		int end = ( slot == -1 ) ? SlotCount : 0;
+		// -1 clears everything, otherwise just the one slot
+		int start = ( slot == -1 ) ? 0 : slot;
+		int end = ( slot == -1 ) ? SlotCount : slot + 1;
+		if( start < 0 || end > SlotCount )
+		{
+			return;
+		}
 		for(int i=start; i<end; ++i)
 		{
 			m_slots[i] = 0;
@@ -39,7 +44,7 @@ public:
 	{
 		if ( slot >= 0 && slot < SlotCount )
 		{
-			m_slots[slot] += count;
+			m_slots[slot] -= count;
 		}
 	}
 	
@@ -52,4 +57,8 @@ private:
 	static int m_slots[SlotCount];
 };
 
+// template statics can live in the header, each instantiation gets one definition
+template<int SlotCount, typename EnumName>
+int PerfGrab<SlotCount, EnumName>::m_slots[SlotCount];
+
 #endif
\ No newline at end of file
@@ -0,0 +1,809 @@
+#include "recording_device.h"
+#include <string.h>
+
+RecordingDevice::RecordingDevice( IDevice* backend, int backBufferWidth, int backBufferHeight )
+	: m_backend(backend)
+	, m_nextHandle(0)
+{
+	memset( &m_stats, 0, sizeof(m_stats) );
+
+	if( m_backend == NULL )
+	{
+		Texture2D::Parameters& bp = m_nullBackBufferTexture.m_params;
+		bp.width = backBufferWidth;
+		bp.height = backBufferHeight;
+		bp.format = Texture2D::TypeInt8UnNormalised;
+		bp.msaaCount = 1;
+		bp.msaaQuality = 0;
+		bp.numMips = 1;
+		bp.access = Texture2D::CpuNoAccess;
+		bp.bindFlags = Texture2D::BindAsRenderTarget;
+		m_nullBackBufferTexture.m_texture = (TextureHandle)_makeHandle();
+
+		m_nullBackBuffer.m_rendertarget = (RendertargetHandle)_makeHandle();
+		m_nullDepthStencil.m_renderTarget = (DepthStencilHandle)_makeHandle();
+		m_nullDepthStencil.m_surface.m_texture = (TextureHandle)_makeHandle();
+	}
+}
+
+RecordingDevice::~RecordingDevice()
+{
+}
+
+void RecordingDevice::ResetFrame()
+{
+	m_commands.clear();
+	memset( m_stats.mCommandCounts, 0, sizeof(m_stats.mCommandCounts) );
+	m_stats.mDrawCalls = 0;
+	m_stats.mIndicesDrawn = 0;
+	m_stats.mBytesUploaded = 0;
+}
+
+void* RecordingDevice::_makeHandle()
+{
+	// never dereferenced, just needs to be unique and non-null
+	return (void*)(++m_nextHandle);
+}
+
+void* RecordingDevice::_getCpuTexture( const Texture2D& t )
+{
+	std::vector<unsigned char>& pixels = m_cpuTextures[t.m_texture];
+	if( pixels.empty() )
+	{
+		pixels.resize( GetTextureByteSize( t.m_params ) + 1, 0 );
+	}
+	return &pixels[0];
+}
+
+void RecordingDevice::_record( CommandType t, unsigned int arg0, unsigned int arg1 )
+{
+	Command c;
+	c.mType = t;
+	c.mArg0 = arg0;
+	c.mArg1 = arg1;
+	m_commands.push_back( c );
+	m_stats.mCommandCounts[t]++;
+}
+
+void RecordingDevice::_created( ResourceType t, const void* handle, size_t bytes )
+{
+	_record( CmdCreate, t, (unsigned int)bytes );
+	if( handle == NULL )
+	{
+		return;		// creation failed
+	}
+
+	Allocation a;
+	a.mType = t;
+	a.mBytes = bytes;
+	m_allocations[handle] = a;
+
+	m_stats.mLiveResources[t]++;
+	m_stats.mLiveBytes[t] += bytes;
+
+	size_t total = GetTotalLiveBytes();
+	if( total > m_stats.mPeakBytes )
+	{
+		m_stats.mPeakBytes = total;
+	}
+}
+
+void RecordingDevice::_released( ResourceType t, const void* handle )
+{
+	// references we never handed out (the back buffer texture) are not tracked
+	std::map<const void*, Allocation>::iterator it = m_allocations.find( handle );
+	if( it == m_allocations.end() )
+	{
+		_record( CmdRelease, t, 0 );
+		return;
+	}
+
+	_record( CmdRelease, t, (unsigned int)it->second.mBytes );
+	m_stats.mLiveResources[t]--;
+	m_stats.mLiveBytes[t] -= it->second.mBytes;
+	m_allocations.erase( it );
+}
+
+size_t RecordingDevice::_getBytesPerPixel( Texture2D::TextureFormat format )
+{
+	switch( format )
+	{
+	case Texture2D::TypeFloat32:
+		return 16;
+	case Texture2D::TypeFloat16:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+size_t RecordingDevice::GetTextureByteSize( const Texture2D::Parameters& p )
+{
+	size_t bytesPerPixel = _getBytesPerPixel( p.format );
+	size_t samples = p.msaaCount > 1 ? p.msaaCount : 1;
+	size_t total = 0;
+	int w = p.width;
+	int h = p.height;
+	int mips = p.numMips;	// 0 = full chain
+	for( int i = 0; (mips == 0 || i < mips) && w > 0 && h > 0; ++i )
+	{
+		total += (size_t)w * h * bytesPerPixel * samples;
+		if( w == 1 && h == 1 )
+		{
+			break;
+		}
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	return total;
+}
+
+const char* RecordingDevice::GetCommandName( CommandType t )
+{
+	static const char* names[MaxCommandTypes] =
+	{
+		"Flush",
+		"ResetShaderState",
+		"Present",
+		"SetViewport",
+		"SetRenderTargets",
+		"SetPrimitiveTopology",
+		"SetInputLayout",
+		"SetVertexBuffer",
+		"SetIndexBuffer",
+		"SetTechnique",
+		"SetSampler",
+		"SetConstant",
+		"DrawIndexed",
+		"ClearDepth",
+		"ClearColour",
+		"CopyTexture",
+		"SaveTexture",
+		"LockTexture",
+		"LockVB",
+		"UpdateVB",
+		"LockIB",
+		"UpdateIB",
+		"DrawText",
+		"Create",
+		"Release"
+	};
+
+	return t < MaxCommandTypes ? names[t] : "Unknown";
+}
+
+const char* RecordingDevice::GetResourceName( ResourceType t )
+{
+	static const char* names[MaxResourceTypes] =
+	{
+		"Texture",
+		"Rendertarget",
+		"DepthStencil",
+		"VertexBuffer",
+		"IndexBuffer",
+		"InputLayout",
+		"Effect",
+		"Font"
+	};
+
+	return t < MaxResourceTypes ? names[t] : "Unknown";
+}
+
+void RecordingDevice::WriteLog( FILE* f ) const
+{
+	for( size_t i = 0; i < m_commands.size(); ++i )
+	{
+		const Command& c = m_commands[i];
+		if( c.mType == CmdCreate || c.mType == CmdRelease )
+		{
+			fprintf( f, "%s %s %u\n", GetCommandName(c.mType), GetResourceName((ResourceType)c.mArg0), c.mArg1 );
+		}
+		else
+		{
+			fprintf( f, "%s %u %u\n", GetCommandName(c.mType), c.mArg0, c.mArg1 );
+		}
+	}
+
+	fprintf( f, "\n// draws %u, indices %u, uploaded %u bytes\n", m_stats.mDrawCalls, m_stats.mIndicesDrawn, (unsigned int)m_stats.mBytesUploaded );
+	for( int i = 0; i < MaxResourceTypes; ++i )
+	{
+		fprintf( f, "// %s: %d live, %u bytes\n", GetResourceName((ResourceType)i), m_stats.mLiveResources[i], (unsigned int)m_stats.mLiveBytes[i] );
+	}
+	fprintf( f, "// peak %u bytes\n", (unsigned int)m_stats.mPeakBytes );
+}
+
+bool RecordingDevice::WriteLog( const char* fileName ) const
+{
+	FILE* f = fopen( fileName, "w" );
+	if( f == NULL )
+	{
+		printf("Failed to open device log '%s'\n", fileName);
+		return false;
+	}
+
+	WriteLog( f );
+	fclose( f );
+
+	return true;
+}
+
+void RecordingDevice::Flush()
+{
+	_record( CmdFlush );
+	if( m_backend ) m_backend->Flush();
+}
+
+void RecordingDevice::ResetShaderState()
+{
+	_record( CmdResetShaderState );
+	if( m_backend ) m_backend->ResetShaderState();
+}
+
+Rendertarget& RecordingDevice::GetBackBuffer()
+{
+	return m_backend ? m_backend->GetBackBuffer() : m_nullBackBuffer;
+}
+
+Texture2D RecordingDevice::GetBackBufferTexture()
+{
+	if( m_backend )
+	{
+		return m_backend->GetBackBufferTexture();
+	}
+
+	return m_nullBackBufferTexture;
+}
+
+DepthStencilBuffer& RecordingDevice::GetDepthStencilBuffer()
+{
+	return m_backend ? m_backend->GetDepthStencilBuffer() : m_nullDepthStencil;
+}
+
+void RecordingDevice::PresentBackbuffer()
+{
+	_record( CmdPresent );
+	if( m_backend ) m_backend->PresentBackbuffer();
+}
+
+void RecordingDevice::SetViewport( Viewport& vp )
+{
+	_record( CmdSetViewport, (unsigned int)vp.dimensions.x(), (unsigned int)vp.dimensions.y() );
+	if( m_backend ) m_backend->SetViewport( vp );
+}
+
+void RecordingDevice::SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget )
+{
+	_record( CmdSetRenderTargets, colourTarget != NULL ? 1 : 0, depthStencilTarget != NULL ? 1 : 0 );
+	if( m_backend ) m_backend->SetRenderTargets( colourTarget, depthStencilTarget );
+}
+
+void RecordingDevice::SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget )
+{
+	_record( CmdSetRenderTargets, targetCount, depthStencilTarget != NULL ? 1 : 0 );
+	if( m_backend ) m_backend->SetRenderTargets( colourTargets, targetCount, depthStencilTarget );
+}
+
+void RecordingDevice::SetPrimitiveTopology(PrimitiveTopology t)
+{
+	_record( CmdSetPrimitiveTopology, (unsigned int)t );
+	if( m_backend ) m_backend->SetPrimitiveTopology( t );
+}
+
+void RecordingDevice::SetInputLayout(ShaderInputLayout& l)
+{
+	_record( CmdSetInputLayout );
+	if( m_backend ) m_backend->SetInputLayout( l );
+}
+
+void RecordingDevice::SetVertexBuffer(int streamIndex, VertexBuffer& vb)
+{
+	_record( CmdSetVertexBuffer, streamIndex, (unsigned int)vb.GetByteSize() );
+	if( m_backend ) m_backend->SetVertexBuffer( streamIndex, vb );
+}
+
+void RecordingDevice::SetIndexBuffer(IndexBuffer& ib)
+{
+	_record( CmdSetIndexBuffer, (unsigned int)ib.GetByteSize() );
+	if( m_backend ) m_backend->SetIndexBuffer( ib );
+}
+
+void RecordingDevice::SetTechnique(EffectTechnique& technique, int pass)
+{
+	_record( CmdSetTechnique, pass );
+	if( m_backend ) m_backend->SetTechnique( technique, pass );
+}
+
+void RecordingDevice::SetSampler( TextureSampler& s, Texture2D& t )
+{
+	_record( CmdSetSampler, t.IsValid() ? t.m_params.width : 0, t.IsValid() ? t.m_params.height : 0 );
+	if( m_backend ) m_backend->SetSampler( s, t );
+}
+
+void RecordingDevice::SetConstant( VectorConstant& c, const float* v )
+{
+	_record( CmdSetConstant, 4 );
+	if( m_backend ) m_backend->SetConstant( c, v );
+}
+
+void RecordingDevice::SetConstant( MatrixConstant& c, const float* m )
+{
+	_record( CmdSetConstant, 16 );
+	if( m_backend ) m_backend->SetConstant( c, m );
+}
+
+void RecordingDevice::SetConstants( ConstantBlock& c, const void* data, unsigned int size )
+{
+	_record( CmdSetConstant, size / sizeof(float) );
+	if( m_backend ) m_backend->SetConstants( c, data, size );
+}
+
+void RecordingDevice::DrawIndexed(DrawIndexedParameters& params)
+{
+	_record( CmdDrawIndexed, params.m_indexCount, params.m_startIndex );
+	m_stats.mDrawCalls++;
+	m_stats.mIndicesDrawn += params.m_indexCount;
+	if( m_backend ) m_backend->DrawIndexed( params );
+}
+
+bool RecordingDevice::ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil )
+{
+	_record( CmdClearDepth, stencil );
+	return m_backend ? m_backend->ClearTarget( rt, depth, stencil ) : rt.IsValid();
+}
+
+bool RecordingDevice::ClearTarget( const Rendertarget& rt, float clearColour[4] )
+{
+	_record( CmdClearColour );
+	return m_backend ? m_backend->ClearTarget( rt, clearColour ) : rt.IsValid();
+}
+
+Rendertarget RecordingDevice::CreateRendertarget( const Rendertarget::Parameters params )
+{
+	Rendertarget result;
+	if( m_backend )
+	{
+		result = m_backend->CreateRendertarget( params );
+	}
+	else if( params.target.IsValid() )
+	{
+		result.m_rendertarget = (RendertargetHandle)_makeHandle();
+	}
+
+	// the memory belongs to the texture, targets are just views
+	_created( ResRendertarget, result.m_rendertarget, 0 );
+	return result;
+}
+
+void RecordingDevice::Release( Rendertarget& r )
+{
+	_released( ResRendertarget, r.m_rendertarget );
+	if( m_backend ) m_backend->Release( r ); else r.Invalidate();
+}
+
+DepthStencilBuffer RecordingDevice::CreateDepthStencil( const DepthStencilBuffer::Parameters& params )
+{
+	DepthStencilBuffer result;
+	if( m_backend )
+	{
+		result = m_backend->CreateDepthStencil( params );
+	}
+	else
+	{
+		result.m_renderTarget = (DepthStencilHandle)_makeHandle();
+		result.m_surface.m_texture = (TextureHandle)_makeHandle();
+		result.m_params = params;
+	}
+
+	size_t samples = params.m_msaaCount > 1 ? params.m_msaaCount : 1;
+	_created( ResDepthStencil, result.m_renderTarget, (size_t)params.m_width * params.m_height * 4 * samples );
+	return result;
+}
+
+void RecordingDevice::Release( DepthStencilBuffer& d )
+{
+	_released( ResDepthStencil, d.m_renderTarget );
+	if( m_backend ) m_backend->Release( d ); else d.Invalidate();
+}
+
+LockedTexture2D RecordingDevice::LockTexture(Texture2D& t, Texture2D::CPUAccess access)
+{
+	_record( CmdLockTexture, t.IsValid() ? t.m_params.width : 0, t.IsValid() ? t.m_params.height : 0 );
+	if( access != Texture2D::CpuRead && t.IsValid() )
+	{
+		m_stats.mBytesUploaded += GetTextureByteSize( t.m_params );
+	}
+
+	if( m_backend )
+	{
+		return m_backend->LockTexture( t, access );
+	}
+
+	// a staging copy in cpu memory, same as the device makes. Nothing was ever drawn so it starts cleared
+	LockedTexture2D result;
+	if( t.IsValid() )
+	{
+		result.m_sourceTexture = t;
+		result.m_stagingTexture.m_texture = (TextureHandle)_makeHandle();
+		result.m_stagingTexture.m_params = t.m_params;
+		result.m_stagingTexture.m_params.stagingTexture = true;
+		result.m_stagingTexture.m_params.access = access;
+		result.m_lockedBuffer = _getCpuTexture( result.m_stagingTexture );
+		result.m_locked = true;
+	}
+
+	return result;
+}
+
+void RecordingDevice::UnlockTexture(LockedTexture2D& t)
+{
+	if( m_backend )
+	{
+		m_backend->UnlockTexture( t );
+		return;
+	}
+
+	m_cpuTextures.erase( t.m_stagingTexture.m_texture );
+	t.m_stagingTexture.Invalidate();
+	t.m_lockedBuffer = NULL;
+	t.m_locked = false;
+}
+
+void* RecordingDevice::MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait)
+{
+	_record( CmdLockTexture, t.IsValid() ? t.m_params.width : 0, t.IsValid() ? t.m_params.height : 0 );
+	rowPitch = 0;
+	if( m_backend )
+	{
+		return m_backend->MapStagingTexture( t, rowPitch, wait );
+	}
+
+	if( !t.IsValid() || !t.m_params.stagingTexture )
+	{
+		return NULL;
+	}
+
+	rowPitch = (unsigned int)(t.m_params.width * _getBytesPerPixel( t.m_params.format ));
+	return _getCpuTexture( t );
+}
+
+void RecordingDevice::UnmapStagingTexture(Texture2D& t)
+{
+	if( m_backend ) m_backend->UnmapStagingTexture( t );
+}
+
+void RecordingDevice::CopyTextureToTexture(Texture2D& src, Texture2D& dst)
+{
+	_record( CmdCopyTexture, src.IsValid() ? src.m_params.width : 0, src.IsValid() ? src.m_params.height : 0 );
+	if( m_backend ) m_backend->CopyTextureToTexture( src, dst );
+}
+
+bool RecordingDevice::SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type)
+{
+	_record( CmdSaveTexture, (unsigned int)type );
+	return m_backend ? m_backend->SaveTextureToFile( t, fileName, type ) : false;
+}
+
+void* RecordingDevice::LockVB(VertexBuffer& vb)
+{
+	// dynamic buffers are written in full (discard)
+	_record( CmdLockVB, (unsigned int)vb.GetByteSize() );
+	m_stats.mBytesUploaded += vb.GetByteSize();
+	return m_backend ? m_backend->LockVB( vb ) : vb.m_ownedBuffer;
+}
+
+void RecordingDevice::UnlockVB(VertexBuffer& vb)
+{
+	if( m_backend ) m_backend->UnlockVB( vb );
+}
+
+void RecordingDevice::UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	_record( CmdUpdateVB, byteOffset, byteCount );
+	m_stats.mBytesUploaded += byteCount;
+	if( m_backend ) m_backend->UpdateVB( vb, data, byteOffset, byteCount );
+}
+
+void* RecordingDevice::LockIB(IndexBuffer& ib)
+{
+	_record( CmdLockIB, (unsigned int)ib.GetByteSize() );
+	m_stats.mBytesUploaded += ib.GetByteSize();
+	return m_backend ? m_backend->LockIB( ib ) : ib.m_ownedBuffer;
+}
+
+void RecordingDevice::UnlockIB(IndexBuffer& ib)
+{
+	if( m_backend ) m_backend->UnlockIB( ib );
+}
+
+void RecordingDevice::UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount)
+{
+	_record( CmdUpdateIB, byteOffset, byteCount );
+	m_stats.mBytesUploaded += byteCount;
+	if( m_backend ) m_backend->UpdateIB( ib, data, byteOffset, byteCount );
+}
+
+Texture2D RecordingDevice::CreateTexture( Texture2D::Parameters params )
+{
+	Texture2D result;
+	if( m_backend )
+	{
+		result = m_backend->CreateTexture( params );
+	}
+	else
+	{
+		result.m_texture = (TextureHandle)_makeHandle();
+		if( (params.bindFlags & Texture2D::BindAsShaderResource) && !params.stagingTexture )
+		{
+			result.m_shaderResource = (ShaderResourceHandle)_makeHandle();
+		}
+		result.m_params = params;
+		result.m_params.initialData = NULL;
+	}
+
+	if( params.initialData )
+	{
+		m_stats.mBytesUploaded += GetTextureByteSize( params );
+	}
+
+	// staging textures can be mapped, so they get real memory
+	if( !m_backend && params.stagingTexture )
+	{
+		_getCpuTexture( result );
+	}
+
+	_created( ResTexture, result.m_texture, GetTextureByteSize( params ) );
+	return result;
+}
+
+Texture2D RecordingDevice::LoadTextureFromFile( const char* fileName )
+{
+	// size isn't known until the file is loaded, so there is nothing to fake without a backend
+	Texture2D result;
+	if( m_backend )
+	{
+		result = m_backend->LoadTextureFromFile( fileName );
+	}
+
+	_created( ResTexture, result.m_texture, result.IsValid() ? GetTextureByteSize( result.m_params ) : 0 );
+	return result;
+}
+
+void RecordingDevice::Release( Texture2D& t )
+{
+	_released( ResTexture, t.m_texture );
+	if( m_backend )
+	{
+		m_backend->Release( t );
+	}
+	else
+	{
+		m_cpuTextures.erase( t.m_texture );
+		t.Invalidate();
+	}
+}
+
+VertexBuffer RecordingDevice::CreateVB( VertexBuffer::Parameters params )
+{
+	VertexBuffer result;
+	if( m_backend )
+	{
+		result = m_backend->CreateVB( params );
+	}
+	else
+	{
+		// keep a cpu copy so Lock has somewhere to write
+		result.m_buffer = (BufferHandle)_makeHandle();
+		result.m_ownedBuffer = new unsigned char[params.vertexCount * params.stride];
+		result.vertexCount = params.vertexCount;
+		result.vertexSize = params.vertexSize;
+		result.vertexStride = params.stride;
+		result.m_lockType = params.access;
+	}
+
+	_created( ResVertexBuffer, result.m_buffer, (size_t)params.vertexCount * params.stride );
+	return result;
+}
+
+void RecordingDevice::Release(VertexBuffer& vb)
+{
+	_released( ResVertexBuffer, vb.m_buffer );
+	if( m_backend )
+	{
+		m_backend->Release( vb );
+	}
+	else
+	{
+		delete [] (unsigned char*)vb.m_ownedBuffer;
+		vb.Invalidate();
+	}
+}
+
+IndexBuffer RecordingDevice::CreateIB( IndexBuffer::Parameters params )
+{
+	IndexBuffer result;
+	unsigned int indexSize = params.format == IndexBuffer::IB_16BIT ? sizeof(unsigned short) : sizeof(unsigned int);
+	if( m_backend )
+	{
+		result = m_backend->CreateIB( params );
+	}
+	else
+	{
+		result.m_buffer = (BufferHandle)_makeHandle();
+		result.m_ownedBuffer = new unsigned char[params.indexCount * indexSize];
+		result.m_indexCount = params.indexCount;
+		result.m_format = params.format;
+		result.m_lockType = params.access;
+	}
+
+	_created( ResIndexBuffer, result.m_buffer, (size_t)params.indexCount * indexSize );
+	return result;
+}
+
+void RecordingDevice::Release(IndexBuffer& ib)
+{
+	_released( ResIndexBuffer, ib.m_buffer );
+	if( m_backend )
+	{
+		m_backend->Release( ib );
+	}
+	else
+	{
+		delete [] (unsigned char*)ib.m_ownedBuffer;
+		ib.Invalidate();
+	}
+}
+
+ShaderInputLayout RecordingDevice::CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd )
+{
+	ShaderInputLayout result;
+	if( m_backend )
+	{
+		result = m_backend->CreateVertexInputLayout( effect, vd );
+	}
+	else
+	{
+		result.m_layout = (InputLayoutHandle)_makeHandle();
+	}
+
+	_created( ResInputLayout, result.m_layout, 0 );
+	return result;
+}
+
+void RecordingDevice::Release(ShaderInputLayout& l)
+{
+	_released( ResInputLayout, l.m_layout );
+	if( m_backend ) m_backend->Release( l ); else l.Invalidate();
+}
+
+Effect RecordingDevice::CreateEffect(Effect::Parameters params)
+{
+	Effect result;
+	if( m_backend )
+	{
+		result = m_backend->CreateEffect( params );
+	}
+	else
+	{
+		// nothing is compiled, every lookup below finds what it asks for
+		result.m_effect = (EffectHandle)_makeHandle();
+	}
+
+	_created( ResEffect, result.m_effect, 0 );
+	return result;
+}
+
+void RecordingDevice::Release(Effect& e)
+{
+	_released( ResEffect, e.m_effect );
+	if( m_backend ) m_backend->Release( e ); else e.Invalidate();
+}
+
+EffectTechnique RecordingDevice::GetTechnique( Effect& e, const char* name )
+{
+	if( m_backend )
+	{
+		return m_backend->GetTechnique( e, name );
+	}
+
+	EffectTechnique result;
+	if( e.IsValid() )
+	{
+		result.m_technique = (TechniqueHandle)_makeHandle();
+		result.m_passCount = 1;
+		result.m_parent = &e;
+	}
+	return result;
+}
+
+TextureSampler RecordingDevice::GetSampler( Effect& e, const char* name )
+{
+	if( m_backend )
+	{
+		return m_backend->GetSampler( e, name );
+	}
+
+	TextureSampler result;
+	if( e.IsValid() )
+	{
+		result.m_sampler = (SamplerHandle)_makeHandle();
+	}
+	return result;
+}
+
+VectorConstant RecordingDevice::GetVectorConstant( Effect& e, const char* name )
+{
+	if( m_backend )
+	{
+		return m_backend->GetVectorConstant( e, name );
+	}
+
+	VectorConstant result;
+	if( e.IsValid() )
+	{
+		result.m_variable = (VectorVariableHandle)_makeHandle();
+	}
+	return result;
+}
+
+MatrixConstant RecordingDevice::GetMatrixConstant( Effect& e, const char* name )
+{
+	if( m_backend )
+	{
+		return m_backend->GetMatrixConstant( e, name );
+	}
+
+	MatrixConstant result;
+	if( e.IsValid() )
+	{
+		result.m_variable = (MatrixVariableHandle)_makeHandle();
+	}
+	return result;
+}
+
+ConstantBlock RecordingDevice::GetConstantBlock( Effect& e, const char* name )
+{
+	if( m_backend )
+	{
+		return m_backend->GetConstantBlock( e, name );
+	}
+
+	// the real size isn't known without the compiled effect, so allow the largest D3D10 allows
+	ConstantBlock result;
+	if( e.IsValid() )
+	{
+		result.m_buffer = (ConstantBufferHandle)_makeHandle();
+		result.m_size = 4096 * 16;
+	}
+	return result;
+}
+
+Font RecordingDevice::CreateFont(Font::Parameters params)
+{
+	Font result;
+	if( m_backend )
+	{
+		result = m_backend->CreateFont( params );
+	}
+	else
+	{
+		result.mFont = (FontHandle)_makeHandle();
+		result.mSprites = (FontSpritesHandle)_makeHandle();
+		result.mParams = params;
+	}
+
+	_created( ResFont, result.mFont, 0 );
+	return result;
+}
+
+void RecordingDevice::Release(Font &f)
+{
+	_released( ResFont, f.mFont );
+	if( m_backend ) m_backend->Release( f ); else f.Invalidate();
+}
+
+void RecordingDevice::DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize)
+{
+	_record( CmdDrawText, (unsigned int)strlen( text ) );
+	if( m_backend ) m_backend->DrawText( text, f, p, position, rectSize );
+}
\ No newline at end of file
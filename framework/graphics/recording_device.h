@@ -0,0 +1,217 @@
+#ifndef RECORDING_DEVICE_INCLUDED
+#define RECORDING_DEVICE_INCLUDED
+
+#include "idevice.h"
+#include "core\containers.h"
+#include <stdio.h>
+
+// Records every call made through the rendering interface, with draw / upload counts and
+// live resource sizes, then forwards it to an optional backend.
+// With no backend it is a no-op device that can run whole frames without a window or a GPU.
+// Resources come back as dummy handles that are only good for passing back in, effects find every
+// technique and variable asked for, and staging / locked textures are cpu memory, left cleared.
+// Files can't be loaded or saved without a backend.
+class RecordingDevice : public IDevice
+{
+public:
+	enum CommandType
+	{
+		CmdFlush = 0,
+		CmdResetShaderState,
+		CmdPresent,
+		CmdSetViewport,
+		CmdSetRenderTargets,
+		CmdSetPrimitiveTopology,
+		CmdSetInputLayout,
+		CmdSetVertexBuffer,
+		CmdSetIndexBuffer,
+		CmdSetTechnique,
+		CmdSetSampler,
+		CmdSetConstant,
+		CmdDrawIndexed,
+		CmdClearDepth,
+		CmdClearColour,
+		CmdCopyTexture,
+		CmdSaveTexture,
+		CmdLockTexture,
+		CmdLockVB,
+		CmdUpdateVB,
+		CmdLockIB,
+		CmdUpdateIB,
+		CmdDrawText,
+		CmdCreate,
+		CmdRelease,
+
+		MaxCommandTypes
+	};
+
+	enum ResourceType
+	{
+		ResTexture = 0,
+		ResRendertarget,
+		ResDepthStencil,
+		ResVertexBuffer,
+		ResIndexBuffer,
+		ResInputLayout,
+		ResEffect,
+		ResFont,
+
+		MaxResourceTypes
+	};
+
+	// mArg0/mArg1 depend on the type, see WriteLog
+	struct Command
+	{
+		CommandType mType;
+		unsigned int mArg0;
+		unsigned int mArg1;
+	};
+
+	struct Stats
+	{
+		unsigned int mCommandCounts[MaxCommandTypes];
+		unsigned int mDrawCalls;
+		unsigned int mIndicesDrawn;
+		size_t mBytesUploaded;		// VB / IB / texture writes from the cpu
+
+		int mLiveResources[MaxResourceTypes];
+		size_t mLiveBytes[MaxResourceTypes];
+		size_t mPeakBytes;			// high water mark of all live resources
+	};
+
+	// the back buffer size is only used when there is no backend
+	RecordingDevice( IDevice* backend = NULL, int backBufferWidth = 0, int backBufferHeight = 0 );
+	~RecordingDevice();
+
+	// clears the command log and the per-frame counters, live resources are kept
+	void ResetFrame();
+
+	inline const Stats& GetStats() const
+	{
+		return m_stats;
+	}
+
+	inline const std::vector<Command>& GetCommands() const
+	{
+		return m_commands;
+	}
+
+	inline size_t GetTotalLiveBytes() const
+	{
+		size_t total = 0;
+		for( int i = 0; i < MaxResourceTypes; ++i )
+		{
+			total += m_stats.mLiveBytes[i];
+		}
+		return total;
+	}
+
+	// plain text, one command per line, then the stats. Stable between runs so logs can be diffed
+	bool WriteLog( const char* fileName ) const;
+	void WriteLog( FILE* f ) const;
+
+	static const char* GetCommandName( CommandType t );
+	static const char* GetResourceName( ResourceType t );
+	static size_t GetTextureByteSize( const Texture2D::Parameters& p );
+
+	// IDevice
+	void Flush();
+	void ResetShaderState();
+
+	Rendertarget& GetBackBuffer();
+	Texture2D GetBackBufferTexture();
+	DepthStencilBuffer& GetDepthStencilBuffer();
+
+	void PresentBackbuffer();
+
+	void SetViewport( Viewport& vp );
+	void SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget );
+	void SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget );
+	void SetPrimitiveTopology(PrimitiveTopology t);
+	void SetInputLayout(ShaderInputLayout& l);
+	void SetVertexBuffer(int streamIndex, VertexBuffer& vb);
+	void SetIndexBuffer(IndexBuffer& ib);
+	void SetTechnique(EffectTechnique& technique, int pass);
+	void SetSampler( TextureSampler& s, Texture2D& t );
+	void SetConstant( VectorConstant& c, const float* v );
+	void SetConstant( MatrixConstant& c, const float* m );
+	void SetConstants( ConstantBlock& c, const void* data, unsigned int size );
+
+	void DrawIndexed(DrawIndexedParameters& params);
+	bool ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil );
+	bool ClearTarget( const Rendertarget& rt, float clearColour[4] );
+
+	Rendertarget CreateRendertarget( const Rendertarget::Parameters params );
+	void Release( Rendertarget& r );
+
+	DepthStencilBuffer CreateDepthStencil( const DepthStencilBuffer::Parameters& params );
+	void Release( DepthStencilBuffer& d );
+
+	LockedTexture2D LockTexture(Texture2D& t, Texture2D::CPUAccess);
+	void UnlockTexture(LockedTexture2D& t);
+	void* MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait);
+	void UnmapStagingTexture(Texture2D& t);
+	void CopyTextureToTexture(Texture2D& src, Texture2D& dst);
+	bool SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type);
+
+	void* LockVB(VertexBuffer& vb);
+	void UnlockVB(VertexBuffer& vb);
+	void UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount);
+
+	void* LockIB(IndexBuffer& ib);
+	void UnlockIB(IndexBuffer& ib);
+	void UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount);
+
+	Texture2D CreateTexture( Texture2D::Parameters params );
+	Texture2D LoadTextureFromFile( const char* fileName );
+	void Release( Texture2D& t );
+
+	VertexBuffer CreateVB( VertexBuffer::Parameters params );
+	void Release(VertexBuffer& vb);
+
+	IndexBuffer CreateIB( IndexBuffer::Parameters params );
+	void Release(IndexBuffer& ib);
+
+	ShaderInputLayout CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd );
+	void Release(ShaderInputLayout& l);
+
+	Effect CreateEffect(Effect::Parameters params);
+	void Release(Effect& e);
+	EffectTechnique GetTechnique( Effect& e, const char* name );
+	TextureSampler GetSampler( Effect& e, const char* name );
+	VectorConstant GetVectorConstant( Effect& e, const char* name );
+	MatrixConstant GetMatrixConstant( Effect& e, const char* name );
+	ConstantBlock GetConstantBlock( Effect& e, const char* name );
+
+	Font CreateFont(Font::Parameters params);
+	void Release(Font &f);
+	void DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize = Vector2(0,0));
+
+private:
+	void _record( CommandType t, unsigned int arg0 = 0, unsigned int arg1 = 0 );
+	void _created( ResourceType t, const void* handle, size_t bytes );
+	void _released( ResourceType t, const void* handle );
+	void* _makeHandle();
+	void* _getCpuTexture( const Texture2D& t );
+	static size_t _getBytesPerPixel( Texture2D::TextureFormat format );
+
+	struct Allocation
+	{
+		ResourceType mType;
+		size_t mBytes;
+	};
+
+	IDevice* m_backend;
+	std::vector<Command> m_commands;
+	Stats m_stats;
+	std::map<const void*, Allocation> m_allocations;	// keyed on the underlying resource
+
+	// handed out when there is no backend
+	size_t m_nextHandle;
+	Texture2D m_nullBackBufferTexture;
+	Rendertarget m_nullBackBuffer;
+	DepthStencilBuffer m_nullDepthStencil;
+	std::map< TextureHandle, std::vector<unsigned char> > m_cpuTextures;	// staging and locked textures
+};
+
+#endif
\ No newline at end of file
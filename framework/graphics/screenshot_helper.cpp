@@ -1,21 +1,44 @@
 #include "screenshot_helper.h"
-#include "device.h"
+#include "idevice.h"
+#include "capture_stream.h"
+#include "command_submitter.h"
+#include <stdio.h>
 
 ScreenshotHelper::ScreenshotHelper()
+	: m_slots(NULL)
+	, m_slotCount(0)
+	, m_nextSlot(0)
+	, m_frame(0)
+	, m_latency(0)
+	, m_droppedCount(0)
+	, m_encoder(NULL)
+	, m_device(NULL)
+	, m_submitter(NULL)
 {
-	m_stagingTexture.Invalidate();
 }
 
 ScreenshotHelper::~ScreenshotHelper()
 {
 }
 
-void ScreenshotHelper::Initialise( Device* d )
+void ScreenshotHelper::Initialise( IDevice* d, ImageEncoder* encoder, int ringSize, int latencyFrames, CommandSubmitter* submitter )
 {
+	m_device = d;
+	m_encoder = encoder;
+	m_submitter = submitter;
+	m_latency = latencyFrames;
+	m_frame = 0;
+	m_nextSlot = 0;
+
 	// get the back buffer so we can grab its parameters
 	Texture2D backBuffer = d->GetBackBufferTexture();
+	if( backBuffer.GetParameters().format != Texture2D::TypeInt8UnNormalised )
+	{
+		printf("Screenshots need an RGBA8 back buffer\n");
+		return;
+	}
 
-	// now make a staging texture with similar properties
+	// now make staging textures with similar properties
 	Texture2D::Parameters stagingParams;
 	stagingParams.access = Texture2D::CpuRead;
 	stagingParams.bindFlags = 0;
@@ -26,25 +49,240 @@ void ScreenshotHelper::Initialise( Device* d )
 	stagingParams.numMips = 1;
 	stagingParams.width = backBuffer.GetParameters().width;
 	stagingParams.stagingTexture = true;
-	m_stagingTexture = d->CreateTexture( stagingParams );
 
-	m_device = d;
+	m_slots = new Slot[ringSize];
+	m_slotCount = ringSize;
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		m_slots[i].mStaging = d->CreateTexture( stagingParams );
+		m_slots[i].mState = SlotFree;
+		m_slots[i].mFrame = 0;
+		m_slots[i].mFence = 0;
+		m_slots[i].mStream = NULL;
+	}
 }
 
 void ScreenshotHelper::Release()
 {
-	m_device->Release( m_stagingTexture );
+	Flush();
+
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		m_device->Release( m_slots[i].mStaging );
+	}
+	delete [] m_slots;
+	m_slots = NULL;
+	m_slotCount = 0;
+}
+
+ScreenshotHelper::Slot* ScreenshotHelper::_acquireSlot()
+{
+	if( m_slotCount == 0 )
+	{
+		return NULL;
+	}
+
+	// the ring is used in order, so the next slot always holds the oldest capture
+	Slot& s = m_slots[m_nextSlot];
+	if( s.mState == SlotCopied )
+	{
+		_startEncode( s, true );
+	}
+	if( s.mState == SlotEncoding )
+	{
+		_finishEncode( s, true );
+	}
+	m_nextSlot = (m_nextSlot + 1) % m_slotCount;
+
+	// Copy the back buffer to the staging texture, it is read once the GPU gets round to it
+	Texture2D backBuffer = m_device->GetBackBufferTexture();
+	m_device->CopyTextureToTexture( backBuffer, s.mStaging );
+
+	s.mState = SlotCopied;
+	s.mFrame = m_frame;
+	s.mFence = 0;
+	s.mStream = NULL;
+
+	return &s;
+}
+
+void ScreenshotHelper::TakeScreenshot( const char* fileName, ImageEncoder::Format format )
+{
+	Slot* s = _acquireSlot();
+	if( s )
+	{
+		s->mJob.mFormat = format;
+		sprintf_s( s->mJob.mFileName, "%s", fileName );
+	}
 }
 
-void ScreenshotHelper::TakeScreenshot( const char* fileName )
+void ScreenshotHelper::CaptureToStream( CaptureStream& stream )
 {
-	// build the full file name
-	char fullFilename[512] = {'\0'};
-	sprintf_s(fullFilename, "%s.jpg", fileName);
+	Slot* s = _acquireSlot();
+	if( s )
+	{
+		s->mStream = &stream;
+	}
+}
 
-	// Copy the back buffer to the staging texture (so we can read it)
-	m_device->CopyTextureToTexture( m_device->GetBackBufferTexture(), m_stagingTexture );
+void ScreenshotHelper::Submitted( unsigned int fence )
+{
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		if( m_slots[i].mState == SlotCopied && m_slots[i].mFence == 0 )
+		{
+			m_slots[i].mFence = fence;
+		}
+	}
+}
 
-	// Finally, write the texture to the file
-	m_device->SaveTextureToFile( m_stagingTexture, fullFilename, Device::TextureTypeJPG );
+void ScreenshotHelper::Update()
+{
+	++m_frame;
+
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		Slot& s = m_slots[i];
+		if( s.mState == SlotEncoding )
+		{
+			_finishEncode( s, false );
+		}
+		if( s.mState == SlotCopied && (m_frame - s.mFrame) >= m_latency )
+		{
+			_startEncode( s, false );
+		}
+	}
+}
+
+void ScreenshotHelper::Flush()
+{
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		// oldest first, so files are written in the order they were taken
+		Slot& s = m_slots[(m_nextSlot + i) % m_slotCount];
+		if( s.mState == SlotCopied )
+		{
+			_startEncode( s, true );
+		}
+	}
+
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		if( m_slots[i].mState == SlotEncoding )
+		{
+			_finishEncode( m_slots[i], true );
+		}
+	}
+}
+
+int ScreenshotHelper::GetPendingCount() const
+{
+	int count = 0;
+	for( int i = 0; i < m_slotCount; ++i )
+	{
+		if( m_slots[i].mState != SlotFree )
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+bool ScreenshotHelper::_startEncode( Slot& s, bool wait )
+{
+	if( m_submitter )
+	{
+		// a copy that hasn't executed yet would map the old contents without waiting
+		if( s.mFence == 0 )
+		{
+			if( wait )
+			{
+				// not even submitted, there is nothing to wait for. Only happens when one frame
+				// takes more captures than the ring holds
+				_drop( s, "more captures in one frame than the ring holds" );
+			}
+			return false;
+		}
+
+		if( wait )
+		{
+			m_submitter->WaitFor( s.mFence );
+		}
+		else if( !m_submitter->IsComplete( s.mFence ) )
+		{
+			return false;
+		}
+	}
+
+	unsigned int rowPitch = 0;
+	void* pixels = m_device->MapStagingTexture( s.mStaging, rowPitch, wait );
+	if( pixels == NULL )
+	{
+		if( wait )
+		{
+			// can't be read, drop it rather than getting stuck
+			_drop( s, "the staging texture couldn't be mapped" );
+		}
+		return false;
+	}
+
+	if( s.mStream )
+	{
+		// the stream takes its own copy, so the texture can be recycled straight away
+		s.mStream->AddFrame( pixels, rowPitch );
+		m_device->UnmapStagingTexture( s.mStaging );
+		s.mState = SlotFree;
+		return true;
+	}
+
+	s.mJob.mPixels = pixels;
+	s.mJob.mRowPitch = rowPitch;
+	s.mJob.mWidth = s.mStaging.GetParameters().width;
+	s.mJob.mHeight = s.mStaging.GetParameters().height;
+	s.mState = SlotEncoding;
+
+	if( m_encoder )
+	{
+		// blocks if the encoder is behind, which keeps the number of captures in flight bounded
+		m_encoder->Encode( &s.mJob );
+	}
+	else
+	{
+		s.mJob.mSucceeded = ImageEncoder::EncodeNow( s.mJob );
+		s.mJob.mDone = 1;
+	}
+
+	return true;
+}
+
+bool ScreenshotHelper::_finishEncode( Slot& s, bool wait )
+{
+	if( !s.mJob.IsDone() )
+	{
+		if( !wait )
+		{
+			return false;
+		}
+		m_encoder->WaitFor( s.mJob );
+	}
+
+	m_device->UnmapStagingTexture( s.mStaging );
+	s.mJob.mPixels = NULL;
+	s.mState = SlotFree;
+
+	return true;
+}
+
+void ScreenshotHelper::_drop( Slot& s, const char* reason )
+{
+	++m_droppedCount;
+	if( s.mStream )
+	{
+		printf("Dropped a captured frame, %s\n", reason);
+	}
+	else
+	{
+		printf("Dropped screenshot '%s', %s\n", s.mJob.mFileName, reason);
+	}
+	s.mState = SlotFree;
 }
\ No newline at end of file
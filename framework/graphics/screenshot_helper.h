@@ -2,22 +2,95 @@
 #define SCREENSHOT_HELPER_INCLUDED
 
 #include "device_types.h"
+#include "image_encoder.h"
 
+class IDevice;
+class CaptureStream;
+class CommandSubmitter;
+
+// Captures the back buffer without stalling the frame
+// Each capture is copied to one of a ring of staging textures, mapped a few frames later once
+// the GPU is done with it, and handed straight to the encoder threads. The staging texture
+// stays mapped until the file is written, so screenshots are never copied on the CPU.
+// If the copies are recorded into command lists, pass the submitter and call Submitted once the
+// list is on its way, so nothing is mapped before its copy has executed
 class ScreenshotHelper
 {
 public:
 	ScreenshotHelper();
 	~ScreenshotHelper();
 
-	void Initialise( Device* d );
-	void Release();
+	// encoder can be NULL, files are then written on the calling thread
+	void Initialise( IDevice* d, ImageEncoder* encoder = NULL, int ringSize = 4, int latencyFrames = 2, CommandSubmitter* submitter = NULL );
+	void Release();		// writes anything still pending first
+
+	inline void SetDevice( IDevice* d )
+	{
+		m_device = d;
+	}
+
+	// the captures taken since the last call went out in the submission with this fence
+	void Submitted( unsigned int fence );
+
+	// if every staging texture is busy, this waits for the oldest capture
+	void TakeScreenshot( const char* fileName, ImageEncoder::Format format = ImageEncoder::FormatJPEG );
+
+	// same, but the frame is appended to a stream (which must match the back buffer size)
+	void CaptureToStream( CaptureStream& stream );
+
+	// call once a frame, starts encoding captures that are old enough and recycles written ones
+	void Update();
+
+	// blocks until every capture is on disk
+	void Flush();
 
-	void TakeScreenshot( const char* fileName );
+	// captures taken but not yet written
+	int GetPendingCount() const;
+
+	// captures thrown away, because a frame took more than the ring holds or a staging
+	// texture couldn't be mapped
+	inline int GetDroppedCount() const
+	{
+		return m_droppedCount;
+	}
 
 private:
+	ScreenshotHelper( const ScreenshotHelper& );
+	ScreenshotHelper& operator=( const ScreenshotHelper& );
+
+	enum SlotState
+	{
+		SlotFree,
+		SlotCopied,		// waiting for the GPU
+		SlotEncoding	// mapped, owned by the encoder
+	};
+
+	struct Slot
+	{
+		Texture2D mStaging;
+		SlotState mState;
+		unsigned int mFrame;
+		unsigned int mFence;		// 0 until the copy has been submitted
+		ImageEncoder::Job mJob;
+		CaptureStream* mStream;		// if set, the frame goes here instead of the encoder
+	};
+
+	Slot* _acquireSlot();
+
+	bool _startEncode( Slot& s, bool wait );
+	bool _finishEncode( Slot& s, bool wait );
+	void _drop( Slot& s, const char* reason );
+
+	Slot* m_slots;
+	int m_slotCount;
+	int m_nextSlot;
+	unsigned int m_frame;
+	unsigned int m_latency;
+	int m_droppedCount;
 
-	Texture2D m_stagingTexture;
-	Device* m_device;
+	ImageEncoder* m_encoder;
+	IDevice* m_device;
+	CommandSubmitter* m_submitter;
 };
 
 #endif
\ No newline at end of file
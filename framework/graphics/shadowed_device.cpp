@@ -0,0 +1,287 @@
+#include "shadowed_device.h"
+#include <string.h>
+
+void ShadowedDevice::Invalidate()
+{
+	m_viewportValid = false;
+	for(int i=0;i<kuMaxRenderTargets;++i)
+	{
+		m_colourTargets[i].Invalidate();
+	}
+	m_colourTargetCount = 0;
+	m_depthStencilBuffer.Invalidate();
+	m_renderTargetsValid = false;
+	m_primitiveType = PRIMITIVE_NA;
+	m_inputLayout.Invalidate();
+
+	for(int i=0;i<kuMaxVertexBuffers;++i)
+	{
+		m_vertexBuffers[i].Invalidate();
+	}
+
+	m_indexBuffer.Invalidate();
+	m_shaderTechnique.Invalidate();
+	m_pass = -1;
+	m_variablesDirty = true;
+	m_variableCount = 0;
+}
+
+void ShadowedDevice::Flush()
+{
+	m_device->Flush();
+	Invalidate();
+}
+
+void ShadowedDevice::ResetShaderState()
+{
+	// unbinds the shader resources, the next pass has to be applied again to rebind them
+	m_device->ResetShaderState();
+	m_shaderTechnique.Invalidate();
+}
+
+void ShadowedDevice::SetViewport( Viewport& vp )
+{
+	if( !m_viewportValid || vp != m_viewport )
+	{
+		m_viewport = vp;
+		m_viewportValid = true;
+		m_device->SetViewport( vp );
+		_applied( ShadowPerfGrab::NumViewportChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget )
+{
+	Rendertarget* targets[1] = { colourTarget };
+	SetRenderTargets( targets, colourTarget != NULL ? 1 : 0, depthStencilTarget );
+}
+
+void ShadowedDevice::SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget )
+{
+	targetCount = targetCount < (int)kuMaxRenderTargets ? targetCount : (int)kuMaxRenderTargets;
+
+	DepthStencilBuffer depth;
+	if( depthStencilTarget )
+	{
+		depth = *depthStencilTarget;
+	}
+
+	bool changed = !m_renderTargetsValid || targetCount != m_colourTargetCount || depth != m_depthStencilBuffer;
+	for( int i = 0; i < targetCount && !changed; ++i )
+	{
+		Rendertarget rt;
+		if( colourTargets[i] )
+		{
+			rt = *colourTargets[i];
+		}
+		changed = rt != m_colourTargets[i];
+	}
+
+	if( !changed )
+	{
+		_filtered();
+		return;
+	}
+
+	for( int i = 0; i < (int)kuMaxRenderTargets; ++i )
+	{
+		m_colourTargets[i].Invalidate();
+		if( i < targetCount && colourTargets[i] )
+		{
+			m_colourTargets[i] = *colourTargets[i];
+		}
+	}
+	m_colourTargetCount = targetCount;
+	m_depthStencilBuffer = depth;
+	m_renderTargetsValid = true;
+
+	m_device->SetRenderTargets( colourTargets, targetCount, depthStencilTarget );
+	_applied( ShadowPerfGrab::NumRenderTargetChanges );
+
+	// binding a target unbinds it as a shader resource, so the next pass has to be applied again
+	m_shaderTechnique.Invalidate();
+}
+
+void ShadowedDevice::SetPrimitiveTopology(PrimitiveTopology t)
+{
+	if( t != m_primitiveType )
+	{
+		m_primitiveType = t;
+		m_device->SetPrimitiveTopology(t);
+		_applied( ShadowPerfGrab::NumTopologyChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetInputLayout(ShaderInputLayout& l)
+{
+	if( l != m_inputLayout )
+	{
+		m_inputLayout = l;
+		m_device->SetInputLayout(l);
+		_applied( ShadowPerfGrab::NumInputLayoutChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetVertexBuffer(int streamIndex, VertexBuffer& vb)
+{
+	if( streamIndex >= 0 && streamIndex < (int)kuMaxVertexBuffers && !(vb != m_vertexBuffers[streamIndex]) )
+	{
+		_filtered();
+		return;
+	}
+
+	if( streamIndex >= 0 && streamIndex < (int)kuMaxVertexBuffers )
+	{
+		m_vertexBuffers[streamIndex] = vb;
+	}
+	m_device->SetVertexBuffer(streamIndex, vb);
+	_applied( ShadowPerfGrab::NumVBChanges );
+}
+
+void ShadowedDevice::SetIndexBuffer(IndexBuffer& ib)
+{
+	if( ib != m_indexBuffer )
+	{
+		m_indexBuffer = ib;
+		m_device->SetIndexBuffer(ib);
+		_applied( ShadowPerfGrab::NumIBChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetTechnique(EffectTechnique& technique, int pass)
+{
+	// applying the pass is what commits the effect variables, so a change to any of them forces it
+	if( m_variablesDirty || technique != m_shaderTechnique || pass != m_pass || !m_shaderTechnique.IsValid() )
+	{
+		m_shaderTechnique = technique;
+		m_pass = pass;
+		m_variablesDirty = false;
+
+		m_device->SetTechnique(technique, pass);
+		_applied( ShadowPerfGrab::NumEffectChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+bool ShadowedDevice::_updateVariable( const void* variable, const void* value, size_t size )
+{
+	if( variable == NULL )
+	{
+		return true;
+	}
+
+	for( int i = 0; i < m_variableCount; ++i )
+	{
+		if( m_variables[i].mVariable == variable )
+		{
+			if( memcmp( &m_variables[i].mValue, value, size ) == 0 )
+			{
+				return false;
+			}
+			memcpy( &m_variables[i].mValue, value, size );
+			return true;
+		}
+	}
+
+	// not seen yet, remember it if there is room
+	if( m_variableCount < (int)kuMaxCachedVariables )
+	{
+		m_variables[m_variableCount].mVariable = variable;
+		memcpy( &m_variables[m_variableCount].mValue, value, size );
+		++m_variableCount;
+	}
+
+	return true;
+}
+
+void ShadowedDevice::SetSampler( TextureSampler& s, Texture2D& t )
+{
+	const size_t textureId = t.GetID();
+	if( _updateVariable( s.m_sampler, &textureId, sizeof(textureId) ) )
+	{
+		m_device->SetSampler( s, t );
+		m_variablesDirty = true;
+		_applied( ShadowPerfGrab::NumSamplerChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetConstant( VectorConstant& c, const float* v )
+{
+	if( _updateVariable( c.m_variable, v, sizeof(float) * 4 ) )
+	{
+		m_device->SetConstant( c, v );
+		m_variablesDirty = true;
+		_applied( ShadowPerfGrab::NumConstantChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetConstant( MatrixConstant& c, const float* m )
+{
+	if( _updateVariable( c.m_variable, m, sizeof(float) * 16 ) )
+	{
+		m_device->SetConstant( c, m );
+		m_variablesDirty = true;
+		_applied( ShadowPerfGrab::NumConstantChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::SetConstants( ConstantBlock& c, const void* data, unsigned int size )
+{
+	// blocks too big for the cache always go through
+	const bool changed = size > sizeof(float) * 16 || _updateVariable( (const void*)c.GetID(), data, size );
+	if( changed )
+	{
+		m_device->SetConstants( c, data, size );
+		m_variablesDirty = true;
+		_applied( ShadowPerfGrab::NumConstantChanges );
+	}
+	else
+	{
+		_filtered();
+	}
+}
+
+void ShadowedDevice::DrawIndexed(DrawIndexedParameters& params)
+{
+	m_device->DrawIndexed(params);
+
+	DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumDrawCalls));
+}
+
+void ShadowedDevice::DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize)
+{
+	// the font sprite sets its own shaders, buffers and state
+	m_device->DrawText( text, f, p, position, rectSize );
+	Invalidate();
+}
\ No newline at end of file
@@ -2,7 +2,7 @@
 #define SHADOWED_DEVICE_INCLUDED
 
 #include "device_types.h"
-#include "device.h"
+#include "idevice.h"
 #include "perf_grab.h"
 
 // Performance grabs
@@ -14,6 +14,14 @@ namespace ShadowPerfGrab
 		NumVBChanges,
 		NumEffectChanges,
 		NumDrawCalls,
+		NumRenderTargetChanges,
+		NumViewportChanges,
+		NumTopologyChanges,
+		NumInputLayoutChanges,
+		NumSamplerChanges,
+		NumConstantChanges,
+		NumAppliedStateChanges,		// everything above that reached the device
+		NumFilteredStateChanges,	// redundant changes that were dropped
 
 		MaxPerfGrabs
 	};
@@ -22,18 +30,30 @@ namespace ShadowPerfGrab
 DeclarePerfGrab(ShadowDevicePerfs,ShadowPerfGrab::MaxPerfGrabs,ShadowPerfGrab::Stats);
 //////////////////
 
-class ShadowedDevice
+// Filters redundant state changes before they reach the device it wraps.
+// Every renderer should talk to one of these rather than the device itself.
+// Anything that changes device state behind the shadow's back (font rendering, Flush)
+// invalidates it, so the next change always goes through.
+class ShadowedDevice : public IDevice
 {
 public:
-	ShadowedDevice(Device* d)
+	ShadowedDevice(IDevice* d=NULL)
 		: m_device(d)
 	{
 		Invalidate();
 	}
 
 	static const unsigned int kuMaxVertexBuffers = 16;
+	static const unsigned int kuMaxRenderTargets = 8;
+	static const unsigned int kuMaxCachedVariables = 32;
 
-	inline Device& GetDevice()
+	inline void SetDevice(IDevice* d)
+	{
+		m_device = d;
+		Invalidate();
+	}
+
+	inline IDevice& GetDevice()
 	{
 		return *m_device;
 	}
@@ -48,104 +68,120 @@ public:
 	{
 	}
 
-	inline void SetRenderTargets( Rendertarget& colourTarget, DepthStencilBuffer& depthStencilTarget )
-	{
-		if( (colourTarget != m_colourTarget) || (depthStencilTarget != m_depthStencilBuffer) )
-		{
-			m_colourTarget = colourTarget;
-			m_depthStencilBuffer = depthStencilTarget;
-
-			m_device->SetRenderTargets(&colourTarget, &depthStencilTarget);
-		}
-	}
-
-	inline void SetPrimitiveTopology(PrimitiveTopology t)
-	{
-		if( t != m_primitiveType )
-		{
-			m_primitiveType = t;
-			m_device->SetPrimitiveTopology(t);
-		}
-	}
-
-	inline void SetInputLayout(ShaderInputLayout& l)
-	{
-		if(l != m_inputLayout )
-		{
-			m_inputLayout = l;
-			m_device->SetInputLayout(l);
-		}
-	}
+	void Invalidate();
+
+	// IDevice
+	void Flush();
+	void ResetShaderState();
+
+	Rendertarget& GetBackBuffer()					{ return m_device->GetBackBuffer(); }
+	Texture2D GetBackBufferTexture()				{ return m_device->GetBackBufferTexture(); }
+	DepthStencilBuffer& GetDepthStencilBuffer()		{ return m_device->GetDepthStencilBuffer(); }
+
+	void PresentBackbuffer()						{ m_device->PresentBackbuffer(); }
+
+	void SetViewport( Viewport& vp );
+	void SetRenderTargets( Rendertarget* colourTarget, DepthStencilBuffer* depthStencilTarget );
+	void SetRenderTargets( Rendertarget** colourTargets, int targetCount, DepthStencilBuffer* depthStencilTarget );
+	void SetPrimitiveTopology(PrimitiveTopology t);
+	void SetInputLayout(ShaderInputLayout& l);
+	void SetVertexBuffer(int streamIndex, VertexBuffer& vb);
+	void SetIndexBuffer(IndexBuffer& ib);
+	void SetTechnique(EffectTechnique& technique, int pass);
+	void SetSampler( TextureSampler& s, Texture2D& t );
+	void SetConstant( VectorConstant& c, const float* v );
+	void SetConstant( MatrixConstant& c, const float* m );
+	void SetConstants( ConstantBlock& c, const void* data, unsigned int size );
+
+	void DrawIndexed(DrawIndexedParameters& params);
+	bool ClearTarget( const DepthStencilBuffer& rt, float depth, unsigned int stencil )		{ return m_device->ClearTarget( rt, depth, stencil ); }
+	bool ClearTarget( const Rendertarget& rt, float clearColour[4] )						{ return m_device->ClearTarget( rt, clearColour ); }
+
+	// resources are passed straight through. A released handle can be reused by the next
+	// create, so releasing anything drops the cached state
+	Rendertarget CreateRendertarget( const Rendertarget::Parameters params )				{ return m_device->CreateRendertarget( params ); }
+	void Release( Rendertarget& r )															{ m_device->Release( r ); Invalidate(); }
+	DepthStencilBuffer CreateDepthStencil( const DepthStencilBuffer::Parameters& params )	{ return m_device->CreateDepthStencil( params ); }
+	void Release( DepthStencilBuffer& d )													{ m_device->Release( d ); Invalidate(); }
+
+	LockedTexture2D LockTexture(Texture2D& t, Texture2D::CPUAccess a)						{ return m_device->LockTexture( t, a ); }
+	void UnlockTexture(LockedTexture2D& t)													{ m_device->UnlockTexture( t ); }
+	void* MapStagingTexture(Texture2D& t, unsigned int& rowPitch, bool wait)				{ return m_device->MapStagingTexture( t, rowPitch, wait ); }
+	void UnmapStagingTexture(Texture2D& t)													{ m_device->UnmapStagingTexture( t ); }
+	void CopyTextureToTexture(Texture2D& src, Texture2D& dst)								{ m_device->CopyTextureToTexture( src, dst ); }
+	bool SaveTextureToFile(Texture2D& t, const char* fileName, TextureFileType type)		{ return m_device->SaveTextureToFile( t, fileName, type ); }
+
+	void* LockVB(VertexBuffer& vb)															{ return m_device->LockVB( vb ); }
+	void UnlockVB(VertexBuffer& vb)															{ m_device->UnlockVB( vb ); }
+	void UpdateVB(VertexBuffer& vb, const void* data, unsigned int byteOffset, unsigned int byteCount)	{ m_device->UpdateVB( vb, data, byteOffset, byteCount ); }
+	void* LockIB(IndexBuffer& ib)															{ return m_device->LockIB( ib ); }
+	void UnlockIB(IndexBuffer& ib)															{ m_device->UnlockIB( ib ); }
+	void UpdateIB(IndexBuffer& ib, const void* data, unsigned int byteOffset, unsigned int byteCount)	{ m_device->UpdateIB( ib, data, byteOffset, byteCount ); }
+
+	Texture2D CreateTexture( Texture2D::Parameters params )									{ return m_device->CreateTexture( params ); }
+	Texture2D LoadTextureFromFile( const char* fileName )									{ return m_device->LoadTextureFromFile( fileName ); }
+	void Release( Texture2D& t )															{ m_device->Release( t ); Invalidate(); }
+
+	VertexBuffer CreateVB( VertexBuffer::Parameters params )								{ return m_device->CreateVB( params ); }
+	void Release(VertexBuffer& vb)															{ m_device->Release( vb ); Invalidate(); }
+	IndexBuffer CreateIB( IndexBuffer::Parameters params )									{ return m_device->CreateIB( params ); }
+	void Release(IndexBuffer& ib)															{ m_device->Release( ib ); Invalidate(); }
+
+	ShaderInputLayout CreateVertexInputLayout( Effect& effect, VertexDescriptor& vd )		{ return m_device->CreateVertexInputLayout( effect, vd ); }
+	void Release(ShaderInputLayout& l)														{ m_device->Release( l ); Invalidate(); }
+
+	Effect CreateEffect(Effect::Parameters params)											{ return m_device->CreateEffect( params ); }
+	void Release(Effect& e)																	{ m_device->Release( e ); Invalidate(); }
+	EffectTechnique GetTechnique( Effect& e, const char* name )								{ return m_device->GetTechnique( e, name ); }
+	TextureSampler GetSampler( Effect& e, const char* name )								{ return m_device->GetSampler( e, name ); }
+	VectorConstant GetVectorConstant( Effect& e, const char* name )							{ return m_device->GetVectorConstant( e, name ); }
+	MatrixConstant GetMatrixConstant( Effect& e, const char* name )							{ return m_device->GetMatrixConstant( e, name ); }
+	ConstantBlock GetConstantBlock( Effect& e, const char* name )							{ return m_device->GetConstantBlock( e, name ); }
+
+	Font CreateFont(Font::Parameters params)												{ return m_device->CreateFont( params ); }
+	void Release(Font &f)																	{ m_device->Release( f ); Invalidate(); }
+	void DrawText(const char* text, Font& f, Font::DrawParameters& p, Vector2 position, Vector2 rectSize = Vector2(0,0));
 
-	inline void SetVertexBuffer(int streamIndex, VertexBuffer& vb)
-	{
-		if( streamIndex < kuMaxVertexBuffers && vb != m_vertexBuffers[streamIndex] )
-		{
-			m_vertexBuffers[streamIndex] = vb;
-			m_device->SetVertexBuffer(streamIndex, vb);
-			DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumVBChanges));
-		}
-	}
-
-	inline void SetIndexBuffer(IndexBuffer& ib)
-	{
-		if( ib != m_indexBuffer )
-		{
-			m_indexBuffer = ib;
-			m_device->SetIndexBuffer(ib);
-			DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumIBChanges));
-		}
-	}
-
-	inline void Invalidate()
+private:
+	inline void _applied( int stat )
 	{
-		m_colourTarget.Invalidate();
-		m_depthStencilBuffer.Invalidate();
-		m_primitiveType = PRIMITIVE_NA;
-		m_inputLayout.Invalidate();
-
-		for(int i=0;i<kuMaxVertexBuffers;++i)
-		{
-			m_vertexBuffers[i].Invalidate();
-		}
-
-		m_indexBuffer.Invalidate();
-		m_shaderTechnique.Invalidate();
-		m_pass = -1;
+		DoPerfGrab(ShadowDevicePerfs::Increment(stat));
+		DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumAppliedStateChanges));
 	}
 
-	inline void DrawIndexed(DrawIndexedParameters& params)
+	inline void _filtered()
 	{
-		m_device->DrawIndexed(params);
-
-		DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumDrawCalls));
+		DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumFilteredStateChanges));
 	}
 
-	inline void SetTechnique(EffectTechnique& technique, int pass)
+	// the last value written to an effect variable
+	struct CachedVariable
 	{
-		if( technique != m_shaderTechnique || pass != m_pass || technique.m_dirty )
-		{
-			m_shaderTechnique = technique;
-			m_pass = pass;
-			technique.m_dirty = false;
-
-			m_device->SetTechnique(technique, pass);
-			DoPerfGrab(ShadowDevicePerfs::Increment(ShadowPerfGrab::NumEffectChanges));
-		}
-	}
+		const void* mVariable;
+		float mValue[16];		// vectors only use the first row
+	};
 
-private:
+	// returns true if the value changed (or couldn't be cached)
+	bool _updateVariable( const void* variable, const void* value, size_t size );
 
-	Rendertarget m_colourTarget;
+	Viewport m_viewport;
+	bool m_viewportValid;
+	Rendertarget m_colourTargets[kuMaxRenderTargets];
+	int m_colourTargetCount;
 	DepthStencilBuffer m_depthStencilBuffer;
+	bool m_renderTargetsValid;
 	PrimitiveTopology m_primitiveType;
 	ShaderInputLayout m_inputLayout;
 	VertexBuffer m_vertexBuffers[kuMaxVertexBuffers];
 	IndexBuffer m_indexBuffer;
 	EffectTechnique m_shaderTechnique;
 	int m_pass;
+	bool m_variablesDirty;	// samplers/constants changed since the pass was applied
+
+	CachedVariable m_variables[kuMaxCachedVariables];
+	int m_variableCount;
 
-	Device* m_device;
+	IDevice* m_device;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "sprite_batch.h"
+#include "framework\graphics\idevice.h"
+#include "core\radix_sort.h"
+#include <stdio.h>
+
+namespace
+{
+	struct BatchVertex
+	{
+		Vector2f mPosition;
+		Vector2f mUV;
+	};
+}
+
+SpriteBatch::SpriteBatch()
+	: mSortKeys(NULL)
+	, mSortedIndices(NULL)
+	, mSortScratch(NULL)
+	, mTechniqueCount(0)
+	, mDrawCalls(0)
+{
+}
+
+bool SpriteBatch::Create( IDevice& d, Parameters& p )
+{
+	if( !mSprites.init(p.mMaxSprites) )
+	{
+		return false;
+	}
+
+	mSortKeys = (unsigned int*)malloc( sizeof(unsigned int) * p.mMaxSprites );
+	mSortedIndices = (unsigned int*)malloc( sizeof(unsigned int) * p.mMaxSprites );
+	mSortScratch = (unsigned int*)malloc( sizeof(unsigned int) * p.mMaxSprites );
+	if( mSortKeys == NULL || mSortedIndices == NULL || mSortScratch == NULL )
+	{
+		return false;
+	}
+
+	m_shader = p.shader;
+	m_binding.Create( d, m_shader );
+	mTechniqueCount = 0;
+
+	return _initGraphics(d);
+}
+
+void SpriteBatch::Release( IDevice& d )
+{
+	mSprites.destroy();
+	mTextureSlots.clear();
+
+	free( mSortKeys );
+	free( mSortedIndices );
+	free( mSortScratch );
+	mSortKeys = mSortedIndices = mSortScratch = NULL;
+
+	d.Release( m_spriteVb );
+	d.Release( m_spriteIb );
+	d.Release( m_inputLayout );
+	m_binding.Release();
+	mTechniqueCount = 0;
+}
+
+void SpriteBatch::Begin()
+{
+	mSprites.deleteAll();
+	mTextureSlots.clear();
+}
+
+SpriteBatch::TechniqueID SpriteBatch::GetTechnique( const char* name )
+{
+	StringHashing::StringHash hash = StringHashing::getHash( name );
+	for( int t = 0; t < mTechniqueCount; ++t )
+	{
+		if( mTechniques[t].mNameHash == hash )
+		{
+			return t;
+		}
+	}
+
+	if( mTechniqueCount >= kMaxTechniques )
+	{
+		printf("SpriteBatch: too many techniques\n");
+		return -1;
+	}
+
+	// copy the handles out of the binding, AddSprite only ever sees the slot
+	Technique& t = mTechniques[mTechniqueCount];
+	t.mNameHash = hash;
+	t.mTechnique = m_binding.GetTechnique( name );
+	t.mSampler = m_binding.GetSampler( "BlitTexture" );
+	t.mPositionScale = m_binding.GetVectorConstant( "PositionScale" );
+	if( !t.mTechnique.IsValid() )
+	{
+		return -1;
+	}
+
+	return mTechniqueCount++;
+}
+
+unsigned int SpriteBatch::_getTextureSlot( const Texture2D& t )
+{
+	std::map<size_t, unsigned int>::iterator it = mTextureSlots.find( t.GetID() );
+	if( it != mTextureSlots.end() )
+	{
+		return it->second;
+	}
+
+	const unsigned int slot = (unsigned int)mTextureSlots.size();
+	mTextureSlots.insert( std::pair<size_t, unsigned int>( t.GetID(), slot ) );
+	return slot;
+}
+
+void SpriteBatch::AddSprite( Texture2D& texture, TechniqueID technique, Vector2f position, Vector2f scale,
+							 Vector2f uv0, Vector2f uv1 )
+{
+	if( technique < 0 || technique >= mTechniqueCount || !texture.IsValid() )
+	{
+		return;
+	}
+
+	Sprite* sp = mSprites.push_back();
+	if( sp == NULL )
+	{
+		return;	// batch is full
+	}
+
+	sp->mPosition = position;
+	sp->mScale = scale;
+	sp->mUV0 = uv0;
+	sp->mUV1 = uv1;
+	sp->mTexture = texture;
+	sp->mTechnique = technique;
+
+	// technique in the top byte, texture in the rest
+	mSortKeys[mSprites.size() - 1] = ((unsigned int)technique << 24) | (_getTextureSlot( texture ) & 0xffffff);
+}
+
+void SpriteBatch::Draw( IDevice& device, Vector2f startPosition, Vector2f scale )
+{
+	mDrawCalls = 0;
+
+	const int spriteCount = (int)mSprites.size();
+	if( spriteCount == 0 )
+	{
+		return;
+	}
+
+	RadixSort::SortIndices( mSortKeys, spriteCount, mSortedIndices, mSortScratch );
+
+	// write the quads in sorted order, so each run is contiguous in the vb
+	BatchVertex* vertices = (BatchVertex*)device.LockVB(m_spriteVb);
+	if( vertices == NULL )
+	{
+		return;
+	}
+
+	for( int i = 0; i < spriteCount; ++i )
+	{
+		const Sprite& s = *mSprites[mSortedIndices[i]];
+		BatchVertex v;
+
+		v.mPosition = s.mPosition + Vector2f(0.0f, 0.0f);		v.mUV = Vector2f(s.mUV0.x(),s.mUV1.y());
+		*vertices = v;	++vertices;
+
+		v.mPosition = s.mPosition + Vector2f(s.mScale.x(), 0.0f);	v.mUV = s.mUV1;
+		*vertices = v;	++vertices;
+
+		v.mPosition = s.mPosition + s.mScale;	v.mUV = Vector2f(s.mUV1.x(),s.mUV0.y());
+		*vertices = v;	++vertices;
+
+		v.mPosition = s.mPosition + Vector2f(0.0f, s.mScale.y());	v.mUV = s.mUV0;
+		*vertices = v;	++vertices;
+	}
+	device.UnlockVB(m_spriteVb);
+
+	device.SetInputLayout(m_inputLayout);
+	device.SetPrimitiveTopology(PRIMITIVE_TRIANGLES);
+	device.SetIndexBuffer(m_spriteIb);
+	device.SetVertexBuffer(0, m_spriteVb);
+
+	// one draw per run of identical keys
+	int runStart = 0;
+	while( runStart < spriteCount )
+	{
+		const unsigned int key = mSortKeys[mSortedIndices[runStart]];
+		int runEnd = runStart + 1;
+		while( runEnd < spriteCount && mSortKeys[mSortedIndices[runEnd]] == key )
+		{
+			++runEnd;
+		}
+
+		Sprite& first = *mSprites[mSortedIndices[runStart]];
+		Technique& t = mTechniques[first.mTechnique];
+		device.SetSampler( t.mSampler, first.mTexture );
+		const float positionScale[4] = { startPosition.x(), startPosition.y(), scale.x(), scale.y() };
+		device.SetConstant( t.mPositionScale, positionScale );
+		device.SetTechnique( t.mTechnique, 0 );
+
+		DrawIndexedParameters dp;
+		dp.m_indexCount = (unsigned int)(runEnd - runStart) * 6;
+		dp.m_pass = 0;
+		dp.m_startIndex = (unsigned int)runStart * 6;
+		device.DrawIndexed(dp);
+		++mDrawCalls;
+
+		runStart = runEnd;
+	}
+}
+
+bool SpriteBatch::_initGraphics( IDevice& d )
+{
+	VertexElement e;
+	e.byteOffset=0;
+	e.elementType = VertexElement::PerVertex;
+	e.format = VertexElement::VTX_FLOAT2;
+	e.SetSemanticName("POSITION");
+	m_vd.AddElement(e);
+	e.byteOffset += sizeof(Vector2f);
+	e.SetSemanticName("TEXCOORD");
+	m_vd.AddElement(e);
+
+	// the whole batch is rewritten each Draw
+	const unsigned int maxSprites = (unsigned int)mSprites.maxSize();
+	unsigned int vertexSize = m_vd.GetVertexSize(0);
+	VertexBuffer::Parameters vbParams;
+	vbParams.sourceBuffer = NULL;
+	vbParams.access = VertexBuffer::CpuWrite;
+	vbParams.stride = vertexSize;
+	vbParams.vertexCount = maxSprites * 4;
+	vbParams.vertexSize = vertexSize;
+	m_spriteVb = d.CreateVB( vbParams );
+
+	// 32 bit indices, galleries can go past 16k sprites
+	unsigned int* indices = new unsigned int[maxSprites * 6];
+	for( unsigned int tile = 0; tile < maxSprites; ++tile )
+	{
+		unsigned int i = tile * 4;
+		unsigned int* ind = indices + tile * 6;
+
+		*(ind + 0) = i + 0;
+		*(ind + 1) = i + 2;
+		*(ind + 2) = i + 1;
+		*(ind + 3) = i + 0;
+		*(ind + 4) = i + 3;
+		*(ind + 5) = i + 2;
+	}
+
+	IndexBuffer::Parameters ibParams;
+	ibParams.format = IndexBuffer::IB_32BIT;
+	ibParams.indexCount = maxSprites * 6;
+	ibParams.sourceBuffer = indices;
+	ibParams.access = IndexBuffer::CpuNoAccess;
+	m_spriteIb = d.CreateIB( ibParams );
+	delete [] indices;
+
+	m_inputLayout = d.CreateVertexInputLayout( m_shader, m_vd );
+
+	return m_spriteVb.IsValid() && m_spriteIb.IsValid();
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef SPRITE_BATCH_INCLUDED
+#define SPRITE_BATCH_INCLUDED
+
+#include "core\array.h"
+#include "core\containers.h"
+#include "framework\graphics\device_types.h"
+#include "framework\graphics\effect_binding.h"
+#include "core\vector2.h"
+
+class IDevice;
+
+// Sprite renderer for sprites that use different textures / techniques
+// Sprites are queued between Begin and Draw, then radix sorted on (technique, texture) so
+// each run of sprites sharing both is a single draw call
+class SpriteBatch
+{
+public:
+	struct Parameters
+	{
+		Parameters()
+			: mMaxSprites(0)
+		{
+		}
+		int mMaxSprites;
+		Effect shader;
+	};
+
+	// slot of a technique in the batch shader, -1 if there isn't one
+	typedef int TechniqueID;
+
+	SpriteBatch();
+
+	bool Create( IDevice& d, Parameters& p );
+	void Release( IDevice& d );
+
+	// creation time only, resolves a technique in the batch shader once. Asking again for the
+	// same name returns the same slot
+	TechniqueID GetTechnique( const char* name );
+
+	// clear all queued sprites
+	void Begin();
+
+	// technique comes from GetTechnique, uv0/uv1 select part of the texture
+	void AddSprite( Texture2D& texture, TechniqueID technique, Vector2f position, Vector2f scale=Vector2f(1.0f,1.0f),
+					Vector2f uv0=Vector2f(0.0f,0.0f), Vector2f uv1=Vector2f(1.0f,1.0f) );
+
+	// sort and submit everything added since Begin
+	void Draw( IDevice& device, Vector2f startPosition, Vector2f scale );
+
+	// number of draw calls issued by the last Draw
+	inline int GetDrawCallCount() const
+	{
+		return mDrawCalls;
+	}
+
+private:
+	static const int kMaxTechniques = 256;	// technique slot lives in the top byte of the sort key
+
+	struct Sprite
+	{
+		Vector2f mPosition;
+		Vector2f mScale;
+		Vector2f mUV0;
+		Vector2f mUV1;
+		Texture2D mTexture;
+		int mTechnique;
+	};
+
+	struct Technique
+	{
+		StringHashing::StringHash mNameHash;
+		EffectTechnique mTechnique;
+		TextureSampler mSampler;
+		VectorConstant mPositionScale;
+	};
+
+	unsigned int _getTextureSlot( const Texture2D& t );
+	bool _initGraphics( IDevice& d );
+
+	Array<Sprite> mSprites;
+	unsigned int* mSortKeys;
+	unsigned int* mSortedIndices;
+	unsigned int* mSortScratch;
+
+	// textures are numbered in the order they are first seen each frame
+	std::map<size_t, unsigned int> mTextureSlots;
+
+	Technique mTechniques[kMaxTechniques];
+	int mTechniqueCount;
+
+	int mDrawCalls;
+
+	Effect m_shader;
+	EffectBinding m_binding;
+	VertexDescriptor m_vd;
+	VertexBuffer m_spriteVb;
+	IndexBuffer m_spriteIb;
+	ShaderInputLayout m_inputLayout;
+};
+
+#endif
\ No newline at end of file
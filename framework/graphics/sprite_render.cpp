@@ -4,11 +4,24 @@
 
 struct SpriteVertex
 {
-	D3DXVECTOR2 mPosition;
-	D3DXVECTOR2 mUV;	
+	Vector2f mPosition;
+	Vector2f mUV;	
 };
 
-void SpriteRender::AddSprite( int spriteID, D3DXVECTOR2 position, D3DXVECTOR2 scale )
+SpriteRender::SpriteRender()
+	: mDirty(false)
+	, m_spritemap(NULL)
+	, mUploadedSprites(NULL)
+	, mUploadedUVs(NULL)
+	, mUploadedCount(0)
+	, mSpritemapVersion(0)
+	, mVertexScratch(NULL)
+	, mIDScratch(NULL)
+	, mUVScratch(NULL)
+{
+}
+
+void SpriteRender::AddSprite( int spriteID, Vector2f position, Vector2f scale )
 {
 	Sprite sp;
 	sp.position = position;
@@ -18,30 +31,41 @@ void SpriteRender::AddSprite( int spriteID, D3DXVECTOR2 position, D3DXVECTOR2 sc
 	mDirty = true;
 }
 
-void SpriteRender::Draw( Device& device, D3DXVECTOR2 startPosition, D3DXVECTOR2 scale, const char* technique )
+void SpriteRender::SetSprite( int index, int spriteID, Vector2f position, Vector2f scale )
+{
+	Sprite* sp = mSprites[index];
+	if( sp )
+	{
+		sp->position = position;
+		sp->scale = scale;
+		sp->spriteID = spriteID;
+		mDirty = true;
+	}
+}
+
+void SpriteRender::Draw( IDevice& device, Vector2f startPosition, Vector2f scale, EffectTechnique& technique )
 {
-	if( mDirty )
+	// uvs added to the spritemap since the last upload change the vertices too
+	if( mDirty || (m_spritemap != NULL && m_spritemap->GetVersion() != mSpritemapVersion) )
 	{
 		updateSpriteMesh( device );
 		mDirty = false;
 	}
 
-	EffectTechnique t = m_shader.GetTechniqueByName(technique);
-	TextureSampler sampler = t.GetSamplerByName("BlitTexture");
-	VectorConstant posScale = t.GetVectorConstant("PositionScale");
 	if( m_texture.IsValid() )
 	{
-		sampler.Set( m_texture );
+		device.SetSampler( m_blitTexture, m_texture );
 	}
 	else
 	{
-		sampler.Set( m_spritemap->GetTexture() );
+		Texture2D mapTexture = m_spritemap->GetTexture();
+		device.SetSampler( m_blitTexture, mapTexture );
 	}
 
-	posScale.Set(D3DXVECTOR4(startPosition.x, startPosition.y, scale.x, scale.y));
-	posScale.Apply();
+	const float positionScale[4] = { startPosition.x(), startPosition.y(), scale.x(), scale.y() };
+	device.SetConstant( m_positionScale, positionScale );
 
-	device.SetTechnique(t, 0);
+	device.SetTechnique(technique, 0);
 	device.SetInputLayout(m_inputLayout);
 	device.SetPrimitiveTopology(PRIMITIVE_TRIANGLES);
 
@@ -55,15 +79,27 @@ void SpriteRender::Draw( Device& device, D3DXVECTOR2 startPosition, D3DXVECTOR2
 	device.DrawIndexed(dp);
 }
 
-void SpriteRender::Release( Device& d )
+void SpriteRender::Release( IDevice& d )
 {
 	mSprites.destroy();
+	free( mUploadedSprites );
+	free( mUploadedUVs );
+	free( mVertexScratch );
+	free( mIDScratch );
+	free( mUVScratch );
+	mUploadedSprites = NULL;
+	mUploadedUVs = NULL;
+	mVertexScratch = NULL;
+	mIDScratch = NULL;
+	mUVScratch = NULL;
+	mUploadedCount = 0;
 	d.Release( m_spriteVb );
 	d.Release( m_spriteIb );
 	d.Release( m_inputLayout );
+	m_binding.Release();
 }
 
-bool SpriteRender::Create( Device& d, Parameters& p )
+bool SpriteRender::Create( IDevice& d, Parameters& p )
 {
 	if( !mSprites.init(p.mMaxSprites) )
 	{
@@ -74,67 +110,112 @@ bool SpriteRender::Create( Device& d, Parameters& p )
 	m_spritemap = p.spritemap;
 	m_texture = p.texture;
 
+	// resolve the shader variables once, Draw never looks anything up by name
+	m_binding.Create( d, m_shader );
+	m_blitTexture = m_binding.GetSampler( "BlitTexture" );
+	m_positionScale = m_binding.GetVectorConstant( "PositionScale" );
+
+	mUploadedSprites = (Sprite*)malloc( sizeof(Sprite) * p.mMaxSprites );
+	mUploadedUVs = (Vector2f*)malloc( sizeof(Vector2f) * 2 * p.mMaxSprites );
+	mVertexScratch = malloc( sizeof(SpriteVertex) * 4 * p.mMaxSprites );
+	mIDScratch = (unsigned int*)malloc( sizeof(unsigned int) * p.mMaxSprites );
+	mUVScratch = (Vector2f*)malloc( sizeof(Vector2f) * 2 * p.mMaxSprites );
+	mUploadedCount = 0;
+	if( mUploadedSprites == NULL || mUploadedUVs == NULL || mVertexScratch == NULL || mIDScratch == NULL || mUVScratch == NULL )
+	{
+		return false;
+	}
+
 	return initGraphics(d);
 }
 
-void SpriteRender::updateSpriteMesh( Device& dd )
+void SpriteRender::buildSpriteVertices( const Sprite& s, const Vector2f& uv0, const Vector2f& uv1, void* vertexData )
 {
-	// lock the vertex buffer
-	SpriteVertex* vertices = (SpriteVertex*)dd.LockVB(m_spriteVb);
+	SpriteVertex* vertices = (SpriteVertex*)vertexData;
 
-	int tilesDrawn=0;
-	for(unsigned int a=0;a<mSprites.size();++a)
-	{
-		int sid = mSprites[a]->spriteID;
-		D3DXVECTOR2 uv0(0.0f,0.0f); 
-		D3DXVECTOR2 uv1(1.0f,1.0f);
-		
-		if( m_spritemap != NULL )
-		{
-			m_spritemap->GetSprite(sid,uv0,uv1);
-		}
+	SpriteVertex v;
+	Vector2f pos = s.position;
+	Vector2f scale = s.scale;
 
-		SpriteVertex v;
-		// push a quad for each tile
-		D3DXVECTOR2 pos = mSprites[a]->position;
-		D3DXVECTOR2 scale = mSprites[a]->scale;
+	v.mPosition = pos + Vector2f(0.0f, 0.0f);		v.mUV = Vector2f(uv0.x(),uv1.y());
+	*vertices = v;	++vertices;
 
-		v.mPosition = pos + D3DXVECTOR2(0.0f, 0.0f);		v.mUV = D3DXVECTOR2(uv0.x,uv1.y);
-		*vertices = v;	++vertices;
+	v.mPosition = pos + Vector2f(scale.x(), 0.0f);		v.mUV = uv1;
+	*vertices = v;	++vertices;
+		
+	v.mPosition = pos + scale;	v.mUV = Vector2f(uv1.x(),uv0.y());
+	*vertices = v;	++vertices;			
 
-		v.mPosition = pos + D3DXVECTOR2(scale.x, 0.0f);		v.mUV = uv1;
-		*vertices = v;	++vertices;
-			
-		v.mPosition = pos + scale;	v.mUV = D3DXVECTOR2(uv1.x,uv0.y);
-		*vertices = v;	++vertices;			
+	v.mPosition = pos + Vector2f(0.0f, scale.y());		v.mUV = uv0;	
+	*vertices = v;
+}
 
-		v.mPosition = pos + D3DXVECTOR2(0.0f, scale.y);		v.mUV = uv0;	
-		*vertices = v;	++vertices;
-		++tilesDrawn;
-	}
+void SpriteRender::updateSpriteMesh( IDevice& dd )
+{
+	// upload each run of sprites that differ from what is already in the vertex buffer
+	const int spriteCount = (int)mSprites.size();
+	const unsigned int quadSize = sizeof(SpriteVertex) * 4;
+	const int maxSprites = (int)mSprites.maxSize();
 
-	dd.UnlockVB(m_spriteVb);
+	// the uvs are part of what is uploaded, so look them all up first
+	Vector2f* uv0s = mUVScratch;
+	Vector2f* uv1s = mUVScratch + maxSprites;
+	if( m_spritemap != NULL )
+	{
+		for( int i = 0; i < spriteCount; ++i )
+		{
+			mIDScratch[i] = (unsigned int)mSprites[i]->spriteID;
+		}
+		m_spritemap->GetSprites( mIDScratch, spriteCount, uv0s, uv1s );
+		mSpritemapVersion = m_spritemap->GetVersion();
+	}
+	else
+	{
+		for( int i = 0; i < spriteCount; ++i )
+		{
+			uv0s[i] = Vector2f(0.0f,0.0f);
+			uv1s[i] = Vector2f(1.0f,1.0f);
+		}
+	}
 
-	unsigned short *indices = (unsigned short*)dd.LockIB(m_spriteIb);
-	for(int tile=0;tile<tilesDrawn;++tile)
+	int a = 0;
+	while( a < spriteCount )
 	{
-		int i=tile*4;
-		unsigned short *ind = indices;	
-		
-		*(ind + 0) = i + 0;	
-		*(ind + 1) = i + 2;	
-		*(ind + 2) = i + 1;	
-		*(ind + 3) = i + 0;	
-		*(ind + 4) = i + 3;	
-		*(ind + 5) = i + 2;	
+		if( !isSpriteDirty( a, uv0s[a], uv1s[a] ) )
+		{
+			++a;
+			continue;
+		}
+
+		const int runStart = a;
+		SpriteVertex* vertices = (SpriteVertex*)mVertexScratch;
+		while( a < spriteCount && isSpriteDirty( a, uv0s[a], uv1s[a] ) )
+		{
+			buildSpriteVertices( *mSprites[a], uv0s[a], uv1s[a], vertices );
+			mUploadedSprites[a] = *mSprites[a];
+			mUploadedUVs[a * 2] = uv0s[a];
+			mUploadedUVs[a * 2 + 1] = uv1s[a];
+			vertices += 4;
+			++a;
+		}
+		const int runLength = a - runStart;
 
-		indices = indices + 6;
+		dd.UpdateVB( m_spriteVb, mVertexScratch, runStart * quadSize, runLength * quadSize );
 	}
 
-	dd.UnlockIB(m_spriteIb);
+	// anything past the end is simply not drawn
+	mUploadedCount = spriteCount;
 }
 
-bool SpriteRender::initGraphics(Device& d)
+bool SpriteRender::isSpriteDirty( int index, const Vector2f& uv0, const Vector2f& uv1 )
+{
+	return index >= mUploadedCount
+		|| *mSprites[index] != mUploadedSprites[index]
+		|| uv0 != mUploadedUVs[index * 2]
+		|| uv1 != mUploadedUVs[index * 2 + 1];
+}
+
+bool SpriteRender::initGraphics(IDevice& d)
 {
 	VertexElement e;
 	e.byteOffset=0;
@@ -142,7 +223,7 @@ bool SpriteRender::initGraphics(Device& d)
 	e.format = VertexElement::VTX_FLOAT2;
 	e.SetSemanticName("POSITION");
 	m_vd.AddElement(e);
-	e.byteOffset += sizeof(D3DXVECTOR2);
+	e.byteOffset += sizeof(Vector2f);
 	e.SetSemanticName("TEXCOORD");
 	m_vd.AddElement(e);
 
@@ -153,18 +234,35 @@ bool SpriteRender::initGraphics(Device& d)
 
 	VertexBuffer::Parameters vbParams;
 	vbParams.sourceBuffer = NULL;
-	vbParams.access = VertexBuffer::CpuWrite;	// we want to write to the buffer
+	vbParams.access = VertexBuffer::CpuNoAccess;	// dirty ranges are written with UpdateVB
 	vbParams.stride = vertexSize;
 	vbParams.vertexCount = numVerts;
 	vbParams.vertexSize = vertexSize;
 	m_spriteVb = d.CreateVB( vbParams );
 
+	// the indices only depend on the sprite index, so build them once for every sprite
+	const unsigned int maxSprites = (unsigned int)mSprites.maxSize();
+	unsigned short* indices = new unsigned short[maxSprites * 6];
+	for(unsigned int tile=0;tile<maxSprites;++tile)
+	{
+		unsigned short i=(unsigned short)(tile*4);
+		unsigned short *ind = indices + tile*6;
+		
+		*(ind + 0) = i + 0;	
+		*(ind + 1) = i + 2;	
+		*(ind + 2) = i + 1;	
+		*(ind + 3) = i + 0;	
+		*(ind + 4) = i + 3;	
+		*(ind + 5) = i + 2;	
+	}
+
 	IndexBuffer::Parameters ibParams;
 	ibParams.format = IndexBuffer::IB_16BIT;
-	ibParams.indexCount = (unsigned int)mSprites.maxSize() * 6;
-	ibParams.sourceBuffer = NULL;
-	ibParams.access = IndexBuffer::CpuWrite;	// we want to write to the buffer
+	ibParams.indexCount = maxSprites * 6;
+	ibParams.sourceBuffer = indices;
+	ibParams.access = IndexBuffer::CpuNoAccess;	// never changes
 	m_spriteIb = d.CreateIB( ibParams );
+	delete [] indices;
 
 	// Create the input layout
 	m_inputLayout = d.CreateVertexInputLayout( m_shader, m_vd );	
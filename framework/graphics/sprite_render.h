@@ -3,7 +3,10 @@
 
 #include "core\array.h"
 #include "framework\graphics\device_types.h"
+#include "framework\graphics\effect_binding.h"
+#include "core\vector2.h"
 
+class IDevice;
 class Spritemap;
 
 class SpriteRender
@@ -23,37 +26,71 @@ public:
 		Texture2D texture;
 	};
 
+	SpriteRender();
+
 	void RemoveSprites();
 
-	void AddSprite( int spriteID, D3DXVECTOR2 position, D3DXVECTOR2 scale=D3DXVECTOR2(1.0f,1.0f) );
-	void Draw( Device& device, D3DXVECTOR2 startPosition, D3DXVECTOR2 scale, const char* technique );
+	void AddSprite( int spriteID, Vector2f position, Vector2f scale=Vector2f(1.0f,1.0f) );
+	void SetSprite( int index, int spriteID, Vector2f position, Vector2f scale=Vector2f(1.0f,1.0f) );
+
+	inline int GetSpriteCount() const
+	{
+		return (int)mSprites.size();
+	}
+
+	// the technique must come from the same effect, see GetBinding
+	void Draw( IDevice& device, Vector2f startPosition, Vector2f scale, EffectTechnique& technique );
 
-	bool Create( Device& d, Parameters& p );
-	void Release( Device& d );
+	bool Create( IDevice& d, Parameters& p );
+	void Release( IDevice& d );
 
 	inline Texture2D& GetTexture()
 	{
 		return m_texture;
 	}
 
+	inline const EffectBinding& GetBinding() const
+	{
+		return m_binding;
+	}
+
 private:
 
 	struct Sprite
 	{
-		D3DXVECTOR2 position;
-		D3DXVECTOR2 scale;
+		Vector2f position;
+		Vector2f scale;
 		int spriteID;
+
+		inline bool operator!=( const Sprite& s ) const
+		{
+			return position != s.position || scale != s.scale || spriteID != s.spriteID;
+		}
 	};
 
-	void updateSpriteMesh( Device& d );
-	bool initGraphics(Device& d);
+	void updateSpriteMesh( IDevice& d );
+	bool isSpriteDirty( int index, const Vector2f& uv0, const Vector2f& uv1 );
+	void buildSpriteVertices( const Sprite& s, const Vector2f& uv0, const Vector2f& uv1, void* vertices );
+	bool initGraphics(IDevice& d);
 
 	bool mDirty;
 	Array<Sprite> mSprites;
 
+	// copy of the sprites and uvs currently in the vertex buffer, so only changed ranges are uploaded
+	Sprite* mUploadedSprites;
+	Vector2f* mUploadedUVs;	// uv0 and uv1 of each sprite
+	int mUploadedCount;
+	unsigned int mSpritemapVersion;
+	void* mVertexScratch;	// vertices for one dirty range
+	unsigned int* mIDScratch;	// sprite ids of every sprite
+	Vector2f* mUVScratch;	// uv0s then uv1s of every sprite
+
 	Spritemap* m_spritemap;
 	Texture2D m_texture;
 	Effect m_shader;
+	EffectBinding m_binding;
+	TextureSampler m_blitTexture;
+	VectorConstant m_positionScale;
 	VertexDescriptor m_vd;
 	VertexBuffer m_spriteVb;
 	IndexBuffer m_spriteIb;
@@ -1,44 +1,80 @@
 #include "spritemap.h"
+#include <stdio.h>
 
 void Spritemap::Init(int maxSprites, Texture2D texture)
 {
-	mSprites.init(maxSprites);
+	mSprites.clear();
+	mSprites.reserve(maxSprites);
 
 	mTexture = texture;
+	++mVersion;
 }
 
 void Spritemap::Release()
 {
-	mSprites.destroy();
+	std::vector<Sprite>().swap(mSprites);
+	++mVersion;
 }
 
-void Spritemap::AddSprite(unsigned int id, D3DXVECTOR2 uv0, D3DXVECTOR2 uv1)
+void Spritemap::AddSprite(unsigned int id, Vector2f uv0, Vector2f uv1)
 {
-	for(unsigned int s=0;s<mSprites.size();++s)
+	if( id >= kMaxSpriteID )
 	{
-		if( mSprites[s]->mID==id )
-		{
-			return;
-		}
+		printf("Sprite id %u is too large for the spritemap\n", id);
+		return;
+	}
+
+	if( id >= mSprites.size() )
+	{
+		Sprite empty;
+		empty.mValid = false;
+		mSprites.resize( id + 1, empty );
+	}
+
+	Sprite& spr = mSprites[id];
+	if( spr.mValid )
+	{
+		return;
 	}
 
-	Sprite spr;
-	spr.mID = id;
 	spr.mUV0 = uv0;
 	spr.mUV1 = uv1;
-	mSprites.push_back(spr);
+	spr.mValid = true;
+	++mVersion;
+}
+
+bool Spritemap::GetSprite(unsigned int id, Vector2f& uv0, Vector2f& uv1) const
+{
+	if( id < mSprites.size() && mSprites[id].mValid )
+	{
+		uv0 = mSprites[id].mUV0;
+		uv1 = mSprites[id].mUV1;
+		return true;
+	}
+	return false;
 }
 
-bool Spritemap::GetSprite(unsigned int id, D3DXVECTOR2& uv0, D3DXVECTOR2& uv1)
+int Spritemap::GetSprites(const unsigned int* ids, int count, Vector2f* uv0s, Vector2f* uv1s) const
 {
-	for(unsigned int s=0;s<mSprites.size();++s)
+	const unsigned int tableSize = (unsigned int)mSprites.size();
+	const Sprite* table = tableSize > 0 ? &mSprites[0] : NULL;
+
+	int found = 0;
+	for(int i=0;i<count;++i)
 	{
-		if( mSprites[s]->mID==id )
+		const unsigned int id = ids[i];
+		if( id < tableSize && table[id].mValid )
 		{
-			uv0 = mSprites[s]->mUV0;
-			uv1 = mSprites[s]->mUV1;
-			return true;
+			uv0s[i] = table[id].mUV0;
+			uv1s[i] = table[id].mUV1;
+			++found;
+		}
+		else
+		{
+			uv0s[i] = Vector2f(0.0f,0.0f);
+			uv1s[i] = Vector2f(1.0f,1.0f);
 		}
 	}
-	return false;
-}
\ No newline at end of file
+
+	return found;
+}
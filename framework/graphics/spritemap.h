@@ -1,32 +1,52 @@
 #ifndef SPRITE_MAP_INCLUDED
 #define SPRITE_MAP_INCLUDED
 
-#include "core\array.h"
+#include "core\containers.h"
 #include "framework\graphics\device_types.h"
+#include "core\vector2.h"
 
+// UV table for a texture atlas
+// Sprite IDs index the table directly, so they should be small and dense (atlas cell indices)
 class Spritemap
 {
 public:
+	static const unsigned int kMaxSpriteID = 1 << 20;
+
+	Spritemap()
+		: mVersion(0)
+	{
+	}
+
 	void Init(int maxSprites, Texture2D texture);
 	void Release();
-	void AddSprite(unsigned int id, D3DXVECTOR2 uv0, D3DXVECTOR2 uv1);
-	bool GetSprite(unsigned int id, D3DXVECTOR2& uv0, D3DXVECTOR2& uv1);
+	void AddSprite(unsigned int id, Vector2f uv0, Vector2f uv1);
+	bool GetSprite(unsigned int id, Vector2f& uv0, Vector2f& uv1) const;
+
+	// looks up count ids at once. Unknown ids get the whole texture (0,0)-(1,1)
+	// returns the number of ids found
+	int GetSprites(const unsigned int* ids, int count, Vector2f* uv0s, Vector2f* uv1s) const;
 
 	inline Texture2D GetTexture()
 	{
 		return mTexture;
 	}
+
+	// changes whenever a uv in the table might have, so users can tell their copies are stale
+	inline unsigned int GetVersion() const
+	{
+		return mVersion;
+	}
 private:
-	class Sprite
+	struct Sprite
 	{
-	public:
-		D3DXVECTOR2 mUV0;
-		D3DXVECTOR2 mUV1;
-		unsigned int mID;
+		Vector2f mUV0;
+		Vector2f mUV1;
+		bool mValid;
 	};
 
-	Array<Sprite> mSprites;
+	std::vector<Sprite> mSprites;	// indexed by id
 	Texture2D mTexture;
+	unsigned int mVersion;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,84 @@
+#include "transient_targets.h"
+#include "idevice.h"
+#include <stdio.h>
+
+TransientTargets::TransientTargets()
+	: mDevice(NULL)
+{
+}
+
+TransientTargets::~TransientTargets()
+{
+}
+
+void TransientTargets::Create( IDevice* d )
+{
+	mDevice = d;
+}
+
+void TransientTargets::Release()
+{
+	for( std::vector<Entry*>::iterator it = mEntries.begin(); it != mEntries.end(); ++it )
+	{
+		Entry* e = *it;
+		if( e->mInUse )
+		{
+			printf("Transient target (%dx%d) was never returned\n", e->mTarget.mWidth, e->mTarget.mHeight);
+		}
+
+		mDevice->Release( e->mTarget.mRT );
+		mDevice->Release( e->mTarget.mTexture );
+		delete e;
+	}
+	mEntries.clear();
+}
+
+TransientTargets::Target* TransientTargets::Acquire( int width, int height, Texture2D::TextureFormat format )
+{
+	for( std::vector<Entry*>::iterator it = mEntries.begin(); it != mEntries.end(); ++it )
+	{
+		Entry* e = *it;
+		if( !e->mInUse && e->mFormat == format && e->mTarget.mWidth == width && e->mTarget.mHeight == height )
+		{
+			e->mInUse = true;
+			return &e->mTarget;
+		}
+	}
+
+	// nothing compatible is free, make a new one
+	Texture2D::Parameters tp;
+	tp.access = Texture2D::CpuNoAccess;
+	tp.bindFlags = Texture2D::BindAsShaderResource | Texture2D::BindAsRenderTarget;
+	tp.format = format;
+	tp.height = height;
+	tp.width = width;
+	tp.msaaCount = 1;
+	tp.msaaQuality = 0;
+	tp.numMips = 1;
+
+	Entry* e = new Entry;
+	e->mTarget.mTexture = mDevice->CreateTexture( tp );
+
+	Rendertarget::Parameters rtp;
+	rtp.target = e->mTarget.mTexture;
+	e->mTarget.mRT = mDevice->CreateRendertarget( rtp );
+	e->mTarget.mWidth = width;
+	e->mTarget.mHeight = height;
+	e->mFormat = format;
+	e->mInUse = true;
+	mEntries.push_back( e );
+
+	return &e->mTarget;
+}
+
+void TransientTargets::Return( Target* t )
+{
+	for( std::vector<Entry*>::iterator it = mEntries.begin(); it != mEntries.end(); ++it )
+	{
+		if( &(*it)->mTarget == t )
+		{
+			(*it)->mInUse = false;
+			return;
+		}
+	}
+}
\ No newline at end of file
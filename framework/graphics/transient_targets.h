@@ -0,0 +1,58 @@
+#ifndef TRANSIENT_TARGETS_INCLUDED
+#define TRANSIENT_TARGETS_INCLUDED
+
+#include "device_types.h"
+#include "core\containers.h"
+
+class IDevice;
+
+// Allocator for post-processing colour targets that are only needed for part of a frame
+// Acquire a target before its first write and Return it after its last read (in recording order).
+// A returned target is handed to the next Acquire with the same size and format, so intermediates
+// whose lifetimes don't overlap alias one allocation. Nothing is freed until Release.
+// Post-processing never depth tests, so no depth buffers are created
+class TransientTargets
+{
+public:
+	struct Target
+	{
+		Texture2D mTexture;
+		Rendertarget mRT;
+		int mWidth;
+		int mHeight;
+	};
+
+	TransientTargets();
+	~TransientTargets();
+
+	void Create( IDevice* d );
+	void Release();	// everything should have been returned
+
+	// usually a command list, swapped each frame
+	inline void SetDevice( IDevice* d )
+	{
+		mDevice = d;
+	}
+
+	Target* Acquire( int width, int height, Texture2D::TextureFormat format );
+	void Return( Target* t );
+
+	// number of targets actually created
+	inline int GetAllocationCount() const
+	{
+		return (int)mEntries.size();
+	}
+
+private:
+	struct Entry
+	{
+		Target mTarget;
+		Texture2D::TextureFormat mFormat;
+		bool mInUse;
+	};
+
+	IDevice* mDevice;
+	std::vector<Entry*> mEntries;	// pointers, so handed out targets never move
+};
+
+#endif
\ No newline at end of file
@@ -2,7 +2,7 @@
 #define VERTEX_DESCRIPTOR_INCLUDED
 
 #include <list>
-#include <D3D10.h>
+#include <string.h>
 
 class Device;
 
@@ -10,9 +10,9 @@ struct VertexElement
 {
 	enum Format
 	{
-		VTX_FLOAT2 = DXGI_FORMAT_R32G32_FLOAT,
-		VTX_FLOAT3 = DXGI_FORMAT_R32G32B32_FLOAT,
-		VTX_FLOAT4 = DXGI_FORMAT_R32G32B32A32_FLOAT,
+		VTX_FLOAT2 = 16,	// same values as the DXGI formats
+		VTX_FLOAT3 = 6,
+		VTX_FLOAT4 = 2,
 	};
 
 	static inline unsigned int GetVertexFormatSize(unsigned int f)
@@ -20,13 +20,13 @@ struct VertexElement
 		switch(f)
 		{
 		case VTX_FLOAT2:
-			return sizeof(D3DXVECTOR2);
+			return sizeof(float) * 2;
 			break;
 		case VTX_FLOAT3:
-			return sizeof(D3DXVECTOR3);
+			return sizeof(float) * 3;
 			break;
 		case VTX_FLOAT4:
-			return sizeof(D3DXVECTOR4);
+			return sizeof(float) * 4;
 			break;
 		default:
 			return 0;
@@ -69,8 +69,8 @@ struct VertexElement
 	
 	enum ElementType
 	{
-		PerVertex = D3D10_INPUT_PER_VERTEX_DATA,
-		PerInstance = D3D10_INPUT_PER_INSTANCE_DATA
+		PerVertex = 0,
+		PerInstance = 1
 	};
 
 	ElementType elementType;
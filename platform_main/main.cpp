@@ -62,17 +62,22 @@ bool parseD3DConfig( HINSTANCE hInst, Config& cfg, D3DAppConfig& config )
 	ConfigElement<unsigned int>* Bpp = NULL;
 	ConfigElement<std::string>* Name = NULL;
 	ConfigElement<bool>* Fullscreen = NULL;
+	ConfigElement<bool>* Headless = NULL;
 
 	cfg.getElement("Application.Window.WindowTitle", &Name);
 	cfg.getElement("Application.Window.Width", &Width);
 	cfg.getElement("Application.Window.Height", &Height);
 	cfg.getElement("Application.Window.Bpp", &Bpp);
 	cfg.getElement("Application.Window.Fullscreen", &Fullscreen);
+	cfg.getElement("Application.Window.Headless", &Headless);
 
 	if( Name && Width && Height && Bpp && Fullscreen )
 	{
 		config = D3DAppConfig( Width->getValue(), Height->getValue(), Bpp->getValue(), Fullscreen->getValue(), Name->getValue(), hInst );
 
+		// optional, older configs don't have it
+		config.m_headless = Headless != NULL && Headless->getValue();
+
 		return true;
 	}
 